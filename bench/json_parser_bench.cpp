@@ -0,0 +1,125 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "json_parser.h"
+#include "CppUtility.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+using namespace std;
+using namespace json_parser;
+
+// The flat parser json_parser::parse used before the structural scan, kept here as the baseline.
+static string_view legacy_read_word(const string& buffer, size_t& offset, const char* start_delimiter,
+                                   const char* end_delimiter) {
+    bool found_first_letter = false;
+    size_t start = offset;
+    if(start == buffer.size())
+        return {};
+    for(size_t i = offset; i < buffer.size(); i++) {
+        if(!found_first_letter) {
+            if(strchr(start_delimiter, buffer[i])) {
+                found_first_letter = true;
+                start = i;
+            }
+        } else if(strchr(end_delimiter, buffer[i])) {
+            offset = i + 1;
+            return { &buffer[start], i - start };
+        }
+    }
+    offset = buffer.size();
+    return { &buffer[start], buffer.size() - start };
+}
+
+static unordered_map<string, string> legacy_parse(const string& json) {
+    unordered_map<string, string> result;
+    string field_name;
+    bool fetching_name = true;
+    size_t offset = 0;
+    while(true) {
+        auto word = fetching_name ? legacy_read_word(json, offset, "\"", "\"")
+                                  : legacy_read_word(json, offset, ":", ",}");
+        if(word.empty())
+            break;
+        if(fetching_name)
+            field_name = word;
+        else
+            result[field_name] = word;
+        fetching_name = !fetching_name;
+    }
+    return result;
+}
+
+// A small request body, like the ones the route handlers bind.
+static string small_body() {
+    return R"({"range": 600, "tail": 120, "metric": "cpu", "resource": "/Dynamic", "name": "a \"b\"", "flag": true})";
+}
+
+// Metric history as /metrics/history answers it: a few arrays of numbers.
+static string history_body() {
+    string json = R"({"interval": 1, "tier": 0, "metrics": {)";
+    for(const char* metric : { "cpu", "memory", "network_in", "network_out" }) {
+        if(json.back() != '{')
+            json += ", ";
+        json += "\"" + string(metric) + "\": [";
+        for(int i = 0; i < 3600; i++)
+            json += (i ? ", " : "") + to_string(double(i * 37 % 1000) / 7);
+        json += "]";
+    }
+    return json + "}}";
+}
+
+// ~64 MB of small records, the object the on-demand access is made for.
+static string records_body() {
+    string json = "{";
+    for(size_t i = 0; json.size() < 64 * 1024 * 1024; i++) {
+        if(i)
+            json += ",\n  ";
+        auto id = to_string(i);
+        json += "\"item" + id + "\": {\"id\": " + id + ", \"name\": \"user \\\"" + id + "\\\"\", \"score\": " +
+                to_string(double(i % 1000) / 7) + ", \"tags\": [\"alpha\", \"beta\", \"gamma\"], \"active\": " +
+                (i % 2 ? "true" : "false") + ", \"parent\": null}";
+    }
+    return json + "}";
+}
+
+// Runs every parser over about 256 MB of the body.
+static void benchmark(const char* name, const string& json, string_view key) {
+    size_t passes = max<size_t>(1, 256 * 1024 * 1024 / json.size());
+    auto measure = [&](const char* parser, auto&& run) {
+        size_t checksum = 0;
+        auto start = chrono::steady_clock::now();
+        for(size_t i = 0; i < passes; i++)
+            checksum += run();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double rate = double(json.size()) * double(passes) / seconds / 1e9;
+        LOG(INFO, "  {}: {} GB/s ({})", parser, round(rate * 100) / 100, checksum);
+    };
+
+    LOG(INFOBOLD, "{}, {} x {}", name, passes, cpp::FriendlyMemorySize(double(json.size())));
+    vector<uint32_t> structurals;
+    json_document document;
+    json_on_demand on_demand;
+    measure("legacy flat parser", [&] { return legacy_parse(json).size(); });
+    measure("json_parser::parse", [&] { return parse(json).size(); });
+    for(auto kernel : SupportedKernels()) {
+        string label = "stage 1, " + string(kernel);
+        measure(label.c_str(), [&] { FindStructurals(json, structurals, kernel); return structurals.size(); });
+    }
+    measure("json_document::Parse", [&] { document.Parse(json); return document.Root().Size(); });
+    measure("json_on_demand, one member", [&] {
+        on_demand.Parse(json);
+        return size_t(on_demand.Root()[key].Exists());
+    });
+}
+
+int main() {
+    LOG(INFOBOLD, "JSON parser benchmark, {} kernel selected.", KernelName());
+    benchmark("small request body", small_body(), "metric");
+    benchmark("metric history", history_body(), "metrics");
+    benchmark("64 MB of records", records_body(), "item1000");
+    return 0;
+}
@@ -0,0 +1,143 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "buffer_pool.h"
+#include "CppUtility.hpp"
+#include <new>
+#include <bit>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+// Large free buffers beyond this are handed back to the system instead of being cached.
+static constexpr size_t MaxCachedLargeBytes = 64 * 1024 * 1024;
+
+buffer_pool &buffer_pool::Global() {
+    static buffer_pool pool;
+    return pool;
+}
+
+buffer_pool::buffer_pool(bool use_huge_pages) : m_use_huge_pages(use_huge_pages) {}
+
+buffer_pool::~buffer_pool() {
+    for(int size_class = 0; size_class < ClassCount; size_class++) {
+        if((MinBufferSize << size_class) <= MaxArenaBufferSize)
+            continue; // part of an arena
+        for(auto* buffer : m_free[size_class])
+            ::operator delete(buffer);
+    }
+    for(auto [memory, mapped] : m_arenas) {
+#ifndef _WIN32
+        if(mapped) {
+            munmap(memory, ArenaSize);
+            continue;
+        }
+#endif
+        ::operator delete(memory);
+    }
+}
+
+void buffer_pool::EnableHugePages(bool enable) {
+    lock_guard guard(m_lock);
+    m_use_huge_pages = enable;
+}
+
+int buffer_pool::SizeClass(size_t size) {
+    if(size <= MinBufferSize)
+        return 0;
+    int size_class = int(bit_width(size - 1)) - int(bit_width(MinBufferSize - 1));
+    return size_class < ClassCount ? size_class : -1;
+}
+
+size_t buffer_pool::Capacity(size_t size) {
+    int size_class = SizeClass(size);
+    return size_class < 0 ? size : MinBufferSize << size_class;
+}
+
+void buffer_pool::AllocateArena(int size_class) {
+    void* memory = nullptr;
+    bool mapped = false;
+#ifndef _WIN32
+    if(m_use_huge_pages && m_huge_pages_available) {
+        memory = mmap(nullptr, ArenaSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(memory == MAP_FAILED) {
+            LOG(WARNING, "No hugepages reserved (vm.nr_hugepages), receive buffers use regular pages.");
+            m_huge_pages_available = false;
+            memory = nullptr;
+        } else {
+            mapped = true;
+        }
+    }
+#endif
+    if(!memory)
+        memory = ::operator new(ArenaSize);
+    m_arenas.emplace_back(memory, mapped);
+
+    size_t buffer_size = MinBufferSize << size_class;
+    auto* base = static_cast<uint8_t*>(memory);
+    for(size_t offset = 0; offset + buffer_size <= ArenaSize; offset += buffer_size) {
+        m_free[size_class].push_back(base + offset);
+    }
+    m_cached_bytes += ArenaSize;
+}
+
+uint8_t *buffer_pool::Borrow(size_t size) {
+    int size_class = SizeClass(size);
+    if(size_class < 0)
+        return static_cast<uint8_t*>(::operator new(size));
+
+    size_t capacity = MinBufferSize << size_class;
+    lock_guard guard(m_lock);
+    auto& free = m_free[size_class];
+    if(free.empty()) {
+        if(capacity <= MaxArenaBufferSize) {
+            AllocateArena(size_class);
+        } else {
+            free.push_back(static_cast<uint8_t*>(::operator new(capacity)));
+            m_cached_bytes += capacity;
+        }
+    }
+    auto* buffer = free.back();
+    free.pop_back();
+    m_cached_bytes -= capacity;
+    m_borrowed++;
+    m_borrowed_bytes += capacity;
+    return buffer;
+}
+
+void buffer_pool::Return(uint8_t *buffer, size_t size) {
+    if(!buffer)
+        return;
+    int size_class = SizeClass(size);
+    if(size_class < 0) {
+        ::operator delete(buffer);
+        return;
+    }
+    size_t capacity = MinBufferSize << size_class;
+    lock_guard guard(m_lock);
+    m_borrowed--;
+    m_borrowed_bytes -= capacity;
+    if(capacity > MaxArenaBufferSize && m_cached_bytes + capacity > MaxCachedLargeBytes) {
+        ::operator delete(buffer);
+        return;
+    }
+    m_free[size_class].push_back(buffer);
+    m_cached_bytes += capacity;
+}
+
+buffer_pool_stats buffer_pool::Stats() {
+    lock_guard guard(m_lock);
+    buffer_pool_stats stats;
+    stats.Borrowed = m_borrowed;
+    stats.BorrowedBytes = m_borrowed_bytes;
+    stats.CachedBytes = m_cached_bytes;
+    stats.ArenaBytes = m_arenas.size() * ArenaSize;
+    for(auto [memory, mapped] : m_arenas) {
+        stats.HugePages |= mapped;
+    }
+    return stats;
+}
@@ -0,0 +1,66 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_BUFFER_POOL_H
+#define WEBCLIENT_BUFFER_POOL_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <mutex>
+
+struct buffer_pool_stats {
+    size_t Borrowed = 0;        // buffers currently handed out
+    size_t BorrowedBytes = 0;
+    size_t CachedBytes = 0;     // free buffers kept for reuse
+    size_t ArenaBytes = 0;      // memory reserved for the small size classes
+    bool HugePages = false;
+};
+
+/*
+ * Receive buffers in power of two size classes (4 KB .. 16 MB). Classes up to 64 KB are carved out of 2 MB arenas,
+ * which are hugepage backed when available and enabled, larger buffers are allocated one by one. Released buffers
+ * go to a per-class free list, so borrowing on every readable socket is a pop from a vector.
+ * Thread-safe.
+ */
+class buffer_pool {
+public:
+    static constexpr size_t MinBufferSize = 4 * 1024;
+    static constexpr size_t MaxArenaBufferSize = 64 * 1024;
+    static constexpr size_t ArenaSize = 2 * 1024 * 1024;
+
+    static buffer_pool& Global();
+
+    explicit buffer_pool(bool use_huge_pages = false);
+    ~buffer_pool();
+
+    buffer_pool(const buffer_pool&) = delete;
+    buffer_pool& operator=(const buffer_pool&) = delete;
+
+    // Only affects arenas allocated from now on, needs hugepages reserved by the system (vm.nr_hugepages).
+    void EnableHugePages(bool enable);
+
+    // The returned buffer holds at least size bytes, Capacity(size) of them. Its content is uninitialized.
+    uint8_t* Borrow(size_t size);
+    void Return(uint8_t* buffer, size_t size);
+
+    static size_t Capacity(size_t size);
+    [[nodiscard]] buffer_pool_stats Stats();
+
+private:
+    static int SizeClass(size_t size);
+    void AllocateArena(int size_class);
+
+private:
+    static constexpr int ClassCount = 13; // 4 KB << 12 = 16 MB
+    std::mutex m_lock;
+    std::vector<uint8_t*> m_free[ClassCount];
+    std::vector<std::pair<void*, bool>> m_arenas; // memory, mapped with MAP_HUGETLB
+    bool m_use_huge_pages;
+    bool m_huge_pages_available = true;
+    size_t m_borrowed = 0;
+    size_t m_borrowed_bytes = 0;
+    size_t m_cached_bytes = 0;
+};
+
+#endif //WEBCLIENT_BUFFER_POOL_H
@@ -0,0 +1,96 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "chunk_compressor.h"
+#include "file_transfer_protocol.h"
+#include <algorithm>
+
+using namespace std;
+
+chunk_compressor::chunk_compressor(size_t workers) {
+    workers = clamp<size_t>(workers, 1, MaxWorkers);
+    m_slots.resize(2 * workers);
+    for(auto& slot : m_slots)
+        slot.Data.resize(file_transfer::DataChunkSize);
+    for(size_t i = 0; i < workers; i++)
+        m_workers.emplace_back([this] { Work(); });
+}
+
+chunk_compressor::~chunk_compressor() {
+    {
+        lock_guard guard(m_lock);
+        m_running = false;
+    }
+    m_work.notify_all();
+    for(auto& worker : m_workers)
+        worker.join();
+}
+
+span<uint8_t> chunk_compressor::Next() {
+    return m_slots[(m_head + m_count) % m_slots.size()].Data;
+}
+
+void chunk_compressor::Submit(uint32_t file_id, uint64_t offset, size_t length) {
+    size_t index = (m_head + m_count) % m_slots.size();
+    auto& slot = m_slots[index];
+    slot.FileId = file_id;
+    slot.Offset = offset;
+    slot.Length = length;
+    m_count++;
+    {
+        lock_guard guard(m_lock);
+        slot.Done = false;
+        m_queue.push_back(index);
+    }
+    m_work.notify_one();
+}
+
+span<const uint8_t> chunk_compressor::Front() {
+    auto& slot = m_slots[m_head];
+    unique_lock lock(m_lock);
+    m_done.wait(lock, [&] { return slot.Done; });
+    return slot.Frame;
+}
+
+void chunk_compressor::Pop() {
+    auto& slot = m_slots[m_head];
+    m_raw_bytes += slot.Length;
+    m_frame_bytes += slot.Frame.size();
+    m_head = (m_head + 1) % m_slots.size();
+    m_count--;
+}
+
+void chunk_compressor::Clear() {
+    unique_lock lock(m_lock);
+    // chunks no worker took yet are dropped, the others are finished before their slots are reused
+    for(size_t index : m_queue)
+        m_slots[index].Done = true;
+    m_queue.clear();
+    m_done.wait(lock, [this] {
+        for(size_t i = 0; i < m_count; i++) {
+            if(!m_slots[(m_head + i) % m_slots.size()].Done)
+                return false;
+        }
+        return true;
+    });
+    m_head = 0;
+    m_count = 0;
+}
+
+void chunk_compressor::Work() {
+    unique_lock lock(m_lock);
+    while(true) {
+        m_work.wait(lock, [this] { return !m_running || !m_queue.empty(); });
+        if(!m_running)
+            return;
+        auto& slot = m_slots[m_queue.front()];
+        m_queue.pop_front();
+        lock.unlock();
+        slot.Frame.clear();
+        file_transfer::AppendDataFrame(slot.Frame, slot.FileId, slot.Offset, { slot.Data.data(), slot.Length }, true);
+        lock.lock();
+        slot.Done = true;
+        m_done.notify_all();
+    }
+}
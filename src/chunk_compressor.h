@@ -0,0 +1,70 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_CHUNK_COMPRESSOR_H
+#define WEBCLIENT_CHUNK_COMPRESSOR_H
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+/*
+ * Turns the chunks of a file into compressed FileData frames on a pool of worker threads, while the caller reads the
+ * next chunks and sends the finished ones, so the disk, the cores and the link are busy at the same time. Frames come
+ * out in the order their chunks went in, through a ring of 2 slots per worker: the caller fills a slot while it is
+ * !Full(), and sends and pops the oldest one otherwise.
+ */
+class chunk_compressor {
+public:
+    // Beyond this the link, not the compression, is the limit.
+    static constexpr size_t MaxWorkers = 8;
+
+    explicit chunk_compressor(size_t workers);
+    ~chunk_compressor();
+    chunk_compressor(const chunk_compressor&) = delete;
+    chunk_compressor& operator=(const chunk_compressor&) = delete;
+
+    // Buffer of DataChunkSize bytes to read the next chunk into, only while !Full().
+    [[nodiscard]] std::span<uint8_t> Next();
+    // Queues the chunk read into Next() for compression.
+    void Submit(uint32_t file_id, uint64_t offset, size_t length);
+    // The frame of the oldest chunk, waits for a worker to finish it. Only while !Empty().
+    [[nodiscard]] std::span<const uint8_t> Front();
+    void Pop();
+    // Waits for the chunks being compressed and drops every chunk in flight.
+    void Clear();
+
+    [[nodiscard]] bool Full() const { return m_count == m_slots.size(); }
+    [[nodiscard]] bool Empty() const { return m_count == 0; }
+    // Data and frame bytes of the chunks popped so far.
+    [[nodiscard]] uint64_t RawBytes() const { return m_raw_bytes; }
+    [[nodiscard]] uint64_t FrameBytes() const { return m_frame_bytes; }
+
+private:
+    struct slot {
+        std::vector<uint8_t> Data;
+        std::vector<uint8_t> Frame;
+        uint32_t FileId = 0;
+        uint64_t Offset = 0;
+        size_t Length = 0;
+        bool Done = false;
+    };
+    void Work();
+
+private:
+    std::vector<slot> m_slots;
+    size_t m_head = 0;  // oldest chunk in flight
+    size_t m_count = 0; // touched by the caller only, like m_head
+    uint64_t m_raw_bytes = 0, m_frame_bytes = 0;
+    std::deque<size_t> m_queue; // slots waiting for a worker
+    std::mutex m_lock;
+    std::condition_variable m_work, m_done;
+    std::vector<std::thread> m_workers;
+    bool m_running = true;
+};
+
+#endif //WEBCLIENT_CHUNK_COMPRESSOR_H
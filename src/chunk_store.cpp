@@ -0,0 +1,54 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "chunk_store.h"
+#include "CppUtility.hpp"
+#include <fstream>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+fs::path chunk_store::PathOf(const sha256::digest &hash) const {
+    auto name = sha256::ToHex(hash);
+    return m_directory / name.substr(0, 2) / name;
+}
+
+bool chunk_store::Read(const sha256::digest &hash, vector<uint8_t> &out) const {
+    ifstream file(PathOf(hash), ios::binary | ios::ate);
+    if(!file)
+        return false;
+    auto size = streamoff(file.tellg());
+    out.resize(size_t(size));
+    file.seekg(0);
+    if(!file.read(reinterpret_cast<char*>(out.data()), size))
+        return false;
+    if(sha256::Hash(out) != hash) {
+        LOG(WARNING, "Chunk {} is corrupted, it will be fetched again.", sha256::ToHex(hash));
+        return false;
+    }
+    return true;
+}
+
+bool chunk_store::Write(const sha256::digest &hash, span<const uint8_t> data) const {
+    auto path = PathOf(hash);
+    error_code ec;
+    if(fs::exists(path, ec))
+        return true;
+    fs::create_directories(path.parent_path(), ec);
+    auto temporary = path;
+    temporary += ".tmp";
+    {
+        ofstream file(temporary, ios::binary | ios::trunc);
+        if(!file.write(reinterpret_cast<const char*>(data.data()), streamsize(data.size()))) {
+            LOG(ERR, "Cannot store chunk {}.", sha256::ToHex(hash));
+            return false;
+        }
+    }
+    fs::rename(temporary, path, ec);
+    if(ec) {
+        LOG(ERR, "Cannot store chunk {}: {}", sha256::ToHex(hash), ec.message());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_CHUNK_STORE_H
+#define WEBCLIENT_CHUNK_STORE_H
+#include "sha256.h"
+#include <filesystem>
+#include <span>
+#include <vector>
+
+/*
+ * Content-addressed store of the chunks a receiver has seen, one file per chunk named by its SHA-256 under a
+ * directory per first byte ("ab/abcdef..."), like git's loose objects. Chunks are immutable, so they are written to
+ * a temporary name and renamed into place, and a chunk read back is hashed again before it is trusted.
+ */
+class chunk_store {
+public:
+    explicit chunk_store(std::filesystem::path directory) : m_directory(std::move(directory)) {}
+
+    // False if the chunk is missing or its file no longer matches its hash.
+    bool Read(const sha256::digest& hash, std::vector<uint8_t>& out) const;
+    bool Write(const sha256::digest& hash, std::span<const uint8_t> data) const;
+
+private:
+    [[nodiscard]] std::filesystem::path PathOf(const sha256::digest& hash) const;
+
+private:
+    std::filesystem::path m_directory;
+};
+
+#endif //WEBCLIENT_CHUNK_STORE_H
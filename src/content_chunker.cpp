@@ -0,0 +1,174 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "content_chunker.h"
+#include <array>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CONTENT_CHUNKER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CONTENT_CHUNKER_TARGET(x)
+#else
+#define CONTENT_CHUNKER_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+using namespace std;
+
+static constexpr size_t WindowSize = 32;
+// The high bits of the hash depend on the whole window, the low ones only on the last few bytes.
+static constexpr uint32_t StrictMask = 0xFFFFC000; // 18 bits, before the average size
+static constexpr uint32_t LooseMask = 0xFFFC0000;  // 14 bits, after it
+
+// Random value per byte, generated at compile time so that every build cuts the same content at the same place.
+static constexpr array<uint32_t, 256> make_gear_table() {
+    array<uint32_t, 256> table {};
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for(auto& value : table) {
+        // splitmix64
+        state += 0x9E3779B97F4A7C15ull;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        value = uint32_t((z ^ (z >> 31)) >> 32);
+    }
+    return table;
+}
+alignas(64) static constexpr array<uint32_t, 256> Gear = make_gear_table();
+
+// Returns the first p in [from, to) whose window hash has no mask bit set, or to. from >= WindowSize.
+using cut_kernel = size_t (*)(const uint8_t* data, size_t from, size_t to, uint32_t mask);
+
+static size_t find_cut_scalar(const uint8_t* data, size_t from, size_t to, uint32_t mask) {
+    uint32_t hash = 0;
+    // bytes older than the window are shifted out
+    for(size_t i = from - (WindowSize - 1); i < from; i++)
+        hash = (hash << 1) + Gear[data[i]];
+    for(size_t p = from; p < to; p++) {
+        hash = (hash << 1) + Gear[data[p]];
+        if(!(hash & mask))
+            return p;
+    }
+    return to;
+}
+
+#ifdef CONTENT_CHUNKER_X86
+// Shifts byte `shift / 8` of every lane's word into the lane's hash.
+CONTENT_CHUNKER_TARGET("avx2")
+static inline __m256i gear_step_avx2(__m256i hash, __m256i words, int shift) {
+    __m256i index = _mm256_and_si256(_mm256_srl_epi32(words, _mm_cvtsi32_si128(shift)), _mm256_set1_epi32(0xFF));
+    __m256i gear = _mm256_i32gather_epi32(reinterpret_cast<const int*>(Gear.data()), index, 4);
+    return _mm256_add_epi32(_mm256_slli_epi32(hash, 1), gear);
+}
+
+// Keeps the position of the first hit of every lane, positions are all ones until then.
+CONTENT_CHUNKER_TARGET("avx2")
+static inline __m256i first_hit_avx2(__m256i first, __m256i hash, __m256i mask, __m256i position) {
+    __m256i hit = _mm256_cmpeq_epi32(_mm256_and_si256(hash, mask), _mm256_setzero_si256());
+    return _mm256_min_epu32(first, _mm256_or_si256(position, _mm256_xor_si256(hit, _mm256_set1_epi32(-1))));
+}
+
+// Eight lanes, each hashing its own Stride positions after a window of warm up. The input is read four bytes per
+// lane at a time and the gear values are gathered, a round reports its earliest hit across lanes.
+CONTENT_CHUNKER_TARGET("avx2")
+static size_t find_cut_avx2(const uint8_t* data, size_t from, size_t to, uint32_t mask) {
+    constexpr size_t Lanes = 8, Stride = 512;
+    const __m256i mask_vector = _mm256_set1_epi32(int(mask));
+    const __m256i all_ones = _mm256_set1_epi32(-1);
+    const __m256i four = _mm256_set1_epi32(4);
+    const __m256i lane_starts = _mm256_setr_epi32(0, Stride, 2 * Stride, 3 * Stride, 4 * Stride, 5 * Stride, 6 * Stride, 7 * Stride);
+    const auto* bytes = reinterpret_cast<const int*>(data);
+
+    size_t p = from;
+    for(; to - p >= Lanes * Stride; p += Lanes * Stride) {
+        // lane j hashes positions [p + j * Stride, p + (j + 1) * Stride)
+        __m256i position = _mm256_add_epi32(_mm256_set1_epi32(int(p)), lane_starts);
+        __m256i offsets = _mm256_sub_epi32(position, _mm256_set1_epi32(int(WindowSize)));
+        __m256i hash = _mm256_setzero_si256();
+        for(size_t i = 0; i < WindowSize; i += 4) {
+            __m256i words = _mm256_i32gather_epi32(bytes, offsets, 1);
+            offsets = _mm256_add_epi32(offsets, four);
+            for(int shift = 0; shift < 32; shift += 8)
+                hash = gear_step_avx2(hash, words, shift);
+        }
+
+        __m256i first = all_ones;
+        for(size_t i = 0; i < Stride; i += 4) {
+            __m256i words = _mm256_i32gather_epi32(bytes, offsets, 1);
+            offsets = _mm256_add_epi32(offsets, four);
+            for(int shift = 0; shift < 32; shift += 8) {
+                hash = gear_step_avx2(hash, words, shift);
+                first = first_hit_avx2(first, hash, mask_vector, position);
+                position = _mm256_add_epi32(position, _mm256_set1_epi32(1));
+            }
+        }
+
+        if(!_mm256_testc_si256(first, all_ones)) {
+            // lanes cover increasing positions, the smallest hit is the earliest
+            __m128i low = _mm_min_epu32(_mm256_castsi256_si128(first), _mm256_extracti128_si256(first, 1));
+            low = _mm_min_epu32(low, _mm_shuffle_epi32(low, 0x4E));
+            low = _mm_min_epu32(low, _mm_shuffle_epi32(low, 0xB1));
+            return size_t(uint32_t(_mm_cvtsi128_si32(low)));
+        }
+    }
+    return p < to ? find_cut_scalar(data, p, to, mask) : to;
+}
+
+static bool cpu_supports_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, 0, 0);
+    if(info[0] < 7)
+        return false;
+    __cpuidex(info, 1, 0);
+    bool osxsave = info[2] & (1 << 27);
+    if(!osxsave || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+struct chunker_dispatch {
+    cut_kernel Kernel = find_cut_scalar;
+    const char* Name = "scalar";
+
+    chunker_dispatch() {
+#ifdef CONTENT_CHUNKER_X86
+        if(cpu_supports_avx2()) {
+            Kernel = find_cut_avx2;
+            Name = "avx2";
+        }
+#endif
+    }
+};
+
+static const chunker_dispatch& dispatch() {
+    static const chunker_dispatch instance;
+    return instance;
+}
+
+size_t content_chunker::NextChunk(span<const uint8_t> data) {
+    if(data.size() <= MinChunkSize)
+        return data.size();
+    auto kernel = dispatch().Kernel;
+    size_t normal = min(data.size(), AverageChunkSize);
+    size_t end = min(data.size(), MaxChunkSize);
+    // the cut goes after the matching byte
+    size_t cut = kernel(data.data(), MinChunkSize, normal, StrictMask);
+    if(cut < normal)
+        return cut + 1;
+    cut = kernel(data.data(), normal, end, LooseMask);
+    return cut < end ? cut + 1 : end;
+}
+
+const char *content_chunker::KernelName() {
+    return dispatch().Name;
+}
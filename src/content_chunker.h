@@ -0,0 +1,33 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_CONTENT_CHUNKER_H
+#define WEBCLIENT_CONTENT_CHUNKER_H
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * FastCDC-style content-defined chunking. A cut is placed after byte p when the gear hash of the 32 bytes ending at
+ * p has all of its mask bits clear, so boundaries depend only on nearby content: an insertion moves the chunks around
+ * it but leaves the others identical, and the same content cuts the same way in every file. Normalized chunking uses
+ * a stricter mask before AverageChunkSize and a looser one after it, which keeps most chunks close to the average.
+ *
+ * Since the hash of a position only depends on its window, the search runs several lanes over separate stretches of
+ * the input at once (AVX2 when the CPU has it, picked once at startup).
+ */
+namespace content_chunker {
+    constexpr size_t MinChunkSize = 16 * 1024;
+    constexpr size_t AverageChunkSize = 64 * 1024;
+    constexpr size_t MaxChunkSize = 256 * 1024;
+
+    // Length of the chunk starting at data[0]. data must hold at least MaxChunkSize bytes unless it is the rest of
+    // the input.
+    size_t NextChunk(std::span<const uint8_t> data);
+
+    // Name of the kernel selected at runtime, for logging.
+    const char* KernelName();
+}
+
+#endif //WEBCLIENT_CONTENT_CHUNKER_H
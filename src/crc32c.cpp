@@ -0,0 +1,168 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "crc32c.h"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32C_X64 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CRC32C_TARGET(x)
+#else
+#define CRC32C_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+using namespace std;
+
+// reflected polynomial
+static constexpr uint32_t Polynomial = 0x82F63B78;
+
+// Kernels work on the raw register, without the initial and final inversion.
+using crc_kernel = uint32_t (*)(uint32_t crc, const uint8_t* data, size_t length);
+
+// slicing-by-8 tables, table[k][b] is the checksum of byte b followed by k zero bytes
+static constexpr array<array<uint32_t, 256>, 8> make_tables() {
+    array<array<uint32_t, 256>, 8> tables {};
+    for(uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for(int i = 0; i < 8; i++)
+            crc = crc & 1 ? (crc >> 1) ^ Polynomial : crc >> 1;
+        tables[0][b] = crc;
+    }
+    for(uint32_t b = 0; b < 256; b++) {
+        for(size_t k = 1; k < 8; k++)
+            tables[k][b] = (tables[k - 1][b] >> 8) ^ tables[0][tables[k - 1][b] & 0xFF];
+    }
+    return tables;
+}
+static constexpr auto Tables = make_tables();
+
+static uint32_t crc_scalar(uint32_t crc, const uint8_t* data, size_t length) {
+    for(; length >= 8; length -= 8, data += 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        word ^= crc; // little endian
+        crc = Tables[7][word & 0xFF] ^ Tables[6][(word >> 8) & 0xFF] ^ Tables[5][(word >> 16) & 0xFF] ^
+              Tables[4][(word >> 24) & 0xFF] ^ Tables[3][(word >> 32) & 0xFF] ^ Tables[2][(word >> 40) & 0xFF] ^
+              Tables[1][(word >> 48) & 0xFF] ^ Tables[0][word >> 56];
+    }
+    for(; length > 0; length--, data++)
+        crc = (crc >> 8) ^ Tables[0][(crc ^ *data) & 0xFF];
+    return crc;
+}
+
+#ifdef CRC32C_X64
+// Bytes per stream of the interleaved kernel.
+static constexpr size_t StreamLength = 4096;
+
+// x^n mod P, reflected.
+static uint32_t x_power(uint64_t n) {
+    uint32_t value = 0x80000000; // x^0
+    for(; n > 0; n--)
+        value = value & 1 ? (value >> 1) ^ Polynomial : value >> 1;
+    return value;
+}
+
+struct shift_constants {
+    // Multiplying by x^(8n - 33) and reducing the 64 bit product with crc32 multiplies by x^(8n): the product is one
+    // bit short of the 64 bits crc32 reads and crc32 itself multiplies by x^32.
+    uint64_t One = x_power(8 * StreamLength - 33);
+    uint64_t Two = x_power(16 * StreamLength - 33);
+};
+
+CRC32C_TARGET("sse4.2")
+static uint32_t crc_sse42(uint32_t crc, const uint8_t* data, size_t length) {
+    uint64_t crc64 = crc;
+    for(; length >= 8; length -= 8, data += 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = uint32_t(crc64);
+    for(; length > 0; length--, data++)
+        crc = _mm_crc32_u8(crc, *data);
+    return crc;
+}
+
+CRC32C_TARGET("sse4.2,pclmul")
+static uint32_t shift_crc(uint32_t crc, uint64_t constant) {
+    __m128i product = _mm_clmulepi64_si128(_mm_cvtsi32_si128(int(crc)), _mm_cvtsi64_si128(int64_t(constant)), 0x00);
+    return uint32_t(_mm_crc32_u64(0, uint64_t(_mm_cvtsi128_si64(product))));
+}
+
+// The crc32 instruction has a latency of three cycles but a throughput of one, three independent streams keep it
+// busy. crc(A B C) = shift(crc(A), |B| + |C|) ^ shift(crc(B), |C|) ^ crc(C) since the checksum is linear.
+CRC32C_TARGET("sse4.2,pclmul")
+static uint32_t crc_sse42_pclmul(uint32_t crc, const uint8_t* data, size_t length) {
+    static const shift_constants constants;
+    for(; length >= 3 * StreamLength; length -= 3 * StreamLength, data += 3 * StreamLength) {
+        uint64_t crc0 = crc, crc1 = 0, crc2 = 0;
+        for(size_t i = 0; i < StreamLength; i += 8) {
+            uint64_t word0, word1, word2;
+            memcpy(&word0, data + i, 8);
+            memcpy(&word1, data + StreamLength + i, 8);
+            memcpy(&word2, data + 2 * StreamLength + i, 8);
+            crc0 = _mm_crc32_u64(crc0, word0);
+            crc1 = _mm_crc32_u64(crc1, word1);
+            crc2 = _mm_crc32_u64(crc2, word2);
+        }
+        crc = shift_crc(uint32_t(crc0), constants.Two) ^ shift_crc(uint32_t(crc1), constants.One) ^ uint32_t(crc2);
+    }
+    return crc_sse42(crc, data, length);
+}
+
+static bool cpu_supports_sse42() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, 1, 0);
+    return info[2] & (1 << 20);
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+static bool cpu_supports_pclmul() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, 1, 0);
+    return info[2] & (1 << 1);
+#else
+    return __builtin_cpu_supports("pclmul");
+#endif
+}
+#endif
+
+struct crc32c_dispatch {
+    crc_kernel Kernel = crc_scalar;
+    const char* Name = "scalar";
+
+    crc32c_dispatch() {
+#ifdef CRC32C_X64
+        if(cpu_supports_sse42() && cpu_supports_pclmul()) {
+            Kernel = crc_sse42_pclmul;
+            Name = "sse4.2+pclmul";
+        } else if(cpu_supports_sse42()) {
+            Kernel = crc_sse42;
+            Name = "sse4.2";
+        }
+#endif
+    }
+};
+
+static const crc32c_dispatch& dispatch() {
+    static const crc32c_dispatch instance;
+    return instance;
+}
+
+uint32_t crc32c::Update(uint32_t crc, span<const uint8_t> data) {
+    return ~dispatch().Kernel(~crc, data.data(), data.size());
+}
+
+const char *crc32c::KernelName() {
+    return dispatch().Name;
+}
@@ -0,0 +1,24 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_CRC32C_H
+#define WEBCLIENT_CRC32C_H
+#include <span>
+#include <cstdint>
+
+/*
+ * CRC-32C (Castagnoli), the checksum of iSCSI and ext4 metadata. With SSE4.2 it runs on the crc32 instruction over
+ * three interleaved streams, whose partial checksums are merged with a carry-less multiply (PCLMULQDQ), so it runs
+ * far above the speed of any network link. The kernel is picked once at startup.
+ */
+namespace crc32c {
+    // Continues crc (the checksum of the data so far, 0 for none) over data.
+    uint32_t Update(uint32_t crc, std::span<const uint8_t> data);
+    inline uint32_t Compute(std::span<const uint8_t> data) { return Update(0, data); }
+
+    // Name of the kernel selected at runtime, for logging.
+    const char* KernelName();
+}
+
+#endif //WEBCLIENT_CRC32C_H
@@ -0,0 +1,136 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "delta_publisher.h"
+#include "json_writer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+using namespace std;
+
+delta_publisher::delta_publisher(web_server &server, vector<std::string> topics, delta_publisher_config config)
+: m_server(server), m_topics(std::move(topics)), m_config(config) {
+    for(const auto& topic : m_topics) {
+        m_topics_key = m_topics_key * 31 + hash<string>{}(topic);
+    }
+    m_server.AddSubscribeHandler([this](client_ctx& client, const std::string& topic) {
+        OnSubscribe(client, topic);
+    });
+}
+
+void delta_publisher::OnSubscribe(client_ctx &client, const std::string &topic) {
+    if(find(m_topics.begin(), m_topics.end(), topic) == m_topics.end())
+        return;
+    web_frame_buffer snapshot;
+    {
+        lock_guard guard(m_lock);
+        if(m_current.empty())
+            return; // nothing published yet, the first update is a keyframe anyway
+        if(!m_snapshot)
+            m_snapshot = make_shared<const vector<uint8_t>>(EncodeSnapshot().ToBinaryStream());
+        snapshot = m_snapshot;
+    }
+    // same key as keyframes, a newer keyframe may replace it in the queue
+    client.SendFrame(snapshot, m_topics_key);
+}
+
+void delta_publisher::Update(const field_list &fields) {
+    web_packet packet;
+    size_t coalesce_key;
+    {
+        lock_guard guard(m_lock);
+        bool same_fields = fields.size() == m_current.size() &&
+                           equal(fields.begin(), fields.end(), m_current.begin(),
+                                 [](const auto& a, const auto& b) { return a.first == b.first; });
+        m_current = fields;
+        m_snapshot.reset();
+
+        if(!same_fields || ++m_updates_since_keyframe >= m_config.KeyframeInterval) {
+            m_generation++;
+            m_updates_since_keyframe = 0;
+            m_keyframe.resize(fields.size());
+            for(size_t i = 0; i < fields.size(); i++) {
+                m_keyframe[i] = fields[i].second;
+            }
+            m_last_sent = m_keyframe;
+            m_changed.assign(fields.size(), false);
+            packet = EncodeSnapshot();
+            coalesce_key = m_topics_key;
+        } else {
+            bool moved = false;
+            for(size_t i = 0; i < fields.size(); i++) {
+                double value = fields[i].second;
+                moved |= fabs(value - m_last_sent[i]) > m_config.Resolution;
+                if(fabs(value - m_keyframe[i]) > m_config.Resolution)
+                    m_changed[i] = true;
+            }
+            if(!moved)
+                return;
+            for(size_t i = 0; i < fields.size(); i++) {
+                m_last_sent[i] = fields[i].second;
+            }
+            packet = EncodeDelta();
+            // deltas only replace deltas of the same keyframe
+            coalesce_key = (m_topics_key ^ (0x9e3779b97f4a7c15ULL * m_generation)) | 1;
+        }
+        m_published_bytes += packet.Payload.size();
+    }
+    m_server.PublishToTopics(m_topics, packet, coalesce_key);
+}
+
+web_packet delta_publisher::EncodeSnapshot() const {
+    web_packet packet;
+    packet.OpCode = web_socket_opcode::TextFrame;
+    // names plus up to 17 digits per value, a single allocation for the usual field set
+    packet.Payload.reserve(16 + m_current.size() * (m_config.Encoding == delta_encoding::binary ? 64 : 40));
+    json_writer json(packet.Payload);
+    json.BeginObject().Member("k", m_generation);
+    for(const auto& [name, value] : m_current) {
+        json.Member(name, value);
+    }
+    if(m_config.Encoding == delta_encoding::binary) {
+        json.Key("f").BeginArray();
+        for(const auto& field : m_current) {
+            json.Value(field.first);
+        }
+        json.EndArray();
+    }
+    json.EndObject();
+    return packet;
+}
+
+web_packet delta_publisher::EncodeDelta() const {
+    web_packet packet;
+    if(m_config.Encoding == delta_encoding::binary) {
+        packet.OpCode = web_socket_opcode::BinaryFrame;
+        auto& payload = packet.Payload;
+        payload.reserve(5 + m_current.size() * 9);
+        payload.push_back('D');
+        for(int i = 0; i < 4; i++) {
+            payload.push_back(uint8_t(m_generation >> (i * 8)));
+        }
+        for(size_t i = 0; i < m_current.size() && i < 256; i++) {
+            if(!m_changed[i])
+                continue;
+            uint64_t bits;
+            memcpy(&bits, &m_current[i].second, sizeof(bits));
+            payload.push_back(uint8_t(i));
+            for(int b = 0; b < 8; b++) {
+                payload.push_back(uint8_t(bits >> (b * 8)));
+            }
+        }
+        return packet;
+    }
+
+    packet.OpCode = web_socket_opcode::TextFrame;
+    packet.Payload.reserve(24 + m_current.size() * 40);
+    json_writer json(packet.Payload);
+    json.BeginObject().Member("k", m_generation).Key("d").BeginObject();
+    for(size_t i = 0; i < m_current.size(); i++) {
+        if(m_changed[i])
+            json.Member(m_current[i].first, m_current[i].second);
+    }
+    json.EndObject().EndObject();
+    return packet;
+}
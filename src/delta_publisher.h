@@ -0,0 +1,70 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_DELTA_PUBLISHER_H
+#define WEBCLIENT_DELTA_PUBLISHER_H
+#include "web_server.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+enum class delta_encoding {
+    // {"k":generation,"d":{"field":value,...}}
+    json,
+    // 'D', u32 generation, then (u8 field index, f64 value) pairs, all little endian
+    binary
+};
+
+struct delta_publisher_config {
+    delta_encoding Encoding = delta_encoding::json;
+    // Changes smaller than this are not worth a message.
+    double Resolution = 0.01;
+    // Every n-th update is a full snapshot, bounding the size of the deltas.
+    uint32_t KeyframeInterval = 20;
+};
+
+/*
+ * Publishes a flat set of numeric fields to websocket topics as a full snapshot (keyframe) followed by deltas.
+ * New subscribers get the current state as a snapshot, after that only fields that changed are sent.
+ *
+ * Deltas are cumulative since the last keyframe and carry its generation, so a slow client whose queued deltas
+ * were coalesced into the newest one still ends up with the right state, and deltas belonging to a keyframe the
+ * client never saw are ignored. Snapshots are JSON text frames, the same shape as sys_info::GetAsJSON plus "k"
+ * (and "f", the field order binary deltas refer to).
+ */
+class delta_publisher {
+public:
+    using field_list = std::vector<std::pair<std::string, double>>;
+
+    delta_publisher(web_server& server, std::vector<std::string> topics, delta_publisher_config config = {});
+
+    // Thread-safe, meant to be called from a timer.
+    void Update(const field_list& fields);
+
+    [[nodiscard]] uint64_t PublishedBytes() const { return m_published_bytes; }
+
+private:
+    void OnSubscribe(client_ctx& client, const std::string& topic);
+    web_packet EncodeSnapshot() const;
+    web_packet EncodeDelta() const;
+
+private:
+    web_server& m_server;
+    std::vector<std::string> m_topics;
+    delta_publisher_config m_config;
+    size_t m_topics_key = 0;
+
+    std::mutex m_lock;
+    field_list m_current;
+    std::vector<double> m_keyframe;
+    std::vector<double> m_last_sent;
+    std::vector<bool> m_changed; // changed since the keyframe, stays set until the next one
+    uint32_t m_generation = 0;
+    uint32_t m_updates_since_keyframe = 0;
+    web_frame_buffer m_snapshot; // current state for new subscribers, built on demand
+    uint64_t m_published_bytes = 0;
+};
+
+#endif //WEBCLIENT_DELTA_PUBLISHER_H
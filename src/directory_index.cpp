@@ -0,0 +1,313 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "directory_index.h"
+#include "sha256.h"
+#include "CppUtility.hpp"
+#include <filesystem>
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+#include <ctime>
+
+#ifndef _WIN32
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static bool read_file_entry(const string& path, directory_entry& entry) {
+#ifdef _WIN32
+    error_code ec;
+    auto status = fs::status(path, ec);
+    if(ec || !fs::is_regular_file(status))
+        return false;
+    entry.Size = fs::file_size(path, ec);
+    entry.ModifiedTime = chrono::duration_cast<chrono::seconds>(fs::last_write_time(path, ec).time_since_epoch()).count();
+    return !ec;
+#else
+    // a single stat() gives us type, size and timestamp.
+    struct stat st {};
+    if(stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        return false;
+    entry.Size = uint64_t(st.st_size);
+    entry.ModifiedTime = int64_t(st.st_mtime);
+    return true;
+#endif
+}
+
+static string escape_html(const string& text) {
+    string result;
+    result.reserve(text.size());
+    for(char c : text) {
+        switch(c) {
+            case '&': result += "&amp;"; break;
+            case '<': result += "&lt;"; break;
+            case '>': result += "&gt;"; break;
+            case '"': result += "&quot;"; break;
+            case '\'': result += "&#39;"; break;
+            default: result.push_back(c);
+        }
+    }
+    return result;
+}
+
+static string format_time(int64_t seconds) {
+    time_t time = time_t(seconds);
+    char buffer[32] = {};
+    if(auto* local = localtime(&time))
+        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", local);
+    return buffer;
+}
+
+static const char* sort_name(directory_sort sort) {
+    switch(sort) {
+        case directory_sort::name: return "name";
+        case directory_sort::modified: return "modified";
+        default: return "size";
+    }
+}
+
+directory_listing_options
+directory_listing_options::FromQuery(const unordered_map<std::string, std::string> &query) {
+    directory_listing_options options;
+    if(auto it = query.find("sort"); it != query.end()) {
+        if(it->second == "name") {
+            options.Sort = directory_sort::name;
+            options.Descending = false;
+        } else if(it->second == "modified") {
+            options.Sort = directory_sort::modified;
+        }
+    }
+    if(auto it = query.find("order"); it != query.end()) {
+        options.Descending = it->second != "asc";
+    }
+    size_t value = 0;
+    if(auto it = query.find("page"); it != query.end() && cpp::TryToInt64(it->second, value)) {
+        options.Page = value;
+    }
+    if(auto it = query.find("per_page"); it != query.end() && cpp::TryToInt64(it->second, value)) {
+        options.PerPage = std::clamp<size_t>(value, 1, 5000);
+    }
+    return options;
+}
+
+directory_index::directory_index(std::string path, std::string url_prefix)
+: m_path(std::move(path)), m_url_prefix(std::move(url_prefix)) {
+#ifndef _WIN32
+    m_notify_handle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_notify_handle >= 0) {
+        uint32_t events = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                          IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+        if(inotify_add_watch(m_notify_handle, m_path.c_str(), events) < 0) {
+            LOG(WARNING, "inotify_add_watch failed for '{}', directory listing falls back to polling.", m_path);
+            close(m_notify_handle);
+            m_notify_handle = -1;
+        }
+    }
+#endif
+    Rescan();
+}
+
+directory_index::~directory_index() {
+#ifndef _WIN32
+    if(m_notify_handle >= 0)
+        close(m_notify_handle);
+#endif
+}
+
+void directory_index::Rescan() {
+    vector<directory_entry> entries;
+    error_code ec;
+    for(const auto& item : fs::directory_iterator(m_path, ec)) {
+        directory_entry entry;
+        entry.Name = item.path().filename().string();
+        if(read_file_entry(item.path().string(), entry))
+            entries.push_back(std::move(entry));
+    }
+    if(ec) {
+        LOG(ERR, "Could not list directory '{}', {}", m_path, ec.message());
+    }
+    sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.Name < b.Name; });
+    m_entries = std::move(entries);
+    m_directory_time = chrono::duration_cast<chrono::seconds>(fs::last_write_time(m_path, ec).time_since_epoch()).count();
+    m_generation++;
+}
+
+void directory_index::Update(const string &name) {
+    directory_entry entry;
+    entry.Name = name;
+    if(!read_file_entry(m_path + "/" + name, entry)) {
+        Erase(name);
+        return;
+    }
+    auto it = lower_bound(m_entries.begin(), m_entries.end(), name,
+                          [](const directory_entry& a, const string& b) { return a.Name < b; });
+    if(it != m_entries.end() && it->Name == name) {
+        if(it->Size == entry.Size && it->ModifiedTime == entry.ModifiedTime)
+            return;
+        *it = std::move(entry);
+    } else {
+        m_entries.insert(it, std::move(entry));
+    }
+    m_generation++;
+}
+
+void directory_index::Erase(const string &name) {
+    auto it = lower_bound(m_entries.begin(), m_entries.end(), name,
+                          [](const directory_entry& a, const string& b) { return a.Name < b; });
+    if(it == m_entries.end() || it->Name != name)
+        return;
+    m_entries.erase(it);
+    m_generation++;
+}
+
+void directory_index::Refresh() {
+#ifndef _WIN32
+    if(m_notify_handle >= 0) {
+        alignas(inotify_event) char buffer[16 * 1024];
+        unordered_set<string> changed;
+        bool rescan = false;
+        ssize_t length;
+        while((length = read(m_notify_handle, buffer, sizeof(buffer))) > 0) {
+            for(char* ptr = buffer; ptr < buffer + length;) {
+                auto* event = reinterpret_cast<inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+                if(event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                    rescan = true;
+                } else if(event->len > 0) {
+                    changed.emplace(event->name);
+                }
+            }
+        }
+        if(rescan) {
+            Rescan();
+        } else {
+            // several events for one file collapse into a single stat()
+            for(const auto& name : changed)
+                Update(name);
+        }
+        return;
+    }
+#endif
+    // No change notifications, compare the directory timestamp at most once a second.
+    auto now = chrono::steady_clock::now();
+    if(now - m_last_poll < chrono::seconds(1))
+        return;
+    m_last_poll = now;
+    error_code ec;
+    auto directory_time = chrono::duration_cast<chrono::seconds>(fs::last_write_time(m_path, ec).time_since_epoch()).count();
+    if(!ec && directory_time != m_directory_time)
+        Rescan();
+}
+
+const vector<uint32_t>& directory_index::SortedOrder(directory_sort sort) {
+    auto& view = m_views[int(sort)];
+    if(view.Generation == m_generation)
+        return view.Order;
+    view.Order.resize(m_entries.size());
+    iota(view.Order.begin(), view.Order.end(), 0u);
+    // m_entries is already sorted by name, ties keep name order.
+    if(sort == directory_sort::size) {
+        stable_sort(view.Order.begin(), view.Order.end(),
+                    [&](uint32_t a, uint32_t b) { return m_entries[a].Size < m_entries[b].Size; });
+    } else if(sort == directory_sort::modified) {
+        stable_sort(view.Order.begin(), view.Order.end(),
+                    [&](uint32_t a, uint32_t b) { return m_entries[a].ModifiedTime < m_entries[b].ModifiedTime; });
+    }
+    view.Generation = m_generation;
+    return view.Order;
+}
+
+const directory_listing& directory_index::Render(const directory_listing_options &options) {
+    Refresh();
+    if(m_rendered_generation != m_generation || m_rendered.size() > 256) {
+        m_rendered.clear();
+        m_rendered_generation = m_generation;
+    }
+    auto key = cpp::Format("{}-{}-{}-{}", sort_name(options.Sort), options.Descending ? "d" : "a",
+                           options.Page, options.PerPage);
+    if(auto it = m_rendered.find(key); it != m_rendered.end())
+        return it->second;
+
+    auto html = RenderHtml(options);
+    auto& listing = m_rendered[key];
+    listing.Html = { html.begin(), html.end() };
+    // from the content rather than m_generation, which starts over in every process: after a restart an unchanged
+    // tag must still mean an unchanged page
+    listing.ETag = "\"" + sha256::ToHex(sha256::Hash(listing.Html)).substr(0, 32) + "\"";
+    return listing;
+}
+
+string directory_index::RenderHtml(const directory_listing_options &options) {
+    const auto& order = SortedOrder(options.Sort);
+    size_t pages = max<size_t>(1, (order.size() + options.PerPage - 1) / options.PerPage);
+    size_t page = min(options.Page, pages - 1);
+    size_t first = page * options.PerPage;
+    size_t last = min(order.size(), first + options.PerPage);
+
+    auto link = [&](directory_sort sort, bool descending, size_t target_page) {
+        return cpp::Format("?sort={}&order={}&page={}&per_page={}", sort_name(sort), descending ? "desc" : "asc",
+                           target_page, options.PerPage);
+    };
+    // clicking the active column flips the order
+    auto header_link = [&](directory_sort sort, const char* title) {
+        bool descending = (sort == options.Sort) ? !options.Descending : sort != directory_sort::name;
+        return cpp::Format("<a href='{}'>{}</a>", link(sort, descending, 0), title);
+    };
+
+    stringstream content;
+    content <<
+            R"(<!DOCTYPE html>
+            <html lang="en-US">
+            <head>
+                <title>List of Files</title>
+            <style>
+                tr:nth-child(even) {background-color: #f2f2f2;}
+                tr:hover {background-color: coral;}
+                table {
+                    margin-left: auto;
+                    margin-right: auto;
+                }
+                a:hover, a:visited { color:blue }
+                table {
+                    border: 2px solid;
+                    border-radius: 6px;
+                }
+                td {
+                    padding: 5px;
+                }
+                p { text-align: center; }
+            </style>
+            </head>
+            <body>
+                <table>
+                <thead>
+                <tr>
+                <th></th>)";
+    content << "<th style=\"min-width: 250px\">" << header_link(directory_sort::name, "File Name") << "</th>"
+            << "<th style=\"min-width: 150px\">" << header_link(directory_sort::size, "File Size") << "</th>"
+            << "<th style=\"min-width: 100px\">" << header_link(directory_sort::modified, "Modified") << "</th>"
+            << "</tr></thead>\n";
+
+    for(size_t i = first; i < last; i++) {
+        const auto& entry = m_entries[order[options.Descending ? order.size() - 1 - i : i]];
+        auto name = escape_html(entry.Name);
+        content << cpp::Format(
+                "<tr><td>{2}</td><td style=\"padding: 0.5em\"><a href='{3}{0}'>{0}</a></td><td style='text-align: center'>{1}</td><td>{4}</td></tr>",
+                name, cpp::FriendlyMemorySize((double) entry.Size), i + 1, m_url_prefix, format_time(entry.ModifiedTime)) << '\n';
+    }
+    content << "</table><p>";
+    if(page > 0)
+        content << "<a href='" << link(options.Sort, options.Descending, page - 1) << "'>&laquo; Previous</a> ";
+    content << "Page " << page + 1 << " of " << pages << " (" << m_entries.size() << " files)";
+    if(page + 1 < pages)
+        content << " <a href='" << link(options.Sort, options.Descending, page + 1) << "'>Next &raquo;</a>";
+    content << "</p></body></html>";
+    return content.str();
+}
@@ -0,0 +1,88 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_DIRECTORY_INDEX_H
+#define WEBCLIENT_DIRECTORY_INDEX_H
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <chrono>
+
+enum class directory_sort {
+    name,
+    size,
+    modified
+};
+
+struct directory_entry {
+    std::string Name;
+    uint64_t Size = 0;
+    int64_t ModifiedTime = 0;
+};
+
+struct directory_listing_options {
+    directory_sort Sort = directory_sort::size;
+    bool Descending = true;
+    size_t Page = 0;
+    size_t PerPage = 250;
+
+    // Reads ?sort=name|size|modified&order=asc|desc&page=N&per_page=N, ignoring malformed values.
+    static directory_listing_options FromQuery(const std::unordered_map<std::string, std::string>& query);
+};
+
+struct directory_listing {
+    std::string ETag;
+    std::vector<uint8_t> Html;
+};
+
+/*
+ * Keeps an in-memory index of the regular files of a single directory. The index is sorted by name and is
+ * patched in place from inotify events (Linux) instead of walking the directory on every request; other
+ * platforms fall back to rescanning when the directory timestamp changes. Rendered pages are cached until
+ * the directory changes, so repeated hits only cost a hash lookup.
+ * Not thread-safe, use from the web_server thread.
+ */
+class directory_index {
+public:
+    explicit directory_index(std::string path, std::string url_prefix = "/");
+    ~directory_index();
+
+    directory_index(const directory_index&) = delete;
+    directory_index& operator=(const directory_index&) = delete;
+
+    // Applies pending change notifications, cheap when nothing has changed.
+    void Refresh();
+    const directory_listing& Render(const directory_listing_options& options);
+
+    [[nodiscard]] size_t Count() const { return m_entries.size(); }
+    [[nodiscard]] uint64_t Generation() const { return m_generation; }
+
+private:
+    void Rescan();
+    void Update(const std::string& name);
+    void Erase(const std::string& name);
+    const std::vector<uint32_t>& SortedOrder(directory_sort sort);
+    std::string RenderHtml(const directory_listing_options& options);
+
+private:
+    std::string m_path;
+    std::string m_url_prefix;
+    std::vector<directory_entry> m_entries; // sorted by name
+    uint64_t m_generation = 0;
+
+    struct sorted_view {
+        uint64_t Generation = UINT64_MAX;
+        std::vector<uint32_t> Order;
+    };
+    sorted_view m_views[3];
+    std::unordered_map<std::string, directory_listing> m_rendered;
+    uint64_t m_rendered_generation = UINT64_MAX;
+
+    int m_notify_handle = -1;
+    int64_t m_directory_time = 0;
+    std::chrono::steady_clock::time_point m_last_poll;
+};
+
+#endif //WEBCLIENT_DIRECTORY_INDEX_H
@@ -0,0 +1,246 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "file_delta.h"
+#include "sha256.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+uint32_t file_delta::BlockSizeFor(uint64_t file_size) {
+    auto root = uint64_t(sqrt(double(file_size)));
+    // multiple of 1 KB
+    root = (root + 1023) & ~uint64_t(1023);
+    return uint32_t(clamp<uint64_t>(root, MinBlockSize, MaxBlockSize));
+}
+
+void file_delta::rolling_checksum::Reset(span<const uint8_t> window) {
+    m_a = 0;
+    m_b = 0;
+    m_length = uint32_t(window.size());
+    // b weighs every byte by its distance from the end of the window
+    for(size_t i = 0; i < window.size(); i++) {
+        m_a += window[i];
+        m_b += uint32_t(window.size() - i) * window[i];
+    }
+}
+
+void file_delta::signature::Encode(vector<uint8_t> &out) const {
+    size_t start = out.size();
+    out.resize(start + Blocks.size() * BlockSignatureSize);
+    uint8_t* cursor = out.data() + start;
+    for(const auto& block : Blocks) {
+        for(int i = 0; i < 4; i++) {
+            cursor[i] = uint8_t(block.Weak >> (8 * i));
+        }
+        memcpy(cursor + 4, block.Strong.data(), StrongLength);
+        cursor += BlockSignatureSize;
+    }
+}
+
+bool file_delta::signature::Decode(span<const uint8_t> payload, uint32_t block_size, uint64_t file_size) {
+    if(block_size < MinBlockSize || block_size > MaxBlockSize || payload.size() % BlockSignatureSize != 0)
+        return false;
+    size_t count = payload.size() / BlockSignatureSize;
+    if(count != (file_size + block_size - 1) / block_size)
+        return false;
+    BlockSize = block_size;
+    FileSize = file_size;
+    Blocks.resize(count);
+    for(auto& block : Blocks) {
+        block.Weak = uint32_t(payload[0]) | uint32_t(payload[1]) << 8 | uint32_t(payload[2]) << 16 | uint32_t(payload[3]) << 24;
+        memcpy(block.Strong.data(), payload.data() + 4, StrongLength);
+        payload = payload.subspan(BlockSignatureSize);
+    }
+    return true;
+}
+
+uint64_t file_delta::signature::BlockLength(uint32_t index) const {
+    uint64_t start = uint64_t(index) * BlockSize;
+    return start >= FileSize ? 0 : min<uint64_t>(BlockSize, FileSize - start);
+}
+
+array<uint8_t, file_delta::StrongLength> file_delta::StrongHash(span<const uint8_t> block) {
+    auto digest = sha256::Hash(block);
+    array<uint8_t, StrongLength> strong;
+    memcpy(strong.data(), digest.data(), StrongLength);
+    return strong;
+}
+
+bool file_delta::ComputeSignature(const reader &read, uint64_t size, signature &out) {
+    out.BlockSize = BlockSizeFor(size);
+    out.FileSize = size;
+    out.Blocks.clear();
+    out.Blocks.reserve(size_t((size + out.BlockSize - 1) / out.BlockSize));
+    // whole blocks per read, at least 1 MB
+    size_t blocks_per_read = max<size_t>(1, MaxLiteralLength / out.BlockSize);
+    vector<uint8_t> buffer(blocks_per_read * out.BlockSize);
+    rolling_checksum weak;
+    for(uint64_t offset = 0; offset < size;) {
+        size_t length = size_t(min<uint64_t>(buffer.size(), size - offset));
+        if(read(offset, { buffer.data(), length }) != int64_t(length))
+            return false;
+        for(size_t start = 0; start < length; start += out.BlockSize) {
+            span<const uint8_t> block(buffer.data() + start, min<size_t>(out.BlockSize, length - start));
+            weak.Reset(block);
+            out.Blocks.push_back({ weak.Value(), StrongHash(block) });
+        }
+        offset += length;
+    }
+    return true;
+}
+
+static uint32_t bucket_of(uint32_t weak) {
+    // the low half of the checksum is a plain byte sum, mix before masking
+    return weak * 0x9E3779B1u;
+}
+
+file_delta::delta_encoder::delta_encoder(const signature &base) : m_base(base) {
+    size_t buckets = 1024;
+    while(buckets < base.Blocks.size() * 2)
+        buckets *= 2;
+    m_heads.assign(buckets, 0);
+    m_next.assign(base.Blocks.size(), 0);
+    m_mask = uint32_t(buckets - 1);
+    // only full size blocks can match a window, the short last block is compared at the end of the file.
+    // Inserted in reverse so chains list the lowest block first, which keeps runs of consecutive blocks together.
+    for(size_t i = base.Blocks.size(); i-- > 0;) {
+        if(base.BlockLength(uint32_t(i)) != base.BlockSize)
+            continue;
+        uint32_t bucket = (bucket_of(base.Blocks[i].Weak) >> 8) & m_mask;
+        m_next[i] = m_heads[bucket];
+        m_heads[bucket] = uint32_t(i + 1);
+    }
+}
+
+int64_t file_delta::delta_encoder::Find(uint32_t weak, const uint8_t *window) const {
+    uint32_t entry = m_heads[(bucket_of(weak) >> 8) & m_mask];
+    bool hashed = false;
+    array<uint8_t, StrongLength> strong {};
+    for(; entry != 0; entry = m_next[entry - 1]) {
+        const auto& block = m_base.Blocks[entry - 1];
+        if(block.Weak != weak)
+            continue;
+        // the strong hash is only computed once the weak checksum matched
+        if(!hashed) {
+            strong = StrongHash({ window, m_base.BlockSize });
+            hashed = true;
+        }
+        if(block.Strong == strong)
+            return int64_t(entry - 1);
+    }
+    return -1;
+}
+
+bool file_delta::delta_encoder::Encode(const reader &read, uint64_t size, const literal_callback &literal,
+                                       const copy_callback &copy) {
+    const size_t block_size = m_base.BlockSize;
+    vector<uint8_t> buffer(max<size_t>(4 * MaxLiteralLength, 4 * block_size));
+    uint64_t buffer_offset = 0; // file offset of buffer[0]
+    uint64_t read_offset = 0;
+    size_t position = 0, end = 0, literal_start = 0;
+    rolling_checksum weak;
+    bool have_weak = false;
+    // pending run of base blocks
+    uint64_t copy_offset = 0;
+    uint32_t copy_first = 0, copy_count = 0;
+    m_literal_bytes = 0;
+    m_copied_bytes = 0;
+
+    auto flush_copy = [&] {
+        if(copy_count == 0)
+            return true;
+        uint32_t count = copy_count;
+        copy_count = 0;
+        return copy(copy_offset, copy_first, count);
+    };
+    auto flush_literal = [&](size_t until) {
+        if(until == literal_start)
+            return true;
+        bool valid = flush_copy() && literal(buffer_offset + literal_start, { buffer.data() + literal_start, until - literal_start });
+        m_literal_bytes += until - literal_start;
+        literal_start = until;
+        return valid;
+    };
+    auto add_block = [&](uint32_t block) {
+        uint64_t offset = buffer_offset + position;
+        m_copied_bytes += m_base.BlockLength(block);
+        if(copy_count > 0 && copy_first + copy_count == block && copy_offset + uint64_t(copy_count) * block_size == offset) {
+            copy_count++;
+            return true;
+        }
+        bool valid = flush_copy();
+        copy_offset = offset;
+        copy_first = block;
+        copy_count = 1;
+        return valid;
+    };
+
+    while(true) {
+        if(end - position <= block_size && read_offset < size) {
+            // keep the window, drop what is behind it
+            if(!flush_literal(position))
+                return false;
+            memmove(buffer.data(), buffer.data() + position, end - position);
+            buffer_offset += position;
+            end -= position;
+            position = literal_start = 0;
+            size_t length = size_t(min<uint64_t>(buffer.size() - end, size - read_offset));
+            if(read(read_offset, { buffer.data() + end, length }) != int64_t(length))
+                return false;
+            end += length;
+            read_offset += length;
+        }
+        if(m_base.Blocks.empty()) {
+            // nothing to match against, everything is literal
+            position = min(end, literal_start + MaxLiteralLength);
+            if(!flush_literal(position))
+                return false;
+            if(position == end && read_offset == size)
+                break;
+            continue;
+        }
+        size_t available = end - position;
+        if(available < block_size)
+            break;
+        if(!have_weak) {
+            weak.Reset({ buffer.data() + position, block_size });
+            have_weak = true;
+        }
+        auto block = Find(weak.Value(), buffer.data() + position);
+        if(block >= 0) {
+            if(!flush_literal(position) || !add_block(uint32_t(block)))
+                return false;
+            position += block_size;
+            literal_start = position;
+            have_weak = false;
+            continue;
+        }
+        if(available == block_size)
+            break; // end of file, nothing left to slide over
+        weak.Roll(buffer[position], buffer[position + block_size]);
+        position++;
+        if(position - literal_start >= MaxLiteralLength && !flush_literal(position))
+            return false;
+    }
+
+    // the base's short last block can only match the end of the new file
+    size_t tail = end - position;
+    if(!m_base.Blocks.empty() && tail > 0) {
+        auto last = uint32_t(m_base.Blocks.size() - 1);
+        if(m_base.BlockLength(last) == tail) {
+            rolling_checksum tail_weak;
+            tail_weak.Reset({ buffer.data() + position, tail });
+            if(tail_weak.Value() == m_base.Blocks[last].Weak &&
+               StrongHash({ buffer.data() + position, tail }) == m_base.Blocks[last].Strong) {
+                if(!flush_literal(position) || !add_block(last))
+                    return false;
+                position = literal_start = end;
+            }
+        }
+    }
+    return flush_literal(end) && flush_copy();
+}
@@ -0,0 +1,100 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_FILE_DELTA_H
+#define WEBCLIENT_FILE_DELTA_H
+#include <array>
+#include <functional>
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * rsync-style delta encoding. The side that has an old version of a file describes it as a signature: for every
+ * block, a weak rolling checksum and a truncated SHA-256. The side with the new version slides a window over its
+ * file, looking the rolling checksum up at every byte offset, and describes the new file as runs of old blocks plus
+ * the literal bytes that matched nothing, so only changed regions cross the network.
+ */
+namespace file_delta {
+    constexpr uint32_t MinBlockSize = 2 * 1024;
+    constexpr uint32_t MaxBlockSize = 1024 * 1024;
+    constexpr size_t StrongLength = 16;
+    // Encoded size of one block in a signature payload.
+    constexpr size_t BlockSignatureSize = 4 + StrongLength;
+    // Literal runs are handed out in pieces of at most this size.
+    constexpr size_t MaxLiteralLength = 1024 * 1024;
+
+    // About the square root of the file size (as rsync does), so the signature and the amount of literal data
+    // around each change grow together.
+    uint32_t BlockSizeFor(uint64_t file_size);
+
+    // Reads up to out.size() bytes at offset, returns the number read or -1.
+    using reader = std::function<int64_t(uint64_t offset, std::span<uint8_t> out)>;
+
+    // Adler-like checksum of a window that can slide by one byte in constant time.
+    class rolling_checksum {
+    public:
+        void Reset(std::span<const uint8_t> window);
+        void Roll(uint8_t out, uint8_t in) {
+            m_a += uint32_t(in) - uint32_t(out);
+            m_b += m_a - m_length * uint32_t(out);
+        }
+        [[nodiscard]] uint32_t Value() const { return (m_a & 0xFFFF) | (m_b << 16); }
+
+    private:
+        uint32_t m_a = 0;
+        uint32_t m_b = 0;
+        uint32_t m_length = 0;
+    };
+
+    struct block_signature {
+        uint32_t Weak = 0;
+        std::array<uint8_t, StrongLength> Strong {};
+    };
+
+    struct signature {
+        uint32_t BlockSize = MinBlockSize;
+        uint64_t FileSize = 0;
+        std::vector<block_signature> Blocks;
+
+        void Encode(std::vector<uint8_t>& out) const;
+        bool Decode(std::span<const uint8_t> payload, uint32_t block_size, uint64_t file_size);
+        // Length of block index, the last one may be short.
+        [[nodiscard]] uint64_t BlockLength(uint32_t index) const;
+    };
+
+    std::array<uint8_t, StrongLength> StrongHash(std::span<const uint8_t> block);
+    bool ComputeSignature(const reader& read, uint64_t size, signature& out);
+
+    class delta_encoder {
+    public:
+        // offset is the position in the new file
+        using literal_callback = std::function<bool(uint64_t offset, std::span<const uint8_t> data)>;
+        using copy_callback = std::function<bool(uint64_t offset, uint32_t first_block, uint32_t count)>;
+
+        explicit delta_encoder(const signature& base);
+
+        // Reads the new file and describes it in order through the callbacks, consecutive matching blocks are
+        // reported as one run. Stops and returns false when a read or a callback fails.
+        bool Encode(const reader& read, uint64_t size, const literal_callback& literal, const copy_callback& copy);
+
+        [[nodiscard]] uint64_t LiteralBytes() const { return m_literal_bytes; }
+        [[nodiscard]] uint64_t CopiedBytes() const { return m_copied_bytes; }
+
+    private:
+        // index of a full size base block equal to the window, -1 if none
+        int64_t Find(uint32_t weak, const uint8_t* window) const;
+
+    private:
+        const signature& m_base;
+        std::vector<uint32_t> m_heads; // block index + 1 by hashed weak checksum, 0 when empty
+        std::vector<uint32_t> m_next;  // chain of blocks sharing a bucket
+        uint32_t m_mask = 0;
+        uint64_t m_literal_bytes = 0;
+        uint64_t m_copied_bytes = 0;
+    };
+}
+
+#endif //WEBCLIENT_FILE_DELTA_H
@@ -1,27 +1,32 @@
 #include "Socket.hpp"
 #include "CppUtility.hpp"
+#include "file_transfer_protocol.h"
+#include "buffer_pool.h"
+#include "content_chunker.h"
+#include "crc32c.h"
+#include "chunk_compressor.h"
 #include <list>
 #include <thread>
+#include <atomic>
+#include <random>
 #include <filesystem>
 using namespace std;
-
-struct file_transfer_header {
-    uint16_t opcode;
-    uint16_t size;
-};
+using namespace file_transfer;
 
 class file_transfer_host {
 
 public:
-    file_transfer_host() {
+    explicit file_transfer_host(uint16_t port = DefaultPort, string receive_directory = "received")
+    : m_sessions(std::move(receive_directory)) {
         sw::Startup();
         m_socket = sw::Socket(sw::SocketType::TCP);
         m_client = sw::Socket(sw::SocketType::TCP);
-        m_socket.Bind(sw::SocketInterface::Any).Listen(1000).SetBlockingMode(false);
+        m_socket.SetReuseAddrOption(true).Bind(sw::SocketInterface::Any, port).Listen(1000).SetBlockingMode(false);
     }
 
     void process() {
         accept_clients();
+        wait_for_data(50);
         process_requests();
     }
 
@@ -35,7 +40,8 @@ private:
         error,
         connect_to,
         send_file,
-        send_dir
+        send_dir,
+        send_delta
     };
 
     enum class ParserState {
@@ -43,6 +49,8 @@ private:
         FetchingAddress,
         FetchingFileName,
         FetchingDirName,
+        FetchingStreamCount,
+        FetchingOption,
         FetchingNull
     };
 
@@ -58,43 +66,54 @@ private:
         ParserState state = ParserState::FetchingAction;
         ParserError error = ParserError::NoError;
         string connect_to_addr;
-        uint16_t connect_port = 80;
+        uint16_t connect_port = DefaultPort;
         string fileName, dirName;
+        int streams = DefaultStreams;
+        bool dedup = false;
+        bool compress = false;
     };
 
-    enum class TransferOpCode : uint16_t {
-        Error,
-        WriteLastFile,
-        CreateDirectory,
-        CreateFile,
-        SelectFile
-    };
-
-    struct TransferHeader {
-        TransferOpCode opcode = TransferOpCode::Error;
-        uint64_t length = 0;
-
-        [[nodiscard]] string to_json() const {
-            stringstream json;
-            json << "{\"opcode\":" << to_string(uint16_t(opcode)) << ",\"length\":" << to_string(length) << "}";
-            return json.str();
-        }
-
-        static TransferHeader from_json(const string& json) {
-
-        }
-
+    // A peer sending to us, the streams of a parallel transfer share their session.
+    struct connection {
+        sw::Socket Socket;
+        string Name;
+        stream_receiver Receiver;
     };
 
     void accept_clients() {
         if(auto client = m_socket.Accept();
                 client.IsValid()) {
-            m_clients.emplace_back(client);
+            client.SetBlockingMode(false);
+            auto name = client.GetEndpoint().ToString();
+            LOG(INFO, "{} connected to the file transfer host.", name);
+            m_clients.push_back({ client, name, stream_receiver(m_sessions) });
         }
     }
 
-    void process_requests() {
+    void wait_for_data(int32_t timeout) {
+        if(m_clients.empty()) {
+            this_thread::sleep_for(chrono::milliseconds(timeout));
+            return;
+        }
+        vector<sw::Socket> sockets;
+        sockets.reserve(m_clients.size());
+        for(auto& client : m_clients) {
+            sockets.push_back(client.Socket);
+        }
+        sw::Socket::WaitForData(sockets, timeout);
+    }
 
+    void process_requests() {
+        for(auto it = m_clients.begin(); it != m_clients.end();) {
+            bool valid = it->Receiver.Receive(it->Socket);
+            if(valid && it->Socket.IsConnected()) {
+                ++it;
+                continue;
+            }
+            LOG(INFO, "{} disconnected from the file transfer host.", it->Name);
+            it->Socket.Disconnect();
+            it = m_clients.erase(it);
+        }
     }
 
     [[noreturn]] void terminal_interface() {
@@ -108,8 +127,9 @@ private:
         /*
          * Commands:
          * connect othercomputer.com [or ip address]
-         * send_file ./myfile.txt
-         * send_dir ./mydir
+         * send_file ./myfile.txt [compress]
+         * send_dir ./mydir [streams] [dedup] [compress]
+         * send_delta ./myfile.txt
          */
         ParseResult result = parse_user_input(szBuffer);
         const Action& action = result.action;
@@ -138,6 +158,7 @@ private:
         if(action == Action::connect_to) goto connect_to;
         if(action == Action::send_file) goto send_file;
         if(action == Action::send_dir) goto send_dir;
+        if(action == Action::send_delta) goto send_delta;
 
         // fallback
         LOG(ERR, "Action Unhandled.");
@@ -151,82 +172,683 @@ private:
 
         send_file:
         {
-            send_file(fileName);
+            send_file(fileName, result.compress);
             goto read_user_input;
         }
 
         send_dir:
         {
-            send_dir(dirName);
+            send_dir(dirName, result.streams, result.dedup, result.compress);
             goto read_user_input;
         }
+
+        send_delta:
+        {
+            send_delta(fileName);
+            goto read_user_input;
+        }
+    }
+
+    void send_file(const string& fileName, bool compress) {
+        send_file(fileName, filesystem::path(fileName).filename().string(), compress);
     }
 
-    void send_file(const string& fileName) {
+    bool send_file(const string& fileName, const string& remotePath, bool compress) {
         if (!m_client.IsConnected()) {
             LOG(ERR, "Cannot send file if not connected.");
-            return;
+            return false;
         }
-        FILE *handle = fopen(fileName.c_str(), "rb");
-        if (!handle) {
+        file_handle file;
+        if (!file.OpenRead(fileName)) {
             LOG(ERR, "Cannot open file to send.");
-            return;
+            return false;
         }
 
-        TransferHeader header = { TransferOpCode::CreateFile, 10 };
+        auto meta = describe_file(fileName, remotePath);
+        uint32_t fileId = m_next_file_id++;
+
+        vector<uint8_t> frame;
+        AppendFrame(frame, TransferOpCode::CreateFile, fileId, meta);
+        if (!send_frame(frame.data(), frame.size()))
+            return false;
+
+        unique_ptr<chunk_compressor> compressor;
+        if (compress)
+            compressor = make_unique<chunk_compressor>(thread::hardware_concurrency());
+        progress_line progress(fileName, meta.Size);
+        sha256::hasher hash;
+        uint64_t totalSentBytes = 0;
+        bool sent = send_range(file, fileId, 0, meta.Size, fileName, compressor.get(), &hash, &progress, totalSentBytes);
+        progress.Finish(totalSentBytes);
+        if (!sent || !finish_file(file, fileId, hash.Final(), fileName, compressor.get()))
+            return false;
+        if (compressor)
+            LOG(INFOBOLD, "Sent '{}' ({}) compressed to {}.", meta.Path, cpp::FriendlyMemorySize((double)meta.Size),
+                cpp::FriendlyMemorySize((double)compressor->FrameBytes()));
+        return true;
+    }
 
-        size_t totalSentBytes = 0;
-        size_t fileSize = cpp::GetFileSize(fileName);
-        auto timestamp = chrono::steady_clock::now();
-        int spinnerCounter = 0;
-        char spinner[] = { '\\', '|', '/', '-', ' ' };
-        double downloadRate = 0.0;
-        double spinnerDuration = 0.0;
-        while (!feof(handle)) {
-            char szFileBuf[2048];
-            auto readFileBytes = (int32_t) fread(szFileBuf, sizeof(char), sizeof(szFileBuf), handle);
-            printf("\r"); // clear line
-            // fileSize = (readFileBytes == 0) ? totalSentBytes : fileSize;
+    /*
+     * Sends a file the receiver may already have an older copy of: the receiver answers with the signature of its
+     * copy, and only the parts that changed go out as data, the rest as block references into that copy.
+     */
+    bool send_delta(const string& fileName) {
+        if (!m_client.IsConnected()) {
+            LOG(ERR, "Cannot send file if not connected.");
+            return false;
+        }
+        file_handle file;
+        if (!file.OpenRead(fileName)) {
+            LOG(ERR, "Cannot open file to send.");
+            return false;
+        }
+        auto meta = describe_file(fileName, filesystem::path(fileName).filename().string());
+        uint32_t fileId = m_next_file_id++;
+
+        vector<uint8_t> frame;
+        AppendFrame(frame, TransferOpCode::DeltaFile, fileId, meta);
+        if (!send_frame(frame.data(), frame.size()))
+            return false;
+
+        frame_header reply;
+        vector<uint8_t> replyMeta, payload;
+        signature_meta baseInfo;
+        file_delta::signature base;
+        if (!ReceiveFrame(m_client, reply, replyMeta, payload) || reply.OpCode != TransferOpCode::Signature ||
+            reply.FileId != fileId || !DecodeMeta(replyMeta, baseInfo) || !base.Decode(payload, baseInfo.BlockSize, baseInfo.FileSize)) {
+            LOG(ERR, "The receiver did not send the signature of '{}'.", meta.Path);
+            m_client.Disconnect();
+            return false;
+        }
+
+        // block copies are a few bytes each, frames are packed into sends of about BatchSize
+        frame.clear();
+        auto flush = [&] {
+            bool sent = frame.empty() || send_frame(frame.data(), frame.size());
+            frame.clear();
+            return sent;
+        };
+        progress_line progress(fileName, meta.Size);
+        file_delta::delta_encoder encoder(base);
+        // the encoder reads the file once from start to end
+        sha256::hasher hash;
+        auto read = [&](uint64_t offset, span<uint8_t> out) {
+            auto read = file.ReadAt(offset, out);
+            if (read > 0)
+                hash.Update(out.first(size_t(read)));
+            return read;
+        };
+        auto literal = [&](uint64_t offset, span<const uint8_t> data) {
+            progress.Update(offset + data.size());
+            AppendFrame(frame, TransferOpCode::FileData, fileId, file_data_meta { offset, crc32c::Compute(data) },
+                        data.size(), ChecksumFlag);
+            // large literals are sent from the encoder's buffer rather than copied
+            if (data.size() >= BatchSize / 4)
+                return flush() && send_frame(data.data(), data.size());
+            frame.insert(frame.end(), data.begin(), data.end());
+            return frame.size() < BatchSize || flush();
+        };
+        auto copy = [&](uint64_t offset, uint32_t firstBlock, uint32_t count) {
+            progress.Update(offset);
+            AppendFrame(frame, TransferOpCode::CopyBlocks, fileId, copy_blocks_meta { offset, firstBlock, count });
+            return frame.size() < BatchSize || flush();
+        };
+        bool sent = encoder.Encode(read, meta.Size, literal, copy) && flush();
+        progress.Finish(sent ? meta.Size : encoder.LiteralBytes() + encoder.CopiedBytes());
+        if (!sent) {
+            if (m_client.IsConnected())
+                LOG(ERR, "Error while reading '{}'.", fileName);
+            return false;
+        }
+        // the hash also covers the blocks the receiver copied from its own file
+        if (!finish_file(file, fileId, hash.Final(), fileName, nullptr))
+            return false;
+        LOG(INFOBOLD, "Sent '{}' as a delta: {} of data, {} reused from the receiver's copy.", meta.Path,
+            cpp::FriendlyMemorySize((double)encoder.LiteralBytes()), cpp::FriendlyMemorySize((double)encoder.CopiedBytes()));
+        return true;
+    }
+
+    static create_file_meta describe_file(const string& fileName, const string& remotePath) {
+        error_code ec;
+        create_file_meta meta;
+        meta.Path = remotePath;
+        meta.Size = filesystem::file_size(fileName, ec);
+        meta.Mode = uint32_t(filesystem::status(fileName, ec).permissions() & filesystem::perms::mask);
+        auto modified = filesystem::last_write_time(fileName, ec);
+        if (!ec)
+            meta.ModifiedTime = chrono::duration_cast<chrono::seconds>(chrono::file_clock::to_sys(modified).time_since_epoch()).count();
+        return meta;
+    }
+
+    // A frame that did not go out whole leaves the stream out of sync, the connection is dropped.
+    static bool send_frame(sw::Socket& socket, const uint8_t* data, size_t size) {
+        if (SendAll(socket, data, size))
+            return true;
+        LOG(ERR, "Error while sending file.");
+        if (socket.IsConnected())
+            socket.Disconnect();
+        LOG(ERR, "Lost Connection.");
+        return false;
+    }
+
+    bool send_frame(const uint8_t* data, size_t size) {
+        return send_frame(m_client, data, size);
+    }
+
+    // "Sending 'name'...12.5 MB  42.00%  | 1.1 GB/sec", redrawn in place at most every 100 ms.
+    class progress_line {
+    public:
+        progress_line(string name, uint64_t total)
+        : m_name(std::move(name)), m_total(total), m_start(chrono::steady_clock::now()), m_last_draw(m_start) {}
+
+        void Update(uint64_t sent) {
             auto now = chrono::steady_clock::now();
-            auto duration = (double)chrono::duration_cast<chrono::microseconds>(now - timestamp).count();
-            downloadRate = (readFileBytes == 0) ? downloadRate : sizeof(szFileBuf) / (duration * 1e-6);
-            timestamp = now;
-            cout << "Sending '" << fileName << "'..." << cpp::FriendlyMemorySize((double)totalSentBytes) << "\t" << fixed << setprecision(2) << (100.0 * (double)totalSentBytes / (double)fileSize) << "%";
-            cout << "\t" << spinner[(readFileBytes == 0) ? 4 : spinnerCounter] << " " << cpp::FriendlyMemorySize(downloadRate) << "/sec";
-            for(int i = 0; i < 20; i++)
+            if (now - m_last_draw < chrono::milliseconds(100))
+                return;
+            m_last_draw = now;
+            m_spinner = (m_spinner + 1) % 4;
+            Draw(sent, now, m_spinner);
+        }
+
+        void Finish(uint64_t sent) {
+            Draw(sent, chrono::steady_clock::now(), 4);
+            cout << "\n";
+        }
+
+    private:
+        void Draw(uint64_t sent, chrono::steady_clock::time_point now, int spinner) {
+            const char spinners[] = { '\\', '|', '/', '-', ' ' };
+            double seconds = max(1e-6, chrono::duration<double>(now - m_start).count());
+            double percent = m_total ? 100.0 * (double)sent / (double)m_total : 100.0;
+            printf("\r"); // clear line
+            cout << "Sending '" << m_name << "'..." << cpp::FriendlyMemorySize((double)sent) << "\t" << fixed << setprecision(2) << percent << "%";
+            cout << "\t" << spinners[spinner] << " " << cpp::FriendlyMemorySize((double)sent / seconds) << "/sec";
+            for (int i = 0; i < 20; i++)
                 putchar(' ');
-            if(spinnerDuration += duration; spinnerDuration > 200e3) {
-                spinnerCounter++;
-                spinnerCounter %= 4;
-                spinnerDuration = 0;
-            }
-            if(readFileBytes == 0) {
+            fflush(stdout);
+        }
+
+    private:
+        string m_name;
+        uint64_t m_total;
+        chrono::steady_clock::time_point m_start, m_last_draw;
+        int m_spinner = 0;
+    };
+
+    // Sends part of a file as FileData frames with their CRC-32C, compressed when a compressor is given. The frame
+    // header is written into the headroom in front of the chunk, header and data leave in one Send.
+    bool send_range(file_handle& file, uint32_t fileId, uint64_t offset, uint64_t length, const string& fileName,
+                    chunk_compressor* compressor, sha256::hasher* hash, progress_line* progress, uint64_t& sentBytes) {
+        if (compressor)
+            return send_compressed(file, fileId, offset, length, fileName, *compressor, hash, progress, sentBytes);
+        auto& pool = buffer_pool::Global();
+        uint8_t* buffer = pool.Borrow(FrameHeadroom + DataChunkSize);
+        uint8_t* chunk = buffer + FrameHeadroom;
+        vector<uint8_t> head;
+        bool sent = true;
+        for (uint64_t end = offset + length; sent && offset < end; ) {
+            auto size = size_t(min<uint64_t>(DataChunkSize, end - offset));
+            if (file.ReadAt(offset, { chunk, size }) != int64_t(size)) {
+                LOG(ERR, "Error while reading '{}'.", fileName);
+                sent = false;
                 break;
             }
-            if(m_client.Send(szFileBuf, (int32_t) readFileBytes) <= 0) {
-                LOG(ERR, "Error while sending file.");
-                if(!m_client.IsConnected()) {
-                    LOG(ERR, "Lost Connection.");
+            if (hash)
+                hash->Update({ chunk, size });
+            head.clear();
+            AppendFrame(head, TransferOpCode::FileData, fileId, file_data_meta { offset, crc32c::Compute({ chunk, size }) },
+                        size, ChecksumFlag);
+            uint8_t* start = chunk - head.size();
+            memcpy(start, head.data(), head.size());
+            sent = send_frame(start, head.size() + size);
+            offset += size;
+            sentBytes += size;
+            if (progress)
+                progress->Update(sentBytes);
+        }
+        pool.Return(buffer, FrameHeadroom + DataChunkSize);
+        return sent;
+    }
+
+    // send_range with the chunks compressed by the workers while the next ones are read and the finished ones sent.
+    bool send_compressed(file_handle& file, uint32_t fileId, uint64_t offset, uint64_t length, const string& fileName,
+                         chunk_compressor& compressor, sha256::hasher* hash, progress_line* progress, uint64_t& sentBytes) {
+        uint64_t end = offset + length, sentOffset = offset;
+        bool sent = true;
+        while (sent) {
+            if (offset < end && !compressor.Full()) {
+                auto size = size_t(min<uint64_t>(DataChunkSize, end - offset));
+                auto chunk = compressor.Next().first(size);
+                if (file.ReadAt(offset, chunk) != int64_t(size)) {
+                    LOG(ERR, "Error while reading '{}'.", fileName);
+                    sent = false;
+                    break;
                 }
+                if (hash)
+                    hash->Update(chunk);
+                compressor.Submit(fileId, offset, size);
+                offset += size;
+                continue;
+            }
+            if (compressor.Empty())
+                break;
+            auto frame = compressor.Front();
+            sent = send_frame(frame.data(), frame.size());
+            compressor.Pop();
+            auto size = min<uint64_t>(DataChunkSize, end - sentOffset);
+            sentOffset += size;
+            sentBytes += size;
+            if (progress)
+                progress->Update(sentBytes);
+        }
+        compressor.Clear();
+        return sent;
+    }
+
+    /*
+     * Closes a file with its SHA-256 and waits for the receiver to check it, resending whatever it reports as
+     * damaged, MaxRetransmits times at most.
+     */
+    bool finish_file(file_handle& file, uint32_t fileId, const sha256::digest& hash, const string& fileName,
+                     chunk_compressor* compressor) {
+        vector<uint8_t> frame, meta, payload;
+        vector<pair<uint64_t, uint64_t>> damaged;
+        for (int attempt = 0; ; attempt++) {
+            frame.clear();
+            AppendFrame(frame, TransferOpCode::CloseFile, fileId, close_file_meta { string(hash.begin(), hash.end()) });
+            if (!send_frame(frame.data(), frame.size()))
+                return false;
+            frame_header reply;
+            file_status_meta status;
+            if (!ReceiveFrame(m_client, reply, meta, payload) || reply.OpCode != TransferOpCode::FileStatus ||
+                reply.FileId != fileId || !DecodeMeta(meta, status) || !DecodeRanges(payload, damaged)) {
+                LOG(ERR, "The receiver did not confirm '{}'.", fileName);
+                m_client.Disconnect();
+                return false;
+            }
+            if (status.Status == CloseStatus::Committed)
+                return true;
+            if (status.Status != CloseStatus::Retransmit) {
+                LOG(ERR, "The receiver could not write '{}'.", fileName);
+                return false;
+            }
+            if (attempt == MaxRetransmits) {
+                LOG(ERR, "'{}' still arrives damaged after {} attempts, giving up.", fileName, MaxRetransmits);
+                return false;
             }
-            totalSentBytes += readFileBytes;
+            uint64_t resent = 0;
+            for (const auto& [offset, length] : damaged) {
+                if (!send_range(file, fileId, offset, length, fileName, compressor, nullptr, nullptr, resent))
+                    return false;
+            }
+            LOG(WARNING, "Resent {} of '{}' that arrived damaged.", cpp::FriendlyMemorySize((double)resent), fileName);
         }
-        cout << "\n";
-        fclose(handle);
     }
 
-    void send_dir(const string& dirName) {
+    struct dir_file {
+        string LocalPath;
+        manifest_entry Entry;
+    };
+
+    // Unit of work of a parallel transfer: a whole file, or a RangeSize range of a large one.
+    struct transfer_item {
+        uint32_t File;
+        uint64_t Offset;
+        uint64_t Length;
+        // a content chunk, sent as ChunkData and placed by the receiver wherever the recipes use it
+        bool Chunk = false;
+    };
+
+    struct file_chunk {
+        sha256::digest Hash;
+        uint64_t Offset;
+        uint32_t Length;
+    };
+
+    /*
+     * Sends the manifest on the control connection, then every file the receiver does not already have over
+     * `streams` connections pulling from a shared work list: large files are split into ranges so they are sent by
+     * several streams at once, files below BatchSize are packed into shared sends. With dedup, only the chunks the
+     * receiver's chunk store does not have are sent, see exchange_recipes. With compress, each stream compresses the
+     * file data it sends, the streams being the worker pool.
+     */
+    void send_dir(const string& dirName, int streams, bool dedup, bool compress) {
         if (!m_client.IsConnected()) {
             LOG(ERR, "Cannot send directory if not connected.");
+            return;
         }
+        auto started = chrono::steady_clock::now();
+        // the directory is recreated under its own name on the receiver
+        auto root = filesystem::path(dirName).lexically_normal();
+        auto base = root.has_filename() ? root.filename() : root.parent_path().filename();
+
+        vector<manifest_entry> directories;
+        vector<dir_file> files;
+        directories.push_back({ 0, base.generic_string() });
+        error_code ec;
         using recursive_directory_iterator = std::filesystem::recursive_directory_iterator;
-        for (const auto& dirEntry : recursive_directory_iterator(dirName)) {
-            if(dirEntry.is_regular_file()) {
-                send_file(dirEntry.path().string());
-            } else if(dirEntry.is_directory()) {
+        for (recursive_directory_iterator it(root, filesystem::directory_options::skip_permission_denied, ec), end;
+             !ec && it != end; it.increment(ec)) {
+            const auto& dirEntry = *it;
+            auto remotePath = (base / dirEntry.path().lexically_relative(root)).generic_string();
+            if(dirEntry.is_regular_file(ec)) {
+                dir_file file;
+                file.LocalPath = dirEntry.path().string();
+                file.Entry.FileId = m_next_file_id++;
+                file.Entry.Path = remotePath;
+                file.Entry.Size = dirEntry.file_size(ec);
+                file.Entry.Mode = uint32_t(dirEntry.status(ec).permissions() & filesystem::perms::mask);
+                auto modified = dirEntry.last_write_time(ec);
+                if (!ec)
+                    file.Entry.ModifiedTime = chrono::duration_cast<chrono::seconds>(chrono::file_clock::to_sys(modified).time_since_epoch()).count();
+                files.push_back(std::move(file));
+            } else if(dirEntry.is_directory(ec)) {
+                directories.push_back({ 0, remotePath });
+            }
+        }
+        if (ec) {
+            LOG(ERR, "Cannot list '{}': {}", dirName, ec.message());
+            return;
+        }
 
+        // the manifest tells the receiver which files to expect, and gets back the ones it already has
+        uint64_t sessionId = random_device{}() ^ (uint64_t(chrono::steady_clock::now().time_since_epoch().count()) << 16);
+        vector<uint8_t> frame, meta;
+        AppendFrame(frame, TransferOpCode::BeginSession, 0, session_meta { sessionId });
+        auto flush_manifest = [&] {
+            size_t start = frame.size();
+            frame.resize(start + FrameHeaderSize);
+            frame_header { TransferOpCode::Manifest, 0, uint32_t(meta.size()), 0, 0 }.Encode(frame.data() + start);
+            frame.insert(frame.end(), meta.begin(), meta.end());
+            meta.clear();
+        };
+        auto add_entry = [&](const manifest_entry& entry) {
+            WriteMeta(meta, entry);
+            if (meta.size() >= MaxMetaLength / 2)
+                flush_manifest();
+        };
+        for (const auto& directory : directories)
+            add_entry(directory);
+        for (const auto& file : files)
+            add_entry(file.Entry);
+        if (!meta.empty())
+            flush_manifest();
+        AppendFrame(frame, TransferOpCode::EndManifest, 0, empty_meta {});
+        if (!send_frame(frame.data(), frame.size()))
+            return;
+
+        frame_header reply;
+        vector<uint8_t> upToDate;
+        if (!ReceiveFrame(m_client, reply, meta, upToDate) || reply.OpCode != TransferOpCode::ManifestAck) {
+            LOG(ERR, "The receiver did not acknowledge the manifest.");
+            m_client.Disconnect();
+            return;
+        }
+
+        vector<transfer_item> items;
+        vector<uint32_t> changed;
+        uint64_t totalBytes = 0;
+        size_t skipped = 0;
+        for (uint32_t i = 0; i < files.size(); i++) {
+            if (i / 8 < upToDate.size() && (upToDate[i / 8] >> (i % 8) & 1)) {
+                skipped++;
+                continue;
+            }
+            if (dedup) {
+                changed.push_back(i);
+                continue;
+            }
+            auto size = files[i].Entry.Size;
+            totalBytes += size;
+            for (uint64_t offset = 0; offset < size; offset += RangeSize) {
+                items.push_back({ i, offset, min(RangeSize, size - offset) });
             }
         }
+        // ranges of large files first, so they are spread over the streams while the small files fill the gaps
+        stable_sort(items.begin(), items.end(), [](const auto& a, const auto& b) { return a.Length > b.Length; });
+        // files that could not be read in full, the receiver keeps them as partial files
+        vector<atomic<bool>> unreadable(files.size());
+        if (dedup && !exchange_recipes(files, changed, items, totalBytes, unreadable))
+            return;
+
+        vector<sw::Socket> extraStreams;
+        vector<uint8_t> join;
+        AppendFrame(join, TransferOpCode::JoinSession, 0, session_meta { sessionId });
+        for (int i = 1; i < streams && items.size() > size_t(i); i++) {
+            sw::Socket stream(sw::SocketType::TCP);
+            stream.Connect(m_connect_addr, m_connect_port);
+            if (!stream.IsConnected() || !SendAll(stream, join.data(), join.size())) {
+                LOG(WARNING, "Could only open {} of {} streams.", i, streams);
+                break;
+            }
+            extraStreams.push_back(stream);
+        }
+
+        atomic<size_t> nextItem = 0;
+        atomic<uint64_t> sentBytes = 0;
+        atomic<bool> failed = false;
+        progress_line progress(dirName, totalBytes);
+        auto worker = [&](sw::Socket& socket, bool report) {
+            if (!send_items(socket, files, items, compress, nextItem, sentBytes, failed, unreadable,
+                            report ? &progress : nullptr))
+                failed = true;
+        };
+        vector<thread> threads;
+        for (auto& stream : extraStreams) {
+            threads.emplace_back(worker, ref(stream), false);
+        }
+        worker(m_client, true);
+        for (auto& t : threads) {
+            t.join();
+        }
+        for (auto& stream : extraStreams) {
+            stream.Disconnect();
+        }
+        progress.Finish(sentBytes);
+
+        auto seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        if (failed) {
+            LOG(ERR, "Transfer of '{}' failed after {}.", dirName, cpp::FriendlyMemorySize((double)sentBytes));
+            return;
+        }
+        size_t incomplete = count_if(unreadable.begin(), unreadable.end(), [](const auto& flag) { return flag.load(); });
+        LOG(INFOBOLD, "Sent {} of {} files ({}) in {} seconds over {} streams, {} already up to date.",
+            files.size() - skipped - incomplete, files.size(), cpp::FriendlyMemorySize((double)totalBytes), seconds,
+            extraStreams.size() + 1, skipped);
+        if (incomplete > 0)
+            LOG(ERR, "{} files of '{}' could not be read, they are incomplete on the receiver.", incomplete, dirName);
+    }
+
+    /*
+     * Splits the changed files into content-defined chunks (one thread per core), sends their recipes on the control
+     * connection and turns the chunks the receiver asks for into the work list. A chunk shared by several files, or
+     * already received in an earlier run, is not sent again. Files that cannot be read are flagged in unreadable.
+     */
+    bool exchange_recipes(const vector<dir_file>& files, const vector<uint32_t>& changed, vector<transfer_item>& items,
+                          uint64_t& totalBytes, vector<atomic<bool>>& unreadable) {
+        vector<vector<file_chunk>> recipes(changed.size());
+        atomic<size_t> nextFile = 0;
+        auto chunk_files = [&] {
+            vector<uint8_t> buffer(4 * content_chunker::MaxChunkSize);
+            for (size_t index = nextFile++; index < changed.size(); index = nextFile++) {
+                const auto& file = files[changed[index]];
+                if (!chunk_file(file.LocalPath, file.Entry.Size, buffer, recipes[index])) {
+                    LOG(WARNING, "Cannot read '{}', skipping it.", file.LocalPath);
+                    recipes[index].clear();
+                    unreadable[changed[index]] = true;
+                }
+            }
+        };
+        vector<thread> threads;
+        size_t workers = min<size_t>(max(1u, thread::hardware_concurrency()), changed.size());
+        for (size_t i = 1; i < workers; i++) {
+            threads.emplace_back(chunk_files);
+        }
+        chunk_files();
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        vector<uint8_t> frame;
+        bool sent = true;
+        for (size_t index = 0; sent && index < changed.size(); index++) {
+            const auto& recipe = recipes[index];
+            constexpr size_t entriesPerFrame = BatchSize / RecipeEntrySize;
+            for (size_t first = 0; first < recipe.size(); first += entriesPerFrame) {
+                size_t count = min(entriesPerFrame, recipe.size() - first);
+                AppendFrame(frame, TransferOpCode::ChunkRecipe, files[changed[index]].Entry.FileId, empty_meta {},
+                            count * RecipeEntrySize);
+                for (size_t i = first; i < first + count; i++) {
+                    const auto& chunk = recipe[i];
+                    frame.insert(frame.end(), chunk.Hash.begin(), chunk.Hash.end());
+                    for (int b = 0; b < 4; b++)
+                        frame.push_back(uint8_t(chunk.Length >> (8 * b)));
+                }
+            }
+            if (frame.size() >= BatchSize) {
+                sent = send_frame(frame.data(), frame.size());
+                frame.clear();
+            }
+        }
+        AppendFrame(frame, TransferOpCode::EndRecipes, 0, empty_meta {});
+        if (!sent || !send_frame(frame.data(), frame.size()))
+            return false;
+
+        frame_header reply;
+        vector<uint8_t> meta, wanted;
+        if (!ReceiveFrame(m_client, reply, meta, wanted) || reply.OpCode != TransferOpCode::ChunkWant) {
+            LOG(ERR, "The receiver did not answer the chunk recipes.");
+            m_client.Disconnect();
+            return false;
+        }
+        items.clear();
+        totalBytes = 0;
+        size_t entry = 0, chunks = 0;
+        uint64_t recipeBytes = 0;
+        for (size_t index = 0; index < changed.size(); index++) {
+            for (const auto& chunk : recipes[index]) {
+                chunks++;
+                recipeBytes += chunk.Length;
+                size_t bit = entry++;
+                if (bit / 8 < wanted.size() && (wanted[bit / 8] >> (bit % 8) & 1)) {
+                    items.push_back({ changed[index], chunk.Offset, chunk.Length, true });
+                    totalBytes += chunk.Length;
+                }
+            }
+        }
+        LOG(INFO, "{} of {} chunks ({} of {}) are missing on the receiver, chunked with {}.", items.size(), chunks,
+            cpp::FriendlyMemorySize((double)totalBytes), cpp::FriendlyMemorySize((double)recipeBytes),
+            content_chunker::KernelName());
+        return true;
+    }
+
+    static bool chunk_file(const string& path, uint64_t size, vector<uint8_t>& buffer, vector<file_chunk>& out) {
+        file_handle file;
+        if (!file.OpenRead(path))
+            return false;
+        // the buffer always holds a whole chunk ahead, except at the end of the file
+        size_t start = 0, end = 0;
+        uint64_t offset = 0, readOffset = 0;
+        while (offset < size) {
+            if (end - start < content_chunker::MaxChunkSize && readOffset < size) {
+                memmove(buffer.data(), buffer.data() + start, end - start);
+                end -= start;
+                start = 0;
+                auto length = size_t(min<uint64_t>(buffer.size() - end, size - readOffset));
+                if (file.ReadAt(readOffset, { buffer.data() + end, length }) != int64_t(length))
+                    return false;
+                end += length;
+                readOffset += length;
+            }
+            size_t length = content_chunker::NextChunk({ buffer.data() + start, end - start });
+            out.push_back({ sha256::Hash({ buffer.data() + start, length }), offset, uint32_t(length) });
+            start += length;
+            offset += length;
+        }
+        return true;
+    }
+
+    // Worker of send_dir, takes items until the list is exhausted or a stream failed.
+    static bool send_items(sw::Socket& socket, const vector<dir_file>& files, const vector<transfer_item>& items, bool compress,
+                           atomic<size_t>& nextItem, atomic<uint64_t>& sentBytes, const atomic<bool>& failed,
+                           vector<atomic<bool>>& unreadable, progress_line* progress) {
+        auto& pool = buffer_pool::Global();
+        uint8_t* buffer = pool.Borrow(FrameHeadroom + DataChunkSize);
+        uint8_t* chunk = buffer + FrameHeadroom;
+        vector<uint8_t> batch, head;
+        batch.reserve(2 * BatchSize);
+        bool sent = true;
+        auto flush_batch = [&] {
+            sent = sent && (batch.empty() || send_frame(socket, batch.data(), batch.size()));
+            batch.clear();
+        };
+
+        file_handle file;
+        uint32_t openFile = UINT32_MAX;
+        for (size_t index = nextItem++; sent && !failed && index < items.size(); index = nextItem++) {
+            const auto& item = items[index];
+            const auto& entry = files[item.File].Entry;
+            if (openFile != item.File) {
+                openFile = item.File;
+                if (!file.OpenRead(files[item.File].LocalPath)) {
+                    LOG(WARNING, "Cannot open '{}', skipping it.", files[item.File].LocalPath);
+                    unreadable[item.File] = true;
+                    openFile = UINT32_MAX;
+                    continue;
+                }
+            }
+
+            if (item.Length < BatchSize) {
+                // small file: header and data appended to the batch, sent together with its neighbours
+                auto length = size_t(item.Length);
+                if (file.ReadAt(item.Offset, { chunk, length }) != int64_t(length)) {
+                    LOG(WARNING, "'{}' changed while it was sent, skipping it.", files[item.File].LocalPath);
+                    unreadable[item.File] = true;
+                    continue;
+                }
+                // chunks are checked by their hash
+                if (item.Chunk) {
+                    AppendFrame(batch, TransferOpCode::ChunkData, 0, empty_meta {}, length);
+                    batch.insert(batch.end(), chunk, chunk + length);
+                } else {
+                    AppendDataFrame(batch, entry.FileId, item.Offset, { chunk, length }, compress);
+                }
+                if (batch.size() >= BatchSize)
+                    flush_batch();
+            } else {
+                flush_batch();
+                for (uint64_t offset = item.Offset; sent && offset < item.Offset + item.Length; ) {
+                    size_t length = size_t(min<uint64_t>(DataChunkSize, item.Offset + item.Length - offset));
+                    if (file.ReadAt(offset, { chunk, length }) != int64_t(length)) {
+                        LOG(WARNING, "'{}' changed while it was sent, skipping the rest of it.", files[item.File].LocalPath);
+                        unreadable[item.File] = true;
+                        break;
+                    }
+                    head.clear();
+                    if (compress) {
+                        AppendDataFrame(head, entry.FileId, offset, { chunk, length }, true);
+                        sent = send_frame(socket, head.data(), head.size());
+                    } else {
+                        AppendFrame(head, TransferOpCode::FileData, entry.FileId,
+                                    file_data_meta { offset, crc32c::Compute({ chunk, length }) }, length, ChecksumFlag);
+                        uint8_t* start = chunk - head.size();
+                        memcpy(start, head.data(), head.size());
+                        sent = send_frame(socket, start, head.size() + length);
+                    }
+                    offset += length;
+                    sentBytes += length;
+                }
+                if (progress)
+                    progress->Update(sentBytes);
+                continue;
+            }
+            sentBytes += item.Length;
+            if (progress)
+                progress->Update(sentBytes);
+        }
+        flush_batch();
+        pool.Return(buffer, FrameHeadroom + DataChunkSize);
+        return sent;
     }
 
     static vector<char> read_terminal_input() {
@@ -290,6 +912,9 @@ private:
                 } else if(word == "send_dir") {
                     result.action = Action::send_dir;
                     result.state = ParserState::FetchingDirName;
+                } else if(word == "send_delta") {
+                    result.action = Action::send_delta;
+                    result.state = ParserState::FetchingFileName;
                 }
             } else if(result.state == ParserState::FetchingAddress) {
                 auto colon = word.find(':');
@@ -321,10 +946,28 @@ private:
                 result.error = ParserError::UnknownArgument;
             } else if(result.state == ParserState::FetchingFileName) {
                 fileName = word;
-                result.state = ParserState::FetchingNull;
+                result.state = result.action == Action::send_file ? ParserState::FetchingOption : ParserState::FetchingNull;
             } else if(result.state == ParserState::FetchingDirName) {
                 dirName = word;
-                result.state = ParserState::FetchingNull;
+                result.state = ParserState::FetchingStreamCount;
+            } else if((result.state == ParserState::FetchingStreamCount || result.state == ParserState::FetchingOption) &&
+                      result.action == Action::send_dir && cpp::LowerCase(word) == "dedup") {
+                result.dedup = true;
+                result.state = ParserState::FetchingOption;
+            } else if((result.state == ParserState::FetchingStreamCount || result.state == ParserState::FetchingOption) &&
+                      cpp::LowerCase(word) == "compress") {
+                result.compress = true;
+                result.state = ParserState::FetchingOption;
+            } else if(result.state == ParserState::FetchingOption) {
+                result.error = ParserError::UnknownArgument;
+            } else if(result.state == ParserState::FetchingStreamCount) {
+                size_t streams = 0;
+                if(!cpp::TryToInt64(word, streams) || streams == 0 || streams > MaxStreams) {
+                    result.error = ParserError::UnknownArgument;
+                    break;
+                }
+                result.streams = int(streams);
+                result.state = ParserState::FetchingOption;
             }
         } while(true);
 
@@ -334,6 +977,8 @@ private:
     void connect_to(const string& connect_to_addr, uint16_t connect_port) {
         LOG(INFOBOLD, "Connecting to {} on port {}", connect_to_addr, connect_port);
         m_client.Connect(connect_to_addr, connect_port);
+        m_connect_addr = connect_to_addr;
+        m_connect_port = connect_port;
         if (m_client.IsConnected()) {
             LOG(INFOBOLD, "Successfully connected.");
         } else {
@@ -344,11 +989,17 @@ private:
 private:
     sw::Socket m_socket;
     sw::Socket m_client;
-    list<sw::Socket> m_clients;
+    list<connection> m_clients;
+    session_registry m_sessions;
+    string m_connect_addr;
+    uint16_t m_connect_port = DefaultPort;
+    uint32_t m_next_file_id = 1;
 };
 
 void test_file_transfer() {
     file_transfer_host host;
     host.start_terminal_interface();
-    this_thread::sleep_for(chrono::hours(10));
+    while (true) {
+        host.process();
+    }
 }
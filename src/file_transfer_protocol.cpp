@@ -0,0 +1,974 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "file_transfer_protocol.h"
+#include "buffer_pool.h"
+#include "crc32c.h"
+#include "lz4_block.h"
+#include "Socket.hpp"
+#include "CppUtility.hpp"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <utility>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static void put_le(uint8_t* out, uint64_t value, int bytes) {
+    for(int i = 0; i < bytes; i++) {
+        out[i] = uint8_t(value >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const uint8_t* in, int bytes) {
+    uint64_t value = 0;
+    for(int i = 0; i < bytes; i++) {
+        value |= uint64_t(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+void file_transfer::frame_header::Encode(uint8_t *out) const {
+    put_le(out, Magic, 4);
+    put_le(out + 4, uint16_t(OpCode), 2);
+    put_le(out + 6, Flags, 2);
+    put_le(out + 8, MetaLength, 4);
+    put_le(out + 12, FileId, 4);
+    put_le(out + 16, PayloadLength, 8);
+}
+
+bool file_transfer::frame_header::Decode(const uint8_t *in, frame_header &header) {
+    if(get_le(in, 4) != Magic)
+        return false;
+    header.OpCode = TransferOpCode(get_le(in + 4, 2));
+    header.Flags = uint16_t(get_le(in + 6, 2));
+    header.MetaLength = uint32_t(get_le(in + 8, 4));
+    header.FileId = uint32_t(get_le(in + 12, 4));
+    header.PayloadLength = get_le(in + 16, 8);
+    return true;
+}
+
+bool file_transfer::SendAll(sw::Socket &socket, const uint8_t *data, size_t size) {
+    while(size > 0) {
+        int32_t sent = socket.Send(data, int32_t(min<size_t>(size, INT32_MAX)));
+        if(sent <= 0)
+            return false;
+        data += sent;
+        size -= size_t(sent);
+    }
+    return true;
+}
+
+static bool receive_exact(sw::Socket& socket, uint8_t* out, size_t size) {
+    while(size > 0) {
+        int32_t received = socket.Recv(out, int32_t(min<size_t>(size, INT32_MAX)), false);
+        if(received <= 0)
+            return false;
+        out += received;
+        size -= size_t(received);
+    }
+    return true;
+}
+
+void file_transfer::AppendDataFrame(vector<uint8_t> &out, uint32_t file_id, uint64_t offset, span<const uint8_t> data,
+                                    bool compress) {
+    uint32_t checksum = crc32c::Compute(data);
+    if(compress && data.size() >= MinCompressLength) {
+        size_t start = out.size();
+        AppendFrame(out, TransferOpCode::FileData, file_id, file_data_meta { offset, checksum, uint32_t(data.size()) },
+                    0, ChecksumFlag | CompressedFlag);
+        size_t payload = out.size();
+        out.resize(payload + data.size() - data.size() / 8);
+        size_t length = lz4_block::Compress(data, span<uint8_t>(out).subspan(payload));
+        if(length > 0) {
+            // the payload length is only known now
+            out.resize(payload + length);
+            frame_header header;
+            frame_header::Decode(out.data() + start, header);
+            header.PayloadLength = length;
+            header.Encode(out.data() + start);
+            return;
+        }
+        out.resize(start);
+    }
+    AppendFrame(out, TransferOpCode::FileData, file_id, file_data_meta { offset, checksum }, data.size(), ChecksumFlag);
+    out.insert(out.end(), data.begin(), data.end());
+}
+
+void file_transfer::range_set::Add(uint64_t offset, uint64_t length) {
+    if(length == 0)
+        return;
+    uint64_t start = offset, end = offset + length;
+    // merge with every range that overlaps or touches [start, end)
+    auto it = m_ranges.upper_bound(start);
+    if(it != m_ranges.begin() && prev(it)->second >= start)
+        --it;
+    while(it != m_ranges.end() && it->first <= end) {
+        start = min(start, it->first);
+        end = max(end, it->second);
+        m_covered -= it->second - it->first;
+        it = m_ranges.erase(it);
+    }
+    m_ranges.emplace(start, end);
+    m_covered += end - start;
+}
+
+void file_transfer::range_set::Clear() {
+    m_ranges.clear();
+    m_covered = 0;
+}
+
+void file_transfer::AppendRange(vector<uint8_t> &out, uint64_t offset, uint64_t length) {
+    size_t start = out.size();
+    out.resize(start + DamagedRangeSize);
+    put_le(out.data() + start, offset, 8);
+    put_le(out.data() + start + 8, length, 8);
+}
+
+bool file_transfer::DecodeRanges(span<const uint8_t> in, vector<pair<uint64_t, uint64_t>> &ranges) {
+    if(in.size() % DamagedRangeSize != 0)
+        return false;
+    ranges.clear();
+    for(; !in.empty(); in = in.subspan(DamagedRangeSize))
+        ranges.emplace_back(get_le(in.data(), 8), get_le(in.data() + 8, 8));
+    return true;
+}
+
+bool file_transfer::ReceiveFrame(sw::Socket &socket, frame_header &header, vector<uint8_t> &meta, vector<uint8_t> &payload) {
+    uint8_t head[FrameHeaderSize];
+    if(!receive_exact(socket, head, sizeof(head)) || !frame_header::Decode(head, header) || header.MetaLength > MaxMetaLength)
+        return false;
+    meta.resize(header.MetaLength);
+    // replies are small, a bitmap of a few million files at most
+    if(header.PayloadLength > 64 * 1024 * 1024)
+        return false;
+    payload.resize(size_t(header.PayloadLength));
+    return receive_exact(socket, meta.data(), meta.size()) && receive_exact(socket, payload.data(), payload.size());
+}
+
+bool file_transfer::SafeRelativePath(string_view path, fs::path &out) {
+    out.clear();
+    while(!path.empty()) {
+        auto end = path.find_first_of("/\\");
+        auto part = path.substr(0, end);
+        path = end == string_view::npos ? string_view() : path.substr(end + 1);
+        if(part.empty() || part == ".")
+            continue;
+        // no parent directories, drive letters (C:) or alternate data streams
+        if(part == ".." || part.find(':') != string_view::npos || part.find('\0') != string_view::npos)
+            return false;
+        out /= fs::path(string(part));
+    }
+    return !out.empty();
+}
+
+file_transfer::file_handle::file_handle(file_handle &&other) noexcept {
+    *this = std::move(other);
+}
+
+file_transfer::file_handle &file_transfer::file_handle::operator=(file_handle &&other) noexcept {
+    if(this != &other) {
+        Close();
+#ifdef _WIN32
+        m_file = std::exchange(other.m_file, nullptr);
+#else
+        m_fd = std::exchange(other.m_fd, -1);
+#endif
+    }
+    return *this;
+}
+
+file_transfer::file_handle::~file_handle() {
+    Close();
+}
+
+#ifdef _WIN32
+bool file_transfer::file_handle::OpenRead(const fs::path &path) {
+    Close();
+    m_file = _wfopen(path.c_str(), L"rb");
+    return m_file != nullptr;
+}
+
+bool file_transfer::file_handle::OpenWrite(const fs::path &path, uint32_t mode) {
+    (void)mode;
+    Close();
+    m_file = _wfopen(path.c_str(), L"w+b");
+    return m_file != nullptr;
+}
+
+bool file_transfer::file_handle::Preallocate(uint64_t size) {
+    return Resize(size);
+}
+
+bool file_transfer::file_handle::WriteAt(uint64_t offset, span<const uint8_t> data) {
+    return _fseeki64(m_file, int64_t(offset), SEEK_SET) == 0 &&
+           fwrite(data.data(), 1, data.size(), m_file) == data.size();
+}
+
+int64_t file_transfer::file_handle::ReadAt(uint64_t offset, span<uint8_t> out) {
+    if(_fseeki64(m_file, int64_t(offset), SEEK_SET) != 0)
+        return -1;
+    size_t read = fread(out.data(), 1, out.size(), m_file);
+    return ferror(m_file) ? -1 : int64_t(read);
+}
+
+bool file_transfer::file_handle::Resize(uint64_t size) {
+    fflush(m_file);
+    return _chsize_s(_fileno(m_file), int64_t(size)) == 0;
+}
+
+void file_transfer::file_handle::Close() {
+    if(m_file)
+        fclose(m_file);
+    m_file = nullptr;
+}
+
+bool file_transfer::file_handle::IsOpen() const {
+    return m_file != nullptr;
+}
+#else
+bool file_transfer::file_handle::OpenRead(const fs::path &path) {
+    Close();
+    m_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(m_fd < 0)
+        return false;
+#ifdef POSIX_FADV_SEQUENTIAL
+    // doubles the kernel read-ahead window, the file is read once from start to end
+    posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return true;
+}
+
+bool file_transfer::file_handle::OpenWrite(const fs::path &path, uint32_t mode) {
+    Close();
+    // the owner must be able to write the file while it is received, whatever mode it had on the sender
+    m_fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, mode_t((mode & 0777) | 0600));
+    return m_fd >= 0;
+}
+
+bool file_transfer::file_handle::Preallocate(uint64_t size) {
+    if(size == 0)
+        return true;
+#ifdef __linux__
+    if(fallocate(m_fd, 0, 0, off_t(size)) == 0)
+        return true;
+    // file systems without fallocate (tmpfs on old kernels, some network file systems) are written as they come
+    return errno == EOPNOTSUPP || errno == ENOSYS;
+#else
+    return true;
+#endif
+}
+
+bool file_transfer::file_handle::WriteAt(uint64_t offset, span<const uint8_t> data) {
+    while(!data.empty()) {
+        ssize_t written = pwrite(m_fd, data.data(), data.size(), off_t(offset));
+        if(written < 0) {
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+        data = data.subspan(size_t(written));
+        offset += uint64_t(written);
+    }
+    return true;
+}
+
+int64_t file_transfer::file_handle::ReadAt(uint64_t offset, span<uint8_t> out) {
+    size_t total = 0;
+    while(total < out.size()) {
+        ssize_t read = pread(m_fd, out.data() + total, out.size() - total, off_t(offset + total));
+        if(read < 0) {
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+        if(read == 0)
+            break;
+        total += size_t(read);
+    }
+    return int64_t(total);
+}
+
+bool file_transfer::file_handle::Resize(uint64_t size) {
+    return ftruncate(m_fd, off_t(size)) == 0;
+}
+
+void file_transfer::file_handle::Close() {
+    if(m_fd >= 0)
+        close(m_fd);
+    m_fd = -1;
+}
+
+bool file_transfer::file_handle::IsOpen() const {
+    return m_fd >= 0;
+}
+#endif
+
+file_transfer::session::~session() {
+    // whatever is still open was interrupted
+    for(auto& [id, file] : m_files) {
+        file.File.Close();
+        error_code ec;
+        fs::remove(file.Temporary, ec);
+        LOG(WARNING, "File transfer of '{}' interrupted after {} of {} bytes.", file.Meta.Path, file.Written.Covered(), file.Meta.Size);
+    }
+}
+
+bool file_transfer::session::AddDirectory(const create_directory_meta &meta) {
+    fs::path relative;
+    if(!SafeRelativePath(meta.Path, relative)) {
+        LOG(ERR, "Refusing to create directory '{}' outside of the receive directory.", meta.Path);
+        return false;
+    }
+    error_code ec;
+    fs::create_directories(m_root / relative, ec);
+    if(ec) {
+        LOG(ERR, "Cannot create directory '{}': {}", meta.Path, ec.message());
+        return false;
+    }
+    return true;
+}
+
+bool file_transfer::session::Prepare(uint32_t file_id, const create_file_meta &meta, open_file &file) {
+    fs::path relative;
+    if(!SafeRelativePath(meta.Path, relative)) {
+        LOG(ERR, "Refusing to write file '{}' outside of the receive directory.", meta.Path);
+        return false;
+    }
+    if(m_files.contains(file_id)) {
+        LOG(ERR, "File id {} announced twice ('{}').", file_id, meta.Path);
+        return false;
+    }
+    file.Meta = meta;
+    file.Destination = m_root / relative;
+    file.Temporary = file.Destination;
+    file.Temporary += ".part";
+    return true;
+}
+
+bool file_transfer::session::Open(open_file &file) {
+    error_code ec;
+    fs::create_directories(file.Destination.parent_path(), ec);
+    if(!file.File.OpenWrite(file.Temporary, file.Meta.Mode)) {
+        LOG(ERR, "Cannot create '{}'.", file.Temporary.string());
+        return false;
+    }
+    if(!file.File.Preallocate(file.Meta.Size)) {
+        LOG(ERR, "Cannot reserve {} for '{}', is the disk full?", cpp::FriendlyMemorySize(double(file.Meta.Size)), file.Meta.Path);
+        file.File.Close();
+        fs::remove(file.Temporary, ec);
+        return false;
+    }
+    return true;
+}
+
+bool file_transfer::session::Commit(open_file &file) {
+    error_code ec;
+    bool resized = file.File.Resize(file.Meta.Size);
+    file.File.Close();
+    file.Base.Close();
+    if(!resized) {
+        fs::remove(file.Temporary, ec);
+        return false;
+    }
+    if(file.Meta.ModifiedTime != 0) {
+        auto modified = chrono::system_clock::time_point(chrono::seconds(file.Meta.ModifiedTime));
+        fs::last_write_time(file.Temporary, chrono::file_clock::from_sys(modified), ec);
+    }
+    fs::rename(file.Temporary, file.Destination, ec);
+    if(ec) {
+        LOG(ERR, "Cannot move '{}' into place: {}", file.Destination.string(), ec.message());
+        return false;
+    }
+    m_completed_files++;
+    return true;
+}
+
+bool file_transfer::session::BeginFile(uint32_t file_id, const create_file_meta &meta) {
+    open_file file;
+    if(!Prepare(file_id, meta, file) || !Open(file))
+        return false;
+    m_files.emplace(file_id, std::move(file));
+    return true;
+}
+
+bool file_transfer::session::AddFile(const manifest_entry &entry, bool &up_to_date) {
+    open_file file;
+    up_to_date = false;
+    if(!Prepare(entry.FileId, { entry.Path, entry.Size, entry.Mode, entry.ModifiedTime }, file))
+        return false;
+
+    error_code ec;
+    auto status = fs::status(file.Destination, ec);
+    if(!ec && fs::is_regular_file(status) && entry.ModifiedTime != 0 && fs::file_size(file.Destination, ec) == entry.Size) {
+        auto modified = fs::last_write_time(file.Destination, ec);
+        auto seconds = chrono::duration_cast<chrono::seconds>(chrono::file_clock::to_sys(modified).time_since_epoch()).count();
+        if(!ec && seconds == entry.ModifiedTime) {
+            up_to_date = true;
+            return true;
+        }
+    }
+
+    // empty files get no data frames
+    if(entry.Size == 0)
+        return Open(file) && Commit(file);
+    file.CompleteWhenWritten = true;
+    m_files.emplace(entry.FileId, std::move(file));
+    return true;
+}
+
+bool file_transfer::session::BeginDelta(uint32_t file_id, const create_file_meta &meta, file_delta::signature &base) {
+    open_file file;
+    if(!Prepare(file_id, meta, file))
+        return false;
+    base = {};
+    base.BlockSize = file_delta::BlockSizeFor(meta.Size);
+    error_code ec;
+    if(fs::is_regular_file(file.Destination, ec)) {
+        file.BaseSize = fs::file_size(file.Destination, ec);
+        if(ec || !file.Base.OpenRead(file.Destination)) {
+            LOG(ERR, "Cannot open '{}' to update it.", file.Destination.string());
+            return false;
+        }
+        auto read = [&](uint64_t offset, span<uint8_t> out) { return file.Base.ReadAt(offset, out); };
+        if(!file_delta::ComputeSignature(read, file.BaseSize, base)) {
+            LOG(ERR, "Cannot read '{}' to update it.", file.Destination.string());
+            return false;
+        }
+    }
+    file.BlockSize = base.BlockSize;
+    if(!Open(file))
+        return false;
+    m_files.emplace(file_id, std::move(file));
+    return true;
+}
+
+bool file_transfer::session::CopyBlocks(uint32_t file_id, const copy_blocks_meta &meta) {
+    auto it = m_files.find(file_id);
+    if(it == m_files.end() || !it->second.Base.IsOpen()) {
+        LOG(ERR, "Block copy received for file id {} without a local copy.", file_id);
+        return false;
+    }
+    auto& file = it->second;
+    uint64_t source = uint64_t(meta.FirstBlock) * file.BlockSize;
+    uint64_t end = min(source + uint64_t(meta.Count) * file.BlockSize, file.BaseSize);
+    if(meta.Count == 0 || source >= file.BaseSize || meta.Offset > file.Meta.Size || end - source > file.Meta.Size - meta.Offset) {
+        LOG(ERR, "Block copy past the end of '{}'.", file.Meta.Path);
+        return false;
+    }
+
+    auto& pool = buffer_pool::Global();
+    uint8_t* buffer = pool.Borrow(DataChunkSize);
+    bool valid = true;
+    for(uint64_t copied = 0; valid && source + copied < end;) {
+        auto length = size_t(min<uint64_t>(DataChunkSize, end - source - copied));
+        valid = file.Base.ReadAt(source + copied, { buffer, length }) == int64_t(length) &&
+                file.File.WriteAt(meta.Offset + copied, { buffer, length });
+        copied += length;
+    }
+    pool.Return(buffer, DataChunkSize);
+    if(!valid) {
+        LOG(ERR, "Cannot copy blocks of '{}' from the local copy.", file.Meta.Path);
+        return false;
+    }
+    file.Written.Add(meta.Offset, end - source);
+    return true;
+}
+
+bool file_transfer::session::AddChunk(uint32_t file_id, const sha256::digest &hash, uint32_t length, bool &wanted) {
+    wanted = false;
+    auto it = m_files.find(file_id);
+    if(it == m_files.end() || !it->second.CompleteWhenWritten) {
+        LOG(ERR, "Chunk recipe received for unknown file id {}.", file_id);
+        return false;
+    }
+    auto& file = it->second;
+    uint64_t offset = file.RecipeLength;
+    if(length == 0 || length > file.Meta.Size - offset) {
+        LOG(ERR, "Chunk recipe of '{}' is longer than the file.", file.Meta.Path);
+        return false;
+    }
+    file.RecipeLength += length;
+
+    if(auto pending = m_wanted_chunks.find(hash); pending != m_wanted_chunks.end()) {
+        pending->second.push_back({ file_id, offset, length });
+        return true;
+    }
+    if(m_store && m_store->Read(hash, m_chunk) && m_chunk.size() == length) {
+        m_reused_bytes += length;
+        return Place(file_id, offset, m_chunk);
+    }
+    m_wanted_chunks[hash].push_back({ file_id, offset, length });
+    wanted = true;
+    return true;
+}
+
+bool file_transfer::session::AddChunkData(span<const uint8_t> data) {
+    auto hash = sha256::Hash(data);
+    auto node = m_wanted_chunks.extract(hash);
+    if(node.empty()) {
+        LOG(ERR, "Received chunk {} that was not asked for.", sha256::ToHex(hash));
+        return false;
+    }
+    // a chunk that cannot be stored is only fetched again next time
+    if(m_store)
+        m_store->Write(hash, data);
+    m_received_bytes += data.size();
+    for(const auto& use : node.mapped()) {
+        if(use.Length != data.size()) {
+            LOG(ERR, "Chunk {} has {} bytes, the recipe has {}.", sha256::ToHex(hash), data.size(), use.Length);
+            return false;
+        }
+        if(!Place(use.FileId, use.Offset, data))
+            return false;
+    }
+    return true;
+}
+
+bool file_transfer::session::Write(uint32_t file_id, uint64_t offset, span<const uint8_t> data, bool verified) {
+    m_received_bytes += data.size();
+    return Place(file_id, offset, data, verified);
+}
+
+bool file_transfer::session::Place(uint32_t file_id, uint64_t offset, span<const uint8_t> data, bool verified) {
+    auto it = m_files.find(file_id);
+    if(it == m_files.end()) {
+        LOG(ERR, "Data received for unknown file id {}.", file_id);
+        return false;
+    }
+    auto& file = it->second;
+    if(offset > file.Meta.Size || data.size() > file.Meta.Size - offset) {
+        LOG(ERR, "Data received past the end of '{}'.", file.Meta.Path);
+        return false;
+    }
+    if(!file.File.IsOpen() && !Open(file))
+        return false;
+    if(!file.File.WriteAt(offset, data)) {
+        LOG(ERR, "Cannot write to '{}'.", file.Temporary.string());
+        return false;
+    }
+    if(!verified)
+        return true;
+    file.Written.Add(offset, data.size());
+    if(file.CompleteWhenWritten && file.Written.Covered() == file.Meta.Size) {
+        bool committed = Commit(file);
+        m_files.erase(it);
+        return committed;
+    }
+    return true;
+}
+
+bool file_transfer::session::Confirm(uint32_t file_id, uint64_t offset, uint64_t length) {
+    auto it = m_files.find(file_id);
+    if(it == m_files.end())
+        return false;
+    auto& file = it->second;
+    file.Written.Add(offset, length);
+    if(file.CompleteWhenWritten && file.Written.Covered() == file.Meta.Size) {
+        bool committed = Commit(file);
+        m_files.erase(it);
+        return committed;
+    }
+    return true;
+}
+
+bool file_transfer::session::Damage(uint32_t file_id, uint64_t offset, uint64_t length) {
+    auto it = m_files.find(file_id);
+    if(it == m_files.end())
+        return false;
+    auto& file = it->second;
+    if(file.CompleteWhenWritten) {
+        LOG(ERR, "Data of '{}' at offset {} arrived damaged.", file.Meta.Path, offset);
+        return false;
+    }
+    LOG(WARNING, "Data of '{}' at offset {} arrived damaged, asking for it again.", file.Meta.Path, offset);
+    file.Damaged.emplace_back(offset, length);
+    return true;
+}
+
+bool file_transfer::session::Matches(open_file &file, string_view hash) {
+    if(hash.size() != sha256::digest().size())
+        return false;
+    auto& pool = buffer_pool::Global();
+    uint8_t* buffer = pool.Borrow(DataChunkSize);
+    sha256::hasher hasher;
+    bool valid = true;
+    for(uint64_t offset = 0; valid && offset < file.Meta.Size;) {
+        auto length = size_t(min<uint64_t>(DataChunkSize, file.Meta.Size - offset));
+        valid = file.File.ReadAt(offset, { buffer, length }) == int64_t(length);
+        hasher.Update({ buffer, length });
+        offset += length;
+    }
+    pool.Return(buffer, DataChunkSize);
+    auto digest = hasher.Final();
+    return valid && memcmp(digest.data(), hash.data(), digest.size()) == 0;
+}
+
+file_transfer::CloseStatus file_transfer::session::EndFile(uint32_t file_id, string_view hash,
+                                                          vector<pair<uint64_t, uint64_t>> &damaged) {
+    auto it = m_files.find(file_id);
+    if(it == m_files.end()) {
+        LOG(ERR, "Close received for unknown file id {}.", file_id);
+        return CloseStatus::Failed;
+    }
+    auto& file = it->second;
+    // without a hash the sender does not wait for an answer, damaged data cannot be asked for
+    if(!hash.empty() && !file.Damaged.empty()) {
+        damaged = std::exchange(file.Damaged, {});
+        return CloseStatus::Retransmit;
+    }
+    if(file.Written.Covered() < file.Meta.Size || !file.Damaged.empty()) {
+        LOG(ERR, "'{}' closed after {} of {} bytes, discarding it.", file.Meta.Path, file.Written.Covered(), file.Meta.Size);
+        file.File.Close();
+        error_code ec;
+        fs::remove(file.Temporary, ec);
+        m_files.erase(it);
+        return CloseStatus::Failed;
+    }
+    if(!hash.empty() && !Matches(file, hash)) {
+        LOG(WARNING, "'{}' does not match its SHA-256, asking for all of it again.", file.Meta.Path);
+        file.Written.Clear();
+        damaged.assign(1, { 0, file.Meta.Size });
+        return CloseStatus::Retransmit;
+    }
+    auto node = m_files.extract(it);
+    return Commit(node.mapped()) ? CloseStatus::Committed : CloseStatus::Failed;
+}
+
+shared_ptr<file_transfer::session> file_transfer::session_registry::Find(uint64_t id) {
+    // forget the sessions whose streams are all gone
+    erase_if(m_sessions, [](const auto& item) { return item.second.expired(); });
+    auto& entry = m_sessions[id];
+    auto existing = entry.lock();
+    if(existing)
+        return existing;
+    auto created = make_shared<session>(m_root, &m_store);
+    entry = created;
+    return created;
+}
+
+shared_ptr<file_transfer::session> file_transfer::session_registry::Create() {
+    return make_shared<session>(m_root, &m_store);
+}
+
+void file_transfer::stream_receiver::SendReplies(sw::Socket &socket) {
+    while(m_replies_sent < m_replies.size()) {
+        int32_t sent = socket.Send(m_replies.data() + m_replies_sent, int32_t(min<size_t>(m_replies.size() - m_replies_sent, INT32_MAX)));
+        if(sent <= 0)
+            break; // socket buffer is full, retry on the next call
+        m_replies_sent += size_t(sent);
+    }
+    if(m_replies_sent == m_replies.size()) {
+        m_replies.clear();
+        m_replies_sent = 0;
+    }
+}
+
+bool file_transfer::stream_receiver::Receive(sw::Socket &socket) {
+    SendReplies(socket);
+    auto& pool = buffer_pool::Global();
+    // borrowed for this read only, the payload is written out and partial headers are copied to m_pending
+    uint8_t* buffer = pool.Borrow(ReceiveBufferSize);
+    bool valid = true;
+    // drain a few reads per call so one busy stream does not starve the others
+    for(int reads = 0; reads < 8 && valid; reads++) {
+        int32_t received = socket.Recv(buffer, int32_t(ReceiveBufferSize), false);
+        if(received <= 0)
+            break;
+        valid = Consume({ buffer, size_t(received) });
+    }
+    pool.Return(buffer, ReceiveBufferSize);
+    // the peer may be waiting for a reply to what was just received
+    if(valid)
+        SendReplies(socket);
+    return valid;
+}
+
+bool file_transfer::stream_receiver::Consume(span<const uint8_t> data) {
+    while(!data.empty()) {
+        if(m_state == state::payload && m_collect_payload) {
+            size_t length = size_t(min<uint64_t>(m_payload_remaining, data.size()));
+            m_pending.insert(m_pending.end(), data.begin(), data.begin() + ptrdiff_t(length));
+            m_payload_remaining -= length;
+            data = data.subspan(length);
+            if(m_payload_remaining > 0)
+                break;
+            if(!OnPayload())
+                return false;
+            m_pending.clear();
+            m_state = state::header;
+            continue;
+        }
+        if(m_state == state::payload) {
+            size_t length = size_t(min<uint64_t>(m_payload_remaining, data.size()));
+            auto piece = data.first(length);
+            if(!Target().Write(m_header.FileId, m_payload_offset, piece, !m_check_payload))
+                return Fail("write failed");
+            if(m_check_payload)
+                m_payload_crc = crc32c::Update(m_payload_crc, piece);
+            m_payload_offset += length;
+            m_payload_remaining -= length;
+            data = data.subspan(length);
+            if(m_payload_remaining == 0) {
+                if(m_check_payload && !OnFileDataEnd())
+                    return false;
+                m_state = state::header;
+            }
+            continue;
+        }
+
+        size_t wanted = m_state == state::header ? FrameHeaderSize : m_header.MetaLength;
+        size_t length = min(wanted - m_pending.size(), data.size());
+        m_pending.insert(m_pending.end(), data.begin(), data.begin() + ptrdiff_t(length));
+        data = data.subspan(length);
+        if(m_pending.size() < wanted)
+            break;
+
+        if(m_state == state::header) {
+            if(!frame_header::Decode(m_pending.data(), m_header))
+                return Fail("bad frame magic");
+            if(m_header.MetaLength > MaxMetaLength)
+                return Fail("metadata too large");
+            m_pending.clear();
+            m_state = state::meta;
+            if(m_header.MetaLength > 0)
+                continue;
+        }
+        if(!OnMeta())
+            return false;
+        m_pending.clear();
+    }
+    return true;
+}
+
+bool file_transfer::stream_receiver::OnMeta() {
+    span<const uint8_t> meta = m_pending;
+    bool valid;
+    // only file data and chunks carry a payload
+    m_collect_payload = m_header.OpCode == TransferOpCode::ChunkRecipe || m_header.OpCode == TransferOpCode::ChunkData;
+    if(m_header.OpCode != TransferOpCode::FileData && !m_collect_payload && m_header.PayloadLength != 0)
+        return Fail("unexpected payload");
+    switch(m_header.OpCode) {
+        case TransferOpCode::CreateDirectory: {
+            create_directory_meta directory;
+            valid = DecodeMeta(meta, directory) && Target().AddDirectory(directory);
+            break;
+        }
+        case TransferOpCode::CreateFile: {
+            create_file_meta file;
+            valid = DecodeMeta(meta, file) && Target().BeginFile(m_header.FileId, file);
+            break;
+        }
+        case TransferOpCode::BeginSession:
+        case TransferOpCode::JoinSession: {
+            session_meta joined;
+            valid = DecodeMeta(meta, joined);
+            if(valid)
+                m_session = m_registry->Find(joined.SessionId);
+            m_up_to_date.clear();
+            m_manifest_files = 0;
+            break;
+        }
+        case TransferOpCode::Manifest:
+            valid = OnManifest(meta);
+            break;
+        case TransferOpCode::EndManifest: {
+            frame_header reply { TransferOpCode::ManifestAck, 0, 0, 0, m_up_to_date.size() };
+            size_t start = m_replies.size();
+            m_replies.resize(start + FrameHeaderSize);
+            reply.Encode(m_replies.data() + start);
+            m_replies.insert(m_replies.end(), m_up_to_date.begin(), m_up_to_date.end());
+            LOG(INFO, "File transfer manifest of {} files received.", m_manifest_files);
+            m_up_to_date.clear();
+            m_manifest_files = 0;
+            valid = true;
+            break;
+        }
+        case TransferOpCode::FileData: {
+            file_data_meta chunk;
+            valid = DecodeMeta(meta, chunk);
+            m_payload_offset = m_payload_start = chunk.Offset;
+            m_payload_remaining = m_header.PayloadLength;
+            m_check_payload = (m_header.Flags & ChecksumFlag) != 0;
+            m_payload_checksum = chunk.Checksum;
+            m_payload_crc = 0;
+            m_payload_length = chunk.Length;
+            if(valid && (m_header.Flags & CompressedFlag)) {
+                if(m_payload_remaining == 0 || m_payload_remaining > MaxCollectedPayload || chunk.Length == 0 ||
+                   chunk.Length > MaxCollectedPayload)
+                    return Fail("bad compressed chunk");
+                // collected into m_pending once the metadata is dropped
+                m_collect_payload = true;
+            }
+            if(valid && m_payload_remaining > 0) {
+                m_state = state::payload;
+                return true;
+            }
+            break;
+        }
+        case TransferOpCode::DeltaFile:
+            valid = OnDeltaFile(meta);
+            break;
+        case TransferOpCode::CopyBlocks: {
+            copy_blocks_meta copy;
+            valid = DecodeMeta(meta, copy) && Target().CopyBlocks(m_header.FileId, copy);
+            break;
+        }
+        case TransferOpCode::ChunkRecipe:
+        case TransferOpCode::ChunkData:
+            if(m_header.PayloadLength > MaxCollectedPayload)
+                return Fail("payload too large");
+            // collected into m_pending once the metadata is dropped
+            m_payload_remaining = m_header.PayloadLength;
+            m_state = state::payload;
+            if(m_payload_remaining > 0)
+                return true;
+            m_pending.clear();
+            valid = OnPayload();
+            break;
+        case TransferOpCode::EndRecipes: {
+            frame_header reply { TransferOpCode::ChunkWant, 0, 0, 0, m_wanted.size() };
+            size_t start = m_replies.size();
+            m_replies.resize(start + FrameHeaderSize);
+            reply.Encode(m_replies.data() + start);
+            m_replies.insert(m_replies.end(), m_wanted.begin(), m_wanted.end());
+            size_t wanted = 0;
+            for(auto bits : m_wanted)
+                wanted += size_t(popcount(bits));
+            LOG(INFO, "File transfer recipes of {} chunks received, {} of them are missing.", m_recipe_chunks, wanted);
+            m_wanted.clear();
+            m_recipe_chunks = 0;
+            valid = true;
+            break;
+        }
+        case TransferOpCode::CloseFile:
+            valid = OnCloseFile(meta);
+            break;
+        default:
+            return Fail("unknown opcode");
+    }
+    m_state = state::header;
+    return valid || Fail("frame rejected");
+}
+
+bool file_transfer::stream_receiver::OnManifest(span<const uint8_t> meta) {
+    if(!m_session)
+        return Fail("manifest outside of a session");
+    while(!meta.empty()) {
+        manifest_entry entry;
+        if(!ReadMeta(meta, entry))
+            return Fail("malformed manifest");
+        if(entry.FileId == 0) {
+            if(!m_session->AddDirectory({ entry.Path }))
+                return false;
+            continue;
+        }
+        bool up_to_date;
+        if(!m_session->AddFile(entry, up_to_date))
+            return false;
+        size_t index = m_manifest_files++;
+        if(m_up_to_date.size() <= index / 8)
+            m_up_to_date.push_back(0);
+        if(up_to_date)
+            m_up_to_date[index / 8] |= uint8_t(1 << (index % 8));
+    }
+    return true;
+}
+
+bool file_transfer::stream_receiver::OnPayload() {
+    span<const uint8_t> payload = m_pending;
+    if(m_header.OpCode == TransferOpCode::FileData)
+        return OnCompressedData();
+    if(m_header.OpCode == TransferOpCode::ChunkData)
+        return Target().AddChunkData(payload) || Fail("chunk rejected");
+
+    if(!m_session || payload.size() % RecipeEntrySize != 0)
+        return Fail("malformed recipe");
+    for(; !payload.empty(); payload = payload.subspan(RecipeEntrySize)) {
+        sha256::digest hash;
+        memcpy(hash.data(), payload.data(), hash.size());
+        auto length = uint32_t(get_le(payload.data() + hash.size(), 4));
+        bool wanted;
+        if(!m_session->AddChunk(m_header.FileId, hash, length, wanted))
+            return Fail("recipe rejected");
+        size_t index = m_recipe_chunks++;
+        if(m_wanted.size() <= index / 8)
+            m_wanted.push_back(0);
+        if(wanted)
+            m_wanted[index / 8] |= uint8_t(1 << (index % 8));
+    }
+    return true;
+}
+
+bool file_transfer::stream_receiver::OnFileDataEnd() {
+    if(m_payload_crc == m_payload_checksum)
+        return Target().Confirm(m_header.FileId, m_payload_start, m_header.PayloadLength) || Fail("commit failed");
+    return Target().Damage(m_header.FileId, m_payload_start, m_header.PayloadLength) || Fail("damaged data");
+}
+
+bool file_transfer::stream_receiver::OnCompressedData() {
+    m_decompressed.resize(m_payload_length);
+    // a block that does not decompress is damaged like one that fails its checksum
+    bool intact = lz4_block::Decompress(m_pending, m_decompressed) &&
+                  (!m_check_payload || crc32c::Compute(m_decompressed) == m_payload_checksum);
+    if(intact)
+        return Target().Write(m_header.FileId, m_payload_start, m_decompressed) || Fail("write failed");
+    if(!m_check_payload)
+        return Fail("malformed compressed chunk");
+    return Target().Damage(m_header.FileId, m_payload_start, m_payload_length) || Fail("damaged data");
+}
+
+bool file_transfer::stream_receiver::OnCloseFile(span<const uint8_t> meta) {
+    close_file_meta close;
+    if(!DecodeMeta(meta, close))
+        return false;
+    vector<pair<uint64_t, uint64_t>> damaged;
+    auto status = Target().EndFile(m_header.FileId, close.Hash, damaged);
+    if(close.Hash.empty())
+        return status == CloseStatus::Committed;
+    // the sender waits for the outcome, a failed file is reported rather than dropping the connection
+    AppendFrame(m_replies, TransferOpCode::FileStatus, m_header.FileId, file_status_meta { status },
+                damaged.size() * DamagedRangeSize);
+    for(const auto& [offset, length] : damaged)
+        AppendRange(m_replies, offset, length);
+    return true;
+}
+
+bool file_transfer::stream_receiver::OnDeltaFile(span<const uint8_t> meta) {
+    create_file_meta file;
+    file_delta::signature base;
+    if(!DecodeMeta(meta, file) || !Target().BeginDelta(m_header.FileId, file, base))
+        return false;
+    // the signature is computed here, on the receiving loop, a large local copy holds up the other streams meanwhile
+    AppendFrame(m_replies, TransferOpCode::Signature, m_header.FileId, signature_meta { base.BlockSize, base.FileSize },
+                base.Blocks.size() * file_delta::BlockSignatureSize);
+    base.Encode(m_replies);
+    return true;
+}
+
+file_transfer::session &file_transfer::stream_receiver::Target() {
+    if(!m_session)
+        m_session = m_registry->Create();
+    return *m_session;
+}
+
+span<const uint8_t> file_transfer::stream_receiver::Replies() const {
+    return span<const uint8_t>(m_replies).subspan(m_replies_sent);
+}
+
+bool file_transfer::stream_receiver::Fail(const char *error) {
+    LOG(ERR, "File transfer stream closed: {} (opcode {}, file id {}).", error, uint16_t(m_header.OpCode), m_header.FileId);
+    return false;
+}
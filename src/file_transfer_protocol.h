@@ -0,0 +1,461 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_FILE_TRANSFER_PROTOCOL_H
+#define WEBCLIENT_FILE_TRANSFER_PROTOCOL_H
+#include "web_message.h"
+#include "file_delta.h"
+#include "chunk_store.h"
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace sw {
+    class Socket;
+}
+
+/*
+ * Wire format of the file transfer host. Every frame starts with a fixed 24 byte little endian header:
+ *
+ *     uint32 magic "WCFT" | uint16 opcode | uint16 flags | uint32 meta length | uint32 file id | uint64 payload length
+ *
+ * followed by the metadata of the opcode (encoded like web_message fields: varints and length-prefixed strings, so
+ * fields can be appended later) and then by the payload, which is raw file data. A file is announced once with
+ * CreateFile (path, size, mode, modification time) under a file id chosen by the sender, then sent as FileData
+ * frames carrying their offset, and committed with CloseFile, so the receiver always knows where a file ends.
+ *
+ * A directory is sent as a session over several connections: the control stream opens it with BeginSession and
+ * lists every directory and file in Manifest frames, the receiver answers EndManifest with ManifestAck (a bitmap of
+ * the files it already has with the same size and modification time), then every stream, control stream included,
+ * sends JoinSession (implied on the control stream) and FileData for whole small files or ranges of large files.
+ * Session files are completed as soon as all of their bytes arrived, whichever streams carried them.
+ *
+ * A file the receiver may already have an older copy of is announced with DeltaFile instead of CreateFile. The
+ * receiver answers with the Signature of its copy (see file_delta.h), and the file follows as FileData for the
+ * literal parts and CopyBlocks for the runs of blocks to take from the old copy, then CloseFile as usual.
+ *
+ * A deduplicated session sends recipes instead of file data after ManifestAck: ChunkRecipe frames list the SHA-256
+ * and length of every content-defined chunk of a file (see content_chunker.h), EndRecipes closes the list. The
+ * receiver fills in the chunks its chunk store already has and answers ChunkWant, a bitmap of the recipe entries it
+ * is missing. Each of those arrives once, on any stream, as ChunkData and is written wherever the recipes use it.
+ *
+ * FileData frames with ChecksumFlag carry the CRC-32C of their payload, a chunk that does not match is not counted
+ * as written. CloseFile may carry the SHA-256 of the whole file, the receiver then checks the file it wrote and
+ * answers FileStatus: committed, or the ranges to send again (damaged chunks, or the whole file if the hash does not
+ * match), after which the sender closes the file again. Files of a session have nobody to ask, a damaged chunk
+ * drops the stream and leaves the file to the next run.
+ *
+ * With CompressedFlag a FileData payload is an LZ4 block (see lz4_block.h) of the chunk's "length" bytes, collected
+ * and decompressed by the receiver before it is written. The sender compresses each chunk on its own and sends the
+ * ones that do not shrink as they are, so already compressed files cost little more than the attempt.
+ */
+namespace file_transfer {
+    constexpr uint16_t DefaultPort = 5050;
+    constexpr uint32_t Magic = 0x54464357; // "WCFT"
+    constexpr size_t FrameHeaderSize = 24;
+    // Room reserved in front of a data chunk for its header and metadata, so header and data go out in one Send.
+    constexpr size_t FrameHeadroom = 64;
+    constexpr uint32_t MaxMetaLength = 64 * 1024;
+    // Payload of a FileData frame, large so a 10 GbE link is not limited by per-frame overhead.
+    constexpr size_t DataChunkSize = 1024 * 1024;
+    constexpr size_t ReceiveBufferSize = 4 * 1024 * 1024;
+    // Files of a session larger than this are split into ranges of this size, spread over the streams.
+    constexpr uint64_t RangeSize = 8 * 1024 * 1024;
+    // Small files are packed into sends of about this size instead of one send per file.
+    constexpr size_t BatchSize = 1024 * 1024;
+    constexpr int DefaultStreams = 4;
+    constexpr int MaxStreams = 32;
+    // SHA-256 and little endian uint32 length of a chunk in a ChunkRecipe payload.
+    constexpr size_t RecipeEntrySize = 36;
+    // Recipes and chunks are assembled in memory before they are processed.
+    constexpr uint64_t MaxCollectedPayload = 4 * 1024 * 1024;
+    // FileData: the metadata carries the CRC-32C of the payload.
+    constexpr uint16_t ChecksumFlag = 1;
+    // FileData: the payload is LZ4 compressed, the CRC-32C is of the data it decompresses to.
+    constexpr uint16_t CompressedFlag = 2;
+    // Chunks smaller than this are not worth compressing.
+    constexpr size_t MinCompressLength = 512;
+    // Little endian uint64 offset and length of a range in a FileStatus payload.
+    constexpr size_t DamagedRangeSize = 16;
+    // Times a sender resends damaged parts of a file before giving up on it.
+    constexpr int MaxRetransmits = 3;
+
+    enum class TransferOpCode : uint16_t {
+        Error,
+        CreateDirectory,
+        CreateFile,
+        FileData,
+        CloseFile,
+        BeginSession,
+        JoinSession,
+        Manifest,
+        EndManifest,
+        ManifestAck,    // receiver to sender, payload: bit i set if the i-th manifest file is up to date
+        DeltaFile,
+        Signature,      // receiver to sender, payload: the block signatures of its copy of the file
+        CopyBlocks,
+        ChunkRecipe,
+        EndRecipes,
+        ChunkWant,      // receiver to sender, payload: bit i set if the i-th recipe entry must be sent
+        ChunkData,
+        FileStatus      // receiver to sender, answers a CloseFile with a hash, payload: the ranges to resend
+    };
+
+    enum class CloseStatus : uint32_t {
+        Committed,
+        Retransmit,
+        Failed
+    };
+
+    struct frame_header {
+        TransferOpCode OpCode = TransferOpCode::Error;
+        uint16_t Flags = 0;
+        uint32_t MetaLength = 0;
+        uint32_t FileId = 0;
+        uint64_t PayloadLength = 0;
+
+        void Encode(uint8_t* out) const;
+        // false if the magic does not match
+        static bool Decode(const uint8_t* in, frame_header& header);
+    };
+
+    struct create_directory_meta {
+        std::string Path;
+        static constexpr auto Fields = std::make_tuple(web_message::field("path", &create_directory_meta::Path));
+    };
+    struct create_file_meta {
+        std::string Path;
+        uint64_t Size = 0;
+        uint32_t Mode = 0644;
+        int64_t ModifiedTime = 0; // seconds since the epoch, 0 leaves the receiver's time
+        static constexpr auto Fields = std::make_tuple(web_message::field("path", &create_file_meta::Path),
+                                                       web_message::field("size", &create_file_meta::Size),
+                                                       web_message::field("mode", &create_file_meta::Mode),
+                                                       web_message::field("mtime", &create_file_meta::ModifiedTime));
+    };
+    struct file_data_meta {
+        uint64_t Offset = 0;
+        uint32_t Checksum = 0; // with ChecksumFlag
+        uint32_t Length = 0;   // decompressed, with CompressedFlag
+        static constexpr auto Fields = std::make_tuple(web_message::field("offset", &file_data_meta::Offset),
+                                                       web_message::field("crc", &file_data_meta::Checksum),
+                                                       web_message::field("length", &file_data_meta::Length));
+    };
+    struct close_file_meta {
+        std::string Hash; // SHA-256 of the file, empty to skip the check
+        static constexpr auto Fields = std::make_tuple(web_message::field("sha256", &close_file_meta::Hash));
+    };
+    struct file_status_meta {
+        CloseStatus Status = CloseStatus::Committed;
+        static constexpr auto Fields = std::make_tuple(web_message::field("status", &file_status_meta::Status));
+    };
+    struct empty_meta {
+        static constexpr auto Fields = std::make_tuple();
+    };
+    struct signature_meta {
+        uint32_t BlockSize = 0;
+        uint64_t FileSize = 0;
+        static constexpr auto Fields = std::make_tuple(web_message::field("block_size", &signature_meta::BlockSize),
+                                                       web_message::field("size", &signature_meta::FileSize));
+    };
+    // Blocks first_block to first_block + count - 1 of the receiver's copy, written at offset of the new file.
+    struct copy_blocks_meta {
+        uint64_t Offset = 0;
+        uint32_t FirstBlock = 0;
+        uint32_t Count = 0;
+        static constexpr auto Fields = std::make_tuple(web_message::field("offset", &copy_blocks_meta::Offset),
+                                                       web_message::field("first", &copy_blocks_meta::FirstBlock),
+                                                       web_message::field("count", &copy_blocks_meta::Count));
+    };
+    struct session_meta {
+        uint64_t SessionId = 0;
+        static constexpr auto Fields = std::make_tuple(web_message::field("session", &session_meta::SessionId));
+    };
+    // Manifest frames carry as many entries as fit in their metadata, back to back. Directories have no file id.
+    struct manifest_entry {
+        uint32_t FileId = 0;
+        std::string Path;
+        uint64_t Size = 0;
+        uint32_t Mode = 0644;
+        int64_t ModifiedTime = 0;
+        static constexpr auto Fields = std::make_tuple(web_message::field("id", &manifest_entry::FileId),
+                                                       web_message::field("path", &manifest_entry::Path),
+                                                       web_message::field("size", &manifest_entry::Size),
+                                                       web_message::field("mode", &manifest_entry::Mode),
+                                                       web_message::field("mtime", &manifest_entry::ModifiedTime));
+    };
+
+    template<class Meta>
+    void WriteMeta(std::vector<uint8_t>& out, const Meta& meta) {
+        std::apply([&](const auto&... fields) { (web_message::WriteField(out, meta.*(fields.Member)), ...); }, Meta::Fields);
+    }
+
+    // Reads every field (no defaults), for metadata that is followed by more entries.
+    template<class Meta>
+    bool ReadMeta(std::span<const uint8_t>& in, Meta& meta) {
+        bool valid = true;
+        std::apply([&](const auto&... fields) {
+            ((valid = valid && web_message::ReadField(in, meta.*(fields.Member))), ...);
+        }, Meta::Fields);
+        return valid;
+    }
+
+    // Appends the header and metadata of a frame, the payload_length bytes of payload are sent after them.
+    template<class Meta>
+    void AppendFrame(std::vector<uint8_t>& out, TransferOpCode opcode, uint32_t file_id, const Meta& meta,
+                     uint64_t payload_length = 0, uint16_t flags = 0) {
+        size_t start = out.size();
+        out.resize(start + FrameHeaderSize);
+        WriteMeta(out, meta);
+        frame_header header { opcode, flags, uint32_t(out.size() - start - FrameHeaderSize), file_id, payload_length };
+        header.Encode(out.data() + start);
+    }
+
+    // Missing trailing fields keep their defaults, like web_message::Decode.
+    template<class Meta>
+    bool DecodeMeta(std::span<const uint8_t> in, Meta& meta) {
+        bool valid = true;
+        std::apply([&](const auto&... fields) {
+            ((valid = valid && (in.empty() || web_message::ReadField(in, meta.*(fields.Member)))), ...);
+        }, Meta::Fields);
+        return valid;
+    }
+
+    // Appends a FileData frame with its checksum and data, compressed when asked to and when it saves at least an
+    // eighth of the data.
+    void AppendDataFrame(std::vector<uint8_t>& out, uint32_t file_id, uint64_t offset, std::span<const uint8_t> data,
+                         bool compress);
+
+    // FileStatus payload.
+    void AppendRange(std::vector<uint8_t>& out, uint64_t offset, uint64_t length);
+    bool DecodeRanges(std::span<const uint8_t> in, std::vector<std::pair<uint64_t, uint64_t>>& ranges);
+
+    // Sends all of data on a blocking socket, false once the connection failed.
+    bool SendAll(sw::Socket& socket, const uint8_t* data, size_t size);
+    // Reads a whole frame from a blocking socket, for the replies a sender waits for.
+    bool ReceiveFrame(sw::Socket& socket, frame_header& header, std::vector<uint8_t>& meta, std::vector<uint8_t>& payload);
+
+    // Converts a path received from the peer to a relative path, rejecting absolute paths and "..".
+    bool SafeRelativePath(std::string_view path, std::filesystem::path& out);
+
+    // Byte ranges of a file received so far, merged as they arrive so resent and overlapping data counts once.
+    class range_set {
+    public:
+        void Add(uint64_t offset, uint64_t length);
+        void Clear();
+        // Bytes covered by the union of the ranges.
+        [[nodiscard]] uint64_t Covered() const { return m_covered; }
+
+    private:
+        std::map<uint64_t, uint64_t> m_ranges; // start -> end
+        uint64_t m_covered = 0;
+    };
+
+    /*
+     * File opened for positional reads or writes (pread/pwrite), so several streams can work on different ranges of
+     * the same file without sharing a file position.
+     */
+    class file_handle {
+    public:
+        file_handle() = default;
+        file_handle(const file_handle&) = delete;
+        file_handle& operator=(const file_handle&) = delete;
+        file_handle(file_handle&& other) noexcept;
+        file_handle& operator=(file_handle&& other) noexcept;
+        ~file_handle();
+
+        // Opened for reading with a sequential read-ahead hint.
+        bool OpenRead(const std::filesystem::path& path);
+        // Created (or truncated) for writing, and reading back.
+        bool OpenWrite(const std::filesystem::path& path, uint32_t mode);
+        // Reserves the blocks of a file of this size up front (fallocate), so writes do not fragment or fail
+        // halfway on a full disk.
+        bool Preallocate(uint64_t size);
+        bool WriteAt(uint64_t offset, std::span<const uint8_t> data);
+        // Returns the number of bytes read, less than requested at the end of file, -1 on error.
+        int64_t ReadAt(uint64_t offset, std::span<uint8_t> out);
+        bool Resize(uint64_t size);
+        void Close();
+        [[nodiscard]] bool IsOpen() const;
+
+    private:
+#ifdef _WIN32
+        FILE* m_file = nullptr;
+#else
+        int m_fd = -1;
+#endif
+    };
+
+    /*
+     * Receiving side of one sender: the files it has announced and not yet closed. Files are written to
+     * "<path>.part" next to their destination and renamed over it when closed, so an interrupted transfer never
+     * leaves a half written file under the final name.
+     */
+    class session {
+    public:
+        session(std::filesystem::path root, const chunk_store* store) : m_root(std::move(root)), m_store(store) {}
+        ~session();
+
+        bool AddDirectory(const create_directory_meta& meta);
+        // Opens the file right away, it is committed by EndFile.
+        bool BeginFile(uint32_t file_id, const create_file_meta& meta);
+        // A manifest file: opened on its first write and committed once all of its bytes were written, so only the
+        // files the streams are working on hold a descriptor. Sets up_to_date instead when the destination already
+        // has the same size and modification time.
+        bool AddFile(const manifest_entry& entry, bool& up_to_date);
+        // Like BeginFile, and computes the signature of the existing destination (empty if there is none), which
+        // stays open as the source of CopyBlocks until the file is committed.
+        bool BeginDelta(uint32_t file_id, const create_file_meta& meta, file_delta::signature& base);
+        bool CopyBlocks(uint32_t file_id, const copy_blocks_meta& meta);
+        // Next chunk of a manifest file's recipe, written right away when the chunk store has it. Sets wanted when
+        // the chunk must be sent, only its first use in the session is wanted.
+        bool AddChunk(uint32_t file_id, const sha256::digest& hash, uint32_t length, bool& wanted);
+        // A wanted chunk, identified by its hash.
+        bool AddChunkData(std::span<const uint8_t> data);
+        // Data that is not verified yet is written but only counted once Confirm is called for it.
+        bool Write(uint32_t file_id, uint64_t offset, std::span<const uint8_t> data, bool verified = true);
+        bool Confirm(uint32_t file_id, uint64_t offset, uint64_t length);
+        // Data that failed its checksum, to be sent again.
+        bool Damage(uint32_t file_id, uint64_t offset, uint64_t length);
+        // Commits the file after checking it against hash (when not empty). Returns Retransmit with the ranges to
+        // send again instead when chunks were damaged or the hash does not match.
+        CloseStatus EndFile(uint32_t file_id, std::string_view hash, std::vector<std::pair<uint64_t, uint64_t>>& damaged);
+
+        [[nodiscard]] uint64_t ReceivedBytes() const { return m_received_bytes; }
+        [[nodiscard]] size_t CompletedFiles() const { return m_completed_files; }
+        [[nodiscard]] uint64_t ReusedBytes() const { return m_reused_bytes; }
+
+    private:
+        struct open_file {
+            file_handle File;
+            create_file_meta Meta;
+            std::filesystem::path Temporary;
+            std::filesystem::path Destination;
+            // complete once the ranges cover the whole file, holes and duplicates do not pass for it
+            range_set Written;
+            bool CompleteWhenWritten = false;
+            // old copy of a delta transfer
+            file_handle Base;
+            uint64_t BaseSize = 0;
+            uint32_t BlockSize = 0;
+            uint64_t RecipeLength = 0; // bytes of the file covered by its recipe so far
+            std::vector<std::pair<uint64_t, uint64_t>> Damaged;
+        };
+        struct chunk_use {
+            uint32_t FileId;
+            uint64_t Offset;
+            uint32_t Length;
+        };
+        struct digest_hash {
+            size_t operator()(const sha256::digest& value) const {
+                size_t hash;
+                std::memcpy(&hash, value.data(), sizeof(hash));
+                return hash;
+            }
+        };
+        bool Prepare(uint32_t file_id, const create_file_meta& meta, open_file& file);
+        bool Open(open_file& file);
+        bool Commit(open_file& file);
+        // Writes data of a file, and commits it once complete.
+        bool Place(uint32_t file_id, uint64_t offset, std::span<const uint8_t> data, bool verified = true);
+        bool Matches(open_file& file, std::string_view hash);
+
+    private:
+        std::filesystem::path m_root;
+        const chunk_store* m_store;
+        std::unordered_map<uint32_t, open_file> m_files;
+        // chunks asked from the sender, and where they go
+        std::unordered_map<sha256::digest, std::vector<chunk_use>, digest_hash> m_wanted_chunks;
+        std::vector<uint8_t> m_chunk;
+        uint64_t m_received_bytes = 0;
+        uint64_t m_reused_bytes = 0;
+        size_t m_completed_files = 0;
+    };
+
+    // Sessions of a receiving host by id, so the streams of a parallel transfer write into the same file table.
+    class session_registry {
+    public:
+        explicit session_registry(std::filesystem::path root) : m_root(std::move(root)), m_store(m_root / ".chunks") {}
+
+        // Session of a parallel transfer, created by whichever of its streams arrives first.
+        std::shared_ptr<session> Find(uint64_t id);
+        // Session of a single stream.
+        std::shared_ptr<session> Create();
+
+    private:
+        std::filesystem::path m_root;
+        chunk_store m_store;
+        std::unordered_map<uint64_t, std::weak_ptr<session>> m_sessions;
+    };
+
+    /*
+     * Non-blocking receiver of one connection. Frames are parsed incrementally as bytes arrive, file data is written
+     * from the receive buffer straight to its file without being assembled into whole frames first.
+     */
+    class stream_receiver {
+    public:
+        explicit stream_receiver(session_registry& registry) : m_registry(&registry) {}
+
+        // Sends pending replies, then receives whatever the socket has and processes it. False when the connection
+        // must be dropped: a malformed frame, or data that could not be written.
+        bool Receive(sw::Socket& socket);
+        // Feeds received bytes through the frame state machine.
+        bool Consume(std::span<const uint8_t> data);
+        // Frames to send back to the peer, written by Receive as the socket accepts them.
+        [[nodiscard]] std::span<const uint8_t> Replies() const;
+
+    private:
+        enum class state {
+            header,
+            meta,
+            payload
+        };
+        bool OnMeta();
+        bool OnManifest(std::span<const uint8_t> meta);
+        bool OnDeltaFile(std::span<const uint8_t> meta);
+        // ChunkRecipe and ChunkData, once their payload was collected
+        bool OnPayload();
+        bool OnCloseFile(std::span<const uint8_t> meta);
+        // Verifies the checksum of a FileData payload once all of it was written.
+        bool OnFileDataEnd();
+        // Decompresses a collected FileData payload, then verifies and writes it.
+        bool OnCompressedData();
+        void SendReplies(sw::Socket& socket);
+        session& Target();
+        bool Fail(const char* error);
+
+    private:
+        session_registry* m_registry;
+        std::shared_ptr<session> m_session;
+        std::vector<uint8_t> m_pending; // header or metadata split across reads
+        std::vector<uint8_t> m_replies;
+        size_t m_replies_sent = 0;
+        std::vector<uint8_t> m_up_to_date; // ManifestAck bitmap of the current session
+        size_t m_manifest_files = 0;
+        std::vector<uint8_t> m_wanted; // ChunkWant bitmap
+        size_t m_recipe_chunks = 0;
+        bool m_collect_payload = false;
+        state m_state = state::header;
+        frame_header m_header;
+        uint64_t m_payload_offset = 0;    // file offset of the next payload byte
+        uint64_t m_payload_remaining = 0;
+        uint64_t m_payload_start = 0;
+        uint32_t m_payload_checksum = 0;  // expected CRC-32C, when m_check_payload
+        uint32_t m_payload_crc = 0;       // of the payload received so far
+        uint32_t m_payload_length = 0;    // decompressed, with CompressedFlag
+        bool m_check_payload = false;
+        std::vector<uint8_t> m_decompressed;
+    };
+}
+
+#endif //WEBCLIENT_FILE_TRANSFER_PROTOCOL_H
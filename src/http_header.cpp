@@ -4,6 +4,7 @@
 #include "web_server.h"
 #include "CppUtility.hpp"
 #include "http_header.h"
+#include <algorithm>
 
 using namespace std;
 
@@ -38,6 +39,16 @@ string http_request::ToString() const {
     return ss.str();
 }
 
+const string* http_request::FindField(string_view name) const {
+    for(const auto& [field, value] : fields) {
+        if(field.size() == name.size() && equal(field.begin(), field.end(), name.begin(), [](char a, char b) {
+            return tolower((unsigned char)a) == tolower((unsigned char)b);
+        }))
+            return &value;
+    }
+    return nullptr;
+}
+
 std::optional<http_request> http_request::ParseHttpRequest(const std::span<uint8_t>& szHeader ) {
     // HTTP Header ends with two CRLF (\r\n)
     // The first line is the resource line
@@ -104,6 +115,8 @@ std::optional<http_request> http_request::ParseHttpRequest(const std::span<uint8
                 auto [resource, query] = ParseHttpResource(word);
                 request.resource = RemoveDirectoryChange(resource);
                 request.query = query;
+                if(auto delim = word.find('?'); delim != string_view::npos)
+                    request.query_string = word.substr(delim + 1);
                 if(request.resource.empty())
                     request.resource = "/";
                 state = ParserState::FetchingHttpVersion;
@@ -144,7 +157,6 @@ std::optional<http_request> http_request::ParseHttpRequest(const std::span<uint8
         vector<uint8_t> content(header.size() - offset);
         memcpy(content.data(), &szHeader[offset], content.size());
         request.content = std::move(content);
-        LOG(WARNING, "{}", string(request.content->begin(), request.content->end()));
     }
 
     return { request };
@@ -161,6 +173,13 @@ http_request::ParseHttpResource(const string_view &resource) {
     string_view pure_resource = { &resource.at(0), delimIndex };
     string_view query_string = { &resource.at(delimIndex + 1), resource.size() - delimIndex - 1 };
     unordered_map<string, string> query;
+    string name_scratch, value_scratch;
+    // malformed escapes are kept as sent
+    auto decode = [](string_view text, string& scratch) -> string {
+        if(text.find_first_of("%+") == string_view::npos || !DecodeQueryComponent(text, scratch))
+            return string(text);
+        return scratch;
+    };
 
    do {
         auto queryDelimIndex = query_string.find('=');
@@ -172,7 +191,7 @@ http_request::ParseHttpResource(const string_view &resource) {
         }
         if(queryDelimIndex == string_view::npos) {
             if(!query_string.empty()) {
-                query[string(query_string)] = "";
+                query[decode(query_string, name_scratch)] = "";
             }
             break;
         }
@@ -188,13 +207,14 @@ http_request::ParseHttpResource(const string_view &resource) {
 
         if(contentDelimIndex == string_view::npos) {
             if(query_string.size() - (queryDelimIndex + 1) > 0)
-                query[string(query_name)] = query_string.substr(queryDelimIndex + 1);
+                query[decode(query_name, name_scratch)] = decode(query_string.substr(queryDelimIndex + 1), value_scratch);
             else
-                query[string(query_name)] = "";
+                query[decode(query_name, name_scratch)] = "";
             break;
         }
 
-        query[string(query_name)] = query_string.substr(queryDelimIndex + 1, contentDelimIndex - (queryDelimIndex + 1));
+        query[decode(query_name, name_scratch)] =
+                decode(query_string.substr(queryDelimIndex + 1, contentDelimIndex - (queryDelimIndex + 1)), value_scratch);
         query_string = query_string.substr(contentDelimIndex + 1);
 
     } while(true);
@@ -202,6 +222,34 @@ http_request::ParseHttpResource(const string_view &resource) {
     return { string(pure_resource), query };
 }
 
+bool http_request::DecodeQueryComponent(const string_view &text, string &out) {
+    auto hex = [](char c) -> int {
+        if(c >= '0' && c <= '9') return c - '0';
+        if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    out.clear();
+    out.reserve(text.size());
+    for(size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if(c == '+') {
+            out.push_back(' ');
+        } else if(c == '%') {
+            if(i + 2 >= text.size())
+                return false;
+            int high = hex(text[i + 1]), low = hex(text[i + 2]);
+            if(high < 0 || low < 0)
+                return false;
+            out.push_back(char(high << 4 | low));
+            i += 2;
+        } else {
+            out.push_back(c);
+        }
+    }
+    return true;
+}
+
 std::string http_request::RemoveDirectoryChange(const string &source) {
     return cpp::ReplaceAll(
             cpp::ReplaceAll(
@@ -7,11 +7,15 @@
 #include <optional>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 
 enum class http_code {
     http_200_ok = 200,
+    http_206_partial_content = 206,
+    http_304_not_modified = 304,
     http_400_bad_request = 400,
     http_404_not_found = 404,
+    http_416_range_not_satisfiable = 416,
     http_101_switch_protocol = 101,
 };
 
@@ -22,13 +26,17 @@ namespace config {
     constexpr const char* get_http_code(http_code code) {
         switch(code) {
             case http_code::http_200_ok: return "200 OK";
+            case http_code::http_206_partial_content: return "206 Partial Content";
+            case http_code::http_304_not_modified: return "304 Not Modified";
             case http_code::http_400_bad_request: return "400 Bad Request";
             case http_code::http_404_not_found: return "404 Not Found";
+            case http_code::http_416_range_not_satisfiable: return "416 Range Not Satisfiable";
             case http_code::http_101_switch_protocol: return "101 Switching Protocols";
             default: return "404 Not Found.";
         }
     }
     constexpr size_t ClientTimeoutDuration = 3600; // seconds
+    constexpr uint64_t WebSocketMaxMessageSize = 1024 * 1024 * 16; // 16 mb, can be changed per port
 }
 
 enum class http_verb {
@@ -40,13 +48,20 @@ class http_request {
 public:
     http_verb verb = http_verb::ERROR;
     std::string resource;
+    // percent-decoded
     std::unordered_map<std::string, std::string> query;
+    // everything after '?' as sent, see request_binding.h
+    std::string query_string;
     std::unordered_map<std::string, std::string> fields;
     std::optional<std::vector<uint8_t>> content;
 
     [[nodiscard]] std::string ToString() const;
+    // Header names are case insensitive and fields keeps them as the client sent them, nullptr if absent.
+    [[nodiscard]] const std::string* FindField(std::string_view name) const;
     static std::optional<http_request> ParseHttpRequest(const std::span<uint8_t>& header);
     static std::pair<std::string, std::unordered_map<std::string, std::string>> ParseHttpResource(const std::string_view& resource);
+    // Decodes %XX escapes and '+' (a space in query strings and form bodies), false on a malformed escape.
+    static bool DecodeQueryComponent(const std::string_view& text, std::string& out);
 
 private:
     static http_verb FetchHttpVerb(const std::string_view& word);
@@ -3,74 +3,915 @@
 //
 
 #include "json_parser.h"
+#include "CppUtility.hpp"
 #include <string_view>
+#include <charconv>
+#include <cstring>
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define JSON_PARSER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define JSON_PARSER_TARGET(x)
+#else
+#define JSON_PARSER_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+#ifdef _MSC_VER
+#define JSON_PARSER_MEMBER_INLINE __forceinline
+#else
+#define JSON_PARSER_MEMBER_INLINE inline __attribute__((always_inline))
+#endif
+#define JSON_PARSER_INLINE static JSON_PARSER_MEMBER_INLINE
+
 using namespace std;
+using namespace json_parser;
+
+// One bit per byte of a 64 byte block.
+struct block_masks {
+    uint64_t Quote = 0;
+    uint64_t Backslash = 0;
+    uint64_t Op = 0;         // { } [ ] : ,
+    uint64_t Whitespace = 0;
+    uint64_t Control = 0;    // bytes below 0x20
+};
+
+/*
+ * Carries the string/escape state from one block to the next and turns the character classes into structural
+ * offsets. Plain integer code, it is inlined into every kernel.
+ */
+class structural_scanner {
+public:
+    explicit structural_scanner(vector<uint32_t>& out) : m_out(out) { m_out.clear(); }
 
-static string_view read_word(const string& szBuffer, size_t& offset, const char* szStartDelimiter, const char* szEndDelimiter) {
-    auto is_valid_character = [](char c, const char* delimiter) {
-        while(*delimiter) {
-            if(*delimiter == c)
-                return true;
-            delimiter++;
+    JSON_PARSER_MEMBER_INLINE void Block(const block_masks& masks, size_t base) {
+        // A character is escaped if it follows an odd run of backslashes, the run may start in the previous block.
+        constexpr uint64_t odd_bits = 0xAAAAAAAAAAAAAAAAull;
+        uint64_t escaped;
+        if(masks.Backslash == 0) {
+            escaped = m_next_escaped;
+            m_next_escaped = 0;
+        } else {
+            uint64_t potential = masks.Backslash & ~m_next_escaped;
+            uint64_t codes = (((potential << 1) | odd_bits) - potential) ^ odd_bits;
+            escaped = codes ^ (masks.Backslash | m_next_escaped);
+            m_next_escaped = (codes & masks.Backslash) >> 63;
         }
-        return false;
-    };
-    bool found_first_letter = false;
-    size_t start = offset;
-    if(start == szBuffer.size())
-        return {};
-    for(size_t i = offset; i < szBuffer.size(); i++) {
-        if(!found_first_letter) {
-            // is this a character
-            if(is_valid_character(szBuffer[i], szStartDelimiter))  {
-                found_first_letter = true;
-                start = i;
+
+        // prefix xor of the real quotes: bits between an opening quote (included) and its closing quote (excluded)
+        uint64_t quotes = masks.Quote & ~escaped;
+        uint64_t in_string = quotes;
+        in_string ^= in_string << 1;
+        in_string ^= in_string << 2;
+        in_string ^= in_string << 4;
+        in_string ^= in_string << 8;
+        in_string ^= in_string << 16;
+        in_string ^= in_string << 32;
+        in_string ^= m_in_string;
+        m_in_string = uint64_t(int64_t(in_string) >> 63);
+        m_error |= masks.Control & in_string;
+
+        // everything else outside strings is part of a number or a literal, only its first byte is kept
+        uint64_t scalar = ~(masks.Op | masks.Whitespace | quotes | in_string);
+        uint64_t scalar_start = scalar & ~((scalar << 1) | m_previous_scalar);
+        m_previous_scalar = scalar >> 63;
+
+        uint64_t structurals = (masks.Op & ~in_string) | (quotes & in_string) | scalar_start;
+        if(structurals == 0)
+            return;
+        // offsets are written eight at a time without checking, the loop count is then predictable; the slots past
+        // count are overwritten by the next block or cut off by Finish()
+        size_t count = size_t(popcount(structurals));
+        if(m_out.size() < m_count + 64)
+            m_out.resize(max(m_count + 64, m_out.size() * 2));
+        uint32_t* out = m_out.data() + m_count;
+        m_count += count;
+        for(size_t i = 0; i < count; i += 8) {
+            for(size_t j = 0; j < 8; j++) {
+                out[i + j] = uint32_t(base + size_t(countr_zero(structurals)));
+                structurals &= structurals - 1;
             }
-        } else {
-            if(is_valid_character(szBuffer[i], szEndDelimiter)) {
-                offset = i + 1;
-                return { &szBuffer[start], i - start };
+        }
+    }
+
+    bool Finish() {
+        m_out.resize(m_count);
+        return m_in_string == 0 && m_error == 0;
+    }
+
+private:
+    vector<uint32_t>& m_out;
+    size_t m_count = 0;
+    uint64_t m_next_escaped = 0;
+    uint64_t m_in_string = 0;
+    uint64_t m_previous_scalar = 0;
+    uint64_t m_error = 0;
+};
+
+using scan_kernel = size_t (*)(const uint8_t* data, size_t length, size_t base, structural_scanner& scanner);
+
+// Each kernel scans as many whole 64 byte blocks as fit and returns the number of bytes it consumed.
+static size_t scan_scalar(const uint8_t* data, size_t length, size_t base, structural_scanner& scanner) {
+    size_t i = 0;
+    for(; i + 64 <= length; i += 64) {
+        block_masks masks;
+        for(size_t j = 0; j < 64; j++) {
+            uint8_t c = data[i + j];
+            uint64_t bit = uint64_t(1) << j;
+            switch(c) {
+                case '"': masks.Quote |= bit; break;
+                case '\\': masks.Backslash |= bit; break;
+                case '{': case '}': case '[': case ']': case ':': case ',': masks.Op |= bit; break;
+                case ' ': case '\t': case '\n': case '\r': masks.Whitespace |= bit; break;
+                default: break;
             }
+            if(c < 0x20)
+                masks.Control |= bit;
+        }
+        scanner.Block(masks, base + i);
+    }
+    return i;
+}
+
+#ifdef JSON_PARSER_X86
+// Classifies 16 bytes into bits [shift, shift + 16) of the block masks.
+JSON_PARSER_INLINE void classify_sse2(const uint8_t* data, block_masks& masks, int shift) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    // '[' and ']' differ from '{' and '}' only by 0x20
+    __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+                              _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+    __m128i whitespace = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+    auto bits = [shift](__m128i mask) { return uint64_t(uint16_t(_mm_movemask_epi8(mask))) << shift; };
+    masks.Quote |= bits(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    masks.Backslash |= bits(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    masks.Op |= bits(op);
+    masks.Whitespace |= bits(whitespace);
+    masks.Control |= bits(control);
+}
+
+static size_t scan_sse2(const uint8_t* data, size_t length, size_t base, structural_scanner& scanner) {
+    size_t i = 0;
+    for(; i + 64 <= length; i += 64) {
+        block_masks masks;
+        classify_sse2(data + i, masks, 0);
+        classify_sse2(data + i + 16, masks, 16);
+        classify_sse2(data + i + 32, masks, 32);
+        classify_sse2(data + i + 48, masks, 48);
+        scanner.Block(masks, base + i);
+    }
+    return i;
+}
+
+JSON_PARSER_TARGET("avx2")
+JSON_PARSER_INLINE void classify_avx2(const uint8_t* data, block_masks& masks, int shift) {
+    // Lookups on the low nibble: only the matching character equals its own table entry. Bytes >= 0x80 look up 0.
+    const __m256i whitespace_table = _mm256_setr_epi8(' ', 100, 100, 100, 17, 100, 113, 2, 100, '\t', '\n', 112, 100, '\r', 100, 100,
+                                                      ' ', 100, 100, 100, 17, 100, 113, 2, 100, '\t', '\n', 112, 100, '\r', 100, 100);
+    const __m256i op_table = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', '{', ',', '}', 0, 0,
+                                              0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', '{', ',', '}', 0, 0);
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    __m256i whitespace = _mm256_cmpeq_epi8(v, _mm256_shuffle_epi8(whitespace_table, v));
+    // '[' and ']' differ from '{' and '}' only by 0x20
+    __m256i op = _mm256_cmpeq_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_shuffle_epi8(op_table, v));
+    __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v);
+    masks.Quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))))) << shift;
+    masks.Backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))))) << shift;
+    // control characters (0x0C, 0x1A) can alias ',' and ':' once folded, they are rejected either way
+    masks.Op |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_andnot_si256(control, op)))) << shift;
+    masks.Whitespace |= uint64_t(uint32_t(_mm256_movemask_epi8(whitespace))) << shift;
+    masks.Control |= uint64_t(uint32_t(_mm256_movemask_epi8(control))) << shift;
+}
+
+JSON_PARSER_TARGET("avx2,popcnt,bmi")
+static size_t scan_avx2(const uint8_t* data, size_t length, size_t base, structural_scanner& scanner) {
+    size_t i = 0;
+    for(; i + 64 <= length; i += 64) {
+        block_masks masks;
+        classify_avx2(data + i, masks, 0);
+        classify_avx2(data + i + 32, masks, 32);
+        scanner.Block(masks, base + i);
+    }
+    return i;
+}
+
+static bool cpu_supports_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, 0, 0);
+    if(info[0] < 7)
+        return false;
+    __cpuidex(info, 1, 0);
+    bool osxsave = info[2] & (1 << 27);
+    if(!osxsave || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("bmi");
+#endif
+}
+#endif
+
+struct scan_dispatch {
+    scan_kernel Kernel = scan_scalar;
+    const char* Name = "scalar";
+
+    scan_dispatch() {
+#ifdef JSON_PARSER_X86
+        if(cpu_supports_avx2()) {
+            Kernel = scan_avx2;
+            Name = "avx2";
+        } else {
+            // SSE2 is part of the x86-64 baseline
+            Kernel = scan_sse2;
+            Name = "sse2";
         }
+#endif
+    }
+};
+
+static const scan_dispatch& dispatch() {
+    static const scan_dispatch instance;
+    return instance;
+}
+
+static bool find_structurals(string_view json, vector<uint32_t>& structurals, scan_kernel kernel) {
+    structural_scanner scanner(structurals);
+    auto* data = reinterpret_cast<const uint8_t*>(json.data());
+    size_t done = kernel(data, json.size(), 0, scanner);
+    if(done < json.size()) {
+        // the last partial block is padded with whitespace, which never adds a structural
+        uint8_t tail[64];
+        memset(tail, ' ', sizeof(tail));
+        memcpy(tail, data + done, json.size() - done);
+        kernel(tail, sizeof(tail), done, scanner);
+    }
+    return scanner.Finish();
+}
+
+bool json_parser::FindStructurals(string_view json, vector<uint32_t> &structurals) {
+    if(json.size() >= UINT32_MAX) {
+        structurals.clear();
+        return false;
     }
-    offset = szBuffer.size();
-    return { &szBuffer[start], szBuffer.size() - start };
+    return find_structurals(json, structurals, dispatch().Kernel);
+}
+
+const char* json_parser::KernelName() {
+    return dispatch().Name;
+}
+
+struct named_kernel {
+    const char* Name;
+    scan_kernel Kernel;
 };
 
-std::unordered_map<std::string, std::string> json_parser::parse(const std::string &json) {
+static vector<named_kernel> supported_kernels() {
+    vector<named_kernel> kernels { { "scalar", scan_scalar } };
+#ifdef JSON_PARSER_X86
+    kernels.push_back({ "sse2", scan_sse2 });
+    if(cpu_supports_avx2())
+        kernels.push_back({ "avx2", scan_avx2 });
+#endif
+    return kernels;
+}
+
+vector<string_view> json_parser::SupportedKernels() {
+    vector<string_view> names;
+    for(const auto& kernel : supported_kernels())
+        names.emplace_back(kernel.Name);
+    return names;
+}
+
+bool json_parser::FindStructurals(string_view json, vector<uint32_t> &structurals, string_view kernel) {
+    structurals.clear();
+    if(json.size() >= UINT32_MAX)
+        return false;
+    for(const auto& candidate : supported_kernels()) {
+        if(candidate.Name == kernel)
+            return find_structurals(json, structurals, candidate.Kernel);
+    }
+    return false;
+}
+
+static inline bool is_delimiter(char c) {
+    switch(c) {
+        case '{': case '}': case '[': case ']': case ':': case ',': case '"':
+        case ' ': case '\t': case '\n': case '\r':
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Offset of the closing quote of the string whose opening quote is at json[offset], npos if it is not terminated.
+// Only for strings stage 1 has not seen, the others use structural_string_end().
+static size_t string_end(string_view json, size_t offset) {
+    for(size_t i = offset + 1; i < json.size(); i++) {
+        char c = json[i];
+        if(c == '"')
+            return i;
+        if(c == '\\')
+            i++;
+    }
+    return string_view::npos;
+}
+
+// Offset of the closing quote of the string whose opening quote is structurals[index]. Stage 1 checked that every
+// string is terminated and only whitespace can follow a closing quote before the next structural (or the end of the
+// input), so the quote is found by stepping back over that whitespace instead of scanning the string.
+static size_t structural_string_end(string_view json, const vector<uint32_t>& structurals, size_t index) {
+    size_t end = index + 1 < structurals.size() ? structurals[index + 1] : json.size();
+    while(json[--end] != '"') {}
+    return end;
+}
+
+static size_t scalar_end(string_view json, size_t offset) {
+    while(offset < json.size() && !is_delimiter(json[offset]))
+        offset++;
+    return offset;
+}
+
+static bool read_hex4(const char* text, uint32_t& value) {
+    value = 0;
+    for(int i = 0; i < 4; i++) {
+        char c = text[i];
+        value <<= 4;
+        if(c >= '0' && c <= '9') value |= uint32_t(c - '0');
+        else if(c >= 'a' && c <= 'f') value |= uint32_t(c - 'a' + 10);
+        else if(c >= 'A' && c <= 'F') value |= uint32_t(c - 'A' + 10);
+        else return false;
+    }
+    return true;
+}
+
+static void append_utf8(uint32_t code_point, string& out) {
+    if(code_point < 0x80) {
+        out.push_back(char(code_point));
+    } else if(code_point < 0x800) {
+        out.push_back(char(0xC0 | (code_point >> 6)));
+        out.push_back(char(0x80 | (code_point & 0x3F)));
+    } else if(code_point < 0x10000) {
+        out.push_back(char(0xE0 | (code_point >> 12)));
+        out.push_back(char(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(char(0x80 | (code_point & 0x3F)));
+    } else {
+        out.push_back(char(0xF0 | (code_point >> 18)));
+        out.push_back(char(0x80 | ((code_point >> 12) & 0x3F)));
+        out.push_back(char(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(char(0x80 | (code_point & 0x3F)));
+    }
+}
+
+// Appends the unescaped content of [begin, end) (without quotes) to out.
+static bool unescape(const char* begin, const char* end, string& out) {
+    while(begin < end) {
+        auto* backslash = static_cast<const char*>(memchr(begin, '\\', size_t(end - begin)));
+        const char* chunk_end = backslash ? backslash : end;
+        out.append(begin, chunk_end);
+        if(!backslash)
+            return true;
+        begin = backslash + 1;
+        if(begin == end)
+            return false;
+        switch(*begin++) {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                uint32_t code_point;
+                if(end - begin < 4 || !read_hex4(begin, code_point))
+                    return false;
+                begin += 4;
+                if(code_point >= 0xD800 && code_point < 0xDC00) {
+                    // high surrogate, must be followed by an escaped low surrogate
+                    uint32_t low;
+                    if(end - begin < 6 || begin[0] != '\\' || begin[1] != 'u' || !read_hex4(begin + 2, low) ||
+                       low < 0xDC00 || low > 0xDFFF)
+                        return false;
+                    begin += 6;
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                } else if(code_point >= 0xDC00 && code_point <= 0xDFFF) {
+                    return false;
+                }
+                append_utf8(code_point, out);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+bool json_parser::UnescapeString(string_view json, size_t offset, string &out) {
+    out.clear();
+    if(offset >= json.size() || json[offset] != '"')
+        return false;
+    size_t end = string_end(json, offset);
+    if(end == string_view::npos)
+        return false;
+    for(size_t i = offset + 1; i < end; i++) {
+        if(uint8_t(json[i]) < 0x20)
+            return false;
+    }
+    return unescape(json.data() + offset + 1, json.data() + end, out);
+}
+
+// Checks the JSON number grammar, from_chars alone would accept "01" or "1." style input. Numbers with at most 19
+// significant digits and a small exponent are converted exactly with one multiplication or division (the double
+// result is correctly rounded when both operands are exact), the rest goes through from_chars.
+static bool parse_number(string_view text, double& value, bool& integer) {
+    static constexpr double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* c = text.data();
+    const char* end = c + text.size();
+    bool negative = c < end && *c == '-';
+    c += negative;
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    auto read_digits = [&](bool fraction) {
+        const char* start = c;
+        for(; c < end && *c >= '0' && *c <= '9'; c++) {
+            mantissa = mantissa * 10 + uint64_t(*c - '0');
+            // leading zeros of "0.000123" are not significant
+            digits += digits > 0 || *c != '0';
+            exponent -= fraction;
+        }
+        return c > start;
+    };
+    if(c < end && *c == '0') {
+        c++;
+    } else if(!read_digits(false)) {
+        return false;
+    }
+    integer = true;
+    if(c < end && *c == '.') {
+        integer = false;
+        c++;
+        if(!read_digits(true))
+            return false;
+    }
+    if(c < end && (*c == 'e' || *c == 'E')) {
+        integer = false;
+        c++;
+        bool negative_exponent = c < end && *c == '-';
+        if(c < end && (*c == '+' || *c == '-'))
+            c++;
+        const char* start = c;
+        int explicit_exponent = 0;
+        for(; c < end && *c >= '0' && *c <= '9'; c++)
+            explicit_exponent = min(explicit_exponent * 10 + (*c - '0'), 100000);
+        if(c == start)
+            return false;
+        exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+    }
+    if(c != end)
+        return false;
+
+    if(digits <= 19 && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+        value = double(mantissa);
+        value = exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent];
+        value = negative ? -value : value;
+        return true;
+    }
+    if(integer && digits <= 19) {
+        // exact integer, the conversion rounds correctly
+        value = negative ? -double(mantissa) : double(mantissa);
+        return true;
+    }
+    auto [last, ec] = from_chars(text.data(), text.data() + text.size(), value);
+    if(ec == errc::result_out_of_range)
+        value = strtod(string(text).c_str(), nullptr);
+    else if(ec != errc())
+        return false;
+    return true;
+}
+
+static bool parse_int64(string_view text, int64_t& value) {
+    auto [end, ec] = from_chars(text.data(), text.data() + text.size(), value);
+    return ec == errc() && end == text.data() + text.size();
+}
 
-    enum class ParserState {
-        FetchingFieldName,
-        FetchingFieldValue
+bool json_document::Fail(const char *error, size_t offset) {
+    m_error = error;
+    m_error_offset = offset;
+    m_nodes = 0;
+    return false;
+}
+
+bool json_document::ParseString(size_t index, node &item) {
+    uint32_t offset = m_structurals[index];
+    size_t end = structural_string_end(m_json, m_structurals, index);
+    item.Type = json_type::string;
+    item.Begin = offset;
+    const char* begin = m_json.data() + offset + 1;
+    if(!memchr(begin, '\\', end - offset - 1)) {
+        // points into the input, no copy
+        item.Escaped = false;
+        item.Count = uint32_t(end - offset - 1);
+        return true;
+    }
+    item.Escaped = true;
+    item.String = { uint32_t(m_strings.size()), uint32_t(end + 1) };
+    if(!unescape(begin, m_json.data() + end, m_strings))
+        return Fail("invalid escape sequence", offset);
+    item.Count = uint32_t(m_strings.size() - item.String.Offset);
+    return true;
+}
+
+bool json_document::ParseScalar(uint32_t offset, node &item) {
+    size_t end = scalar_end(m_json, offset);
+    auto text = m_json.substr(offset, end - offset);
+    item.Begin = offset;
+    if(text == "true" || text == "false") {
+        item.Type = json_type::boolean;
+        item.Boolean = text[0] == 't';
+    } else if(text == "null") {
+        item.Type = json_type::null;
+    } else {
+        double number;
+        bool integer;
+        if(!parse_number(text, number, integer))
+            return Fail("invalid value", offset);
+        item.Type = json_type::number;
+        item.Number = number;
+        item.Integer = integer;
+    }
+    return true;
+}
+
+bool json_document::Parse(string_view json) {
+    m_json = json;
+    m_stack.clear();
+    m_strings.clear();
+    m_error.clear();
+    m_error_offset = 0;
+    if(json.size() >= UINT32_MAX)
+        return Fail("document too large", 0);
+    if(!FindStructurals(json, m_structurals))
+        return Fail("unterminated string or control character in a string", json.size());
+    if(m_structurals.empty())
+        return Fail("empty document", 0);
+    // there are never more values than structurals, writing through a pointer keeps the loop free of capacity checks
+    if(m_tape.size() < m_structurals.size())
+        m_tape.resize(m_structurals.size());
+    node* tape = m_tape.data();
+    uint32_t size = 0;
+
+    enum class expect {
+        value,
+        array_value_or_end,
+        member_or_end,
+        member,
+        colon,
+        separator_or_end
     };
-    std::unordered_map<std::string, std::string> result;
-
-    string fieldName, fieldValue;
-
-    ParserState state = ParserState::FetchingFieldName;
-    size_t offset = 0;
-    do {
-        string_view word;
-        if(state == ParserState::FetchingFieldName) {
-            word = read_word(json, offset, "\"", "\"");
-        } else {// if(state == ParserState::FetchingFieldValue) {
-            word = read_word(json, offset, ":", ",}");
+    expect state = expect::value;
+    auto close = [&](uint32_t offset) {
+        auto& container = tape[m_stack.back()];
+        container.Next = size;
+        container.End = offset + 1;
+        m_stack.pop_back();
+    };
+
+    for(size_t i = 0; i < m_structurals.size(); i++) {
+        uint32_t offset = m_structurals[i];
+        char c = m_json[offset];
+        switch(state) {
+            case expect::array_value_or_end:
+                if(c == ']') {
+                    close(offset);
+                    state = expect::separator_or_end;
+                    break;
+                }
+                [[fallthrough]];
+            case expect::value: {
+                if(!m_stack.empty() && tape[m_stack.back()].Type == json_type::array)
+                    tape[m_stack.back()].Count++;
+                uint32_t index = size++;
+                auto& item = tape[index];
+                item = node();
+                item.Next = index + 1;
+                if(c == '{' || c == '[') {
+                    item.Type = c == '{' ? json_type::object : json_type::array;
+                    item.Begin = offset;
+                    m_stack.push_back(index);
+                    state = c == '{' ? expect::member_or_end : expect::array_value_or_end;
+                    break;
+                }
+                if(c == '"') {
+                    if(!ParseString(i, item))
+                        return false;
+                } else if(c == '}' || c == ']' || c == ':' || c == ',') {
+                    return Fail("expected a value", offset);
+                } else if(!ParseScalar(offset, item)) {
+                    return false;
+                }
+                state = expect::separator_or_end;
+                break;
+            }
+            case expect::member_or_end:
+                if(c == '}') {
+                    close(offset);
+                    state = expect::separator_or_end;
+                    break;
+                }
+                [[fallthrough]];
+            case expect::member: {
+                if(c != '"')
+                    return Fail("expected a member name", offset);
+                tape[m_stack.back()].Count++;
+                uint32_t index = size++;
+                auto& item = tape[index];
+                item = node();
+                item.Next = index + 1;
+                if(!ParseString(i, item))
+                    return false;
+                state = expect::colon;
+                break;
+            }
+            case expect::colon:
+                if(c != ':')
+                    return Fail("expected ':'", offset);
+                state = expect::value;
+                break;
+            case expect::separator_or_end: {
+                if(m_stack.empty())
+                    return Fail("unexpected content after the document", offset);
+                bool object = tape[m_stack.back()].Type == json_type::object;
+                if(c == ',') {
+                    state = object ? expect::member : expect::value;
+                } else if(c == (object ? '}' : ']')) {
+                    close(offset);
+                } else {
+                    return Fail(object ? "expected ',' or '}'" : "expected ',' or ']'", offset);
+                }
+                break;
+            }
         }
-        if(word.empty())
-            break;
+    }
+    if(state != expect::separator_or_end || !m_stack.empty())
+        return Fail("unexpected end of document", json.size());
+    m_nodes = size;
+    return true;
+}
 
-        if(state == ParserState::FetchingFieldName) {
-            fieldName = word;
-            state = ParserState::FetchingFieldValue;
-        } else {
-            fieldValue = word;
-            result[fieldName] = fieldValue;
-            fieldName = "";
-            fieldValue = "";
-            state = ParserState::FetchingFieldName;
+json_value json_document::Root() const {
+    if(m_nodes == 0)
+        return {};
+    return { this, 0 };
+}
+
+json_type json_value::Type() const {
+    if(!m_document)
+        return json_type::missing;
+    return m_document->m_tape[m_index].Type;
+}
+
+uint32_t json_value::End() const {
+    return m_document->m_tape[m_index].Next;
+}
+
+uint32_t json_value::NextOf(uint32_t node) const {
+    return m_document->m_tape[node].Next;
+}
+
+bool json_value::AsBool(bool fallback) const {
+    if(Type() != json_type::boolean)
+        return fallback;
+    return m_document->m_tape[m_index].Boolean;
+}
+
+double json_value::AsNumber(double fallback) const {
+    if(Type() != json_type::number)
+        return fallback;
+    return m_document->m_tape[m_index].Number;
+}
+
+int64_t json_value::AsInt64(int64_t fallback) const {
+    if(Type() != json_type::number)
+        return fallback;
+    const auto& item = m_document->m_tape[m_index];
+    int64_t value;
+    if(item.Integer && parse_int64(Raw(), value))
+        return value;
+    if(item.Number >= -9.2233720368547758e18 && item.Number < 9.2233720368547758e18)
+        return int64_t(item.Number);
+    return fallback;
+}
+
+string_view json_value::AsString(string_view fallback) const {
+    if(Type() != json_type::string)
+        return fallback;
+    const auto& item = m_document->m_tape[m_index];
+    if(item.Escaped)
+        return string_view(m_document->m_strings).substr(item.String.Offset, item.Count);
+    return m_document->m_json.substr(item.Begin + 1, item.Count);
+}
+
+string_view json_value::Raw() const {
+    if(!m_document)
+        return {};
+    const auto& item = m_document->m_tape[m_index];
+    const auto& json = m_document->m_json;
+    size_t end;
+    if(item.Type == json_type::object || item.Type == json_type::array)
+        end = item.End;
+    else if(item.Type == json_type::string)
+        end = item.Escaped ? item.String.End : item.Begin + item.Count + 2;
+    else
+        end = scalar_end(json, item.Begin);
+    return json.substr(item.Begin, end - item.Begin);
+}
+
+size_t json_value::Size() const {
+    auto type = Type();
+    if(type != json_type::array && type != json_type::object)
+        return 0;
+    return m_document->m_tape[m_index].Count;
+}
+
+json_value json_value::operator[](string_view key) const {
+    if(Type() != json_type::object)
+        return {};
+    for(uint32_t node = m_index + 1; node < End(); node = NextOf(node + 1)) {
+        if(json_value(m_document, node).AsString() == key)
+            return { m_document, node + 1 };
+    }
+    return {};
+}
+
+json_value json_value::operator[](size_t index) const {
+    if(Type() != json_type::array || index >= Size())
+        return {};
+    uint32_t node = m_index + 1;
+    for(size_t i = 0; i < index; i++)
+        node = NextOf(node);
+    return { m_document, node };
+}
+
+bool json_on_demand::Parse(string_view json) {
+    m_json = json;
+    if(!FindStructurals(json, m_structurals)) {
+        m_structurals.clear();
+        return false;
+    }
+    return !m_structurals.empty();
+}
+
+size_t json_on_demand::Skip(size_t index) const {
+    char c = m_json[m_structurals[index]];
+    if(c != '{' && c != '[')
+        return index + 1;
+    size_t depth = 0;
+    for(size_t i = index; i < m_structurals.size(); i++) {
+        switch(m_json[m_structurals[i]]) {
+            case '{': case '[': depth++; break;
+            case '}': case ']':
+                if(--depth == 0)
+                    return i + 1;
+                break;
+            default: break;
         }
+    }
+    return SIZE_MAX;
+}
+
+json_type json_on_demand::value::Type() const {
+    if(!m_document || m_index >= m_document->m_structurals.size())
+        return json_type::missing;
+    switch(m_document->m_json[m_document->m_structurals[m_index]]) {
+        case '{': return json_type::object;
+        case '[': return json_type::array;
+        case '"': return json_type::string;
+        case 't': case 'f': return json_type::boolean;
+        case 'n': return json_type::null;
+        case '-': case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            return json_type::number;
+        default: return json_type::missing;
+    }
+}
+
+json_on_demand::value json_on_demand::value::operator[](string_view key) const {
+    if(Type() != json_type::object)
+        return {};
+    const auto& json = m_document->m_json;
+    const auto& structurals = m_document->m_structurals;
+    auto at = [&](size_t i) { return i < structurals.size() ? json[structurals[i]] : '\0'; };
+    string name;
+    for(size_t i = m_index + 1; at(i) == '"' && at(i + 1) == ':';) {
+        size_t offset = structurals[i];
+        size_t end = structural_string_end(json, structurals, i);
+        auto raw = json.substr(offset + 1, end - offset - 1);
+        name.clear();
+        bool escaped = raw.find('\\') != string_view::npos;
+        if(escaped ? unescape(raw.data(), raw.data() + raw.size(), name) && name == key : raw == key)
+            return { m_document, i + 2 };
+        size_t next = m_document->Skip(i + 2);
+        if(at(next) != ',')
+            return {};
+        i = next + 1;
+    }
+    return {};
+}
+
+json_on_demand::value json_on_demand::value::operator[](size_t index) const {
+    if(Type() != json_type::array)
+        return {};
+    const auto& structurals = m_document->m_structurals;
+    size_t i = m_index + 1;
+    if(i >= structurals.size() || m_document->m_json[structurals[i]] == ']')
+        return {};
+    for(size_t element = 0; element < index; element++) {
+        size_t next = m_document->Skip(i);
+        if(next >= structurals.size() || m_document->m_json[structurals[next]] != ',')
+            return {};
+        i = next + 1;
+    }
+    return { m_document, i };
+}
+
+bool json_on_demand::value::GetBool(bool &out) const {
+    auto raw = Raw();
+    if(raw != "true" && raw != "false")
+        return false;
+    out = raw[0] == 't';
+    return true;
+}
 
-    } while (true);
+bool json_on_demand::value::GetNumber(double &out) const {
+    bool integer;
+    return Type() == json_type::number && parse_number(Raw(), out, integer);
+}
 
+bool json_on_demand::value::GetInt64(int64_t &out) const {
+    double number;
+    bool integer;
+    auto raw = Raw();
+    if(Type() != json_type::number || !parse_number(raw, number, integer))
+        return false;
+    if(integer && parse_int64(raw, out))
+        return true;
+    if(number < -9.2233720368547758e18 || number >= 9.2233720368547758e18)
+        return false;
+    out = int64_t(number);
+    return true;
+}
+
+bool json_on_demand::value::GetString(string &out) const {
+    out.clear();
+    if(Type() != json_type::string)
+        return false;
+    const auto& json = m_document->m_json;
+    size_t offset = m_document->m_structurals[m_index];
+    size_t end = structural_string_end(json, m_document->m_structurals, m_index);
+    return unescape(json.data() + offset + 1, json.data() + end, out);
+}
+
+string_view json_on_demand::value::Raw() const {
+    auto type = Type();
+    if(type == json_type::missing)
+        return {};
+    const auto& json = m_document->m_json;
+    size_t offset = m_document->m_structurals[m_index];
+    size_t end;
+    if(type == json_type::object || type == json_type::array) {
+        size_t next = m_document->Skip(m_index);
+        if(next == SIZE_MAX)
+            return {};
+        end = m_document->m_structurals[next - 1] + 1;
+    } else if(type == json_type::string) {
+        end = structural_string_end(json, m_document->m_structurals, m_index) + 1;
+    } else {
+        end = scalar_end(json, offset);
+    }
+    return json.substr(offset, end - offset);
+}
+
+unordered_map<string, string> json_parser::parse(const string &json) {
+    unordered_map<string, string> result;
+    json_document document;
+    if(!document.Parse(json)) {
+        LOG(WARNING, "Invalid JSON at offset {}, {}", document.ErrorOffset(), document.Error());
+        return result;
+    }
+    document.Root().ForEachMember([&](string_view name, json_value value) {
+        result.emplace(name, value.Type() == json_type::string ? value.AsString() : value.Raw());
+    });
     return result;
 }
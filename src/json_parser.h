@@ -6,11 +6,195 @@
 #define WEBCLIENT_JSON_PARSER_H
 #include <unordered_map>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
 
 namespace json_parser {
 
+    // Top level members of an object: strings are unescaped, other values are kept as their JSON text.
     std::unordered_map<std::string, std::string> parse(const std::string& json);
 
+    enum class json_type : uint8_t {
+        missing, // lookup of a member/element that does not exist
+        null,
+        boolean,
+        number,
+        string,
+        array,
+        object
+    };
+
+    /*
+     * Stage 1: finds the offsets of every structural character ({ } [ ] : ,), of every string's opening quote and of
+     * the first byte of every other scalar, 64 bytes at a time with SSE2/AVX2 (picked once at startup). Quotes and
+     * brackets inside strings are masked out, escaped quotes included.
+     * Returns false if a string is not terminated.
+     */
+    bool FindStructurals(std::string_view json, std::vector<uint32_t>& structurals);
+    const char* KernelName();
+    // The same scan on a given kernel ("scalar", "sse2", "avx2") instead of the one picked at startup, so tests and
+    // benchmarks reach every kernel. Also false if this CPU cannot run the kernel.
+    bool FindStructurals(std::string_view json, std::vector<uint32_t>& structurals, std::string_view kernel);
+    // Names of the kernels this CPU can run.
+    std::vector<std::string_view> SupportedKernels();
+
+    class json_document;
+
+    // Handle into a parsed json_document, cheap to copy, valid as long as the document is not parsed again.
+    class json_value {
+    public:
+        json_value() = default;
+
+        [[nodiscard]] json_type Type() const;
+        [[nodiscard]] bool Exists() const { return Type() != json_type::missing; }
+        [[nodiscard]] bool IsNull() const { return Type() == json_type::null; }
+
+        [[nodiscard]] bool AsBool(bool fallback = false) const;
+        [[nodiscard]] double AsNumber(double fallback = 0) const;
+        // Integers are parsed exactly (no round trip through double).
+        [[nodiscard]] int64_t AsInt64(int64_t fallback = 0) const;
+        [[nodiscard]] std::string_view AsString(std::string_view fallback = {}) const;
+        // JSON text of the value as it appears in the input.
+        [[nodiscard]] std::string_view Raw() const;
+
+        // Number of elements (array) or members (object).
+        [[nodiscard]] size_t Size() const;
+        // Linear in the number of members, the members are skipped without looking at their content.
+        json_value operator[](std::string_view key) const;
+        json_value operator[](size_t index) const;
+
+        template<class Callback>
+        void ForEachMember(Callback&& callback) const {
+            if(Type() != json_type::object)
+                return;
+            for(uint32_t node = m_index + 1; node < End(); node = NextOf(node + 1)) {
+                callback(json_value(m_document, node).AsString(), json_value(m_document, node + 1));
+            }
+        }
+
+        template<class Callback>
+        void ForEachElement(Callback&& callback) const {
+            if(Type() != json_type::array)
+                return;
+            for(uint32_t node = m_index + 1; node < End(); node = NextOf(node)) {
+                callback(json_value(m_document, node));
+            }
+        }
+
+    private:
+        friend class json_document;
+        json_value(const json_document* document, uint32_t index) : m_document(document), m_index(index) {}
+        [[nodiscard]] uint32_t End() const;
+        [[nodiscard]] uint32_t NextOf(uint32_t node) const;
+
+    private:
+        const json_document* m_document = nullptr;
+        uint32_t m_index = 0;
+    };
+
+    /*
+     * DOM parser: stage 1 (FindStructurals), then a single pass over the structural offsets that validates the
+     * grammar and writes a flat tape of nodes, where each container knows where it ends so lookups can skip it.
+     * Strings without escapes point into the input, so the input must outlive the document. Parsing into the same
+     * document again reuses its buffers.
+     */
+    class json_document {
+    public:
+        bool Parse(std::string_view json);
+        [[nodiscard]] json_value Root() const;
+
+        [[nodiscard]] const std::string& Error() const { return m_error; }
+        [[nodiscard]] size_t ErrorOffset() const { return m_error_offset; }
+
+    private:
+        friend class json_value;
+
+        // 24 bytes, the tape is written once per value so its size shows up directly in the parse time
+        struct node {
+            uint32_t Begin = 0;         // input offset of the value's first byte
+            uint32_t Next = 0;          // tape index following this value (and its children)
+            json_type Type = json_type::null;
+            bool Integer = false;
+            bool Escaped = false;       // string lives in m_strings instead of the input
+            uint32_t Count = 0;         // elements/members, string length
+            // escaped strings: start of the unescaped copy in m_strings, input offset after the closing quote
+            struct escaped_string {
+                uint32_t Offset;
+                uint32_t End;
+            };
+            union {
+                double Number;
+                escaped_string String;
+                uint32_t End;           // containers: input offset after the closing bracket
+                bool Boolean;
+            };
+            node() : Number(0) {}
+        };
+
+        bool Fail(const char* error, size_t offset);
+        // index: of the string's opening quote in m_structurals
+        bool ParseString(size_t index, node& item);
+        bool ParseScalar(uint32_t offset, node& item);
+
+    private:
+        std::string_view m_json;
+        std::vector<uint32_t> m_structurals;
+        std::vector<node> m_tape; // only grows, the first m_nodes entries belong to the current document
+        uint32_t m_nodes = 0;
+        std::vector<uint32_t> m_stack;
+        std::string m_strings;
+        std::string m_error;
+        size_t m_error_offset = 0;
+    };
+
+    /*
+     * On-demand access: only stage 1 runs up front, values are located and decoded when they are asked for.
+     * Cheaper than building the DOM when a handler reads a few fields of a large body, but only the parts that
+     * are accessed get validated.
+     */
+    class json_on_demand {
+    public:
+        class value {
+        public:
+            value() = default;
+
+            [[nodiscard]] json_type Type() const;
+            [[nodiscard]] bool Exists() const { return Type() != json_type::missing; }
+
+            value operator[](std::string_view key) const;
+            value operator[](size_t index) const;
+
+            [[nodiscard]] bool GetBool(bool& out) const;
+            [[nodiscard]] bool GetNumber(double& out) const;
+            [[nodiscard]] bool GetInt64(int64_t& out) const;
+            // Unescapes into out.
+            [[nodiscard]] bool GetString(std::string& out) const;
+            [[nodiscard]] std::string_view Raw() const;
+
+        private:
+            friend class json_on_demand;
+            value(const json_on_demand* document, size_t index) : m_document(document), m_index(index) {}
+
+        private:
+            const json_on_demand* m_document = nullptr;
+            size_t m_index = SIZE_MAX; // into the structural offsets, SIZE_MAX when missing
+        };
+
+        bool Parse(std::string_view json);
+        [[nodiscard]] value Root() const { return { this, m_structurals.empty() ? SIZE_MAX : 0 }; }
+
+    private:
+        // index of the structural following the value starting at index, SIZE_MAX on malformed input
+        [[nodiscard]] size_t Skip(size_t index) const;
+
+    private:
+        std::string_view m_json;
+        std::vector<uint32_t> m_structurals;
+    };
+
+    // Unescapes the string whose opening quote is at json[offset], returns false on malformed strings.
+    bool UnescapeString(std::string_view json, size_t offset, std::string& out);
 }
 
 
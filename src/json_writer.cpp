@@ -0,0 +1,43 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "json_writer.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+size_t json_format::Double(double value, char *out) {
+    if(!isfinite(value)) {
+        memcpy(out, "null", 4);
+        return 4;
+    }
+    // integral values are the common case (byte counts, sizes) and print faster as integers
+    if(value == trunc(value) && fabs(value) < 9.0e15)
+        return Int64(int64_t(value), out);
+    auto result = to_chars(out, out + MaxNumberLength, value);
+    return size_t(result.ptr - out);
+}
+
+size_t json_format::Float(float value, char *out) {
+    if(!isfinite(value)) {
+        memcpy(out, "null", 4);
+        return 4;
+    }
+    if(value == truncf(value) && fabsf(value) < 1.0e7f)
+        return Int64(int64_t(value), out);
+    auto result = to_chars(out, out + MaxNumberLength, value);
+    return size_t(result.ptr - out);
+}
+
+size_t json_format::Int64(int64_t value, char *out) {
+    auto result = to_chars(out, out + MaxNumberLength, value);
+    return size_t(result.ptr - out);
+}
+
+size_t json_format::UInt64(uint64_t value, char *out) {
+    auto result = to_chars(out, out + MaxNumberLength, value);
+    return size_t(result.ptr - out);
+}
@@ -0,0 +1,133 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_JSON_WRITER_H
+#define WEBCLIENT_JSON_WRITER_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace json_format {
+    // Largest output of the number formatters.
+    constexpr size_t MaxNumberLength = 32;
+
+    // Shortest text that parses back to the same double, locale independent. NaN and infinities have no JSON
+    // representation and are written as null.
+    size_t Double(double value, char* out);
+    // Shortest text for the float, 0.1f is written as 0.1 rather than 0.10000000149011612.
+    size_t Float(float value, char* out);
+    size_t Int64(int64_t value, char* out);
+    size_t UInt64(uint64_t value, char* out);
+}
+
+/*
+ * Streaming JSON writer that appends to a caller-owned buffer: an std::string, or directly the std::vector<uint8_t>
+ * payload of a web_packet or body of an http_response. Commas and colons are inserted automatically, strings are
+ * escaped, numbers go through std::to_chars. Nothing is allocated besides the growth of the buffer, so a buffer
+ * that is cleared and reused between documents serializes without heap traffic.
+ *
+ *     json_writer json(packet.Payload);
+ *     json.BeginObject().Member("cpu", 12.5).Key("cores").BeginArray().Value(1).Value(2).EndArray().EndObject();
+ *
+ * Nesting is not checked, mismatched Begin/End calls produce invalid JSON.
+ */
+template<class Buffer>
+class basic_json_writer {
+public:
+    explicit basic_json_writer(Buffer& out) : m_out(out) {}
+
+    basic_json_writer& BeginObject() { Separate(); Put('{'); m_first = true; return *this; }
+    basic_json_writer& EndObject() { Put('}'); m_first = false; return *this; }
+    basic_json_writer& BeginArray() { Separate(); Put('['); m_first = true; return *this; }
+    basic_json_writer& EndArray() { Put(']'); m_first = false; return *this; }
+
+    basic_json_writer& Key(std::string_view name) {
+        Separate();
+        WriteString(name);
+        Put(':');
+        m_after_key = true;
+        return *this;
+    }
+
+    basic_json_writer& Value(std::string_view text) { Separate(); WriteString(text); return *this; }
+    basic_json_writer& Value(const char* text) { return Value(std::string_view(text)); }
+    basic_json_writer& Value(const std::string& text) { return Value(std::string_view(text)); }
+    basic_json_writer& Value(bool value) { Separate(); Append(value ? std::string_view("true") : std::string_view("false")); return *this; }
+    basic_json_writer& Value(double value) { return Number(json_format::Double(value, m_number)); }
+    basic_json_writer& Value(float value) { return Number(json_format::Float(value, m_number)); }
+    basic_json_writer& Value(int value) { return Number(json_format::Int64(value, m_number)); }
+    basic_json_writer& Value(long value) { return Number(json_format::Int64(value, m_number)); }
+    basic_json_writer& Value(long long value) { return Number(json_format::Int64(value, m_number)); }
+    basic_json_writer& Value(unsigned value) { return Number(json_format::UInt64(value, m_number)); }
+    basic_json_writer& Value(unsigned long value) { return Number(json_format::UInt64(value, m_number)); }
+    basic_json_writer& Value(unsigned long long value) { return Number(json_format::UInt64(value, m_number)); }
+    basic_json_writer& Null() { Separate(); Append("null"); return *this; }
+    // Already serialized JSON, written as is.
+    basic_json_writer& RawValue(std::string_view json) { Separate(); Append(json); return *this; }
+
+    template<class T>
+    basic_json_writer& Member(std::string_view name, const T& value) { return Key(name).Value(value); }
+
+    [[nodiscard]] Buffer& Output() { return m_out; }
+
+private:
+    void Put(char c) { m_out.push_back(static_cast<typename Buffer::value_type>(c)); }
+    void Append(std::string_view text) { m_out.insert(m_out.end(), text.begin(), text.end()); }
+
+    void Separate() {
+        if(m_after_key)
+            m_after_key = false;
+        else if(!m_first)
+            Put(',');
+        m_first = false;
+    }
+
+    basic_json_writer& Number(size_t length) {
+        Separate();
+        Append({ m_number, length });
+        return *this;
+    }
+
+    void WriteString(std::string_view text) {
+        static constexpr char hex[] = "0123456789abcdef";
+        Put('"');
+        size_t run = 0;
+        for(size_t i = 0; i < text.size(); i++) {
+            auto c = static_cast<unsigned char>(text[i]);
+            if(c >= 0x20 && c != '"' && c != '\\')
+                continue;
+            // copy the unescaped run in one go
+            Append(text.substr(run, i - run));
+            run = i + 1;
+            switch(c) {
+                case '"': Append("\\\""); break;
+                case '\\': Append("\\\\"); break;
+                case '\n': Append("\\n"); break;
+                case '\r': Append("\\r"); break;
+                case '\t': Append("\\t"); break;
+                case '\b': Append("\\b"); break;
+                case '\f': Append("\\f"); break;
+                default: {
+                    char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+                    Append({ escape, sizeof(escape) });
+                }
+            }
+        }
+        Append(text.substr(run));
+        Put('"');
+    }
+
+private:
+    Buffer& m_out;
+    bool m_first = true;
+    bool m_after_key = false;
+    char m_number[json_format::MaxNumberLength] {};
+};
+
+using json_writer = basic_json_writer<std::vector<uint8_t>>;
+using json_string_writer = basic_json_writer<std::string>;
+
+#endif //WEBCLIENT_JSON_WRITER_H
@@ -0,0 +1,66 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "log_tail.h"
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+using namespace std;
+
+log_tail::log_tail(std::string path, size_t max_poll_bytes)
+: m_path(std::move(path)), m_max_poll_bytes(max_poll_bytes) {}
+
+uint64_t log_tail::FileSize() const {
+    error_code ec;
+    auto size = filesystem::file_size(m_path, ec);
+    return ec ? 0 : size;
+}
+
+std::optional<std::vector<uint8_t>> log_tail::ReadRange(uint64_t offset, uint64_t length) const {
+    ifstream file(m_path, ios::binary);
+    if(!file.is_open())
+        return {};
+    file.seekg(0, ios::end);
+    auto size = uint64_t(file.tellg());
+    if(offset >= size)
+        return vector<uint8_t>{};
+    length = min(length, size - offset);
+    vector<uint8_t> content(length);
+    file.seekg(streamoff(offset));
+    file.read(reinterpret_cast<char*>(content.data()), streamsize(length));
+    content.resize(size_t(file.gcount()));
+    return content;
+}
+
+std::optional<std::string> log_tail::PollAppended() {
+    lock_guard lock(m_poll_lock);
+    auto size = FileSize();
+    if(!m_offset || size < *m_offset) {
+        // first poll, or the file was truncated/rotated: follow from the current end.
+        m_offset = size;
+        return {};
+    }
+    if(size == *m_offset)
+        return {};
+
+    auto content = ReadRange(*m_offset, min<uint64_t>(size - *m_offset, m_max_poll_bytes));
+    if(!content || content->empty())
+        return {};
+    // only hand out complete lines, the rest is picked up on the next poll.
+    auto last_line = find(content->rbegin(), content->rend(), '\n');
+    if(last_line == content->rend()) {
+        if(content->size() < m_max_poll_bytes)
+            return {};
+        // a single line longer than the poll window, send it in pieces.
+        last_line = content->rbegin();
+    }
+    size_t length = content->rend() - last_line;
+    *m_offset += length;
+    return string(content->begin(), content->begin() + ptrdiff_t(length));
+}
+
+bool log_tail::Truncate() {
+    ofstream file(m_path, ios::binary | ios::trunc);
+    return file.is_open();
+}
@@ -0,0 +1,38 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_LOG_TAIL_H
+#define WEBCLIENT_LOG_TAIL_H
+#include <string>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <mutex>
+
+/*
+ * Offset-aware reader for an append-only log file. Requests only read the byte range they ask for, and
+ * PollAppended() only reads what was appended since the previous poll (detected with a stat of the file size),
+ * so following a large log never re-reads it from the start.
+ */
+class log_tail {
+public:
+    explicit log_tail(std::string path, size_t max_poll_bytes = 256 * 1024);
+
+    [[nodiscard]] uint64_t FileSize() const;
+    // Reads up to length bytes starting at offset, clamped to the current file size.
+    std::optional<std::vector<uint8_t>> ReadRange(uint64_t offset, uint64_t length) const;
+    // Returns the complete lines appended since the previous call. The first call starts at the current end of file.
+    std::optional<std::string> PollAppended();
+    bool Truncate();
+
+    [[nodiscard]] const std::string& Path() const { return m_path; }
+
+private:
+    std::string m_path;
+    size_t m_max_poll_bytes;
+    std::mutex m_poll_lock;
+    std::optional<uint64_t> m_offset;
+};
+
+#endif //WEBCLIENT_LOG_TAIL_H
@@ -0,0 +1,194 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "lz4_block.h"
+#include <array>
+#include <bit>
+#include <cstring>
+
+using namespace std;
+
+static constexpr size_t MinMatch = 4;
+// The format ends with at least LastLiterals literals, and the last match starts MatchFindLimit bytes before the end.
+static constexpr size_t LastLiterals = 5;
+static constexpr size_t MatchFindLimit = 12;
+static constexpr size_t MaxDistance = 65535;
+static constexpr int HashLog = 12; // 16 KB table, stays in L1
+// The stride grows by one every 2^SkipTrigger positions without a match.
+static constexpr int SkipTrigger = 6;
+
+static inline uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+static inline uint32_t hash4(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HashLog);
+}
+
+// Length of the common prefix of a and b, at most limit bytes.
+static inline size_t match_length(const uint8_t* a, const uint8_t* b, size_t limit) {
+    size_t length = 0;
+    if constexpr(endian::native == endian::little) {
+        for(; length + 8 <= limit; length += 8) {
+            uint64_t x, y;
+            memcpy(&x, a + length, 8);
+            memcpy(&y, b + length, 8);
+            if(x != y)
+                return length + size_t(countr_zero(x ^ y)) / 8;
+        }
+    }
+    while(length < limit && a[length] == b[length])
+        length++;
+    return length;
+}
+
+// Lengths of 15 and more continue in bytes of up to 255 after the token.
+static inline void write_length(uint8_t*& op, size_t length) {
+    for(; length >= 255; length -= 255)
+        *op++ = 255;
+    *op++ = uint8_t(length);
+}
+
+static inline bool read_length(const uint8_t*& ip, const uint8_t* end, size_t& length) {
+    uint8_t byte;
+    do {
+        if(ip == end)
+            return false;
+        byte = *ip++;
+        length += byte;
+    } while(byte == 255);
+    return true;
+}
+
+// Copies length bytes from offset bytes back, 16 at a time and up to 15 bytes past the end. offset >= 16.
+static inline void copy_match_wide(uint8_t* op, size_t offset, size_t length) {
+    for(size_t i = 0; i < length; i += 16)
+        memcpy(op + i, op - offset + i, 16);
+}
+
+// Writes a sequence: the literals, then a match unless it is the last sequence (match_length 0).
+static bool write_sequence(uint8_t*& op, const uint8_t* end, const uint8_t* literals, size_t literal_length,
+                           size_t offset, size_t match_length) {
+    size_t match_code = match_length ? match_length - MinMatch : 0;
+    size_t worst = 1 + literal_length / 255 + 1 + literal_length + 2 + match_code / 255 + 1;
+    if(size_t(end - op) < worst)
+        return false;
+    uint8_t* token = op++;
+    *token = uint8_t(min<size_t>(literal_length, 15) << 4);
+    if(literal_length >= 15)
+        write_length(op, literal_length - 15);
+    if(literal_length > 0)
+        memcpy(op, literals, literal_length);
+    op += literal_length;
+    if(match_length == 0)
+        return true;
+    *op++ = uint8_t(offset);
+    *op++ = uint8_t(offset >> 8);
+    *token |= uint8_t(min<size_t>(match_code, 15));
+    if(match_code >= 15)
+        write_length(op, match_code - 15);
+    return true;
+}
+
+size_t lz4_block::Compress(span<const uint8_t> in, span<uint8_t> out) {
+    const uint8_t* base = in.data();
+    const size_t size = in.size();
+    uint8_t* op = out.data();
+    const uint8_t* out_end = op + out.size();
+    size_t anchor = 0; // first byte not written yet
+
+    if(size > MatchFindLimit) {
+        const size_t match_limit = size - LastLiterals;
+        const size_t search_limit = size - MatchFindLimit;
+        array<uint32_t, 1 << HashLog> table {};
+        size_t p = 1;
+        while(p <= search_limit) {
+            // look for a 4-byte sequence seen before, striding faster the longer nothing matches
+            size_t match = 0;
+            unsigned attempts = 1 << SkipTrigger;
+            bool found = false;
+            while(p <= search_limit) {
+                uint32_t sequence = read32(base + p);
+                auto& slot = table[hash4(sequence)];
+                match = slot;
+                slot = uint32_t(p);
+                if(p - match <= MaxDistance && read32(base + match) == sequence) {
+                    found = true;
+                    break;
+                }
+                p += attempts++ >> SkipTrigger;
+            }
+            if(!found)
+                break;
+            while(p > anchor && match > 0 && base[p - 1] == base[match - 1]) {
+                p--;
+                match--;
+            }
+            size_t length = MinMatch + match_length(base + p + MinMatch, base + match + MinMatch,
+                                                    match_limit - p - MinMatch);
+            if(!write_sequence(op, out_end, base + anchor, p - anchor, p - match, length))
+                return 0;
+            p += length;
+            anchor = p;
+            // the bytes just matched are not searched, remember one of them for the next matches
+            if(p <= search_limit)
+                table[hash4(read32(base + p - 2))] = uint32_t(p - 2);
+        }
+    }
+    if(!write_sequence(op, out_end, base + anchor, size - anchor, 0, 0))
+        return 0;
+    return size_t(op - out.data());
+}
+
+bool lz4_block::Decompress(span<const uint8_t> in, span<uint8_t> out) {
+    const uint8_t* ip = in.data();
+    const uint8_t* in_end = ip + in.size();
+    uint8_t* op = out.data();
+    uint8_t* out_end = op + out.size();
+    while(ip < in_end) {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if(literals < 15 && size_t(in_end - ip) >= 16 && size_t(out_end - op) >= 16) {
+            // short literals are copied 16 bytes at a time, what lies past them is overwritten next
+            memcpy(op, ip, 16);
+        } else {
+            if(literals == 15 && !read_length(ip, in_end, literals))
+                return false;
+            if(literals > size_t(in_end - ip) || literals > size_t(out_end - op))
+                return false;
+            if(literals > 0)
+                memcpy(op, ip, literals);
+        }
+        ip += literals;
+        op += literals;
+        // the last sequence has no match
+        if(ip == in_end)
+            return op == out_end;
+
+        if(in_end - ip < 2)
+            return false;
+        size_t offset = size_t(ip[0]) | size_t(ip[1]) << 8;
+        ip += 2;
+        size_t length = token & 15;
+        if(length == 15 && !read_length(ip, in_end, length))
+            return false;
+        length += MinMatch;
+        if(offset == 0 || offset > size_t(op - out.data()) || length > size_t(out_end - op))
+            return false;
+        if(offset >= 16 && size_t(out_end - op) >= length + 15) {
+            copy_match_wide(op, offset, length);
+        } else if(offset == 1) {
+            memset(op, op[-1], length);
+        } else {
+            // a match overlapping itself repeats its first offset bytes
+            const uint8_t* match = op - offset;
+            for(size_t i = 0; i < length; i++)
+                op[i] = match[i];
+        }
+        op += length;
+    }
+    return false;
+}
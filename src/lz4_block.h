@@ -0,0 +1,26 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_LZ4_BLOCK_H
+#define WEBCLIENT_LZ4_BLOCK_H
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Compressor and decompressor for the LZ4 block format: byte-aligned literal runs and back references of at least
+ * four bytes into the last 64 KB, found through a hash table of the last position of every 4-byte sequence. It trades
+ * ratio for speed, compressing at hundreds of MB/s per core and decompressing at several GB/s. Like LZ4, the search
+ * takes longer strides the longer it goes without a match, so incompressible data (JPEG, PNG, archives) is skimmed
+ * rather than searched byte by byte.
+ */
+namespace lz4_block {
+    // Compresses in into out, returns the compressed length, or 0 if it does not fit in out.
+    size_t Compress(std::span<const uint8_t> in, std::span<uint8_t> out);
+    // Decompresses a block whose decompressed length is exactly out.size(). False if the block is malformed, it never
+    // reads or writes outside of in and out.
+    bool Decompress(std::span<const uint8_t> in, std::span<uint8_t> out);
+}
+
+#endif //WEBCLIENT_LZ4_BLOCK_H
@@ -5,9 +5,102 @@
 #include <numeric>
 #include "web_server.h"
 #include "sys_info.h"
+#include "directory_index.h"
+#include "log_tail.h"
+#include "delta_publisher.h"
+#include "web_message.h"
+#include "buffer_pool.h"
+#include "request_binding.h"
 
 using namespace std;
 bool g_ContinueRunning = true;
+constexpr const char* LogFilePath = "history.log";
+// Largest window /history.log reads into one response, whatever tail, length or Range asks for.
+constexpr uint64_t HistoryLogMaxRead = 4 * 1024 * 1024;
+
+// Binary messages of the dashboard pages, see web_message.h for the wire format.
+struct set_name_message {
+    static constexpr uint16_t Id = 1;
+    static constexpr const char* Name = "set_name";
+    string NewName;
+    static constexpr auto Fields = make_tuple(web_message::field("name", &set_name_message::NewName));
+};
+struct join_room_message {
+    static constexpr uint16_t Id = 2;
+    static constexpr const char* Name = "join_room";
+    string Room;
+    static constexpr auto Fields = make_tuple(web_message::field("room", &join_room_message::Room));
+};
+struct leave_room_message {
+    static constexpr uint16_t Id = 3;
+    static constexpr const char* Name = "leave_room";
+    string Room;
+    static constexpr auto Fields = make_tuple(web_message::field("room", &leave_room_message::Room));
+};
+struct room_message {
+    static constexpr uint16_t Id = 4;
+    static constexpr const char* Name = "room_message";
+    string Room;
+    string Text;
+    static constexpr auto Fields = make_tuple(web_message::field("room", &room_message::Room),
+                                              web_message::field("text", &room_message::Text));
+};
+struct chat_message {
+    static constexpr uint16_t Id = 5;
+    static constexpr const char* Name = "chat";
+    string Text;
+    static constexpr auto Fields = make_tuple(web_message::field("text", &chat_message::Text));
+};
+struct button_click_message {
+    static constexpr uint16_t Id = 10;
+    static constexpr const char* Name = "button_click";
+    uint32_t Button = 0;
+    static constexpr auto Fields = make_tuple(web_message::field("button", &button_click_message::Button));
+};
+struct counter_message {
+    static constexpr uint16_t Id = 11;
+    static constexpr const char* Name = "counter";
+    int64_t Value = 0;
+    static constexpr auto Fields = make_tuple(web_message::field("value", &counter_message::Value));
+};
+
+// Query parameters of the HTTP routes, see request_binding.h.
+struct history_log_query {
+    bool Clear = false;
+    optional<uint64_t> Tail;
+    optional<uint64_t> Offset;
+    optional<uint64_t> Length;
+    static constexpr auto Fields = make_tuple(request_binding::field("clear", &history_log_query::Clear),
+                                              request_binding::field("tail", &history_log_query::Tail),
+                                              request_binding::field("offset", &history_log_query::Offset),
+                                              request_binding::field("length", &history_log_query::Length));
+};
+struct message_schema_query {
+    string Resource = "/Stats";
+    static constexpr auto Fields = make_tuple(request_binding::field("resource", &message_schema_query::Resource));
+
+    bool Validate(string& error) const {
+        if(Resource == "/Stats" || Resource == "/Dynamic")
+            return true;
+        error = "resource must be /Stats or /Dynamic";
+        return false;
+    }
+};
+struct metrics_history_query {
+    int64_t Range = 600;
+    int64_t Resolution = 0;
+    string Metric;
+    static constexpr auto Fields = make_tuple(request_binding::field("range", &metrics_history_query::Range),
+                                              request_binding::field("resolution", &metrics_history_query::Resolution),
+                                              request_binding::field("metric", &metrics_history_query::Metric));
+
+    bool Validate(string& error) const {
+        if(Range > 0 && Resolution >= 0)
+            return true;
+        error = "range must be positive and resolution not negative";
+        return false;
+    }
+};
 
 int main()
 {
@@ -16,109 +109,194 @@ int main()
     cpp::Logger::GetGlobalLogger().Options.VerboseMode = true;
     cpp::Logger::GetGlobalLogger().Options.IncludeDate = true;
     cpp::Logger::GetGlobalLogger().Options.IncludeFileAndLine = true;
-    cpp::Logger::GetGlobalLogger().AddFileLogging("history.log");
+    cpp::Logger::GetGlobalLogger().AddFileLogging(LogFilePath);
 
     LOG(INFO, "Server Startup");
 
     web_server server;
+    log_tail history_log(LogFilePath);
 
-    server.AddHttpRouteHandler({"/history.log"}, [](http_request &request,
-                                                    optional<http_response> &outResponse) -> middleware_route_status {
-        if (request.query.contains("clear") &&
-            request.query["clear"] == "true") {
-            cpp::WriteAllText("../cmake-build-debug/history.log", "");
+    // /history.log?tail=N returns the last N bytes (64 KB by default), ?offset=N&length=N an explicit window and
+    // a "Range: bytes=..." header is answered with 206, all of them cut to HistoryLogMaxRead. Only the first range of a
+    // multi-range request is served. Live appends are pushed to the /LogStream websocket port.
+    server.AddHttpRouteHandler({"/history.log"}, request_binding::Handler<history_log_query>(
+            [&](http_request &request, history_log_query &query,
+                optional<http_response> &outResponse) -> middleware_route_status {
+        if (query.Clear) {
+            history_log.Truncate();
+        }
+        uint64_t size = history_log.FileSize();
+        uint64_t length = min(query.Tail.value_or(64 * 1024), HistoryLogMaxRead), offset;
+        offset = size > length ? size - length : 0;
+        if (query.Offset) {
+            offset = *query.Offset;
+            length = min(query.Length.value_or(size), HistoryLogMaxRead);
         }
-        auto text = cpp::ReadAllText("../cmake-build-debug/history.log").value_or("could not open history.log file.");
-        if (text.empty())
-            text = "[Empty]";
+
         http_response response;
         response.headers["Content-Type"] = "text/plain";
-        response.SetBody(text);
+        response.headers["Accept-Ranges"] = "bytes";
+        if (auto range = request.fields.find("Range");
+            range != request.fields.end() && range->second.starts_with("bytes=")) {
+            // bytes=first-last, bytes=first- or bytes=-suffix_length
+            auto spec = range->second.substr(6);
+            spec = spec.substr(0, spec.find(','));
+            auto dash = spec.find('-');
+            size_t first = 0, last = 0;
+            bool has_first = dash != string::npos && dash > 0 && cpp::TryToInt64(spec.substr(0, dash), first);
+            bool has_last = dash != string::npos && dash + 1 < spec.size() && cpp::TryToInt64(spec.substr(dash + 1), last);
+            // a zero-length suffix (bytes=-0) selects nothing
+            if (size == 0 || (!has_first && (!has_last || last == 0)) || (has_first && first >= size) ||
+                (has_first && has_last && last < first)) {
+                response.code = http_code::http_416_range_not_satisfiable;
+                response.headers["Content-Range"] = cpp::Format("bytes */{}", size);
+                outResponse = response;
+                return middleware_route_status::dynamic_response;
+            }
+            if (!has_first) {
+                length = min<uint64_t>({ last, size, HistoryLogMaxRead });
+                offset = size - length;
+            } else {
+                offset = first;
+                length = has_last ? min<uint64_t>(last, size - 1) - first + 1 : size - first;
+                length = min(length, HistoryLogMaxRead);
+            }
+            response.code = http_code::http_206_partial_content;
+            response.headers["Content-Range"] = cpp::Format("bytes {}-{}/{}", offset, offset + length - 1, size);
+        }
+
+        auto content = history_log.ReadRange(offset, length);
+        if (!content) {
+            response.SetBody("could not open history.log file.");
+        } else if (content->empty() && response.code == http_code::http_200_ok) {
+            response.SetBody("[Empty]");
+        } else {
+            response.body = std::move(content);
+        }
+        response.headers["X-Log-Offset"] = to_string(offset);
+        response.headers["X-Log-Size"] = to_string(size);
         outResponse = response;
         return middleware_route_status::dynamic_response;
-    });
+    }));
 
-    server.AddHttpRouteHandler({"/ls", "/dir"}, [](http_request &request,
+    directory_index wwwroot_index("../wwwroot");
+    server.AddHttpRouteHandler({"/ls", "/dir"}, [&](http_request &request,
                                                    optional<http_response> &outResponse) -> middleware_route_status {
-        stringstream content;
-        content <<
-                R"(<!DOCTYPE html>
-            <html lang="en-US">
-            <head>
-                <title>List of Files</title>
-            <style>
-                tr:nth-child(even) {background-color: #f2f2f2;}
-                tr:hover {background-color: coral;}
-                table {
-                    margin-left: auto;
-                    margin-right: auto;
-                }
-                a:hover, a:visited { color:blue }
-                table {
-                    border: 2px solid;
-                    border-radius: 6px;
-                }
-                td {
-                    padding: 5px;
-                }
-            </style>
-            </head>
-            <body>
-                <table>
-                <thead>
-                <tr>
-                <th></th>
-                <th style="min-width: 250px">File Name</th>
-                <th style="min-width: 150px">File Size</th>
-                </tr>
-                </thead>)";
-
-        namespace fs = filesystem;
-
-        std::vector<std::pair<fs::path, uintmax_t>> files;
-
-        for (const auto &entry: fs::directory_iterator("../wwwroot")) {
-            if (fs::is_regular_file(entry.path())) {
-                uintmax_t size = fs::file_size(entry.path());
-                files.emplace_back(entry.path(), size);
-            }
-        }
+        const auto& listing = wwwroot_index.Render(directory_listing_options::FromQuery(request.query));
 
-        // Sort files by size in descending order
-        std::sort(files.begin(), files.end(),
-                  [](const std::pair<fs::path, uintmax_t> &a, const std::pair<fs::path, uintmax_t> &b) {
-                      return a.second > b.second;
-                  });
-
-        // Print sorted files
-        int counter = 1;
-        for (const auto &[file, size]: files) {
-            auto name = file.filename().string();
-            content << cpp::Format(
-                    "<tr><td>{2}</td><td style=\"padding: 0.5em\"><a href='/{0}'>{0}</a></td><td style='text-align: center'>{1}</td>",
-                    name, cpp::FriendlyMemorySize((double) cpp::GetFileSize(file.string())),
-                    counter++) << '\n';
+        http_response response;
+        response.headers["ETag"] = listing.ETag;
+        response.headers["Cache-Control"] = "no-cache";
+        if (auto tag = request.FindField("If-None-Match"); tag && *tag == listing.ETag) {
+            response.code = http_code::http_304_not_modified;
+        } else {
+            response.headers["Content-Type"] = "text/html";
+            response.body = listing.Html;
         }
+        outResponse = response;
+
+        return middleware_route_status::dynamic_response;
+    });
 
-        content << "</table></body></html>";
 
+    // chat and button clicks are tiny, do not let these ports buffer multi-megabyte messages
+    server.SetWebSocketMaxMessageSize({"/Stats", "/Dynamic", "/LogStream"}, 64 * 1024);
+    // only the newest stats snapshot matters to a dashboard that fell behind
+    server.SetWebSocketSendPolicy({"/Stats", "/Dynamic"}, {websocket_backlog_policy::coalesce_latest, 256 * 1024, 10s});
+    // a log follower that cannot keep up is better off reconnecting and re-reading the tail
+    server.SetWebSocketSendPolicy({"/LogStream"}, {websocket_backlog_policy::disconnect, 4 * 1024 * 1024, 30s});
+    server.Heartbeat.Interval = 10s;
+    server.Heartbeat.MaxMissedPongs = 3;
+
+    server.AddHttpRouteHandler({"/metrics"}, [&](http_request &,
+                                                 optional<http_response> &outResponse) -> middleware_route_status {
+        auto stats = server.GetWebSocketQueueStats();
+        stringstream text;
+        text << "websocket_connections " << stats.Connections << "\n"
+             << "websocket_send_queue_frames " << stats.QueuedFrames << "\n"
+             << "websocket_send_queue_bytes " << stats.QueuedBytes << "\n"
+             << "websocket_send_queue_largest_bytes " << stats.LargestQueueBytes << "\n"
+             << "websocket_dropped_frames_total " << stats.DroppedFrames << "\n"
+             << "websocket_slow_consumer_disconnects_total " << stats.SlowConsumerDisconnects << "\n";
+        auto rtt = server.GetRttPercentiles();
+        text << "websocket_rtt_ms{quantile=\"0.5\"} " << rtt.P50 << "\n"
+             << "websocket_rtt_ms{quantile=\"0.9\"} " << rtt.P90 << "\n"
+             << "websocket_rtt_ms{quantile=\"0.99\"} " << rtt.P99 << "\n"
+             << "websocket_rtt_ms_max " << rtt.Max << "\n"
+             << "websocket_rtt_samples " << rtt.Samples << "\n";
+        auto buffers = buffer_pool::Global().Stats();
+        text << "receive_buffers_borrowed " << buffers.Borrowed << "\n"
+             << "receive_buffers_borrowed_bytes " << buffers.BorrowedBytes << "\n"
+             << "receive_buffers_cached_bytes " << buffers.CachedBytes << "\n"
+             << "receive_buffers_arena_bytes " << buffers.ArenaBytes << "\n";
         http_response response;
-        response.headers["Content-Type"] = "text/html";
-        response.SetBody(content.str());
+        response.headers["Content-Type"] = "text/plain; version=0.0.4";
+        response.SetBody(text.str());
         outResponse = response;
-
         return middleware_route_status::dynamic_response;
     });
 
+    // /metrics/history?range=600&resolution=1&metric=cpu_usage, served from the sampler's in-memory history
+    server.AddHttpRouteHandler({"/metrics/history"}, request_binding::Handler<metrics_history_query>(
+            [&](http_request &, metrics_history_query &query,
+                optional<http_response> &outResponse) -> middleware_route_status {
+        http_response response;
+        response.headers["Content-Type"] = "application/json";
+        json_writer json(response.body.emplace());
+        sys_info::sampler::Global().History().QueryJSON(json, query.Range, query.Resolution, query.Metric);
+        outResponse = response;
+        return middleware_route_status::dynamic_response;
+    }));
 
-    server.AddPortWebSocketHandler({"/Stats"}, [&](client_ctx& client, web_packet& packet) -> websocket_callback_status {
+    // Chat commands, reachable as text ("/join room") or as binary web_message frames.
+    auto join_room = [&](client_ctx& client, const string& room) {
+        if(!room.empty())
+            server.Subscribe(client, "chat:" + room);
+    };
+    auto leave_room = [&](client_ctx& client, const string& room) {
+        if(!room.empty())
+            server.Unsubscribe(client, "chat:" + room);
+    };
+    auto send_to_room = [&](client_ctx& client, const string& room, const string& message) {
+        if(!room.empty())
+            server.Publish("chat:" + room, web_packet::TextPacket(cpp::Format("[{}] {}: {}", room, client.Name, message)));
+    };
+    auto chat = [&](client_ctx& client, const string& message) {
+        server.Publish("/Stats", web_packet::TextPacket(client.Name + ": " + message));
+    };
+
+    // one dispatcher per websocket resource, a chat message sent to /Dynamic is not handled there
+    web_message::dispatcher chat_messages;
+    chat_messages.On<set_name_message>([&](client_ctx& client, set_name_message& message) {
+        if(!message.NewName.empty())
+            client.Name = message.NewName;
+    });
+    chat_messages.On<join_room_message>([&](client_ctx& client, join_room_message& message) { join_room(client, message.Room); });
+    chat_messages.On<leave_room_message>([&](client_ctx& client, leave_room_message& message) { leave_room(client, message.Room); });
+    chat_messages.On<room_message>([&](client_ctx& client, room_message& message) {
+        send_to_room(client, message.Room, message.Text);
+    });
+    chat_messages.On<chat_message>([&](client_ctx& client, chat_message& message) { chat(client, message.Text); });
+    web_message::dispatcher dynamic_messages;
+    dynamic_messages.Describe<counter_message>();
+
+    // /message_schema.json?resource=/Dynamic, the JS decoder (wwwroot/web_message.js) builds its codecs from this
+    server.AddHttpRouteHandler({"/message_schema.json"}, request_binding::Handler<message_schema_query>(
+            [&](http_request &, message_schema_query &query,
+                optional<http_response> &outResponse) -> middleware_route_status {
+        http_response response;
+        response.headers["Content-Type"] = "application/json";
+        response.SetBody((query.Resource == "/Dynamic" ? dynamic_messages : chat_messages).SchemaAsJSON());
+        outResponse = response;
+        return middleware_route_status::dynamic_response;
+    }));
 
+    server.AddPortWebSocketHandler({"/Stats"}, [&](client_ctx& client, web_packet_view& packet) -> websocket_callback_status {
+        if(packet.OpCode == web_socket_opcode::BinaryFrame)
+            return chat_messages.Dispatch(client, packet);
         if(packet.OpCode != web_socket_opcode::TextFrame)
             return websocket_callback_status::ignore;
 
-        web_packet response;
-        response.OpCode = web_socket_opcode::TextFrame;
-
         string payload = string(packet.Payload.begin(), packet.Payload.end());
         if(payload.starts_with("/set_name")) {
             auto split = cpp::Split(payload, " ");
@@ -126,17 +304,31 @@ int main()
                 client.Name = split[1];
             }
             return websocket_callback_status::processed;
+        } else if(payload.starts_with("/join ") || payload.starts_with("/leave ")) {
+            auto split = cpp::Split(payload, " ");
+            if(split.size() > 1) {
+                if(payload.starts_with("/join "))
+                    join_room(client, split[1]);
+                else
+                    leave_room(client, split[1]);
+            }
+            return websocket_callback_status::processed;
+        } else if(payload.starts_with("/to ")) {
+            auto split = cpp::Split(payload, " ");
+            if(split.size() > 2 && !split[1].empty()) {
+                send_to_room(client, split[1], payload.substr(payload.find(split[2], 4 + split[1].size())));
+            }
+            return websocket_callback_status::processed;
         } else if(payload.starts_with("/help")) {
-            string msg = "/set_name [Name] --- Will set your public name.";
-            response.SetPayloadFromString(msg);
-            client.SendPacket(response);
+            string msg = "/set_name [Name] --- Will set your public name.\n"
+                         "/join [Room] --- Receive messages sent to a room.\n"
+                         "/leave [Room] --- Stop receiving messages from a room.\n"
+                         "/to [Room] [Message] --- Send a message to everyone in a room.";
+            client.SendPacket(web_packet::TextPacket(msg));
             return websocket_callback_status::processed;
         }
 
-        string msg = client.Name + ": " + payload;
-
-        response.SetPayloadFromString(msg);
-        server.SendAll(response, "/Stats");
+        chat(client, payload);
         return websocket_callback_status::processed;
     });
 
@@ -145,7 +337,17 @@ int main()
         int counter = 22;
     };
 
-    server.AddPortWebSocketHandler({"/Dynamic"}, [&](client_ctx& client, web_packet& packet) {
+    dynamic_messages.On<button_click_message>([&](client_ctx& client, button_click_message& message) {
+        if(message.Button == 1) {
+            auto& ctx = client.GetOrCreateUserData<dynamic_page_ctx>();
+            ctx.counter++;
+            client.SendPacket(web_message::ToPacket(counter_message { ctx.counter }));
+        }
+    });
+
+    server.AddPortWebSocketHandler({"/Dynamic"}, [&](client_ctx& client, web_packet_view& packet) {
+        if(packet.OpCode == web_socket_opcode::BinaryFrame)
+            return dynamic_messages.Dispatch(client, packet);
         auto code = packet.GetPayloadAsString();
         if(code == "button_1_clicked") {
             auto& ctx = client.GetOrCreateUserData<dynamic_page_ctx>();
@@ -155,13 +357,20 @@ int main()
         return websocket_callback_status::processed;
     });
 
+    // /proc is read on the sampler's thread, the timer below only picks up the latest snapshot
+    sys_info::sampler::Global().Start(500ms);
+
+    // dashboards get the full stats once, then only what changed
+    delta_publisher stats_publisher(server, {"/Stats", "/Dynamic"});
     cpp::StopWatch::CreateEventCallback(500ms, [&]() {
-        string json = sys_info::GetAsJSON();
-        web_packet packet;
-        packet.OpCode = web_socket_opcode::TextFrame;
-        packet.SetPayloadFromString(json);
-        server.SendAll(packet, "/Stats");
-        server.SendAll(packet, "/Dynamic");
+        stats_publisher.Update(sys_info::GetFields());
+        return cpp::StopWatchEvent::Continue;
+    });
+
+    cpp::StopWatch::CreateEventCallback(250ms, [&]() {
+        if (auto appended = history_log.PollAppended()) {
+            server.Publish("/LogStream", web_packet::TextPacket(*appended));
+        }
         return cpp::StopWatchEvent::Continue;
     });
 
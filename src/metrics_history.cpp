@@ -0,0 +1,81 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "metrics_history.h"
+#include <algorithm>
+using namespace std;
+
+metrics_history::metrics_history(vector<std::string> names) : m_names(std::move(names)) {
+    for(const auto& config : Tiers) {
+        tier item;
+        item.Resolution = config.Resolution;
+        item.Capacity = config.Capacity;
+        item.Time.resize(config.Capacity);
+        item.Values.resize(config.Capacity * m_names.size());
+        item.PendingSum.resize(m_names.size());
+        m_tiers.push_back(std::move(item));
+    }
+}
+
+void metrics_history::Record(int64_t unix_seconds, span<const double> values) {
+    if(values.size() != m_names.size())
+        return;
+    lock_guard guard(m_lock);
+    Add(0, unix_seconds, values);
+}
+
+void metrics_history::Add(size_t tier_index, int64_t time, span<const double> values) {
+    auto& current = m_tiers[tier_index];
+    int64_t point_time = time - ((time % current.Resolution) + current.Resolution) % current.Resolution;
+    if(point_time != current.PendingTime && current.PendingSamples > 0) {
+        // the previous point is complete, store it and hand it to the coarser tier
+        vector<double> average(current.PendingSum.size());
+        for(size_t i = 0; i < average.size(); i++) {
+            average[i] = current.PendingSum[i] / current.PendingSamples;
+        }
+        current.Time[current.Next] = current.PendingTime;
+        copy(average.begin(), average.end(), current.Values.begin() + ptrdiff_t(current.Next * m_names.size()));
+        current.Next = (current.Next + 1) % current.Capacity;
+        current.Count = min(current.Count + 1, current.Capacity);
+        int64_t completed_time = current.PendingTime;
+        current.PendingSamples = 0;
+        fill(current.PendingSum.begin(), current.PendingSum.end(), 0.0);
+        if(tier_index + 1 < m_tiers.size())
+            Add(tier_index + 1, completed_time, average);
+    }
+    current.PendingTime = point_time;
+    for(size_t i = 0; i < values.size(); i++) {
+        current.PendingSum[i] += values[i];
+    }
+    current.PendingSamples++;
+}
+
+void metrics_history::QueryJSON(json_writer &out, int64_t range_seconds, int64_t resolution, const string &metric) const {
+    lock_guard guard(m_lock);
+    const tier* selected = &m_tiers.back();
+    for(const auto& item : m_tiers) {
+        if(resolution > 0 ? item.Resolution >= resolution : item.Resolution * int64_t(item.Capacity) >= range_seconds) {
+            selected = &item;
+            break;
+        }
+    }
+    size_t points = min(selected->Count, size_t(max<int64_t>(1, range_seconds / selected->Resolution)));
+    size_t first = (selected->Next + selected->Capacity - points) % selected->Capacity;
+
+    out.BeginObject().Member("resolution", selected->Resolution).Key("time").BeginArray();
+    for(size_t i = 0; i < points; i++) {
+        out.Value(selected->Time[(first + i) % selected->Capacity]);
+    }
+    out.EndArray().Key("metrics").BeginObject();
+    for(size_t m = 0; m < m_names.size(); m++) {
+        if(!metric.empty() && metric != m_names[m])
+            continue;
+        out.Key(m_names[m]).BeginArray();
+        for(size_t i = 0; i < points; i++) {
+            out.Value(selected->Values[((first + i) % selected->Capacity) * m_names.size() + m]);
+        }
+        out.EndArray();
+    }
+    out.EndObject().EndObject();
+}
@@ -0,0 +1,61 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_METRICS_HISTORY_H
+#define WEBCLIENT_METRICS_HISTORY_H
+#include "json_writer.h"
+#include <string>
+#include <vector>
+#include <span>
+#include <mutex>
+#include <cstdint>
+
+/*
+ * Fixed-memory time series of a set of metrics in three tiers: 1 second points for the last hour, 1 minute points
+ * for the last day and 1 hour points for the last 30 days. Samples falling into the same point are averaged and
+ * every completed point feeds the next tier, so nothing is ever recomputed from /proc to answer a query.
+ * Thread-safe.
+ */
+class metrics_history {
+public:
+    struct tier_config {
+        int64_t Resolution; // seconds per point
+        size_t Capacity;    // points kept
+    };
+    static constexpr tier_config Tiers[] = { { 1, 3600 }, { 60, 1440 }, { 3600, 720 } };
+
+    explicit metrics_history(std::vector<std::string> names);
+
+    void Record(int64_t unix_seconds, std::span<const double> values);
+
+    // {"resolution":1,"time":[...],"metrics":{"name":[...]}} covering the last range_seconds. A resolution of 0 picks
+    // the finest tier that covers the range, an empty metric returns all of them. Written straight into the response
+    // body, a day of 1 minute points is too large to build in a temporary string first.
+    void QueryJSON(json_writer& out, int64_t range_seconds, int64_t resolution = 0, const std::string& metric = "") const;
+
+    [[nodiscard]] const std::vector<std::string>& Names() const { return m_names; }
+
+private:
+    struct tier {
+        int64_t Resolution = 1;
+        size_t Capacity = 0;
+        std::vector<int64_t> Time;  // start of each point
+        std::vector<double> Values; // Capacity * metric count, one row per point, byte rates outgrow a float
+        size_t Next = 0;
+        size_t Count = 0;
+        // point being accumulated
+        int64_t PendingTime = INT64_MIN;
+        std::vector<double> PendingSum;
+        uint32_t PendingSamples = 0;
+    };
+
+    void Add(size_t tier_index, int64_t time, std::span<const double> values);
+
+private:
+    std::vector<std::string> m_names;
+    std::vector<tier> m_tiers;
+    mutable std::mutex m_lock;
+};
+
+#endif //WEBCLIENT_METRICS_HISTORY_H
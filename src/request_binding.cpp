@@ -0,0 +1,68 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "request_binding.h"
+#include "json_writer.h"
+#include "CppUtility.hpp"
+#include <algorithm>
+
+using namespace std;
+
+static bool equal_ignore_case(string_view a, string_view b) {
+    return a.size() == b.size() && equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return tolower((unsigned char)x) == tolower((unsigned char)y);
+    });
+}
+
+request_binding::body_kind request_binding::BodyKind(const http_request &request) {
+    if(!request.content || request.content->empty())
+        return body_kind::none;
+    auto field = request.FindField("Content-Type");
+    string_view type = field ? string_view(*field) : string_view();
+    // media type without parameters (; charset=utf-8)
+    type = type.substr(0, type.find(';'));
+    while(!type.empty() && (type.back() == ' ' || type.back() == '\t'))
+        type.remove_suffix(1);
+    if(equal_ignore_case(type, "application/json"))
+        return body_kind::json;
+    if(equal_ignore_case(type, "application/x-www-form-urlencoded"))
+        return body_kind::form;
+    return body_kind::unsupported;
+}
+
+bool request_binding::ParseJSON(const vector<uint8_t> &content, json_parser::json_value &root, string &error) {
+    // reused so its tape and buffers are allocated once per thread
+    thread_local json_parser::json_document document;
+    if(!document.Parse({ (const char*)content.data(), content.size() })) {
+        error = cpp::Format("malformed JSON body at offset {}: {}", document.ErrorOffset(), document.Error());
+        return false;
+    }
+    root = document.Root();
+    return true;
+}
+
+void request_binding::BadRequest(optional<http_response> &response, const string &error) {
+    http_response bad_request;
+    bad_request.code = http_code::http_400_bad_request;
+    bad_request.headers["Content-Type"] = "application/json";
+    json_writer json(bad_request.body.emplace());
+    json.BeginObject().Member("error", error).EndObject();
+    response = std::move(bad_request);
+}
+
+bool request_binding::ParseBool(string_view text, bool &value) {
+    for(auto word : { "true", "1", "on", "yes" }) {
+        if(equal_ignore_case(text, word)) {
+            value = true;
+            return true;
+        }
+    }
+    for(auto word : { "false", "0", "off", "no" }) {
+        if(equal_ignore_case(text, word)) {
+            value = false;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,320 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_REQUEST_BINDING_H
+#define WEBCLIENT_REQUEST_BINDING_H
+#include "web_server.h"
+#include "json_parser.h"
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Binds the query string and the body of an http_request to a struct declared per route, instead of handlers
+ * looking strings up in request.query and converting them by hand:
+ *
+ *     struct history_query {
+ *         int64_t Range = 600;
+ *         std::optional<uint64_t> Tail;
+ *         std::string Metric;
+ *         static constexpr auto Fields = std::make_tuple(request_binding::field("range", &history_query::Range),
+ *                                                        request_binding::field("tail", &history_query::Tail),
+ *                                                        request_binding::required("metric", &history_query::Metric));
+ *         // optional, called once every field is bound
+ *         bool Validate(std::string& error) const;
+ *     };
+ *
+ *     server.AddHttpRouteHandler({"/history"}, request_binding::Handler<history_query>(
+ *         [&](http_request& request, history_query& query, std::optional<http_response>& response) { ... }));
+ *
+ * The query string is bound first, then the body when its Content-Type is application/json or
+ * application/x-www-form-urlencoded, so body members override query parameters of the same name. Values are decoded
+ * from the raw query string and the receive buffer straight into the fields, only percent-escaped names and values
+ * go through a scratch string. Unknown names are ignored; a value that does not convert, a missing required field or
+ * a failed Validate() answers 400 with {"error": "..."} without calling the handler.
+ *
+ * Supported field types: std::string, bool, integers, enums (by their underlying value), floating point,
+ * std::optional<T> (left empty when absent, JSON null empties it) and std::vector<T> (JSON arrays, or repeated
+ * names in forms and query strings).
+ */
+namespace request_binding {
+    template<class Request, class T>
+    struct field_descriptor {
+        const char* Name;
+        T Request::* Member;
+        bool Required;
+    };
+
+    template<class Request, class T>
+    constexpr field_descriptor<Request, T> field(const char* name, T Request::* member) {
+        return { name, member, false };
+    }
+
+    template<class Request, class T>
+    constexpr field_descriptor<Request, T> required(const char* name, T Request::* member) {
+        return { name, member, true };
+    }
+
+    enum class body_kind {
+        none,
+        json,
+        form,
+        unsupported
+    };
+
+    body_kind BodyKind(const http_request& request);
+    // Parses the body into a per-thread document, the value stays valid until the next call on the same thread.
+    bool ParseJSON(const std::vector<uint8_t>& content, json_parser::json_value& root, std::string& error);
+    // Fills response with a 400 and {"error": error}.
+    void BadRequest(std::optional<http_response>& response, const std::string& error);
+    // true/1/on/yes and false/0/off/no, case insensitive.
+    bool ParseBool(std::string_view text, bool& value);
+
+    template<class T> struct is_optional : std::false_type {};
+    template<class T> struct is_optional<std::optional<T>> : std::true_type {};
+    template<class T> struct is_vector : std::false_type {};
+    template<class T, class A> struct is_vector<std::vector<T, A>> : std::true_type {};
+
+    // Value of a query parameter or form field, already percent-decoded.
+    template<class T>
+    bool FromText(std::string_view text, T& value) {
+        if constexpr (std::is_same_v<T, std::string>) {
+            value.assign(text);
+            return true;
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return ParseBool(text, value);
+        } else if constexpr (std::is_enum_v<T>) {
+            std::underlying_type_t<T> raw;
+            if(!FromText(text, raw))
+                return false;
+            value = T(raw);
+            return true;
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+            return result.ec == std::errc() && result.ptr == text.data() + text.size() && !text.empty();
+        } else if constexpr (is_optional<T>::value) {
+            return FromText(text, value.emplace());
+        } else if constexpr (is_vector<T>::value) {
+            // repeated names append
+            return FromText(text, value.emplace_back());
+        } else {
+            static_assert(std::is_same_v<T, std::string>, "unsupported request_binding field type");
+        }
+    }
+
+    template<class T>
+    bool FromJSON(const json_parser::json_value& json, T& value) {
+        using json_parser::json_type;
+        if constexpr (std::is_same_v<T, std::string>) {
+            if(json.Type() != json_type::string)
+                return false;
+            value.assign(json.AsString());
+            return true;
+        } else if constexpr (std::is_same_v<T, bool>) {
+            if(json.Type() != json_type::boolean)
+                return false;
+            value = json.AsBool();
+            return true;
+        } else if constexpr (std::is_enum_v<T>) {
+            std::underlying_type_t<T> raw;
+            if(!FromJSON(json, raw))
+                return false;
+            value = T(raw);
+            return true;
+        } else if constexpr (std::is_floating_point_v<T>) {
+            if(json.Type() != json_type::number)
+                return false;
+            value = T(json.AsNumber());
+            return true;
+        } else if constexpr (std::is_integral_v<T>) {
+            // from the text so large unsigned values and out of range numbers are exact, 1.5 or 1e3 are rejected
+            return json.Type() == json_type::number && FromText(json.Raw(), value);
+        } else if constexpr (is_optional<T>::value) {
+            if(json.IsNull()) {
+                value.reset();
+                return true;
+            }
+            return FromJSON(json, value.emplace());
+        } else if constexpr (is_vector<T>::value) {
+            if(json.Type() != json_type::array)
+                return false;
+            value.clear();
+            value.reserve(json.Size());
+            bool valid = true;
+            json.ForEachElement([&](const json_parser::json_value& element) {
+                valid = valid && FromJSON(element, value.emplace_back());
+            });
+            return valid;
+        } else {
+            static_assert(std::is_same_v<T, std::string>, "unsupported request_binding field type");
+        }
+    }
+
+    // Calls callback(name, value) with the raw (still escaped) parts of every name=value pair of a query string or
+    // form body. A pair without '=' has an empty value, empty pairs are skipped.
+    template<class Callback>
+    void ForEachPair(std::string_view text, Callback&& callback) {
+        while(!text.empty()) {
+            auto end = text.find('&');
+            auto pair = text.substr(0, end);
+            text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+            if(pair.empty())
+                continue;
+            auto equal = pair.find('=');
+            if(equal == 0)
+                continue;
+            if(equal == std::string_view::npos)
+                callback(pair, std::string_view());
+            else
+                callback(pair.substr(0, equal), pair.substr(equal + 1));
+        }
+    }
+
+    template<class Request>
+    class binder {
+        static constexpr size_t FieldCount = std::tuple_size_v<std::decay_t<decltype(Request::Fields)>>;
+
+    public:
+        explicit binder(Request& out) : m_out(out) {}
+
+        bool BindQueryString(std::string_view query_string) { return BindPairs(query_string, "query parameter"); }
+
+        bool BindBody(const http_request& request) {
+            switch(BodyKind(request)) {
+                case body_kind::none:
+                    return true;
+                case body_kind::form:
+                    return BindPairs({ (const char*)request.content->data(), request.content->size() }, "form field");
+                case body_kind::unsupported:
+                    m_error = "unsupported Content-Type, expected application/json or application/x-www-form-urlencoded";
+                    return false;
+                case body_kind::json:
+                    break;
+            }
+            json_parser::json_value root;
+            if(!ParseJSON(*request.content, root, m_error))
+                return false;
+            if(root.Type() != json_parser::json_type::object) {
+                m_error = "JSON body must be an object";
+                return false;
+            }
+            return ForEachField([&](const auto& field, size_t index) {
+                auto value = root[field.Name];
+                if(!value.Exists())
+                    return true;
+                m_seen[index] = true;
+                if(FromJSON(value, m_out.*(field.Member)))
+                    return true;
+                m_error = std::string("invalid value for member '") + field.Name + "'";
+                return false;
+            });
+        }
+
+        bool Finish() {
+            bool valid = ForEachField([&](const auto& field, size_t index) {
+                if(!field.Required || m_seen[index])
+                    return true;
+                m_error = std::string("missing required field '") + field.Name + "'";
+                return false;
+            });
+            if constexpr (requires(const Request& request, std::string& error) { { request.Validate(error) } -> std::convertible_to<bool>; }) {
+                valid = valid && m_out.Validate(m_error);
+            }
+            return valid;
+        }
+
+        [[nodiscard]] const std::string& Error() const { return m_error; }
+
+    private:
+        // callback(descriptor, index) on every field until one returns false
+        template<class Callback>
+        bool ForEachField(Callback&& callback) {
+            return std::apply([&](const auto&... fields) {
+                size_t index = 0;
+                return (callback(fields, index++) && ...);
+            }, Request::Fields);
+        }
+
+        bool BindPairs(std::string_view text, const char* what) {
+            bool valid = true;
+            ForEachPair(text, [&](std::string_view name, std::string_view value) {
+                if(!valid)
+                    return;
+                if(!Decode(name, m_name)) {
+                    valid = Fail("malformed percent-encoding in ", what, name);
+                    return;
+                }
+                ForEachField([&](const auto& field, size_t index) {
+                    if(name != field.Name)
+                        return true;
+                    m_seen[index] = true;
+                    std::string_view decoded = value;
+                    if(!Decode(decoded, m_value))
+                        valid = Fail("malformed percent-encoding in ", what, field.Name);
+                    else if(!FromText(decoded, m_out.*(field.Member)))
+                        valid = Fail("invalid value for ", what, field.Name);
+                    return false;
+                });
+            });
+            return valid;
+        }
+
+        // Points text at its decoded form, only copies into scratch when there is something to decode.
+        static bool Decode(std::string_view& text, std::string& scratch) {
+            if(text.find_first_of("%+") == std::string_view::npos)
+                return true;
+            if(!http_request::DecodeQueryComponent(text, scratch))
+                return false;
+            text = scratch;
+            return true;
+        }
+
+        bool Fail(const char* message, const char* what, std::string_view name) {
+            m_error.assign(message).append(what).append(" '").append(name).append("'");
+            return false;
+        }
+
+    private:
+        Request& m_out;
+        std::array<bool, FieldCount> m_seen {};
+        std::string m_name;
+        std::string m_value;
+        std::string m_error;
+    };
+
+    // Binds the query string and body of request into out, error describes the first problem on failure.
+    template<class Request>
+    bool Bind(const http_request& request, Request& out, std::string& error) {
+        binder<Request> bind(out);
+        bool valid = bind.BindQueryString(request.query_string) && bind.BindBody(request) && bind.Finish();
+        if(!valid)
+            error = bind.Error();
+        return valid;
+    }
+
+    // Wraps a typed handler into a middleware callback for web_server::AddHttpRouteHandler. The struct starts from
+    // its default member values on every request.
+    template<class Request>
+    auto Handler(std::function<middleware_route_status(http_request&, Request&, std::optional<http_response>&)> handler) {
+        return [handler = std::move(handler)](http_request& request, std::optional<http_response>& response) {
+            Request bound {};
+            std::string error;
+            if(!Bind(request, bound, error)) {
+                BadRequest(response, error);
+                return middleware_route_status::dynamic_response;
+            }
+            return handler(request, bound, response);
+        };
+    }
+}
+
+#endif //WEBCLIENT_REQUEST_BINDING_H
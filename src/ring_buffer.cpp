@@ -0,0 +1,92 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "ring_buffer.h"
+#include "buffer_pool.h"
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+ring_buffer::~ring_buffer() {
+    buffer_pool::Global().Return(m_data, m_capacity);
+}
+
+ring_buffer::ring_buffer(const ring_buffer &copy) {
+    *this = copy;
+}
+
+ring_buffer::ring_buffer(ring_buffer &&move) noexcept {
+    *this = std::move(move);
+}
+
+ring_buffer &ring_buffer::operator=(const ring_buffer &copy) {
+    if(this == &copy)
+        return *this;
+    m_read = m_write = 0;
+    Release();
+    if(copy.Empty())
+        return *this;
+    Reallocate(copy.Size());
+    memcpy(m_data, copy.Readable().data(), copy.Size());
+    m_write = copy.Size();
+    return *this;
+}
+
+ring_buffer &ring_buffer::operator=(ring_buffer &&move) noexcept {
+    if(this == &move)
+        return *this;
+    buffer_pool::Global().Return(m_data, m_capacity);
+    m_data = move.m_data;
+    m_capacity = move.m_capacity;
+    m_read = move.m_read;
+    m_write = move.m_write;
+    move.m_data = nullptr;
+    move.m_capacity = move.m_read = move.m_write = 0;
+    return *this;
+}
+
+span<uint8_t> ring_buffer::Writable(size_t min_size) {
+    if(m_capacity - m_write < min_size) {
+        if(m_capacity - Size() >= min_size && m_read > 0) {
+            // enough room once the consumed bytes at the front are reclaimed
+            memmove(m_data, m_data + m_read, Size());
+            m_write -= m_read;
+            m_read = 0;
+        } else {
+            Reallocate(max(m_capacity * 2, Size() + min_size));
+        }
+    }
+    return { m_data + m_write, m_capacity - m_write };
+}
+
+void ring_buffer::Consume(size_t size) {
+    m_read += min(size, Size());
+    if(m_read == m_write)
+        Release();
+}
+
+void ring_buffer::Release() {
+    if(!Empty())
+        return;
+    buffer_pool::Global().Return(m_data, m_capacity);
+    m_data = nullptr;
+    m_capacity = m_read = m_write = 0;
+}
+
+void ring_buffer::Reserve(size_t size) {
+    if(size > Size())
+        Writable(size - Size());
+}
+
+void ring_buffer::Reallocate(size_t capacity) {
+    capacity = buffer_pool::Capacity(capacity);
+    auto* data = buffer_pool::Global().Borrow(capacity);
+    if(!Empty())
+        memcpy(data, m_data + m_read, Size());
+    buffer_pool::Global().Return(m_data, m_capacity);
+    m_write -= m_read;
+    m_read = 0;
+    m_data = data;
+    m_capacity = capacity;
+}
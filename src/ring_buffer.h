@@ -0,0 +1,53 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_RING_BUFFER_H
+#define WEBCLIENT_RING_BUFFER_H
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Per-connection receive buffer. Socket reads are written straight into the free space after the unread bytes and
+ * parsers read the unread bytes in place. Instead of wrapping around (which would split a frame in two), the unread
+ * tail is slid back to the front when the end is reached, so everything unread is always one contiguous span.
+ * Storage is borrowed from buffer_pool::Global() once the socket is readable, left uninitialized, only grows when a
+ * single message needs more room and goes back to the pool as soon as everything was consumed, so idle connections
+ * hold none.
+ */
+class ring_buffer {
+public:
+    ring_buffer() = default;
+    ~ring_buffer();
+    ring_buffer(const ring_buffer& copy);
+    ring_buffer(ring_buffer&& move) noexcept;
+    ring_buffer& operator=(const ring_buffer& copy);
+    ring_buffer& operator=(ring_buffer&& move) noexcept;
+
+    [[nodiscard]] std::span<uint8_t> Readable() const { return { m_data + m_read, m_write - m_read }; }
+    // Returns at least min_size bytes of free space following the unread bytes, compacting or growing if needed.
+    std::span<uint8_t> Writable(size_t min_size);
+    void Commit(size_t size) { m_write += size; }
+    // Returns the storage to the pool once everything is consumed.
+    void Consume(size_t size);
+    // Returns the storage to the pool if nothing is left to read (e.g. Writable was called but nothing received).
+    void Release();
+    // Makes room for size unread bytes in total, so the rest of a partially received frame lands contiguously.
+    void Reserve(size_t size);
+
+    [[nodiscard]] size_t Size() const { return m_write - m_read; }
+    [[nodiscard]] bool Empty() const { return m_write == m_read; }
+    [[nodiscard]] size_t Capacity() const { return m_capacity; }
+
+private:
+    void Reallocate(size_t capacity);
+
+private:
+    uint8_t* m_data = nullptr;
+    size_t m_capacity = 0;
+    size_t m_read = 0;
+    size_t m_write = 0;
+};
+
+#endif //WEBCLIENT_RING_BUFFER_H
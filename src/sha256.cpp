@@ -0,0 +1,228 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "sha256.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SHA256_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SHA256_TARGET(x)
+#else
+#include <cpuid.h>
+#define SHA256_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+using namespace std;
+
+alignas(16) static const uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+using transform_kernel = void (*)(uint32_t state[8], const uint8_t* data, size_t blocks);
+
+static inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void transform_scalar(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    for(; blocks > 0; blocks--, data += 64) {
+        uint32_t w[64];
+        for(int i = 0; i < 16; i++) {
+            w[i] = uint32_t(data[i * 4]) << 24 | uint32_t(data[i * 4 + 1]) << 16 | uint32_t(data[i * 4 + 2]) << 8 | data[i * 4 + 3];
+        }
+        for(int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for(int i = 0; i < 64; i++) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+#ifdef SHA256_X86
+// Four rounds per step, sha256rnds2 does two. The message schedule of the next steps is computed alongside:
+// msg2 completes the words of step + 1 from step, msg1 starts those of step + 3.
+SHA256_TARGET("sha,sse4.1")
+static void transform_shani(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+    // the instructions want the state as ABEF and CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for(; blocks > 0; blocks--, data += 64) {
+        const __m128i abef = state0, cdgh = state1;
+        __m128i msg[4];
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 16
+#endif
+        for(int step = 0; step < 16; step++) {
+            __m128i& current = msg[step & 3];
+            if(step < 4)
+                current = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + step * 16)), byte_swap);
+            __m128i words = _mm_add_epi32(current, _mm_load_si128(reinterpret_cast<const __m128i*>(K + step * 4)));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, words);
+            if(step >= 3 && step <= 14) {
+                __m128i& next = msg[(step + 1) & 3];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(current, msg[(step + 3) & 3], 4));
+                next = _mm_sha256msg2_epu32(next, current);
+            }
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(words, 0x0E));
+            if(step >= 1 && step <= 12) {
+                __m128i& previous = msg[(step + 3) & 3];
+                previous = _mm_sha256msg1_epu32(previous, current);
+            }
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+
+static bool cpu_supports_sha() {
+    // SHA (leaf 7 EBX bit 29), SSSE3 and SSE4.1 (leaf 1 ECX bits 9 and 19)
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, 0, 0);
+    if(info[0] < 7)
+        return false;
+    __cpuidex(info, 1, 0);
+    if(!(info[2] & (1 << 9)) || !(info[2] & (1 << 19)))
+        return false;
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 29);
+#else
+    unsigned eax, ebx, ecx, edx;
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & (1 << 9)) || !(ecx & (1 << 19)))
+        return false;
+    if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return false;
+    return ebx & (1 << 29);
+#endif
+}
+#endif
+
+struct sha256_dispatch {
+    transform_kernel Kernel = transform_scalar;
+    const char* Name = "scalar";
+
+    sha256_dispatch() {
+#ifdef SHA256_X86
+        if(cpu_supports_sha()) {
+            Kernel = transform_shani;
+            Name = "sha-ni";
+        }
+#endif
+    }
+};
+
+static const sha256_dispatch& dispatch() {
+    static const sha256_dispatch instance;
+    return instance;
+}
+
+sha256::hasher::hasher() {
+    Reset();
+}
+
+void sha256::hasher::Reset() {
+    static const uint32_t initial[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(m_state, initial, sizeof(m_state));
+    m_buffered = 0;
+    m_length = 0;
+}
+
+void sha256::hasher::Update(span<const uint8_t> data) {
+    if(data.empty())
+        return;
+    auto kernel = dispatch().Kernel;
+    m_length += data.size();
+    if(m_buffered > 0) {
+        size_t length = min(data.size(), sizeof(m_block) - m_buffered);
+        memcpy(m_block + m_buffered, data.data(), length);
+        m_buffered += length;
+        data = data.subspan(length);
+        if(m_buffered < sizeof(m_block))
+            return;
+        kernel(m_state, m_block, 1);
+        m_buffered = 0;
+    }
+    // whole blocks straight from the input
+    size_t blocks = data.size() / 64;
+    if(blocks > 0) {
+        kernel(m_state, data.data(), blocks);
+        data = data.subspan(blocks * 64);
+    }
+    memcpy(m_block, data.data(), data.size());
+    m_buffered = data.size();
+}
+
+sha256::digest sha256::hasher::Final() {
+    uint64_t bits = m_length * 8;
+    uint8_t padding[72] = { 0x80 };
+    // pad to 56 mod 64, then the big endian bit length
+    size_t length = (m_buffered < 56 ? 56 : 120) - m_buffered;
+    for(int i = 0; i < 8; i++) {
+        padding[length + i] = uint8_t(bits >> (56 - 8 * i));
+    }
+    Update({ padding, length + 8 });
+
+    digest out;
+    for(int i = 0; i < 8; i++) {
+        out[i * 4] = uint8_t(m_state[i] >> 24);
+        out[i * 4 + 1] = uint8_t(m_state[i] >> 16);
+        out[i * 4 + 2] = uint8_t(m_state[i] >> 8);
+        out[i * 4 + 3] = uint8_t(m_state[i]);
+    }
+    return out;
+}
+
+sha256::digest sha256::Hash(span<const uint8_t> data) {
+    hasher hash;
+    hash.Update(data);
+    return hash.Final();
+}
+
+string sha256::ToHex(const digest &value) {
+    static constexpr char hex[] = "0123456789abcdef";
+    string text(value.size() * 2, '0');
+    for(size_t i = 0; i < value.size(); i++) {
+        text[i * 2] = hex[value[i] >> 4];
+        text[i * 2 + 1] = hex[value[i] & 15];
+    }
+    return text;
+}
+
+const char *sha256::KernelName() {
+    return dispatch().Name;
+}
@@ -0,0 +1,42 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_SHA256_H
+#define WEBCLIENT_SHA256_H
+#include <array>
+#include <span>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace sha256 {
+    using digest = std::array<uint8_t, 32>;
+
+    /*
+     * Incremental SHA-256. The compression function uses the SHA extensions (SHA-NI) when the CPU has them, several
+     * times faster than the portable version; the kernel is picked once at startup.
+     */
+    class hasher {
+    public:
+        hasher();
+        void Update(std::span<const uint8_t> data);
+        // The hasher must be reset before it is reused.
+        digest Final();
+        void Reset();
+
+    private:
+        uint32_t m_state[8];
+        uint8_t m_block[64];
+        size_t m_buffered = 0;
+        uint64_t m_length = 0;
+    };
+
+    digest Hash(std::span<const uint8_t> data);
+    std::string ToHex(const digest& value);
+
+    // Name of the kernel selected at runtime, for logging.
+    const char* KernelName();
+}
+
+#endif //WEBCLIENT_SHA256_H
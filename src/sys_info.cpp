@@ -3,16 +3,23 @@
 //
 
 #include "sys_info.h"
+#include "json_writer.h"
 
 using namespace std;
 
 #ifdef _WIN32
+#include <winsock2.h>
 #include <windows.h>
 #include <pdh.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#include <iphlpapi.h>
 #include <iostream>
 #include <sstream>
 
 #pragma comment(lib, "pdh.lib")
+#pragma comment(lib, "psapi.lib")
+#pragma comment(lib, "iphlpapi.lib")
 
 double sys_info::GetCPUUsage(long wait_for_reading_ms) {
     PDH_HQUERY cpuQuery;
@@ -59,6 +66,17 @@ double sys_info::GetCPUUsage(long wait_for_reading_ms) {
     return counterVal.doubleValue;
 }
 
+bool sys_info::ReadCPUTimes(std::vector<cpu_times>& times) {
+    FILETIME idle, kernel, user;
+    if (!GetSystemTimes(&idle, &kernel, &user))
+        return false;
+    auto to_u64 = [](const FILETIME& time) { return (uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+    // kernel time includes idle time
+    uint64_t total = to_u64(kernel) + to_u64(user);
+    times.assign(1, { total - to_u64(idle), total });
+    return true;
+}
+
 sys_info::sys_mem_info sys_info::GetMemoryUsage() {
         MEMORYSTATUSEX memInfo;
         memInfo.dwLength = sizeof(MEMORYSTATUSEX);
@@ -78,7 +96,8 @@ sys_info::sys_mem_info sys_info::GetMemoryUsage() {
 
             return {
                 totalPhysMem,
-                physMemUsed
+                physMemUsed,
+                double(memInfo.ullAvailPhys)
             };
 
         } else {
@@ -86,47 +105,123 @@ sys_info::sys_mem_info sys_info::GetMemoryUsage() {
         }
         return {};
 }
+
+sys_info::process_info sys_info::GetProcessInfo() {
+    process_info info;
+    HANDLE process = GetCurrentProcess();
+    PROCESS_MEMORY_COUNTERS memory;
+    if (GetProcessMemoryInfo(process, &memory, sizeof(memory)))
+        info.ResidentMemory = double(memory.WorkingSetSize) / (1024 * 1024);
+    // every kernel object (files, sockets, events, ...), the closest there is to the open descriptors on Linux
+    DWORD handles = 0;
+    if (GetProcessHandleCount(process, &handles))
+        info.OpenFiles = handles;
+
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot != INVALID_HANDLE_VALUE) {
+        PROCESSENTRY32 entry;
+        entry.dwSize = sizeof(entry);
+        DWORD id = GetCurrentProcessId();
+        for (BOOL found = Process32First(snapshot, &entry); found; found = Process32Next(snapshot, &entry)) {
+            if (entry.th32ProcessID == id) {
+                info.Threads = entry.cntThreads;
+                break;
+            }
+        }
+        CloseHandle(snapshot);
+    }
+    return info;
+}
+
+bool sys_info::ReadIOCounters(io_counters& counters) {
+    counters = {};
+    PMIB_IF_TABLE2 table = nullptr;
+    if (GetIfTable2(&table) != NO_ERROR)
+        return false;
+    for (ULONG i = 0; i < table->NumEntries; i++) {
+        const auto& row = table->Table[i];
+        // filter drivers show the same traffic again as interfaces of their own
+        if (row.Type == IF_TYPE_SOFTWARE_LOOPBACK || row.InterfaceAndOperStatusFlags.FilterInterface)
+            continue;
+        counters.NetRxBytes += row.InOctets;
+        counters.NetTxBytes += row.OutOctets;
+        counters.NetRxPackets += row.InUcastPkts + row.InNUcastPkts;
+        counters.NetTxPackets += row.OutUcastPkts + row.OutNUcastPkts;
+    }
+    FreeMibTable(table);
+
+    // Windows has no cheap system-wide disk totals, the bytes this process read and wrote stand in for them
+    IO_COUNTERS io;
+    if (GetProcessIoCounters(GetCurrentProcess(), &io)) {
+        counters.DiskReadBytes = io.ReadTransferCount;
+        counters.DiskWriteBytes = io.WriteTransferCount;
+    }
+    return true;
+}
 #else
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <unistd.h>
 #include <sys/sysinfo.h>
+#include <filesystem>
+#include <unordered_map>
 
 
-double sys_info::GetCPUUsage(long wait_for_reading_sec) {
-    double prevIdleTime = 0, prevTotalTime = 0;
-    usleep(wait_for_reading_sec * 1000000); // Sleep for wait_for_reading_sec seconds
-
+bool sys_info::ReadCPUTimes(std::vector<cpu_times>& times) {
     std::ifstream statFile("/proc/stat");
     if (!statFile.is_open()) {
         std::cerr << "Failed to open /proc/stat" << std::endl;
-        return -1.0;
+        return false;
     }
 
+    times.clear();
     std::string line;
-    std::getline(statFile, line);
-    std::istringstream iss(line);
-
-    std::string cpuLabel;
-    long user, nice, system, idle, iowait, irq, softirq, steal, guest, guest_nice;
-    iss >> cpuLabel >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal >> guest >> guest_nice;
-
-    long idleTime = idle + iowait;
-    long totalTime = user + nice + system + idle + iowait + irq + softirq + steal;
-
-    double idleTimeDelta = idleTime - prevIdleTime;
-    double totalTimeDelta = totalTime - prevTotalTime;
-
-    double cpuUsage = ((totalTimeDelta - idleTimeDelta) / totalTimeDelta) * 100.0;
+    // "cpu" (aggregate) comes first, followed by "cpu0", "cpu1", ...
+    while (std::getline(statFile, line) && line.starts_with("cpu")) {
+        std::istringstream iss(line);
+        std::string cpuLabel;
+        uint64_t user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+        iss >> cpuLabel >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal;
+        // guest time is already part of user/nice
+        uint64_t idleTime = idle + iowait;
+        uint64_t totalTime = user + nice + system + idle + iowait + irq + softirq + steal;
+        times.push_back({ totalTime - idleTime, totalTime });
+    }
+    return !times.empty();
+}
 
-    prevIdleTime = idleTime;
-    prevTotalTime = totalTime;
+double sys_info::GetCPUUsage(long wait_for_reading_ms) {
+    std::vector<cpu_times> before, after;
+    if (!ReadCPUTimes(before))
+        return -1.0;
+    usleep(useconds_t(wait_for_reading_ms) * 1000);
+    if (!ReadCPUTimes(after))
+        return -1.0;
 
-    return cpuUsage;
+    double busyDelta = double(after[0].Busy - before[0].Busy);
+    double totalDelta = double(after[0].Total - before[0].Total);
+    return totalDelta > 0 ? busyDelta / totalDelta * 100.0 : 0.0;
 }
 
 sys_info::sys_mem_info sys_info::GetMemoryUsage() {
+    // MemAvailable accounts for reclaimable page cache, totalram - freeram would count the cache as used
+    std::ifstream memFile("/proc/meminfo");
+    std::unordered_map<std::string, double> values;
+    std::string name;
+    double value;
+    std::string unit;
+    while (memFile >> name >> value) {
+        values[name] = value;
+        std::getline(memFile, unit);
+    }
+    if (values.contains("MemTotal:") && values.contains("MemAvailable:")) {
+        // kB to megabytes
+        double totalPhysMem = values["MemTotal:"] / 1024;
+        double available = values["MemAvailable:"] / 1024;
+        return {totalPhysMem, totalPhysMem - available, available};
+    }
+
     struct sysinfo memInfo;
     sysinfo(&memInfo);
 
@@ -137,22 +232,220 @@ sys_info::sys_mem_info sys_info::GetMemoryUsage() {
     totalPhysMem /= (1024 * 1024);
     physMemUsed /= (1024 * 1024);
 
-    return {totalPhysMem, physMemUsed};
+    return {totalPhysMem, physMemUsed, totalPhysMem - physMemUsed};
+}
+
+sys_info::process_info sys_info::GetProcessInfo() {
+    process_info info;
+    std::ifstream statusFile("/proc/self/status");
+    std::string line;
+    while (std::getline(statusFile, line)) {
+        if (line.starts_with("VmRSS:"))
+            info.ResidentMemory = std::stod(line.substr(6)) / 1024;
+        else if (line.starts_with("Threads:"))
+            info.Threads = std::stoull(line.substr(8));
+    }
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator("/proc/self/fd", ec); !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        info.OpenFiles++;
+    }
+    return info;
+}
+
+bool sys_info::ReadIOCounters(io_counters& counters) {
+    counters = {};
+    std::ifstream netFile("/proc/net/dev");
+    if (!netFile.is_open())
+        return false;
+    std::string line;
+    // two header lines, then "iface: rx_bytes rx_packets errs drop fifo frame compressed multicast tx_bytes tx_packets ..."
+    std::getline(netFile, line);
+    std::getline(netFile, line);
+    while (std::getline(netFile, line)) {
+        auto colon = line.find(':');
+        if (colon == std::string::npos)
+            continue;
+        std::istringstream iss(line.substr(colon + 1));
+        auto name = line.substr(0, colon);
+        name.erase(0, name.find_first_not_of(' '));
+        uint64_t rxBytes = 0, rxPackets = 0, skip = 0, txBytes = 0, txPackets = 0;
+        iss >> rxBytes >> rxPackets >> skip >> skip >> skip >> skip >> skip >> skip >> txBytes >> txPackets;
+        if (name == "lo")
+            continue;
+        counters.NetRxBytes += rxBytes;
+        counters.NetRxPackets += rxPackets;
+        counters.NetTxBytes += txBytes;
+        counters.NetTxPackets += txPackets;
+    }
+
+    // "major minor name reads merged sectors_read ms writes merged sectors_written ...", sectors are 512 bytes
+    std::ifstream diskFile("/proc/diskstats");
+    while (std::getline(diskFile, line)) {
+        std::istringstream iss(line);
+        std::string name;
+        uint64_t major = 0, minor = 0, reads = 0, merged = 0, sectorsRead = 0, ms = 0, writes = 0, sectorsWritten = 0;
+        iss >> major >> minor >> name >> reads >> merged >> sectorsRead >> ms >> writes >> merged >> sectorsWritten;
+        // partitions would count the same I/O twice, only whole disks have a /sys/block entry
+        if (name.starts_with("loop") || name.starts_with("ram") || access(("/sys/block/" + name).c_str(), F_OK) != 0)
+            continue;
+        counters.DiskReadBytes += sectorsRead * 512;
+        counters.DiskWriteBytes += sectorsWritten * 512;
+    }
+    return true;
 }
 
 #endif
 
-std::string sys_info::GetAsJSON(long wait_for_reading_ms) {
-    stringstream str;
+sys_info::sampler &sys_info::sampler::Global() {
+    static sampler instance;
+    return instance;
+}
+
+const std::vector<std::string>& sys_info::HistoryMetricNames() {
+    static const std::vector<std::string> names = {
+        "cpu_usage", "memory_used", "memory_available", "process_rss", "process_open_files", "process_threads",
+        "net_rx_bytes_per_sec", "net_tx_bytes_per_sec", "net_rx_packets_per_sec", "net_tx_packets_per_sec",
+        "disk_read_bytes_per_sec", "disk_write_bytes_per_sec"
+    };
+    return names;
+}
+
+sys_info::sampler::sampler() : m_history(HistoryMetricNames()) {}
+
+sys_info::sampler::~sampler() {
+    Stop();
+}
 
-    double cpu = GetCPUUsage(wait_for_reading_ms);
-    sys_mem_info memInfo = GetMemoryUsage();
+void sys_info::sampler::Start(chrono::milliseconds interval) {
+    Stop();
+    m_interval = interval;
+    {
+        lock_guard guard(m_lock);
+        m_running = true;
+    }
+    // counters since boot are no usage: read a baseline and measure the first snapshot over a short window, so the
+    // first one readers see is already a real one
+    m_previous.clear();
+    ReadCPUTimes(m_previous);
+    m_previous_time = chrono::steady_clock::now();
+    if (!ReadIOCounters(m_previous_io))
+        m_previous_time = {};
+    this_thread::sleep_for(min(m_interval, chrono::milliseconds(100)));
+    Sample();
+    m_thread = thread([this] {
+        unique_lock lock(m_lock);
+        while (m_running) {
+            if (m_wake.wait_for(lock, m_interval, [this] { return !m_running; }))
+                break;
+            lock.unlock();
+            Sample();
+            lock.lock();
+        }
+    });
+}
 
-    str << "{\n";
-    str << "\t\"cpu_usage\": " << cpu << ",\n";
-    str << "\t\"total_physical_memory\": " << memInfo.TotalPhysicalMemory << ",\n";
-    str << "\t\"total_used_memory\": " << memInfo.TotalUsedMemory << "\n";
-    str << '}';
+void sys_info::sampler::Stop() {
+    {
+        lock_guard guard(m_lock);
+        m_running = false;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+}
 
-    return str.str();
-}
\ No newline at end of file
+bool sys_info::sampler::Running() const {
+    lock_guard guard(m_lock);
+    return m_running;
+}
+
+void sys_info::sampler::Sample() {
+    vector<cpu_times> current;
+    auto snapshot = make_shared<sys_snapshot>();
+    snapshot->Time = chrono::system_clock::now();
+    snapshot->Memory = GetMemoryUsage();
+    if (ReadCPUTimes(current)) {
+        auto usage = [&](size_t i) {
+            cpu_times previous = i < m_previous.size() ? m_previous[i] : cpu_times {};
+            double totalDelta = double(current[i].Total - previous.Total);
+            return totalDelta > 0 ? double(current[i].Busy - previous.Busy) / totalDelta * 100.0 : 0.0;
+        };
+        snapshot->CPUUsage = usage(0);
+        for (size_t i = 1; i < current.size(); i++) {
+            snapshot->CoreUsage.push_back(usage(i));
+        }
+        m_previous = std::move(current);
+    }
+    snapshot->Process = GetProcessInfo();
+
+    auto now = chrono::steady_clock::now();
+    if (ReadIOCounters(snapshot->IO) && m_previous_time != chrono::steady_clock::time_point {}) {
+        double seconds = chrono::duration<double>(now - m_previous_time).count();
+        auto rate = [&](uint64_t current, uint64_t previous) {
+            return seconds > 0 && current >= previous ? double(current - previous) / seconds : 0.0;
+        };
+        const auto& io = snapshot->IO;
+        snapshot->IORates = {
+            rate(io.NetRxBytes, m_previous_io.NetRxBytes), rate(io.NetTxBytes, m_previous_io.NetTxBytes),
+            rate(io.NetRxPackets, m_previous_io.NetRxPackets), rate(io.NetTxPackets, m_previous_io.NetTxPackets),
+            rate(io.DiskReadBytes, m_previous_io.DiskReadBytes), rate(io.DiskWriteBytes, m_previous_io.DiskWriteBytes)
+        };
+    }
+    m_previous_io = snapshot->IO;
+    m_previous_time = now;
+
+    const auto& rates = snapshot->IORates;
+    double history[] = {
+        snapshot->CPUUsage, snapshot->Memory.TotalUsedMemory, snapshot->Memory.AvailableMemory,
+        snapshot->Process.ResidentMemory, double(snapshot->Process.OpenFiles), double(snapshot->Process.Threads),
+        rates.NetRxBytes, rates.NetTxBytes, rates.NetRxPackets, rates.NetTxPackets, rates.DiskReadBytes, rates.DiskWriteBytes
+    };
+    m_history.Record(chrono::duration_cast<chrono::seconds>(snapshot->Time.time_since_epoch()).count(), history);
+    snapshot->Sequence = ++m_sequence;
+    m_snapshot.store(std::move(snapshot), memory_order_release);
+}
+
+std::shared_ptr<const sys_info::sys_snapshot> sys_info::GetSnapshot() {
+    static once_flag started;
+    call_once(started, [] {
+        if (!sampler::Global().Running())
+            sampler::Global().Start();
+    });
+    return sampler::Global().Snapshot();
+}
+
+std::vector<std::pair<std::string, double>> sys_info::GetFields() {
+    auto snapshot = GetSnapshot();
+
+    std::vector<std::pair<std::string, double>> fields = {
+        {"cpu_usage", snapshot->CPUUsage},
+        {"total_physical_memory", snapshot->Memory.TotalPhysicalMemory},
+        {"total_used_memory", snapshot->Memory.TotalUsedMemory},
+        {"available_memory", snapshot->Memory.AvailableMemory},
+        {"process_rss", snapshot->Process.ResidentMemory},
+        {"process_open_files", double(snapshot->Process.OpenFiles)},
+        {"process_threads", double(snapshot->Process.Threads)},
+        {"net_rx_bytes_per_sec", snapshot->IORates.NetRxBytes},
+        {"net_tx_bytes_per_sec", snapshot->IORates.NetTxBytes},
+        {"disk_read_bytes_per_sec", snapshot->IORates.DiskReadBytes},
+        {"disk_write_bytes_per_sec", snapshot->IORates.DiskWriteBytes}
+    };
+    for (size_t i = 0; i < snapshot->CoreUsage.size(); i++) {
+        fields.emplace_back("cpu_core_" + to_string(i), snapshot->CoreUsage[i]);
+    }
+    return fields;
+}
+
+std::string sys_info::GetAsJSON() {
+    auto fields = GetFields();
+
+    string json;
+    json.reserve(fields.size() * 40);
+    json_string_writer writer(json);
+    writer.BeginObject();
+    for(const auto& [name, value] : fields) {
+        writer.Member(name, value);
+    }
+    writer.EndObject();
+    return json;
+}
@@ -5,16 +5,119 @@
 #ifndef WEBCLIENT_SYS_INFO_H
 #define WEBCLIENT_SYS_INFO_H
 #include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "metrics_history.h"
 
 namespace sys_info {
     struct sys_mem_info {
         double TotalPhysicalMemory;
         double TotalUsedMemory;
+        // Memory that can be handed to applications without swapping, page cache included.
+        double AvailableMemory = 0;
     };
 
+    struct process_info {
+        double ResidentMemory = 0; // MB
+        uint64_t OpenFiles = 0;
+        uint64_t Threads = 0;
+    };
+
+    // Totals since boot, summed over all interfaces (except loopback) and whole disks. On Windows the disk bytes are
+    // the ones this process read and wrote.
+    struct io_counters {
+        uint64_t NetRxBytes = 0;
+        uint64_t NetTxBytes = 0;
+        uint64_t NetRxPackets = 0;
+        uint64_t NetTxPackets = 0;
+        uint64_t DiskReadBytes = 0;
+        uint64_t DiskWriteBytes = 0;
+    };
+
+    // io_counters deltas divided by the sample interval.
+    struct io_rates {
+        double NetRxBytes = 0;
+        double NetTxBytes = 0;
+        double NetRxPackets = 0;
+        double NetTxPackets = 0;
+        double DiskReadBytes = 0;
+        double DiskWriteBytes = 0;
+    };
+
+    // Busy and total CPU time since boot, in the platform's units.
+    struct cpu_times {
+        uint64_t Busy = 0;
+        uint64_t Total = 0;
+    };
+
+    // One immutable sample, published by the sampler and shared by every reader.
+    struct sys_snapshot {
+        uint64_t Sequence = 0;
+        std::chrono::system_clock::time_point Time;
+        double CPUUsage = 0;            // percent, all cores
+        std::vector<double> CoreUsage;  // percent per core, empty where unsupported
+        sys_mem_info Memory {};
+        process_info Process;
+        io_counters IO;
+        io_rates IORates;
+    };
+
+    /*
+     * Samples the system on its own thread and keeps the previous CPU counters, so usage is measured over the last
+     * interval instead of since boot. Readers get the latest snapshot with a single atomic load and never wait for
+     * /proc reads.
+     */
+    class sampler {
+    public:
+        static sampler& Global();
+
+        sampler();
+        ~sampler();
+
+        void Start(std::chrono::milliseconds interval = std::chrono::milliseconds(500));
+        void Stop();
+        [[nodiscard]] bool Running() const;
+        [[nodiscard]] std::shared_ptr<const sys_snapshot> Snapshot() const { return m_snapshot.load(std::memory_order_acquire); }
+        // Every sample is also recorded here, see HistoryMetricNames for the metrics.
+        [[nodiscard]] const metrics_history& History() const { return m_history; }
+
+    private:
+        void Sample();
+
+    private:
+        std::atomic<std::shared_ptr<const sys_snapshot>> m_snapshot { std::make_shared<const sys_snapshot>() };
+        std::vector<cpu_times> m_previous;
+        io_counters m_previous_io;
+        std::chrono::steady_clock::time_point m_previous_time; // of m_previous_io, unset without a baseline
+        uint64_t m_sequence = 0;
+        metrics_history m_history;
+
+        mutable std::mutex m_lock;
+        std::condition_variable m_wake;
+        std::thread m_thread;
+        bool m_running = false;
+        std::chrono::milliseconds m_interval {};
+    };
+
+    // Aggregate at index 0, then one entry per core.
+    bool ReadCPUTimes(std::vector<cpu_times>& times);
+    // Blocks for wait_for_reading_ms and returns the usage over that window.
     double GetCPUUsage(long wait_for_reading_ms = 1000);
     sys_mem_info GetMemoryUsage();
-    std::string GetAsJSON(long wait_for_reading_ms = 1000);
+    process_info GetProcessInfo();
+    bool ReadIOCounters(io_counters& counters);
+    const std::vector<std::string>& HistoryMetricNames();
+    // Latest sample of the global sampler, which is started on first use.
+    std::shared_ptr<const sys_snapshot> GetSnapshot();
+    std::string GetAsJSON();
+    // Same values as GetAsJSON, as (name, value) pairs in a fixed order.
+    std::vector<std::pair<std::string, double>> GetFields();
 };
 
 
@@ -0,0 +1,70 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "user_data.h"
+#include <mutex>
+#include <vector>
+using namespace std;
+
+// 128 B .. 4 KB in powers of two, anything larger goes straight to operator new
+static constexpr size_t MinClassShift = 7;
+static constexpr size_t ClassCount = 6;
+static constexpr size_t MaxCachedBlocks = 1024;
+
+static mutex pool_lock;
+static struct free_lists {
+    vector<void*> Blocks[ClassCount];
+
+    vector<void*>& operator[](size_t index) { return Blocks[index]; }
+
+    ~free_lists() {
+        for(auto& blocks : Blocks) {
+            for(void* memory : blocks)
+                ::operator delete(memory);
+        }
+    }
+} free_blocks;
+
+static int size_class(size_t size, size_t alignment) {
+    if(alignment > alignof(max_align_t))
+        return -1;
+    for(size_t i = 0; i < ClassCount; i++) {
+        if(size <= (size_t(1) << (MinClassShift + i)))
+            return int(i);
+    }
+    return -1;
+}
+
+void *user_data_pool::Allocate(size_t size, size_t alignment) {
+    int index = size_class(size, alignment);
+    if(index < 0)
+        return ::operator new(size, align_val_t(alignment));
+    {
+        lock_guard guard(pool_lock);
+        auto& blocks = free_blocks[index];
+        if(!blocks.empty()) {
+            void* memory = blocks.back();
+            blocks.pop_back();
+            return memory;
+        }
+    }
+    return ::operator new(size_t(1) << (MinClassShift + index));
+}
+
+void user_data_pool::Release(void *memory, size_t size, size_t alignment) {
+    int index = size_class(size, alignment);
+    if(index < 0) {
+        ::operator delete(memory, align_val_t(alignment));
+        return;
+    }
+    {
+        lock_guard guard(pool_lock);
+        auto& blocks = free_blocks[index];
+        if(blocks.size() < MaxCachedBlocks) {
+            blocks.push_back(memory);
+            return;
+        }
+    }
+    ::operator delete(memory);
+}
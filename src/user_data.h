@@ -0,0 +1,133 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_USER_DATA_H
+#define WEBCLIENT_USER_DATA_H
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Size-class free lists for user data objects that do not fit inline, shared by all connections.
+namespace user_data_pool {
+    void* Allocate(size_t size, size_t alignment);
+    void Release(void* memory, size_t size, size_t alignment);
+}
+
+/*
+ * Holds at most one object of any type. Objects up to InlineSize bytes (and nothrow movable) live inside the
+ * user_data itself, larger ones come from user_data_pool. Each type gets one static table of operations instead of
+ * per-instance std::function members, and the address of that table doubles as the type id, so retrieving the
+ * object as a different type is detected instead of reinterpreting memory.
+ * Movable, not copyable: the object belongs to exactly one owner.
+ */
+class user_data {
+public:
+    static constexpr size_t InlineSize = 64;
+
+    user_data() = default;
+    ~user_data() { Reset(); }
+
+    user_data(const user_data&) = delete;
+    user_data& operator=(const user_data&) = delete;
+
+    user_data(user_data&& move) noexcept { MoveFrom(move); }
+    user_data& operator=(user_data&& move) noexcept {
+        if(this != &move) {
+            Reset();
+            MoveFrom(move);
+        }
+        return *this;
+    }
+
+    // Returns the stored T, default constructing it first if empty. A different type is replaced.
+    template<class T>
+    T& GetOrCreate() {
+        if(auto* object = Get<T>())
+            return *object;
+        Reset();
+        if constexpr (is_inline<T>()) {
+            m_object = new(m_inline) T();
+        } else {
+            void* memory = user_data_pool::Allocate(sizeof(T), alignof(T));
+            try {
+                m_object = new(memory) T();
+            } catch (...) {
+                user_data_pool::Release(memory, sizeof(T), alignof(T));
+                throw;
+            }
+        }
+        m_operations = &operations_for<T>;
+        return *static_cast<T*>(m_object);
+    }
+
+    // nullptr when empty or holding another type.
+    template<class T>
+    T* Get() {
+        return m_operations == &operations_for<T> ? static_cast<T*>(m_object) : nullptr;
+    }
+
+    [[nodiscard]] bool HasValue() const { return m_operations != nullptr; }
+
+    void Reset() {
+        if(!m_operations)
+            return;
+        m_operations->Destroy(m_object);
+        m_operations = nullptr;
+        m_object = nullptr;
+    }
+
+private:
+    struct operations {
+        void (*Destroy)(void* object);
+        // only used for inline objects, pooled ones move by handing over the pointer
+        void (*MoveTo)(void* source, void* destination);
+        bool Inline;
+    };
+
+    template<class T>
+    static constexpr bool is_inline() {
+        return sizeof(T) <= InlineSize && alignof(T) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<T>;
+    }
+
+    template<class T>
+    static void destroy(void* object) {
+        static_cast<T*>(object)->~T();
+        if constexpr (!is_inline<T>())
+            user_data_pool::Release(object, sizeof(T), alignof(T));
+    }
+
+    template<class T>
+    static void move_to(void* source, void* destination) {
+        if constexpr (is_inline<T>()) {
+            new(destination) T(std::move(*static_cast<T*>(source)));
+            static_cast<T*>(source)->~T();
+        }
+    }
+
+    template<class T>
+    static constexpr operations operations_for { &destroy<T>, &move_to<T>, is_inline<T>() };
+
+    void MoveFrom(user_data& move) noexcept {
+        if(!move.m_operations)
+            return;
+        if(move.m_operations->Inline) {
+            move.m_operations->MoveTo(move.m_object, m_inline);
+            m_object = m_inline;
+        } else {
+            m_object = move.m_object;
+        }
+        m_operations = move.m_operations;
+        move.m_operations = nullptr;
+        move.m_object = nullptr;
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char m_inline[InlineSize];
+    void* m_object = nullptr;
+    const operations* m_operations = nullptr;
+};
+
+#endif //WEBCLIENT_USER_DATA_H
@@ -0,0 +1,249 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "web_deflate.h"
+#include "CppUtility.hpp"
+#include <algorithm>
+
+#ifdef WEBCLIENT_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+// zlib memory use, see zconf.h
+static size_t deflate_memory(int window_bits, int memory_level) {
+    return (size_t(1) << (window_bits + 2)) + (size_t(1) << (memory_level + 9)) + 6 * 1024;
+}
+
+static size_t inflate_memory(int window_bits) {
+    return (size_t(1) << window_bits) + 7 * 1024;
+}
+
+static string trim(const string& text) {
+    size_t first = text.find_first_not_of(" \t");
+    if(first == string::npos)
+        return {};
+    size_t last = text.find_last_not_of(" \t");
+    return text.substr(first, last - first + 1);
+}
+
+std::optional<web_deflate_options>
+web_deflate_options::Negotiate(const string &offers, const web_deflate_config &config, string &response) {
+#ifndef WEBCLIENT_HAS_ZLIB
+    (void)offers;
+    (void)config;
+    (void)response;
+    return {};
+#else
+    if(!config.Enabled)
+        return {};
+    for(const auto& offer : cpp::Split(offers, ",")) {
+        auto params = cpp::Split(offer, ";");
+        if(params.empty() || trim(params[0]) != "permessage-deflate")
+            continue;
+
+        web_deflate_options options;
+        options.MinMessageSize = config.MinMessageSize;
+        bool valid = true, client_window_offered = false;
+        int server_window_limit = 15, client_window_limit = 15;
+        for(size_t i = 1; i < params.size() && valid; i++) {
+            auto param = trim(params[i]);
+            auto equal = param.find('=');
+            auto name = trim(param.substr(0, equal));
+            string value = equal == string::npos ? "" : trim(param.substr(equal + 1));
+            if(value.size() >= 2 && value.front() == '"' && value.back() == '"')
+                value = value.substr(1, value.size() - 2);
+            size_t bits = 0;
+            if(name == "server_no_context_takeover") {
+                options.ServerNoContextTakeover = true;
+            } else if(name == "client_no_context_takeover") {
+                options.ClientNoContextTakeover = true;
+            } else if(name == "server_max_window_bits") {
+                // zlib cannot produce raw deflate streams with a 256 byte window
+                valid = cpp::TryToInt64(value, bits) && bits >= 9 && bits <= 15;
+                server_window_limit = int(bits);
+            } else if(name == "client_max_window_bits") {
+                client_window_offered = true;
+                if(!value.empty()) {
+                    valid = cpp::TryToInt64(value, bits) && bits >= 8 && bits <= 15;
+                    client_window_limit = int(bits);
+                }
+            } else {
+                valid = false;
+            }
+        }
+        if(!valid)
+            continue;
+
+        if(!config.AllowContextTakeover)
+            options.ServerNoContextTakeover = true;
+        options.ServerWindowBits = min(server_window_limit, max(9, config.MaxWindowBits));
+        // the client only limits its own window if it said it can
+        options.ClientWindowBits = client_window_offered ? min(client_window_limit, max(8, config.MaxWindowBits)) : 15;
+
+        // shrink the compressor until both streams fit in the per-connection budget
+        auto total = [&] {
+            return deflate_memory(options.ServerWindowBits, options.MemoryLevel) + inflate_memory(options.ClientWindowBits);
+        };
+        while(total() > config.MaxMemoryPerConnection) {
+            if(options.MemoryLevel > options.ServerWindowBits - 7 && options.MemoryLevel > 1)
+                options.MemoryLevel--;
+            else if(options.ServerWindowBits > 9)
+                options.ServerWindowBits--;
+            else if(client_window_offered && options.ClientWindowBits > 8)
+                options.ClientWindowBits--;
+            else if(options.MemoryLevel > 1)
+                options.MemoryLevel--;
+            else
+                break;
+        }
+        if(total() > config.MaxMemoryPerConnection)
+            continue;
+
+        response = "permessage-deflate";
+        if(options.ServerNoContextTakeover)
+            response += "; server_no_context_takeover";
+        if(options.ClientNoContextTakeover)
+            response += "; client_no_context_takeover";
+        if(options.ServerWindowBits < 15)
+            response += "; server_max_window_bits=" + to_string(options.ServerWindowBits);
+        if(client_window_offered)
+            response += "; client_max_window_bits=" + to_string(options.ClientWindowBits);
+        return options;
+    }
+    return {};
+#endif
+}
+
+#ifdef WEBCLIENT_HAS_ZLIB
+struct web_deflate_context::zlib_state {
+    z_stream Deflate {};
+    z_stream Inflate {};
+    bool HasDeflate = false;
+    bool HasInflate = false;
+
+    ~zlib_state() {
+        if(HasDeflate)
+            deflateEnd(&Deflate);
+        if(HasInflate)
+            inflateEnd(&Inflate);
+    }
+};
+
+// Runs deflate with Z_SYNC_FLUSH over the whole payload and strips the 00 00 FF FF tail (RFC 7692 7.2.1).
+static bool deflate_message(z_stream& stream, span<const uint8_t> payload, vector<uint8_t>& out) {
+    out.resize(deflateBound(&stream, uLong(payload.size())) + 16);
+    stream.next_in = const_cast<Bytef*>(payload.data());
+    stream.avail_in = uInt(payload.size());
+    stream.next_out = out.data();
+    stream.avail_out = uInt(out.size());
+    int status = deflate(&stream, Z_SYNC_FLUSH);
+    if(status != Z_OK || stream.avail_in != 0)
+        return false;
+    out.resize(out.size() - stream.avail_out);
+    if(out.size() < 4)
+        return false;
+    out.resize(out.size() - 4);
+    return out.size() < payload.size();
+}
+#else
+struct web_deflate_context::zlib_state {};
+#endif
+
+web_deflate_context::web_deflate_context(const web_deflate_options &options)
+: m_options(options), m_state(make_unique<zlib_state>()) {}
+
+web_deflate_context::~web_deflate_context() = default;
+
+bool web_deflate_context::Compress(span<const uint8_t> payload, vector<uint8_t> &out) {
+#ifdef WEBCLIENT_HAS_ZLIB
+    auto& state = *m_state;
+    if(!state.HasDeflate) {
+        if(deflateInit2(&state.Deflate, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -m_options.ServerWindowBits,
+                        m_options.MemoryLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+            return false;
+        state.HasDeflate = true;
+    } else if(m_reset_compressor || m_options.ServerNoContextTakeover) {
+        deflateReset(&state.Deflate);
+    }
+    m_reset_compressor = false;
+    if(!deflate_message(state.Deflate, payload, out)) {
+        // the peer never sees this output, so our history must not keep it either
+        m_reset_compressor = true;
+        return false;
+    }
+    return true;
+#else
+    (void)payload;
+    (void)out;
+    return false;
+#endif
+}
+
+bool web_deflate_context::Decompress(span<const uint8_t> payload, vector<uint8_t> &out, uint64_t max_size) {
+#ifdef WEBCLIENT_HAS_ZLIB
+    auto& state = *m_state;
+    if(!state.HasInflate) {
+        // the client may use any window up to the negotiated size, 15 if it was not limited
+        if(inflateInit2(&state.Inflate, -m_options.ClientWindowBits) != Z_OK)
+            return false;
+        state.HasInflate = true;
+    } else if(m_options.ClientNoContextTakeover) {
+        inflateReset(&state.Inflate);
+    }
+
+    static const uint8_t tail[4] = { 0x00, 0x00, 0xFF, 0xFF };
+    out.clear();
+    // room for one byte past the limit tells a message that is too large from one that fills it exactly
+    uint64_t limit = min<uint64_t>(max_size, SIZE_MAX - 1) + 1;
+    size_t capacity = min<uint64_t>(max(payload.size() * 4, size_t(1024)), limit);
+    for(int pass = 0; pass < 2; pass++) {
+        auto input = pass == 0 ? payload : span<const uint8_t>(tail, 4);
+        state.Inflate.next_in = const_cast<Bytef*>(input.data());
+        state.Inflate.avail_in = uInt(input.size());
+        do {
+            if(out.size() == capacity)
+                capacity = min<uint64_t>(capacity * 2, limit);
+            size_t used = out.size();
+            out.resize(capacity);
+            state.Inflate.next_out = out.data() + used;
+            state.Inflate.avail_out = uInt(capacity - used);
+            int status = inflate(&state.Inflate, Z_SYNC_FLUSH);
+            out.resize(capacity - state.Inflate.avail_out);
+            if(out.size() > max_size) {
+                LOG(ERR, "WebSocket compressed message inflates past {} bytes.", max_size);
+                return false;
+            }
+            if(status != Z_OK && status != Z_BUF_ERROR && status != Z_STREAM_END)
+                return false;
+            if(status == Z_BUF_ERROR && state.Inflate.avail_in == 0)
+                break;
+        } while(state.Inflate.avail_in > 0 || state.Inflate.avail_out == 0);
+    }
+    return true;
+#else
+    (void)payload;
+    (void)out;
+    (void)max_size;
+    return false;
+#endif
+}
+
+bool web_deflate_context::CompressStandalone(span<const uint8_t> payload, int window_bits, int memory_level, vector<uint8_t> &out) {
+#ifdef WEBCLIENT_HAS_ZLIB
+    z_stream stream {};
+    if(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -window_bits, memory_level, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+    bool compressed = deflate_message(stream, payload, out);
+    deflateEnd(&stream);
+    return compressed;
+#else
+    (void)payload;
+    (void)window_bits;
+    (void)memory_level;
+    (void)out;
+    return false;
+#endif
+}
@@ -0,0 +1,72 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_WEB_DEFLATE_H
+#define WEBCLIENT_WEB_DEFLATE_H
+#include <string>
+#include <vector>
+#include <span>
+#include <optional>
+#include <memory>
+#include <cstdint>
+
+// Server side policy for the permessage-deflate extension (RFC 7692).
+struct web_deflate_config {
+    bool Enabled = true;
+    // Upper bound for the zlib state of one connection (compressor + decompressor), window sizes are reduced to fit.
+    size_t MaxMemoryPerConnection = 192 * 1024;
+    int MaxWindowBits = 15;
+    bool AllowContextTakeover = true;
+    // Messages smaller than this are sent uncompressed, the deflate overhead is not worth it.
+    size_t MinMessageSize = 64;
+};
+
+// Parameters agreed on during the handshake.
+struct web_deflate_options {
+    bool ServerNoContextTakeover = false;
+    bool ClientNoContextTakeover = false;
+    int ServerWindowBits = 15;
+    int ClientWindowBits = 15;
+    int MemoryLevel = 8;
+    size_t MinMessageSize = 64;
+
+    // Picks the first permessage-deflate offer of a Sec-WebSocket-Extensions header that we can accept and
+    // fills the value of the response header.
+    static std::optional<web_deflate_options> Negotiate(const std::string& offers, const web_deflate_config& config,
+                                                        std::string& response);
+};
+
+/*
+ * Per-connection compressor/decompressor. The zlib streams are created on first use, so connections that never
+ * send or receive a compressed message do not pay for them.
+ */
+class web_deflate_context {
+public:
+    explicit web_deflate_context(const web_deflate_options& options);
+    ~web_deflate_context();
+
+    web_deflate_context(const web_deflate_context&) = delete;
+    web_deflate_context& operator=(const web_deflate_context&) = delete;
+
+    // Compresses one message payload into out (RSV1 payload, without the trailing 00 00 FF FF).
+    // Returns false if the result is not smaller than the input, the message should then be sent uncompressed.
+    bool Compress(std::span<const uint8_t> payload, std::vector<uint8_t>& out);
+    bool Decompress(std::span<const uint8_t> payload, std::vector<uint8_t>& out, uint64_t max_size);
+    // A message compressed elsewhere was sent on this connection, the peer's window no longer matches ours.
+    void InvalidateCompressorHistory() { m_reset_compressor = true; }
+
+    [[nodiscard]] const web_deflate_options& Options() const { return m_options; }
+
+    // Compresses a message without any history, the output can be sent to every connection whose negotiated
+    // window is at least window_bits. Used to compress broadcasts once for all subscribers.
+    static bool CompressStandalone(std::span<const uint8_t> payload, int window_bits, int memory_level, std::vector<uint8_t>& out);
+
+private:
+    struct zlib_state;
+    web_deflate_options m_options;
+    std::unique_ptr<zlib_state> m_state;
+    bool m_reset_compressor = false;
+};
+
+#endif //WEBCLIENT_WEB_DEFLATE_H
@@ -0,0 +1,81 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "web_heartbeat.h"
+#include <algorithm>
+using namespace std;
+
+void web_heartbeat::Start(heartbeat_state &state, uint64_t key, chrono::steady_clock::time_point now) const {
+    // mix the key so consecutive addresses/ids land far apart within the interval
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    auto interval = uint64_t(max<int64_t>(1, Config.Interval.count()));
+    state = {};
+    state.NextPing = now + chrono::milliseconds(key % interval);
+}
+
+web_heartbeat::tick_result
+web_heartbeat::Tick(heartbeat_state &state, chrono::steady_clock::time_point now, array<uint8_t, 8> &payload) const {
+    if(!Config.Enabled || now < state.NextPing)
+        return tick_result::idle;
+    if(state.AwaitingPong) {
+        state.MissedPongs++;
+        if(state.MissedPongs >= Config.MaxMissedPongs)
+            return tick_result::evict;
+    }
+    // keep the connection's phase instead of drifting towards the tick boundaries
+    state.NextPing += Config.Interval;
+    if(state.NextPing <= now)
+        state.NextPing = now + Config.Interval;
+    state.Sequence++;
+    state.AwaitingPong = true;
+    state.PingSentTime = now;
+    for(int i = 0; i < 8; i++) {
+        payload[i] = uint8_t(state.Sequence >> ((7 - i) * 8));
+    }
+    return tick_result::send_ping;
+}
+
+optional<double> web_heartbeat::OnPong(heartbeat_state &state, span<const uint8_t> payload, chrono::steady_clock::time_point now) {
+    if(!state.AwaitingPong || payload.size() != 8)
+        return {}; // unsolicited pong (allowed by RFC 6455) or not one of ours
+    uint64_t sequence = 0;
+    for(uint8_t byte : payload) {
+        sequence = (sequence << 8) | byte;
+    }
+    if(sequence != state.Sequence)
+        return {};
+
+    double rtt = chrono::duration<double, milli>(now - state.PingSentTime).count();
+    state.AwaitingPong = false;
+    state.MissedPongs = 0;
+    state.LastRttMs = rtt;
+    state.SmoothedRttMs = state.SmoothedRttMs < 0 ? rtt : state.SmoothedRttMs * 0.875 + rtt * 0.125;
+
+    if(m_samples.size() < MaxSamples) {
+        m_samples.push_back(float(rtt));
+    } else {
+        m_samples[m_next_sample] = float(rtt);
+        m_next_sample = (m_next_sample + 1) % MaxSamples;
+    }
+    return rtt;
+}
+
+rtt_percentiles web_heartbeat::GetRttPercentiles() const {
+    rtt_percentiles result;
+    result.Samples = m_samples.size();
+    if(m_samples.empty())
+        return result;
+    auto sorted = m_samples;
+    sort(sorted.begin(), sorted.end());
+    auto at = [&](double quantile) {
+        return double(sorted[min(sorted.size() - 1, size_t(quantile * double(sorted.size())))]);
+    };
+    result.P50 = at(0.50);
+    result.P90 = at(0.90);
+    result.P99 = at(0.99);
+    result.Max = sorted.back();
+    return result;
+}
@@ -0,0 +1,69 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_WEB_HEARTBEAT_H
+#define WEBCLIENT_WEB_HEARTBEAT_H
+#include <chrono>
+#include <vector>
+#include <array>
+#include <span>
+#include <optional>
+#include <cstdint>
+
+struct heartbeat_config {
+    bool Enabled = true;
+    std::chrono::milliseconds Interval = std::chrono::seconds(15);
+    // Connections that leave this many pings in a row unanswered are closed.
+    uint32_t MaxMissedPongs = 3;
+};
+
+// Per-connection heartbeat bookkeeping, stored on client_ctx.
+struct heartbeat_state {
+    std::chrono::steady_clock::time_point NextPing;
+    std::chrono::steady_clock::time_point PingSentTime;
+    uint64_t Sequence = 0;
+    bool AwaitingPong = false;
+    uint32_t MissedPongs = 0;
+    double LastRttMs = -1;
+    double SmoothedRttMs = -1;
+};
+
+struct rtt_percentiles {
+    size_t Samples = 0;
+    double P50 = 0;
+    double P90 = 0;
+    double P99 = 0;
+    double Max = 0;
+};
+
+/*
+ * Schedules websocket pings and measures round trip times from the matching pongs. Every connection gets its own
+ * phase within the interval (derived from a per-connection key), so pings are spread out instead of being sent to
+ * everyone at once. Not thread-safe, the web_server calls it with the clients lock held.
+ */
+class web_heartbeat {
+public:
+    enum class tick_result {
+        idle,
+        send_ping,
+        evict
+    };
+
+    heartbeat_config Config;
+
+    void Start(heartbeat_state& state, uint64_t key, std::chrono::steady_clock::time_point now) const;
+    // Decides what to do with a connection on this tick, payload is filled when a ping is due.
+    tick_result Tick(heartbeat_state& state, std::chrono::steady_clock::time_point now, std::array<uint8_t, 8>& payload) const;
+    // Returns the measured round trip time (ms) if the pong answers the outstanding ping.
+    std::optional<double> OnPong(heartbeat_state& state, std::span<const uint8_t> payload, std::chrono::steady_clock::time_point now);
+
+    [[nodiscard]] rtt_percentiles GetRttPercentiles() const;
+
+private:
+    static constexpr size_t MaxSamples = 4096;
+    std::vector<float> m_samples;
+    size_t m_next_sample = 0;
+};
+
+#endif //WEBCLIENT_WEB_HEARTBEAT_H
@@ -0,0 +1,157 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "web_mask.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define WEB_MASK_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define WEB_MASK_TARGET(x)
+#else
+#define WEB_MASK_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+using namespace std;
+
+using mask_kernel = size_t (*)(uint8_t* dst, const uint8_t* src, size_t length, uint32_t key);
+
+// Each kernel processes as many whole lanes as fit and returns the number of bytes it consumed,
+// lane widths are multiples of 4 so the key stays aligned for the scalar tail.
+static size_t mask_scalar(uint8_t* dst, const uint8_t* src, size_t length, uint32_t key) {
+    uint64_t key64 = (uint64_t(key) << 32) | key;
+    size_t i = 0;
+    for(; i + 8 <= length; i += 8) {
+        uint64_t block;
+        memcpy(&block, src + i, 8);
+        block ^= key64;
+        memcpy(dst + i, &block, 8);
+    }
+    return i;
+}
+
+#ifdef WEB_MASK_X86
+static size_t mask_sse2(uint8_t* dst, const uint8_t* src, size_t length, uint32_t key) {
+    const __m128i key128 = _mm_set1_epi32(int(key));
+    size_t i = 0;
+    for(; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(block, key128));
+    }
+    return i;
+}
+
+WEB_MASK_TARGET("avx2")
+static size_t mask_avx2(uint8_t* dst, const uint8_t* src, size_t length, uint32_t key) {
+    const __m256i key256 = _mm256_set1_epi32(int(key));
+    size_t i = 0;
+    for(; i + 64 <= length; i += 64) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(a, key256));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), _mm256_xor_si256(b, key256));
+    }
+    for(; i + 32 <= length; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(a, key256));
+    }
+    return i;
+}
+
+WEB_MASK_TARGET("avx512f")
+static size_t mask_avx512(uint8_t* dst, const uint8_t* src, size_t length, uint32_t key) {
+    const __m512i key512 = _mm512_set1_epi32(int(key));
+    size_t i = 0;
+    for(; i + 64 <= length; i += 64) {
+        __m512i a = _mm512_loadu_si512(src + i);
+        _mm512_storeu_si512(dst + i, _mm512_xor_si512(a, key512));
+    }
+    return i;
+}
+
+static bool cpu_supports_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, 0, 0);
+    if(info[0] < 7)
+        return false;
+    __cpuidex(info, 1, 0);
+    bool osxsave = info[2] & (1 << 27);
+    if(!osxsave || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool cpu_supports_avx512() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, 0, 0);
+    if(info[0] < 7)
+        return false;
+    __cpuidex(info, 1, 0);
+    bool osxsave = info[2] & (1 << 27);
+    // XMM, YMM, opmask and ZMM state must all be enabled by the OS
+    if(!osxsave || (_xgetbv(0) & 0xE6) != 0xE6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 16);
+#else
+    return __builtin_cpu_supports("avx512f");
+#endif
+}
+#endif
+
+struct mask_dispatch {
+    mask_kernel Kernel = mask_scalar;
+    const char* Name = "scalar";
+
+    mask_dispatch() {
+#ifdef WEB_MASK_X86
+        if(cpu_supports_avx512()) {
+            Kernel = mask_avx512;
+            Name = "avx512";
+        } else if(cpu_supports_avx2()) {
+            Kernel = mask_avx2;
+            Name = "avx2";
+        } else {
+            // SSE2 is part of the x86-64 baseline
+            Kernel = mask_sse2;
+            Name = "sse2";
+        }
+#endif
+    }
+};
+
+static const mask_dispatch& dispatch() {
+    static const mask_dispatch instance;
+    return instance;
+}
+
+void web_mask::Apply(uint8_t *dst, const uint8_t *src, size_t length, const uint8_t key[4], size_t key_offset) {
+    // rotate the key so that lane byte 0 lines up with src[0]
+    uint8_t rotated[4];
+    for(size_t i = 0; i < 4; i++)
+        rotated[i] = key[(key_offset + i) & 3];
+
+    size_t i = 0;
+    if(length >= 16) {
+        uint32_t key32;
+        memcpy(&key32, rotated, 4);
+        i = dispatch().Kernel(dst, src, length, key32);
+        i += mask_scalar(dst + i, src + i, length - i, key32);
+    }
+    for(; i < length; i++)
+        dst[i] = src[i] ^ rotated[i & 3];
+}
+
+const char* web_mask::KernelName() {
+    return dispatch().Name;
+}
@@ -0,0 +1,24 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_WEB_MASK_H
+#define WEBCLIENT_WEB_MASK_H
+#include <cstdint>
+#include <cstddef>
+
+namespace web_mask {
+
+    /*
+     * XORs length bytes of src with the repeating 4-byte websocket masking key and writes them to dst
+     * (dst may equal src). key_offset is the position of src[0] within the payload, so a payload can be
+     * masked in pieces. The widest kernel the CPU supports (AVX-512, AVX2, SSE2 or scalar) is picked once at startup.
+     */
+    void Apply(uint8_t* dst, const uint8_t* src, size_t length, const uint8_t key[4], size_t key_offset = 0);
+
+    // Name of the kernel selected at runtime, for logging.
+    const char* KernelName();
+
+}
+
+#endif //WEBCLIENT_WEB_MASK_H
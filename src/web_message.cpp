@@ -0,0 +1,110 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "web_message.h"
+#include "web_server.h"
+#include "CppUtility.hpp"
+#include "json_writer.h"
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+const char *web_message::FieldTypeName(field_type type) {
+    switch(type) {
+        case field_type::uint: return "uint";
+        case field_type::sint: return "sint";
+        case field_type::float64: return "float64";
+        default: return "string";
+    }
+}
+
+void web_message::WriteVarint(vector<uint8_t> &out, uint64_t value) {
+    while(value >= 0x80) {
+        out.push_back(uint8_t(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+bool web_message::ReadVarint(span<const uint8_t> &in, uint64_t &value) {
+    value = 0;
+    for(size_t i = 0; i < in.size() && i < 10; i++) {
+        value |= uint64_t(in[i] & 0x7F) << (7 * i);
+        if(!(in[i] & 0x80)) {
+            in = in.subspan(i + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void web_message::WriteDouble(vector<uint8_t> &out, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for(int i = 0; i < 8; i++) {
+        out.push_back(uint8_t(bits >> (i * 8)));
+    }
+}
+
+bool web_message::ReadDouble(span<const uint8_t> &in, double &value) {
+    if(in.size() < 8)
+        return false;
+    uint64_t bits = 0;
+    for(int i = 0; i < 8; i++) {
+        bits |= uint64_t(in[i]) << (i * 8);
+    }
+    memcpy(&value, &bits, sizeof(bits));
+    in = in.subspan(8);
+    return true;
+}
+
+void web_message::WriteString(vector<uint8_t> &out, const string &value) {
+    WriteVarint(out, value.size());
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+bool web_message::ReadString(span<const uint8_t> &in, string &value) {
+    uint64_t length;
+    if(!ReadVarint(in, length) || length > in.size())
+        return false;
+    value.assign(in.begin(), in.begin() + ptrdiff_t(length));
+    in = in.subspan(length);
+    return true;
+}
+
+websocket_callback_status web_message::dispatcher::Dispatch(client_ctx &client, const web_packet_view &packet) const {
+    if(packet.OpCode != web_socket_opcode::BinaryFrame || packet.Payload.size() < 2)
+        return websocket_callback_status::ignore;
+    size_t id = packet.Payload[0] | (packet.Payload[1] << 8);
+    if(id >= m_handlers.size() || !m_handlers[id])
+        return websocket_callback_status::ignore;
+    if(!m_handlers[id](client, packet.Payload)) {
+        LOG(WARNING, "{} (WebSocket) sent a malformed message with id {}.", client.Name, id);
+        return websocket_callback_status::ignore;
+    }
+    return websocket_callback_status::processed;
+}
+
+void web_message::dispatcher::AddSchema(schema_entry &&entry) {
+    auto it = find_if(m_schema.begin(), m_schema.end(), [&](const auto& item) { return item.Id == entry.Id; });
+    if(it != m_schema.end())
+        *it = std::move(entry);
+    else
+        m_schema.push_back(std::move(entry));
+}
+
+string web_message::dispatcher::SchemaAsJSON() const {
+    string text;
+    json_string_writer json(text);
+    json.BeginObject().Key("messages").BeginArray();
+    for(const auto& entry : m_schema) {
+        json.BeginObject().Member("id", entry.Id).Member("name", entry.Name).Key("fields").BeginArray();
+        for(const auto& [name, type] : entry.Fields) {
+            json.BeginArray().Value(name).Value(FieldTypeName(type)).EndArray();
+        }
+        json.EndArray().EndObject();
+    }
+    json.EndArray().EndObject();
+    return text;
+}
@@ -0,0 +1,196 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_WEB_MESSAGE_H
+#define WEBCLIENT_WEB_MESSAGE_H
+#include "web_packet.h"
+#include <string>
+#include <vector>
+#include <span>
+#include <tuple>
+#include <functional>
+#include <type_traits>
+#include <cstdint>
+
+struct client_ctx;
+enum class websocket_callback_status;
+
+/*
+ * Binary messages sent over BinaryFrame: a fixed 2 byte header with the message id (little endian) followed by the
+ * fields in schema order. Integers are LEB128 varints (signed ones zigzag encoded), floating point values are 8 byte
+ * little endian doubles and strings are a varint length followed by the bytes.
+ *
+ * A message type describes its own schema:
+ *
+ *     struct chat_message {
+ *         static constexpr uint16_t Id = 1;
+ *         static constexpr const char* Name = "chat";
+ *         std::string Text;
+ *         static constexpr auto Fields = std::make_tuple(web_message::field("text", &chat_message::Text));
+ *     };
+ *
+ * Fields may only be appended: a decoder that reaches the end of the payload early leaves the remaining fields at
+ * their defaults, and extra trailing bytes from a newer sender are ignored.
+ */
+namespace web_message {
+    enum class field_type : uint8_t {
+        uint,
+        sint,
+        float64,
+        string
+    };
+
+    const char* FieldTypeName(field_type type);
+
+    template<class T>
+    constexpr field_type type_of() {
+        if constexpr (std::is_same_v<T, std::string>)
+            return field_type::string;
+        else if constexpr (std::is_floating_point_v<T>)
+            return field_type::float64;
+        else if constexpr (std::is_same_v<T, bool> || std::is_unsigned_v<T>)
+            return field_type::uint;
+        else if constexpr (std::is_signed_v<T> || std::is_enum_v<T>)
+            return field_type::sint;
+        else
+            static_assert(std::is_same_v<T, std::string>, "unsupported web_message field type");
+    }
+
+    template<class Message, class T>
+    struct field_descriptor {
+        const char* Name;
+        T Message::* Member;
+        static constexpr field_type Type = type_of<T>();
+    };
+
+    template<class Message, class T>
+    constexpr field_descriptor<Message, T> field(const char* name, T Message::* member) {
+        return { name, member };
+    }
+
+    // low level encoding, shared by every message type
+    void WriteVarint(std::vector<uint8_t>& out, uint64_t value);
+    bool ReadVarint(std::span<const uint8_t>& in, uint64_t& value);
+    void WriteDouble(std::vector<uint8_t>& out, double value);
+    bool ReadDouble(std::span<const uint8_t>& in, double& value);
+    void WriteString(std::vector<uint8_t>& out, const std::string& value);
+    bool ReadString(std::span<const uint8_t>& in, std::string& value);
+
+    template<class T>
+    void WriteField(std::vector<uint8_t>& out, const T& value) {
+        constexpr auto type = type_of<T>();
+        if constexpr (type == field_type::string)
+            WriteString(out, value);
+        else if constexpr (type == field_type::float64)
+            WriteDouble(out, double(value));
+        else if constexpr (type == field_type::uint)
+            WriteVarint(out, uint64_t(value));
+        else {
+            auto signed_value = int64_t(value);
+            WriteVarint(out, (uint64_t(signed_value) << 1) ^ uint64_t(signed_value >> 63));
+        }
+    }
+
+    template<class T>
+    bool ReadField(std::span<const uint8_t>& in, T& value) {
+        constexpr auto type = type_of<T>();
+        if constexpr (type == field_type::string) {
+            return ReadString(in, value);
+        } else if constexpr (type == field_type::float64) {
+            double number;
+            if(!ReadDouble(in, number))
+                return false;
+            value = T(number);
+            return true;
+        } else {
+            uint64_t raw;
+            if(!ReadVarint(in, raw))
+                return false;
+            if constexpr (type == field_type::uint)
+                value = T(raw);
+            else
+                value = T(int64_t(raw >> 1) ^ -int64_t(raw & 1));
+            return true;
+        }
+    }
+
+    template<class Message>
+    void Encode(const Message& message, std::vector<uint8_t>& out) {
+        out.push_back(uint8_t(Message::Id));
+        out.push_back(uint8_t(Message::Id >> 8));
+        std::apply([&](const auto&... fields) { (WriteField(out, message.*(fields.Member)), ...); }, Message::Fields);
+    }
+
+    // payload is the whole frame payload, header included
+    template<class Message>
+    bool Decode(std::span<const uint8_t> payload, Message& message) {
+        if(payload.size() < 2 || (payload[0] | (payload[1] << 8)) != Message::Id)
+            return false;
+        payload = payload.subspan(2);
+        bool valid = true;
+        std::apply([&](const auto&... fields) {
+            ((valid = valid && (payload.empty() || ReadField(payload, message.*(fields.Member)))), ...);
+        }, Message::Fields);
+        return valid;
+    }
+
+    template<class Message>
+    web_packet ToPacket(const Message& message) {
+        web_packet packet;
+        packet.OpCode = web_socket_opcode::BinaryFrame;
+        Encode(message, packet.Payload);
+        return packet;
+    }
+
+    /*
+     * Routes binary frames to typed handlers by message id, a vector lookup instead of string prefix matching.
+     * Also keeps the schema of every registered message so it can be served to the JS decoder (wwwroot/web_message.js).
+     */
+    class dispatcher {
+    public:
+        template<class Message>
+        void On(std::function<void(client_ctx& client, Message& message)> handler) {
+            Describe<Message>();
+            if(m_handlers.size() <= Message::Id)
+                m_handlers.resize(size_t(Message::Id) + 1);
+            m_handlers[Message::Id] = [handler = std::move(handler)](client_ctx& client, std::span<const uint8_t> payload) {
+                Message message {};
+                if(!Decode(payload, message))
+                    return false;
+                handler(client, message);
+                return true;
+            };
+        }
+
+        // Adds a message the server only sends to the schema.
+        template<class Message>
+        void Describe() {
+            schema_entry entry { Message::Id, Message::Name, {} };
+            std::apply([&](const auto&... fields) {
+                (entry.Fields.emplace_back(fields.Name, fields.Type), ...);
+            }, Message::Fields);
+            AddSchema(std::move(entry));
+        }
+
+        // processed if the frame was a known, well-formed message; ignore for anything else.
+        websocket_callback_status Dispatch(client_ctx& client, const web_packet_view& packet) const;
+
+        // {"messages":[{"id":1,"name":"chat","fields":[["text","string"]]}]}
+        [[nodiscard]] std::string SchemaAsJSON() const;
+
+    private:
+        struct schema_entry {
+            uint16_t Id;
+            const char* Name;
+            std::vector<std::pair<const char*, field_type>> Fields;
+        };
+        void AddSchema(schema_entry&& entry);
+
+    private:
+        std::vector<std::function<bool(client_ctx&, std::span<const uint8_t>)>> m_handlers;
+        std::vector<schema_entry> m_schema;
+    };
+}
+
+#endif //WEBCLIENT_WEB_MESSAGE_H
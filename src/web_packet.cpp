@@ -3,15 +3,14 @@
 //
 
 #include "web_packet.h"
+#include "web_mask.h"
 #include "CppUtility.hpp"
 using namespace std;
 
 void web_packet::ApplyMask() const {
     if(!MaskFlag)
         return;
-    for (size_t i = 0; i < Payload.size(); ++i) {
-        Payload[i] ^= Mask[i % 4];
-    }
+    web_mask::Apply(Payload.data(), Payload.data(), Payload.size(), Mask);
     IsMaskApplied = !IsMaskApplied;
 }
 
@@ -21,49 +20,50 @@ std::vector<uint8_t> web_packet::ToBinaryStream() const {
         throw runtime_error("Invalid WebSocket OpCode.");
     }
 
-    vector<uint8_t> stream;
-    stream.reserve(2 + Payload.size() + 2 + 8);
-
-    uint8_t byte0 = (FinalFragment << 7) |
-                    (RSV1 << 6) |
-                    (RSV2 << 5) |
-                    (RSV3 << 4) |
-                    (uint8_t(OpCode) & 0x0F);
+    uint8_t header[14];
+    size_t header_size = 0;
 
-    stream.push_back(byte0);
+    header[header_size++] = (FinalFragment << 7) |
+                            (RSV1 << 6) |
+                            (RSV2 << 5) |
+                            (RSV3 << 4) |
+                            (uint8_t(OpCode) & 0x0F);
 
     if(Payload.size() < 126) {
-        stream.push_back(uint8_t(Payload.size()) | (MaskFlag << 7));
-    } else if(Payload.size() < UINT16_MAX) {
-        stream.push_back(126 | (MaskFlag << 7));
-        stream.push_back(uint16_t(Payload.size()) >> 8);
-        stream.push_back(uint16_t(Payload.size()) & 0x00FF);
+        header[header_size++] = uint8_t(Payload.size()) | (MaskFlag << 7);
+    } else if(Payload.size() <= UINT16_MAX) {
+        header[header_size++] = 126 | (MaskFlag << 7);
+        header[header_size++] = uint16_t(Payload.size()) >> 8;
+        header[header_size++] = uint16_t(Payload.size()) & 0x00FF;
     } else {
-        stream.push_back(127 | (MaskFlag << 7));
-        assert(0 && "Not Implemented.");
+        header[header_size++] = 127 | (MaskFlag << 7);
+        // 64-bit length in network order (big endian)
+        for (int i = 7; i >= 0; i--) {
+            header[header_size++] = uint8_t(uint64_t(Payload.size()) >> (i * 8));
+        }
     }
 
     if(MaskFlag) {
-        for(uint8_t item : Mask) {
-            stream.push_back(item);
-        }
+        memcpy(&header[header_size], Mask, 4);
+        header_size += 4;
     }
 
+    vector<uint8_t> stream(header_size + Payload.size());
+    memcpy(stream.data(), header, header_size);
+
     if(!Payload.empty()) {
-        if(!IsMaskApplied)
-            ApplyMask();
-        for(uint8_t item : Payload) {
-            stream.push_back(item);
-        }
+        // mask straight into the output buffer, Payload itself is left untouched
+        if(MaskFlag && !IsMaskApplied)
+            web_mask::Apply(&stream[header_size], Payload.data(), Payload.size(), Mask);
+        else
+            memcpy(&stream[header_size], Payload.data(), Payload.size());
     }
 
-    return std::move(stream);
+    return stream;
 }
 
-std::pair<std::optional<web_packet>, web_packet_parse_code>
-web_packet::FromBinaryStream(const span<uint8_t> &data, uint32_t& index)
-{
-    web_packet result;
+web_packet_parse_code
+web_frame_header::Parse(std::span<const uint8_t> data, uint64_t max_payload_length, web_frame_header &header) {
     /*
            0                   1                   2                   3
       0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -84,68 +84,67 @@ web_packet::FromBinaryStream(const span<uint8_t> &data, uint32_t& index)
      |                     Payload Data continued ...                |
      +---------------------------------------------------------------+
      */
-    result.FinalFragment = data[index] & 0b10000000;
-    result.RSV1 = data[index] & 0b01000000;
-    result.RSV2 = data[index] & 0b00100000;
-    result.RSV3 = data[index] & 0b00010000;
-    result.MaskFlag = data[index + 1] & 0b10000000;
-    result.OpCode = web_socket_opcode(data[index] & 0b00001111); // only-4 bits max
-    result.PayloadLength = data[index + 1] & 0b01111111; // only 7-bit max
-
-    // skip 2 bytes
-    index += 2;
-
-    if (result.PayloadLength > 1024) {
-        // payload too large, close connection
-        LOG(ERR, "WebSocket Packet Error, payload too large. Closing Connection.");
-        return { {}, web_packet_parse_code::error };
+    // The header is 2 to 14 bytes, if it is not all here yet the caller retries once more data arrived.
+    if (data.size() < 2) {
+        return web_packet_parse_code::missing_header;
+    }
+    uint8_t length_code = data[1] & 0b01111111; // only 7-bit max
+    header.HeaderSize = 2 + (length_code == 126 ? 2 : length_code == 127 ? 8 : 0) + ((data[1] & 0b10000000) ? 4 : 0);
+    if (data.size() < header.HeaderSize) {
+        return web_packet_parse_code::missing_header;
     }
 
-    if (result.PayloadLength == 126) {
+    header.FinalFragment = data[0] & 0b10000000;
+    header.RSV1 = data[0] & 0b01000000;
+    header.RSV2 = data[0] & 0b00100000;
+    header.RSV3 = data[0] & 0b00010000;
+    header.MaskFlag = data[1] & 0b10000000;
+    header.OpCode = web_socket_opcode(data[0] & 0b00001111); // only-4 bits max
+    header.PayloadLength = length_code;
+
+    size_t index = 2;
+    if (length_code == 126) {
         // 16-bit length (next 2-bytes)
-        result.PayloadLength = uint16_t(data[2]) << 8 | data[3];
+        header.PayloadLength = uint16_t(data[index]) << 8 | data[index + 1];
         index += 2;
-    } else if (result.PayloadLength == 127) {
+    } else if (length_code == 127) {
         // 64-bit length (next 8-bytes)
         // bytes are in network order (big endian)
+        header.PayloadLength = 0;
         for (int i = 0; i < 8; i++) {
-            result.PayloadLength = (result.PayloadLength << 8) | data[index++];
+            header.PayloadLength = (header.PayloadLength << 8) | data[index++];
         }
     }
 
-    if (result.MaskFlag) {
-        if(data.size() < index+4) {
-            return { result, web_packet_parse_code::missing_mask };
-        }
-        int counter = 0;
-        for(size_t i = index; i < index + 4; i++) {
-            result.Mask[counter++] = data[i];
-        }
-        index += 4;
+    switch (header.OpCode) {
+        case web_socket_opcode::ContinuationFrame:
+        case web_socket_opcode::TextFrame:
+        case web_socket_opcode::BinaryFrame:
+        case web_socket_opcode::ConnectionCloseFrame:
+        case web_socket_opcode::PingFrame:
+        case web_socket_opcode::PongFrame:
+            break;
+        default:
+            LOG(ERR, "WebSocket Packet Error, reserved opcode {}. Closing Connection.", int(header.OpCode));
+            return web_packet_parse_code::error;
     }
 
-    if (!result.PayloadLength) {
-        return { result, web_packet_parse_code::complete };
+    if (header.PayloadLength > max_payload_length) {
+        // payload too large, close connection
+        LOG(ERR, "WebSocket Packet Error, payload too large ({} bytes). Closing Connection.", header.PayloadLength);
+        return web_packet_parse_code::error;
     }
 
-    result.IsMaskApplied = true;
-    // rest is data, copy into buffer
-    if(result.PayloadLength <= data.size() - index) {
-        result.Payload.resize(result.PayloadLength);
-        memcpy(result.Payload.data(), &data[index], result.PayloadLength);
-        result.ApplyMask();
-        index += result.PayloadLength;
-    } else if(data.size() - index > 0) {
-        size_t recvPayloadSize = data.size() - index;
-        result.Payload.resize(recvPayloadSize);
-        memcpy(result.Payload.data(), &data[index], recvPayloadSize);
-        index += recvPayloadSize;
-        return { result, web_packet_parse_code::missing_payload };
-    } else {
-        return { result, web_packet_parse_code::missing_payload };
+    // control frames cannot be fragmented and carry at most 125 bytes (RFC 6455 5.5)
+    if (header.IsControl() && (!header.FinalFragment || header.PayloadLength > 125)) {
+        LOG(ERR, "WebSocket Packet Error, malformed control frame. Closing Connection.");
+        return web_packet_parse_code::error;
     }
 
-    return { result, web_packet_parse_code::complete };
+    if (header.MaskFlag) {
+        memcpy(header.Mask, &data[index], 4);
+    }
+    return web_packet_parse_code::complete;
 }
 
 void web_packet::EnsureUnmasked() const {
@@ -155,52 +154,10 @@ void web_packet::EnsureUnmasked() const {
         ApplyMask();
 }
 
-web_packet web_packet::GetPingPacket() {
-    web_packet packet;
-    packet.OpCode = web_socket_opcode::PingFrame;
-    return packet;
-}
-
 void web_packet::SetPayloadFromString(const string &text) {
     Payload = { text.begin(), text.end() };
 }
 
-web_packet_parse_code
-web_packet::CompletePacketFromBinaryStream(const span<uint8_t> &data, uint32_t &index,
-                                           web_packet_parse_code previous_parse_code, web_packet &previous_packet) {
-    if(previous_parse_code == web_packet_parse_code::complete)
-        return web_packet_parse_code::complete;
-    if(previous_parse_code == web_packet_parse_code::missing_mask) {
-        if(!previous_packet.MaskFlag)
-            return web_packet_parse_code::error;
-        // The data stream still does not have the mask, therefore, we cancel the parsing
-        if(data.size() <= index+4)
-            return web_packet_parse_code::error;
-        int counter = 0;
-        for(size_t i = index; i < index + 4; i++) {
-            previous_packet.Mask[counter++] = data[i];
-        }
-        index += 4;
-        if(previous_packet.PayloadLength > 0)
-            previous_parse_code = web_packet_parse_code::missing_payload;
-        else
-            return web_packet_parse_code::complete;
-    }
-    if(previous_parse_code == web_packet_parse_code::missing_payload) {
-        for(size_t counter = previous_packet.Payload.size();
-            counter < previous_packet.PayloadLength &&
-            counter < data.size();
-            counter++) {
-            previous_packet.Payload.push_back(data[counter]);
-        }
-        if(previous_packet.Payload.size() != previous_packet.PayloadLength)
-            return web_packet_parse_code::missing_payload;
-        previous_packet.ApplyMask();
-        return web_packet_parse_code::complete;
-    }
-    return web_packet_parse_code::error;
-}
-
 std::string web_packet::GetPayloadAsString() const {
     return { Payload.begin(), Payload.end() };
 }
@@ -5,7 +5,6 @@
 #ifndef WEBCLIENT_WEB_PACKET_H
 #define WEBCLIENT_WEB_PACKET_H
 #include <vector>
-#include <optional>
 #include <span>
 #include <string>
 #include <list>
@@ -36,11 +35,39 @@ enum class web_socket_opcode {
 
 enum class web_packet_parse_code {
     complete = 0,
-    missing_mask,
+    missing_header,
     missing_payload,
     error
 };
 
+struct web_frame_header {
+    bool FinalFragment = true;
+    bool RSV1 = false;
+    bool RSV2 = false;
+    bool RSV3 = false;
+    bool MaskFlag = false;
+    web_socket_opcode OpCode = web_socket_opcode::ERROR;
+    uint8_t Mask[4] = {};
+    uint64_t PayloadLength = 0;
+    size_t HeaderSize = 0;
+
+    [[nodiscard]] bool IsControl() const { return uint8_t(OpCode) & 0x8; }
+    [[nodiscard]] uint64_t FrameSize() const { return HeaderSize + PayloadLength; }
+
+    // Decodes the 2-14 byte frame header at the start of data, returns missing_header until all of it has arrived.
+    static web_packet_parse_code Parse(std::span<const uint8_t> data, uint64_t max_payload_length, web_frame_header& header);
+};
+
+// Unmasked, complete message handed to websocket handlers. Payload points into the connection's receive buffer
+// (or its fragment buffer) and is only valid for the duration of the callback.
+struct web_packet_view {
+    web_socket_opcode OpCode = web_socket_opcode::ERROR;
+    bool RSV1 = false;
+    std::span<uint8_t> Payload;
+
+    [[nodiscard]] std::string GetPayloadAsString() const { return { Payload.begin(), Payload.end() }; }
+};
+
 struct web_packet {
     bool FinalFragment = true;
     bool RSV1 = false;
@@ -50,7 +77,7 @@ struct web_packet {
     mutable bool IsMaskApplied = false;
     web_socket_opcode OpCode = web_socket_opcode::ERROR;
     uint8_t Mask[4] = {};
-    uint16_t PayloadLength = 0;
+    uint64_t PayloadLength = 0;
     mutable std::vector<uint8_t> Payload;
 
     void SetPayloadFromString(const std::string& text);
@@ -58,12 +85,6 @@ struct web_packet {
     void EnsureUnmasked() const;
     std::string GetPayloadAsString() const;
     [[nodiscard]] std::vector<uint8_t> ToBinaryStream() const;
-    static std::pair<std::optional<web_packet>, web_packet_parse_code> FromBinaryStream(const std::span<uint8_t>& data, uint32_t& offset);
-    static web_packet_parse_code CompletePacketFromBinaryStream
-                                 (const std::span<uint8_t>& data, uint32_t& offset,
-                                 web_packet_parse_code previous_parse_code,
-                                 web_packet& previous_packet);
-    static web_packet GetPingPacket();
 
     static web_packet TextPacket(const std::string& text);
 };
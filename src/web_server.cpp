@@ -3,6 +3,7 @@
 //
 
 #include "web_server.h"
+#include "web_mask.h"
 #include "CppUtility.hpp"
 #include <iostream>
 #include <thread>
@@ -10,6 +11,7 @@
 #include <optional>
 #include <string_view>
 #include <algorithm>
+#include <array>
 using namespace std;
 
 web_server::web_server(int port) {
@@ -21,16 +23,6 @@ web_server::web_server(int port) {
             .Listen(1024)
             .SetBlockingMode(false)
             .SetNagleAlgorthim(false);
-
-#if 0
-    thread ping_websockets([&] {
-        while(m_server.IsValid()) {
-            this_thread::sleep_for(chrono::seconds(5));
-            PingWebSockets();
-        }
-    });
-    ping_websockets.detach();
-#endif
 }
 
 void web_server::Serve() {
@@ -41,6 +33,8 @@ void web_server::Serve() {
         AcceptClient();
         WaitForData(50);
         ProcessClients();
+        RunHeartbeat();
+        FlushSendQueues();
         RemoveDisconnectedClients();
         if (m_clients.empty()) {
             this_thread::sleep_for(chrono::milliseconds(10));
@@ -56,10 +50,10 @@ void web_server::AcceptClient() {
     if (connection.IsValid()) {
         LOG(INFO, "{}, connected.", connection.GetEndpoint().ToString());
         connection.SetBlockingMode(false);
-        client_ctx client;
+        auto& client = m_clients.emplace_back();
         client.connection = connection;
-        client.Name = connection.GetEndpoint().ToString();
-        m_clients.push_back(client);
+        client.Endpoint = connection.GetEndpoint().ToString();
+        client.Name = client.Endpoint;
     }
 }
 
@@ -69,42 +63,84 @@ void web_server::WaitForData(int32_t timeout) {
     vector<sw::Socket> connections(m_clients.size());
     size_t i = 0;
     for(auto& client : m_clients) {
-        connections[i] = client.connection;
+        connections[i++] = client.connection;
     }
+    // only the sockets with data to read are left in connections
     sw::Socket::WaitForData(connections, timeout);
+    unordered_set<string> readable;
+    for(auto& connection : connections) {
+        readable.insert(connection.GetEndpoint().ToString());
+    }
+    for(auto& client : m_clients) {
+        client.Readable = readable.contains(client.Endpoint);
+    }
 }
 
 void web_server::ProcessClients() {
     for (auto& client : m_clients) {
-        uint8_t szHeader[config::MaxHeaderSize] = {};
-        int32_t headerSize = client.connection.Recv(szHeader, config::MaxHeaderSize, false);
-        span<uint8_t> header(szHeader, headerSize);
+        // idle connections are not read from and hold no receive buffer
+        if (!client.Readable)
+            continue;
+        client.Readable = false;
+        if (client.isWebsocket) {
+            // websocket frames are received straight into the connection's buffer and parsed in place
+            auto writable = client.ReceiveBuffer.Writable(config::MaxHeaderSize);
+            int32_t received = client.connection.Recv(writable.data(), (int32_t)min<size_t>(writable.size(), INT32_MAX), false);
+            if (received > 0) {
+                client.ReceiveBuffer.Commit(received);
+                HandleWebSocketRequest(client);
+            }
+            // nothing (left) to parse, the buffer goes back to the pool
+            client.ReceiveBuffer.Release();
+            continue;
+        }
+        // borrowed from the pool for this read only, no zero-filling
+        auto writable = client.ReceiveBuffer.Writable(config::MaxHeaderSize);
+        int32_t headerSize = client.connection.Recv(writable.data(), config::MaxHeaderSize, false);
+        // Recv returns <= 0 when a non-blocking socket has nothing to read
+        size_t received = headerSize > 0 ? size_t(headerSize) : 0;
+        span<uint8_t> header(writable.data(), received);
         // The smallest possible http request is the following:
         // GET / HTTP/1.1\r\n\r\n ---  18 characters
-        if (headerSize + client.IncompleteRequest.size() >= 18 && !client.isWebsocket) {
+        if (received > 0 && received + client.IncompleteRequest.size() >= 18 && !client.isWebsocket) {
             client.connectedTime = chrono::steady_clock::now();
             auto request = http_request::ParseHttpRequest(header);
-            if(!request.has_value()) {
-                continue;
+            if(request.has_value()) {
+                HandleRequest(client, *request);
             }
-            HandleRequest(client, *request);
-        } else if(headerSize > 0 && client.isWebsocket) {
-            HandleWebSocketRequest(client, header);
-        }
-        else if (headerSize > 0) {
+        } else if (headerSize > 0) {
             // (TODO): Implement
         }
+        client.ReceiveBuffer.Release();
     }
 }
 
 void web_server::RemoveDisconnectedClients() {
     auto now = chrono::steady_clock::now();
     m_clients.remove_if([&](client_ctx& client) {
-        if(!client.connection.IsConnected()) {
+        bool connected = client.connection.IsConnected();
+        auto connected_seconds = chrono::duration_cast<chrono::seconds>(now - client.connectedTime).count();
+        bool timed_out = connected_seconds > int64_t(config::ClientTimeoutDuration);
+        if(!connected || timed_out) {
+            m_dropped_frames += client.DroppedFrames;
+            if(client.SlowConsumer) {
+                m_slow_consumer_disconnects++;
+                LOG(WARNING, "Disconnected slow websocket client [{}], {} queued.", client.Name,
+                    cpp::FriendlyMemorySize((double)client.QueuedBytes));
+            }
+            for(const auto& topic : client.Topics) {
+                if(auto it = m_topics.find(topic); it != m_topics.end()) {
+                    it->second.erase(&client);
+                    if(it->second.empty())
+                        m_topics.erase(it);
+                }
+            }
+        }
+        if(!connected) {
             LOG(INFO, "Client [{}] disconnected.\tTotal Client(s): {}", client.connection.GetEndpoint().ToString(), m_clients.size() - 1);
             client.connection.Disconnect().Close();
             return true;
-        } else if(chrono::duration_cast<chrono::seconds>(now - client.connectedTime).count() > config::ClientTimeoutDuration) {
+        } else if(timed_out) {
             LOG(INFO, "Closed connection to Client [{}] after {} seconds.\tTotal Client(s): {}", client.connection.GetEndpoint().ToString(), config::ClientTimeoutDuration, m_clients.size() - 1);
             client.connection.Disconnect().Close();
             return true;
@@ -161,9 +197,26 @@ void web_server::WebSocketHandshake
     response.headers["Upgrade"] = "websocket";
     response.headers["Connection"] = "Upgrade";
     response.headers["Sec-WebSocket-Accept"] = hash64;
+    if(auto extensions = request.fields.find("Sec-WebSocket-Extensions"); extensions != request.fields.end()) {
+        string accepted;
+        if(auto options = web_deflate_options::Negotiate(extensions->second, WebSocketCompression, accepted)) {
+            response.headers["Sec-WebSocket-Extensions"] = accepted;
+            client.Deflate = make_shared<web_deflate_context>(*options);
+        }
+    }
     client.isWebsocket = true;
     client.WebSocketResource = request.resource;
+    client.WebSocketHandler = ResolveWebSocketHandler(request.resource);
+    m_heartbeat.Start(client.Heartbeat, std::hash<string>{}(client.connection.GetEndpoint().ToString()), chrono::steady_clock::now());
+    if(auto max_size = m_websocket_max_message_size.find(request.resource); max_size != m_websocket_max_message_size.end()) {
+        client.MaxMessageSize = max_size->second;
+    }
+    if(auto policy = m_websocket_send_policy.find(request.resource); policy != m_websocket_send_policy.end()) {
+        client.SendPolicy = policy->second;
+    }
     SendResponse(client, request, response);
+    // after the 101 response, subscribe handlers may already queue frames
+    Subscribe(client, request.resource);
 }
 
 std::optional<std::vector<uint8_t>>
@@ -262,75 +315,159 @@ std::string getCurrentDateTime() {
     return std::string(buffer);
 }
 
-void web_server::HandleWebSocketRequest(client_ctx &client, span<uint8_t> data) {
-    // Is this a normal HTTP Request?
-    const char* szVerbs[] = { "GET", "POST", "PUT", "PATCH", "DELETE" };
-    for(int i = 0; (i < 5) && data.size() >= 3; i++) {
-        if(memcmp(data.data(), szVerbs[i], 3) == 0) {
-            assert(0); // TODO: Redirect for regular HTTP processing.
-        }
-    }
-
-    uint32_t offset = 0;
-    do {
-        optional<web_packet> packet;
-        web_packet_parse_code status;
-        if(client.PreviousParseCode == web_packet_parse_code::complete) {
-            auto pair = web_packet::FromBinaryStream(data, offset);
-            packet = pair.first;
-            status = pair.second;
-        } else {
-            LOG(WARNING, "Attempting to complete packet.");
-            client.PreviousParseCode =
-            web_packet::CompletePacketFromBinaryStream(data, offset, client.PreviousParseCode, client.IncompletePacket);
-            packet = client.IncompletePacket;
-            status = client.PreviousParseCode;
-        }
-        if (status == web_packet_parse_code::error || !packet) {
+void web_server::HandleWebSocketRequest(client_ctx &client) {
+    auto& buffer = client.ReceiveBuffer;
+    while(!buffer.Empty()) {
+        auto data = buffer.Readable();
+        web_frame_header header;
+        auto status = web_frame_header::Parse(data, client.MaxMessageSize, header);
+        if(status == web_packet_parse_code::missing_header)
+            break;
+        if(status == web_packet_parse_code::error) {
             client.connection.Disconnect();
             break;
         }
+        if(data.size() < header.FrameSize()) {
+            // make room for the whole frame now, the rest of it is then received in place behind what we have
+            buffer.Reserve(header.FrameSize());
+            break;
+        }
 
-        if(status != web_packet_parse_code::complete) {
-            LOG(WARNING, "Recv incomplete web-packet");
-            client.IncompletePacket = packet.value();
-            client.PreviousParseCode = status;
+        auto payload = data.subspan(header.HeaderSize, header.PayloadLength);
+        if(header.MaskFlag)
+            web_mask::Apply(payload.data(), payload.data(), payload.size(), header.Mask);
+        bool keep_connection = HandleWebSocketFrame(client, header, payload);
+        buffer.Consume(header.FrameSize());
+        if(!keep_connection) {
+            client.connection.Disconnect();
             break;
         }
+    }
+}
+
+bool web_server::HandleWebSocketFrame(client_ctx &client, const web_frame_header &header, span<uint8_t> payload) {
+    web_packet_view packet;
+    packet.OpCode = header.OpCode;
+    packet.RSV1 = header.RSV1;
+    packet.Payload = payload;
 
-        for(const auto& callback : m_websocket_callbacks) {
-            auto callback_status = callback(client, *packet);
-            if(callback_status == websocket_callback_status::processed)
-                return;
+    // RSV1 marks a compressed message, it is only valid on the first frame of a data message
+    if(header.RSV2 || header.RSV3 ||
+       (header.RSV1 && (!client.Deflate || header.IsControl() || header.OpCode == web_socket_opcode::ContinuationFrame))) {
+        LOG(ERR, "{} (WebSocket) sent a frame with unexpected reserved bits.", client.Name);
+        return false;
+    }
+
+    // control frames (ping, pong, close) may arrive between the fragments of a message
+    if(!header.IsControl()) {
+        if(header.OpCode == web_socket_opcode::ContinuationFrame) {
+            if(!client.FragmentedMessage) {
+                LOG(ERR, "{} (WebSocket) sent a continuation frame without a message to continue.", client.Name);
+                return false;
+            }
+            auto& message = client.FragmentBuffer;
+            if(message.size() + payload.size() > client.MaxMessageSize) {
+                LOG(ERR, "{} (WebSocket) fragmented message exceeds {} bytes. Closing Connection.", client.Name, client.MaxMessageSize);
+                return false;
+            }
+            message.insert(message.end(), payload.begin(), payload.end());
+            if(!header.FinalFragment)
+                return true;
+            packet.OpCode = client.FragmentedMessage->OpCode;
+            packet.RSV1 = client.FragmentedMessage->RSV1;
+            packet.Payload = message;
+            bool valid = DispatchWebSocketPacket(client, packet);
+            client.FragmentedMessage.reset();
+            message.clear();
+            // do not keep a multi-megabyte buffer around for an idle connection
+            if(message.capacity() > config::MaxHeaderSize)
+                message.shrink_to_fit();
+            return valid;
+        } else if(client.FragmentedMessage) {
+            LOG(ERR, "{} (WebSocket) started a new message before finishing the fragmented one.", client.Name);
+            return false;
+        } else if(!header.FinalFragment) {
+            // first fragment, the only copy a fragmented message makes is into the fragment buffer
+            client.FragmentedMessage = header;
+            client.FragmentBuffer.assign(payload.begin(), payload.end());
+            return true;
         }
+    }
+    return DispatchWebSocketPacket(client, packet);
+}
 
-        if(packet->OpCode == web_socket_opcode::ConnectionCloseFrame) {
-            LOG(INFOBOLD, "{} (WebSocket) sent disconnection packet.", client.connection.GetEndpoint().ToString());
-            client.connection.Disconnect();
-        } else if(packet->OpCode == web_socket_opcode::PingFrame) {
-            web_packet pong = *packet;
-            pong.EnsureUnmasked();
-            pong.MaskFlag = false;
-            pong.OpCode = web_socket_opcode::PongFrame;
-            client.SendPacket(pong);
-        } else if(packet->OpCode == web_socket_opcode::PongFrame) {
-            // pong, we have recved pong, what do we do now?
+bool web_server::DispatchWebSocketPacket(client_ctx &client, web_packet_view &packet) {
+    if(packet.RSV1) {
+        if(!client.Deflate->Decompress(packet.Payload, client.InflateBuffer, client.MaxMessageSize)) {
+            LOG(ERR, "{} (WebSocket) sent a message that could not be decompressed.", client.Name);
+            return false;
         }
+        packet.Payload = client.InflateBuffer;
+    }
+    if(packet.OpCode == web_socket_opcode::TextFrame || packet.OpCode == web_socket_opcode::BinaryFrame) {
+        if(client.WebSocketHandler)
+            (*client.WebSocketHandler)(client, packet);
+        return true;
+    }
 
-    } while(offset < data.size());
+    if(packet.OpCode == web_socket_opcode::PongFrame) {
+        m_heartbeat.OnPong(client.Heartbeat, packet.Payload, chrono::steady_clock::now());
+    } else if(packet.OpCode == web_socket_opcode::ConnectionCloseFrame) {
+        LOG(INFOBOLD, "{} (WebSocket) sent disconnection packet.", client.connection.GetEndpoint().ToString());
+        client.connection.Disconnect();
+    } else if(packet.OpCode == web_socket_opcode::PingFrame) {
+        web_packet pong;
+        pong.OpCode = web_socket_opcode::PongFrame;
+        pong.Payload.assign(packet.Payload.begin(), packet.Payload.end());
+        client.SendPacket(pong);
+    }
+    return true;
 }
 
 void web_server::PingWebSockets() {
     _safe_lock();
+    auto now = chrono::steady_clock::now();
     for(auto& client : m_clients) {
-        if(!client.isWebsocket)
+        if(client.isWebsocket)
+            client.Heartbeat.NextPing = now;
+    }
+    RunHeartbeat();
+    _safe_unlock();
+}
+
+void web_server::RunHeartbeat() {
+    if(!m_heartbeat.Config.Enabled)
+        return;
+    auto now = chrono::steady_clock::now();
+    array<uint8_t, 8> payload {};
+    for(auto& client : m_clients) {
+        if(!client.isWebsocket || !client.connection.IsConnected())
             continue;
-        web_packet packet = web_packet::GetPingPacket();
-        auto stream = packet.ToBinaryStream();
-        client.connection.Send(stream.data(), int32_t(stream.size()));
-        LOG(INFO, "Pinging {}", client.connection.GetEndpoint().ToString());
-    };
+        switch(m_heartbeat.Tick(client.Heartbeat, now, payload)) {
+            case web_heartbeat::tick_result::send_ping: {
+                web_packet ping;
+                ping.OpCode = web_socket_opcode::PingFrame;
+                ping.Payload.assign(payload.begin(), payload.end());
+                // ahead of the queued data, but never in the middle of a partially sent frame
+                client.SendPacket(ping);
+                break;
+            }
+            case web_heartbeat::tick_result::evict:
+                LOG(WARNING, "{} (WebSocket) missed {} pongs in a row, disconnecting.", client.Name,
+                    client.Heartbeat.MissedPongs);
+                client.connection.Disconnect();
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+rtt_percentiles web_server::GetRttPercentiles() {
+    _safe_lock();
+    auto percentiles = m_heartbeat.GetRttPercentiles();
     _safe_unlock();
+    return percentiles;
 }
 
 void web_server::AddHttpHandler(const middleware_callback &&callback)
@@ -350,33 +487,220 @@ void web_server::SendResponse(client_ctx& client, const http_request& request, h
 }
 
 void web_server::AddWebSocketHandler(const web_server::websocket_callback &&callback) {
-    m_websocket_callbacks.push_back(callback);
+    m_websocket_callbacks.push_back({ m_websocket_registrations++, callback });
+    ResetWebSocketHandlers();
+}
+
+shared_ptr<const web_server::websocket_callback> web_server::ResolveWebSocketHandler(const std::string &resource) {
+    if(auto it = m_websocket_chains.find(resource); it != m_websocket_chains.end())
+        return it->second;
+
+    vector<const websocket_registration*> chain;
+    for(const auto& registration : m_websocket_callbacks) {
+        chain.push_back(&registration);
+    }
+    if(auto it = m_port_websocket_callbacks.find(resource); it != m_port_websocket_callbacks.end()) {
+        for(const auto& registration : it->second)
+            chain.push_back(&registration);
+    }
+    if(auto it = m_port_websocket_callbacks_nocase.find(cpp::LowerCase(resource)); it != m_port_websocket_callbacks_nocase.end()) {
+        for(const auto& registration : it->second)
+            chain.push_back(&registration);
+    }
+    sort(chain.begin(), chain.end(), [](const auto* a, const auto* b) { return a->Order < b->Order; });
+
+    shared_ptr<const websocket_callback> handler;
+    if(chain.size() == 1) {
+        handler = make_shared<const websocket_callback>(chain.front()->Callback);
+    } else if(!chain.empty()) {
+        vector<websocket_callback> callbacks;
+        for(const auto* registration : chain) {
+            callbacks.push_back(registration->Callback);
+        }
+        handler = make_shared<const websocket_callback>([callbacks = std::move(callbacks)](client_ctx& client, web_packet_view& packet) {
+            for(const auto& callback : callbacks) {
+                if(callback(client, packet) == websocket_callback_status::processed)
+                    return websocket_callback_status::processed;
+            }
+            return websocket_callback_status::ignore;
+        });
+    }
+    // the resource comes from the client, do not let arbitrary paths grow the cache forever
+    if(m_websocket_chains.size() >= 1024)
+        m_websocket_chains.clear();
+    m_websocket_chains[resource] = handler;
+    return handler;
+}
+
+void web_server::ResetWebSocketHandlers() {
+    _safe_lock();
+    m_websocket_chains.clear();
+    for(auto& client : m_clients) {
+        if(client.isWebsocket)
+            client.WebSocketHandler = ResolveWebSocketHandler(client.WebSocketResource);
+    }
+    _safe_unlock();
+}
+
+void web_server::AddSubscribeHandler(const web_server::subscribe_callback &&callback) {
+    m_subscribe_callbacks.push_back(callback);
 }
 
+// Serializes a published packet at most once per encoding: plain, or deflated once per negotiated window size.
+class published_frame {
+public:
+    explicit published_frame(const web_packet& packet) : m_packet(packet) {}
+
+    web_frame_buffer For(client_ctx& client) {
+        auto* deflate = client.Deflate.get();
+        bool data_frame = m_packet.OpCode == web_socket_opcode::TextFrame || m_packet.OpCode == web_socket_opcode::BinaryFrame;
+        if(deflate && data_frame && !m_incompressible && m_packet.Payload.size() >= deflate->Options().MinMessageSize) {
+            int window_bits = deflate->Options().ServerWindowBits;
+            auto& frame = m_deflated[window_bits];
+            if(!frame) {
+                web_packet compressed;
+                compressed.OpCode = m_packet.OpCode;
+                compressed.RSV1 = true;
+                if(!web_deflate_context::CompressStandalone(m_packet.Payload, window_bits, 8, compressed.Payload)) {
+                    m_incompressible = true;
+                    return Plain();
+                }
+                frame = make_shared<const vector<uint8_t>>(compressed.ToBinaryStream());
+            }
+            deflate->InvalidateCompressorHistory();
+            return frame;
+        }
+        return Plain();
+    }
+
+private:
+    web_frame_buffer Plain() {
+        if(!m_plain)
+            m_plain = make_shared<const vector<uint8_t>>(m_packet.ToBinaryStream());
+        return m_plain;
+    }
+
+private:
+    const web_packet& m_packet;
+    web_frame_buffer m_plain;
+    web_frame_buffer m_deflated[16];
+    bool m_incompressible = false;
+};
+
 void web_server::SendAll(const web_packet &packet, const std::string& specific_port) {
+    if(!specific_port.empty()) {
+        Publish(specific_port, packet);
+        return;
+    }
     _safe_lock();
-    auto stream = packet.ToBinaryStream();
+    published_frame frame(packet);
     for(auto& client : m_clients) {
         if(!client.isWebsocket)
             continue;
-        if(!specific_port.empty() &&
-            specific_port != client.WebSocketResource)
+        client.SendFrame(frame.For(client));
+    }
+    _safe_unlock();
+}
+
+void web_server::Publish(const std::string &topic, const web_packet &packet, size_t coalesce_key) {
+    _safe_lock();
+    if(auto subscribers = m_topics.find(topic); subscribers != m_topics.end()) {
+        published_frame frame(packet);
+        for(auto* client : subscribers->second) {
+            client->SendFrame(frame.For(*client), coalesce_key);
+        }
+    }
+    _safe_unlock();
+}
+
+void web_server::PublishToTopics(const vector<std::string> &topics, const web_packet &packet, size_t coalesce_key) {
+    _safe_lock();
+    // a client subscribed to several of the topics receives the message once
+    vector<client_ctx*> subscribers;
+    for(const auto& topic : topics) {
+        if(auto it = m_topics.find(topic); it != m_topics.end())
+            subscribers.insert(subscribers.end(), it->second.begin(), it->second.end());
+    }
+    if(topics.size() > 1) {
+        sort(subscribers.begin(), subscribers.end());
+        subscribers.erase(unique(subscribers.begin(), subscribers.end()), subscribers.end());
+    }
+    published_frame frame(packet);
+    for(auto* client : subscribers) {
+        client->SendFrame(frame.For(*client), coalesce_key);
+    }
+    _safe_unlock();
+}
+
+void web_server::Subscribe(client_ctx &client, const std::string &topic) {
+    _safe_lock();
+    m_topics[topic].insert(&client);
+    if(client.Topics.insert(topic).second) {
+        for(const auto& callback : m_subscribe_callbacks) {
+            callback(client, topic);
+        }
+    }
+    _safe_unlock();
+}
+
+void web_server::Unsubscribe(client_ctx &client, const std::string &topic) {
+    _safe_lock();
+    if(auto it = m_topics.find(topic); it != m_topics.end()) {
+        it->second.erase(&client);
+        if(it->second.empty())
+            m_topics.erase(it);
+    }
+    client.Topics.erase(topic);
+    _safe_unlock();
+}
+
+void web_server::FlushSendQueues() {
+    for(auto& client : m_clients) {
+        if(!client.SendQueue.empty())
+            client.FlushSendQueue();
+    }
+}
+
+void web_server::SetWebSocketSendPolicy(const vector<std::string> &port, const websocket_send_policy &policy) {
+    for(const auto& item : port) {
+        m_websocket_send_policy[item] = policy;
+    }
+}
+
+websocket_queue_stats web_server::GetWebSocketQueueStats() {
+    _safe_lock();
+    websocket_queue_stats stats;
+    stats.DroppedFrames = m_dropped_frames;
+    stats.SlowConsumerDisconnects = m_slow_consumer_disconnects;
+    for(const auto& client : m_clients) {
+        if(!client.isWebsocket)
             continue;
-        client.connection.Send(stream.data(), (int32_t)stream.size());
+        stats.Connections++;
+        stats.QueuedFrames += client.SendQueue.size();
+        stats.QueuedBytes += client.QueuedBytes;
+        stats.LargestQueueBytes = max(stats.LargestQueueBytes, client.QueuedBytes);
+        stats.DroppedFrames += client.DroppedFrames;
     }
     _safe_unlock();
+    return stats;
 }
 
 void web_server::_safe_lock() {
-    if(m_current_lock_holder == cpp::GetCurrentThreadId())
+    if(m_current_lock_holder == cpp::GetCurrentThreadId()) {
+        // nested call (e.g. Publish from a websocket handler), only the outermost unlock releases the mutex
+        m_lock_depth++;
         return;
+    }
     m_clients_lock.lock();
     m_current_lock_holder = cpp::GetCurrentThreadId();
+    m_lock_depth = 1;
 }
 
 void web_server::_safe_unlock() {
     if(m_current_lock_holder != cpp::GetCurrentThreadId())
         return;
+    if(--m_lock_depth > 0)
+        return;
     m_current_lock_holder = 0;
     m_clients_lock.unlock();
 }
@@ -422,20 +746,117 @@ void web_server::AddPortWebSocketHandler(const vector<std::string> &port, const
                                     bool case_sensitive) {
     if(port.empty())
         return;
-    AddWebSocketHandler([=](client_ctx& client, web_packet& packet) -> websocket_callback_status {
-        bool is_route = ranges::any_of(port, [&](const auto &user_route) {
-            if (case_sensitive)
-                return user_route == client.WebSocketResource;
-            return cpp::EqualIgnoreCase(user_route, client.WebSocketResource);
-        });
-        if(is_route)
-            callback(client, packet);
-        return websocket_callback_status::ignore;
-    });
-    (void)case_sensitive;
+    auto order = m_websocket_registrations++;
+    for(const auto& item : port) {
+        if(case_sensitive)
+            m_port_websocket_callbacks[item].push_back({ order, callback });
+        else
+            m_port_websocket_callbacks_nocase[cpp::LowerCase(item)].push_back({ order, callback });
+    }
+    ResetWebSocketHandlers();
+}
+
+void web_server::SetWebSocketMaxMessageSize(const vector<std::string> &port, uint64_t max_message_size) {
+    for(const auto& item : port) {
+        m_websocket_max_message_size[item] = max_message_size;
+    }
 }
 
 void client_ctx::SendPacket(const web_packet &packet) {
-    auto stream = packet.ToBinaryStream();
-    connection.Send(stream.data(), (int32_t)stream.size());
+    if(packet.OpCode >= web_socket_opcode::ConnectionCloseFrame && packet.OpCode != web_socket_opcode::ERROR) {
+        SendFrame(make_shared<const vector<uint8_t>>(packet.ToBinaryStream()), 0, queued_frame_kind::control);
+        return;
+    }
+    bool data_frame = packet.OpCode == web_socket_opcode::TextFrame || packet.OpCode == web_socket_opcode::BinaryFrame;
+    if(Deflate && data_frame && !packet.RSV1 && packet.Payload.size() >= Deflate->Options().MinMessageSize) {
+        packet.EnsureUnmasked();
+        web_packet compressed;
+        compressed.OpCode = packet.OpCode;
+        compressed.RSV1 = true;
+        if(Deflate->Compress(packet.Payload, compressed.Payload)) {
+            SendFrame(make_shared<const vector<uint8_t>>(compressed.ToBinaryStream()), 0, queued_frame_kind::stream);
+            return;
+        }
+    }
+    SendFrame(make_shared<const vector<uint8_t>>(packet.ToBinaryStream()));
+}
+
+void client_ctx::SendFrame(web_frame_buffer frame, size_t coalesce_key, queued_frame_kind kind) {
+    auto size = frame->size();
+    if(kind == queued_frame_kind::control) {
+        // after the frame being written and the control frames queued before this one
+        size_t index = SendOffset > 0 ? 1 : 0;
+        while(index < SendQueue.size() && SendQueue[index].Kind == queued_frame_kind::control)
+            index++;
+        QueuedBytes += size;
+        SendQueue.insert(SendQueue.begin() + ptrdiff_t(index), { std::move(frame), kind, 0, chrono::steady_clock::now() });
+        FlushSendQueue();
+        return;
+    }
+    if(coalesce_key != 0 && SendPolicy.Policy == websocket_backlog_policy::coalesce_latest) {
+        // the front frame may be half written, it cannot be replaced
+        for(size_t i = SendOffset > 0 ? 1 : 0; i < SendQueue.size(); i++) {
+            auto& queued = SendQueue[i];
+            if(queued.CoalesceKey != coalesce_key || queued.Kind != queued_frame_kind::data)
+                continue;
+            QueuedBytes = QueuedBytes - queued.Frame->size() + size;
+            queued.Frame = std::move(frame);
+            DroppedFrames++;
+            FlushSendQueue();
+            return;
+        }
+    }
+    QueuedBytes += size;
+    SendQueue.push_back({ std::move(frame), kind, coalesce_key, chrono::steady_clock::now() });
+    FlushSendQueue();
+}
+
+bool client_ctx::FlushSendQueue() {
+    while(!SendQueue.empty()) {
+        const auto& frame = *SendQueue.front().Frame;
+        auto remaining = int32_t(min<size_t>(frame.size() - SendOffset, INT32_MAX));
+        int32_t sent = connection.Send(frame.data() + SendOffset, remaining);
+        if(sent <= 0)
+            break; // socket buffer is full (or the connection dropped), retry on the next tick
+        SendOffset += sent;
+        QueuedBytes -= sent;
+        if(SendOffset < frame.size())
+            break;
+        SendQueue.pop_front();
+        SendOffset = 0;
+    }
+    if(SendQueue.empty())
+        return true;
+
+    auto age = chrono::steady_clock::now() - SendQueue.front().QueuedTime;
+    bool over_limit = QueuedBytes > SendPolicy.MaxQueuedBytes || age > SendPolicy.MaxBacklogAge;
+    if(!over_limit)
+        return true;
+    if(SendPolicy.Policy == websocket_backlog_policy::disconnect) {
+        SlowConsumer = true;
+        connection.Disconnect();
+        return false;
+    }
+    // drop whole data frames from the front (never the half written one) until we are back within limits
+    auto now = chrono::steady_clock::now();
+    size_t index = SendOffset > 0 ? 1 : 0;
+    while(index < SendQueue.size()) {
+        auto& oldest = SendQueue[index];
+        if(QueuedBytes <= SendPolicy.MaxQueuedBytes && now - oldest.QueuedTime <= SendPolicy.MaxBacklogAge)
+            break;
+        if(oldest.Kind != queued_frame_kind::data) {
+            index++;
+            continue;
+        }
+        QueuedBytes -= oldest.Frame->size();
+        SendQueue.erase(SendQueue.begin() + ptrdiff_t(index));
+        DroppedFrames++;
+    }
+    if(QueuedBytes > SendPolicy.MaxQueuedBytes) {
+        // what is left cannot be dropped
+        SlowConsumer = true;
+        connection.Disconnect();
+        return false;
+    }
+    return true;
 }
@@ -7,12 +7,19 @@
 #include "Socket.hpp"
 #include <optional>
 #include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <memory>
 #include <chrono>
 #include <span>
 #include <mutex>
 #include <functional>
 #include "http_header.h"
 #include "web_packet.h"
+#include "ring_buffer.h"
+#include "web_deflate.h"
+#include "web_heartbeat.h"
+#include "user_data.h"
 
 enum class server_error_flag {
     MalformedHTTPRequest,
@@ -31,8 +38,49 @@ enum class websocket_callback_status {
     ignore
 };
 
-struct client_ctx_user_data {
+struct client_ctx;
+using websocket_handler = std::function<websocket_callback_status(client_ctx& client, web_packet_view& packet)>;
 
+// Serialized websocket frame shared by every connection it is queued on.
+using web_frame_buffer = std::shared_ptr<const std::vector<uint8_t>>;
+
+// What happens to a websocket whose peer reads slower than we publish.
+enum class websocket_backlog_policy {
+    // frames are dropped from the front of the queue once the limits are exceeded
+    drop_oldest,
+    // a new frame replaces the queued, unsent frame of the same topic (latest snapshot wins), then drop_oldest
+    coalesce_latest,
+    // the connection is closed once the limits are exceeded
+    disconnect
+};
+
+struct websocket_send_policy {
+    websocket_backlog_policy Policy = websocket_backlog_policy::disconnect;
+    size_t MaxQueuedBytes = 1024 * 1024 * 8;
+    std::chrono::milliseconds MaxBacklogAge = std::chrono::seconds(30);
+};
+
+struct websocket_queue_stats {
+    size_t Connections = 0;
+    size_t QueuedFrames = 0;
+    size_t QueuedBytes = 0;
+    size_t LargestQueueBytes = 0;
+    uint64_t DroppedFrames = 0;
+    uint64_t SlowConsumerDisconnects = 0;
+};
+
+enum class queued_frame_kind {
+    data,   // may be dropped or coalesced by the backlog policy
+    stream, // compressed against the connection's deflate history, the peer cannot inflate what follows without it
+    control // ping, pong, close: sent ahead of queued data frames so RTT measures the link, never dropped
+};
+
+struct queued_frame {
+    web_frame_buffer Frame;
+    queued_frame_kind Kind = queued_frame_kind::data;
+    // frames with the same non-zero key may replace each other (coalesce_latest), 0 is never replaced
+    size_t CoalesceKey = 0;
+    std::chrono::steady_clock::time_point QueuedTime;
 };
 
 struct client_ctx {
@@ -40,60 +88,54 @@ struct client_ctx {
     bool isWebsocket = false;
     std::string WebSocketResource;
     std::string Name;
+    // Peer address of the connection, set once when it is accepted. WaitForData matches ready sockets by it, Name is
+    // only a display name the application may change.
+    std::string Endpoint;
     std::chrono::steady_clock::time_point connectedTime = std::chrono::steady_clock::now();
     std::vector<uint8_t> IncompleteRequest;
-    web_packet IncompletePacket;
-    web_packet_parse_code PreviousParseCode = web_packet_parse_code::complete;
+    // Set by WaitForData when the socket has bytes to read, only then is ReceiveBuffer borrowed and Recv called.
+    bool Readable = false;
+    ring_buffer ReceiveBuffer;
+    // Header of the first frame of a fragmented message, its payload and the continuations are kept in FragmentBuffer.
+    std::optional<web_frame_header> FragmentedMessage;
+    std::vector<uint8_t> FragmentBuffer;
+    uint64_t MaxMessageSize = config::WebSocketMaxMessageSize;
+    // Topics this client is subscribed to, the connection's port is always one of them.
+    std::unordered_set<std::string> Topics;
+    // Frames waiting for the socket, SendOffset bytes of the first one are already sent.
+    std::deque<queued_frame> SendQueue;
+    size_t SendOffset = 0;
+    size_t QueuedBytes = 0;
+    uint64_t DroppedFrames = 0;
+    bool SlowConsumer = false;
+    websocket_send_policy SendPolicy;
+    heartbeat_state Heartbeat;
+    // Every handler registered for WebSocketResource, resolved once at handshake time.
+    std::shared_ptr<const websocket_handler> WebSocketHandler;
+    // permessage-deflate state, only set when the extension was negotiated.
+    std::shared_ptr<web_deflate_context> Deflate;
+    std::vector<uint8_t> InflateBuffer;
 
     void SendPacket(const web_packet& packet);
+    void SendFrame(web_frame_buffer frame, size_t coalesce_key = 0, queued_frame_kind kind = queued_frame_kind::data);
+    // Writes as much of the send queue as the socket accepts without blocking, then applies the backlog policy: only
+    // data frames are dropped, a client still over MaxQueuedBytes without them is disconnected.
+    // Returns false if the client was disconnected for being too slow.
+    bool FlushSendQueue();
 
-    client_ctx() = default;
-
-    client_ctx(const client_ctx& copy) noexcept {
-        connection = copy.connection;
-        isWebsocket = copy.isWebsocket;
-        WebSocketResource = copy.WebSocketResource;
-        Name = copy.Name;
-        connectedTime = copy.connectedTime;
-        IncompleteRequest = copy.IncompleteRequest;
-        IncompletePacket = copy.IncompletePacket;
-        PreviousParseCode = copy.PreviousParseCode;
-        m_user_defined_data = copy.m_user_defined_data;
-    }
-
-    ~client_ctx() {
-        m_destroy_user_data_object();
-    }
+    // Per-connection state of the application (e.g. a page's counter), destroyed with the client.
+    user_data UserData;
 
     template<class T>
-    T& GetOrCreateUserData()
-    {
-        if(!m_user_defined_data) {
-            m_user_defined_data = std::make_shared<std::vector<uint8_t>>(sizeof(T));
-            (void) new(m_user_defined_data.get()) T();
-
-            m_destroy_user_data_object = [&]() {
-                auto object = (T*)m_user_defined_data.get()->data();
-                object->~T();
-            };
-        }
-        return *(T*)m_user_defined_data.get();
+    T& GetOrCreateUserData() {
+        return UserData.GetOrCreate<T>();
     }
 
     // Manually release user-data object (the object will also be released when client_ctx deconstructor is invoked,
     // which occurs when client is disconnected).
     void ClearUserDataObject() {
-        m_destroy_user_data_object();
-        m_user_defined_data = nullptr;
+        UserData.Reset();
     }
-
-private:
-    std::function<void()> m_destroy_user_data_object = []() {};
-    std::function<void()> m_copy_object = []() {};
-    std::function<void()> m_move_object = []() {};
-    std::function<void()> m_assignment_object = []() {};
-    //std::shared_ptr<uint8_t[]> m_user_defined_data = nullptr;
-    std::shared_ptr<std::vector<uint8_t>> m_user_defined_data = nullptr;
 };
 
 class web_server {
@@ -101,43 +143,71 @@ class web_server {
     using middleware_callback = std::function<middleware_route_status(http_request& request,
                                                                       std::optional<http_response>& response)>;
 
-    using websocket_callback = std::function<websocket_callback_status(client_ctx& client, web_packet& packet)>;
+    using websocket_callback = websocket_handler;
 
     using postprocess_callback = std::function<void(const http_request& request, http_response& response)>;
 
+    using subscribe_callback = std::function<void(client_ctx& client, const std::string& topic)>;
+
 public:
     explicit web_server(int port = 80);
 
     void Serve();
+    // Pings every websocket right away, regular pings are sent by the heartbeat scheduler.
     void PingWebSockets();
+    rtt_percentiles GetRttPercentiles();
 
     void SendAll(const web_packet& packet, const std::string& specific_port = "");
+    // Serializes the packet once and queues the same buffer on every subscriber of the given topic(s).
+    // Queued frames with the same non-zero coalesce key replace each other for coalescing clients, only states where the
+    // newest one supersedes the older ones (snapshots) should pass one. 0 (messages, chat lines) is never coalesced.
+    void Publish(const std::string& topic, const web_packet& packet, size_t coalesce_key = 0);
+    void PublishToTopics(const std::vector<std::string>& topics, const web_packet& packet, size_t coalesce_key = 0);
+    void Subscribe(client_ctx& client, const std::string& topic);
+    void Unsubscribe(client_ctx& client, const std::string& topic);
 
     void AddHttpHandler(const middleware_callback &&callback);
     void AddHttpRouteHandler(const std::vector<std::string> &route, const middleware_callback &&callback, bool case_sensitive = true);
     void AddPostProcess(const postprocess_callback&& callback);
     void AddRoutePostProcess(const std::vector<std::string> &route, const postprocess_callback &&callback, bool case_sensitive = true);
 
+    // Handlers see the text and binary messages of a connection in registration order, until one returns processed.
+    // Control frames (close, ping, pong) are answered by the server.
     void AddWebSocketHandler(const websocket_callback&& callback);
+    // Called (with the clients lock held) whenever a client joins a topic, e.g. to send it the current state.
+    void AddSubscribeHandler(const subscribe_callback&& callback);
     void AddPortWebSocketHandler(const std::vector<std::string> &port, const websocket_callback&& callback, bool case_sensitive = true);
+    // Largest message (after reassembling fragments) accepted on the given ports, larger messages close the connection.
+    void SetWebSocketMaxMessageSize(const std::vector<std::string> &port, uint64_t max_message_size);
+    // How outbound frames are queued for slow clients connected on the given ports.
+    void SetWebSocketSendPolicy(const std::vector<std::string> &port, const websocket_send_policy& policy);
+    websocket_queue_stats GetWebSocketQueueStats();
 
     static std::string GetMimeCode(const std::string& extension, const std::string& fallback);
 
 public:
     std::unordered_map<std::string, std::string> DefaultHeaders;
+    web_deflate_config WebSocketCompression;
+    heartbeat_config& Heartbeat = m_heartbeat.Config;
 
 private:
     void AcceptClient();
     void WaitForData(int32_t timeout);
     void ProcessClients();
     void RemoveDisconnectedClients();
+    void FlushSendQueues();
+    void RunHeartbeat();
+    std::shared_ptr<const websocket_callback> ResolveWebSocketHandler(const std::string& resource);
+    void ResetWebSocketHandlers();
 
     void SendErrorResponse(client_ctx& client, server_error_flag flag);
     static std::optional<std::vector<uint8_t>> LoadStaticAsset(const http_request& comparisons, std::string& mime_code, http_code& code);
     void WebSocketHandshake(client_ctx& client, http_request& request);
     void SendResponse(client_ctx& client, const http_request& request, http_response& response);
     void HandleRequest(client_ctx& client, http_request& request);
-    void HandleWebSocketRequest(client_ctx& ctx, std::span<uint8_t> data);
+    void HandleWebSocketRequest(client_ctx& ctx);
+    bool HandleWebSocketFrame(client_ctx& client, const web_frame_header& header, std::span<uint8_t> payload);
+    bool DispatchWebSocketPacket(client_ctx& client, web_packet_view& packet);
 
 private:
     void _safe_lock();
@@ -147,10 +217,28 @@ private:
     sw::Socket m_server;
     std::mutex m_clients_lock;
     volatile uint64_t m_current_lock_holder = 0;
+    uint32_t m_lock_depth = 0;
     std::list<middleware_callback> m_http_callbacks;
-    std::list<websocket_callback> m_websocket_callbacks;
+    struct websocket_registration {
+        uint64_t Order;
+        websocket_callback Callback;
+    };
+    std::vector<websocket_registration> m_websocket_callbacks;
+    // port handlers by exact resource, and by lower case resource for case insensitive registrations
+    std::unordered_map<std::string, std::vector<websocket_registration>> m_port_websocket_callbacks;
+    std::unordered_map<std::string, std::vector<websocket_registration>> m_port_websocket_callbacks_nocase;
+    std::unordered_map<std::string, std::shared_ptr<const websocket_callback>> m_websocket_chains;
+    uint64_t m_websocket_registrations = 0;
     std::list<postprocess_callback> m_postprocess_http;
+    std::list<subscribe_callback> m_subscribe_callbacks;
     std::list<client_ctx> m_clients;
+    // topic -> subscribed websocket clients (client_ctx lives in m_clients, a list, so the pointers are stable)
+    std::unordered_map<std::string, std::unordered_set<client_ctx*>> m_topics;
+    std::unordered_map<std::string, uint64_t> m_websocket_max_message_size;
+    std::unordered_map<std::string, websocket_send_policy> m_websocket_send_policy;
+    uint64_t m_dropped_frames = 0;
+    uint64_t m_slow_consumer_disconnects = 0;
+    web_heartbeat m_heartbeat;
 };
 
 
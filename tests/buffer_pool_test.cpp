@@ -0,0 +1,115 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "buffer_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <set>
+
+using namespace std;
+
+TEST_CASE(buffer_pool, size_classes) {
+    CHECK(buffer_pool::Capacity(0) == 4096 && buffer_pool::Capacity(1) == 4096 && buffer_pool::Capacity(4096) == 4096);
+    CHECK(buffer_pool::Capacity(4097) == 8192 && buffer_pool::Capacity(65536) == 65536);
+    CHECK(buffer_pool::Capacity(65537) == 131072);
+    CHECK(buffer_pool::Capacity(16 * 1024 * 1024) == 16 * 1024 * 1024);
+    // past the largest class, buffers are exactly the requested size
+    CHECK(buffer_pool::Capacity(16 * 1024 * 1024 + 1) == 16 * 1024 * 1024 + 1);
+}
+
+TEST_CASE(buffer_pool, arena_reuse) {
+    buffer_pool pool;
+    auto* first = pool.Borrow(100);
+    auto stats = pool.Stats();
+    CHECK(stats.Borrowed == 1 && stats.BorrowedBytes == 4096 && stats.ArenaBytes == buffer_pool::ArenaSize);
+    CHECK(stats.CachedBytes == buffer_pool::ArenaSize - 4096);
+    pool.Return(first, 100);
+    CHECK(pool.Stats().Borrowed == 0 && pool.Stats().CachedBytes == buffer_pool::ArenaSize);
+    // the buffer returned last is borrowed first, still warm in the cache
+    CHECK(pool.Borrow(4000) == first);
+
+    // an arena holds 512 buffers of 4 KB, all distinct and usable
+    set<uint8_t*> buffers { first };
+    for(int i = 1; i < 512; i++) {
+        auto* buffer = pool.Borrow(4096);
+        memset(buffer, i, 4096);
+        buffers.insert(buffer);
+    }
+    CHECK(buffers.size() == 512 && pool.Stats().ArenaBytes == buffer_pool::ArenaSize);
+    CHECK(*max_element(buffers.begin(), buffers.end()) - *buffers.begin() == buffer_pool::ArenaSize - 4096);
+    auto* next = pool.Borrow(4096);
+    CHECK(!buffers.contains(next) && pool.Stats().ArenaBytes == 2 * buffer_pool::ArenaSize);
+    // every class up to 64 KB has arenas of its own
+    auto* larger = pool.Borrow(64 * 1024);
+    CHECK(pool.Stats().ArenaBytes == 3 * buffer_pool::ArenaSize);
+
+    pool.Return(next, 4096);
+    pool.Return(larger, 64 * 1024);
+    for(auto* buffer : buffers)
+        pool.Return(buffer, 4096);
+    stats = pool.Stats();
+    CHECK(stats.Borrowed == 0 && stats.BorrowedBytes == 0 && stats.CachedBytes == 3 * buffer_pool::ArenaSize);
+}
+
+TEST_CASE(buffer_pool, large_buffers) {
+    buffer_pool pool;
+    auto* buffer = pool.Borrow(1024 * 1024);
+    memset(buffer, 1, 1024 * 1024);
+    auto stats = pool.Stats();
+    CHECK(stats.ArenaBytes == 0 && stats.CachedBytes == 0 && stats.BorrowedBytes == 1024 * 1024);
+    pool.Return(buffer, 1024 * 1024);
+    CHECK(pool.Stats().CachedBytes == 1024 * 1024 && pool.Borrow(1000 * 1000) == buffer);
+
+    // at most 64 MB of large buffers are kept for reuse
+    vector<uint8_t*> buffers { buffer };
+    for(int i = 1; i < 65; i++)
+        buffers.push_back(pool.Borrow(1024 * 1024));
+    for(auto* item : buffers)
+        pool.Return(item, 1024 * 1024);
+    stats = pool.Stats();
+    CHECK(stats.Borrowed == 0 && stats.CachedBytes == 64 * 1024 * 1024);
+
+    // beyond the largest class buffers are neither counted nor cached
+    auto* huge = pool.Borrow(17 * 1024 * 1024);
+    CHECK(pool.Stats().Borrowed == 0);
+    pool.Return(huge, 17 * 1024 * 1024);
+    CHECK(pool.Stats().CachedBytes == 64 * 1024 * 1024);
+}
+
+// Without hugepages reserved the arenas fall back to regular pages.
+TEST_CASE(buffer_pool, huge_pages) {
+    buffer_pool pool(true);
+    auto* buffer = pool.Borrow(8192);
+    memset(buffer, 0, 8192);
+    CHECK(pool.Stats().ArenaBytes == buffer_pool::ArenaSize);
+    pool.Return(buffer, 8192);
+    pool.EnableHugePages(false);
+    buffer = pool.Borrow(16384);
+    CHECK(pool.Stats().ArenaBytes == 2 * buffer_pool::ArenaSize);
+    pool.Return(buffer, 16384);
+}
+
+TEST_CASE(buffer_pool, concurrent_borrowers) {
+    buffer_pool pool;
+    vector<thread> threads;
+    for(int t = 0; t < 4; t++) {
+        threads.emplace_back([&pool, t] {
+            for(int i = 0; i < 10000; i++) {
+                size_t size = size_t(4096) << ((i + t) % 6);
+                auto* buffer = pool.Borrow(size);
+                buffer[0] = buffer[size - 1] = uint8_t(t);
+                pool.Return(buffer, size);
+            }
+        });
+    }
+    for(auto& thread : threads)
+        thread.join();
+    auto stats = pool.Stats();
+    CHECK(stats.Borrowed == 0 && stats.BorrowedBytes == 0);
+    // one arena per small class, and a 128 KB buffer for each thread that held one at the same time
+    CHECK(stats.ArenaBytes == 5 * buffer_pool::ArenaSize);
+    CHECK(stats.CachedBytes > stats.ArenaBytes && stats.CachedBytes <= stats.ArenaBytes + 4 * 128 * 1024);
+}
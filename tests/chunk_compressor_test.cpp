@@ -0,0 +1,115 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "chunk_compressor.h"
+#include "file_transfer_protocol.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+using namespace std;
+using namespace file_transfer;
+
+// Chunk i of a test file: random bytes, repeated text or a mix of both, so some chunks compress and some do not.
+static vector<uint8_t> chunk_data(uint32_t i, uint32_t seed = 0) {
+    mt19937 random(i * 31 + seed);
+    size_t length = i % 7 == 0 ? DataChunkSize : random() % (DataChunkSize / 8) + 1;
+    vector<uint8_t> data(length);
+    for(size_t j = 0; j < length; j++) {
+        bool text = i % 3 == 0 || (i % 3 == 1 && j % 4096 < 2048);
+        data[j] = text ? uint8_t("lorem ipsum "[j % 12]) : uint8_t(random());
+    }
+    return data;
+}
+
+static vector<uint8_t> expected_frame(uint32_t file_id, uint64_t offset, const vector<uint8_t>& data) {
+    vector<uint8_t> frame;
+    AppendDataFrame(frame, file_id, offset, data, true);
+    return frame;
+}
+
+// Pushes count chunks through the compressor the way send_file does and checks every frame, in order.
+static bool compress_in_order(chunk_compressor& compressor, uint32_t count, uint32_t seed = 0) {
+    bool in_order = true;
+    uint32_t submitted = 0, popped = 0;
+    uint64_t offset = 0;
+    vector<uint64_t> offsets;
+    while(popped < count) {
+        if(submitted < count && !compressor.Full()) {
+            auto data = chunk_data(submitted, seed);
+            auto next = compressor.Next();
+            memcpy(next.data(), data.data(), data.size());
+            compressor.Submit(7, offset, data.size());
+            offsets.push_back(offset);
+            offset += data.size();
+            submitted++;
+            continue;
+        }
+        auto frame = compressor.Front();
+        auto expected = expected_frame(7, offsets[popped], chunk_data(popped, seed));
+        in_order &= vector<uint8_t>(frame.begin(), frame.end()) == expected;
+        compressor.Pop();
+        popped++;
+    }
+    return in_order && compressor.Empty();
+}
+
+TEST_CASE(chunk_compressor, ordered_output) {
+    for(size_t workers : { 1, 2, 3, 8, 64 }) {
+        chunk_compressor compressor(workers);
+        CHECK(compressor.Empty() && !compressor.Full());
+        CHECK(compress_in_order(compressor, 30));
+
+        uint64_t raw = 0, frames = 0;
+        for(uint32_t i = 0; i < 30; i++) {
+            auto data = chunk_data(i);
+            frames += expected_frame(7, raw, data).size();
+            raw += data.size();
+        }
+        CHECK(compressor.RawBytes() == raw && compressor.FrameBytes() == frames && frames < raw);
+    }
+}
+
+// Two slots per worker, at most 8 workers.
+TEST_CASE(chunk_compressor, ring_size) {
+    for(size_t workers : { 0, 1, 3, 8, 9 }) {
+        chunk_compressor compressor(workers);
+        size_t slots = 0;
+        while(!compressor.Full()) {
+            CHECK(compressor.Next().size() == DataChunkSize);
+            compressor.Submit(1, 0, 100);
+            slots++;
+        }
+        CHECK(slots == 2 * clamp<size_t>(workers, 1, chunk_compressor::MaxWorkers));
+        compressor.Clear();
+        CHECK(compressor.Empty());
+    }
+}
+
+// Clearing while workers are compressing waits for them, drops the rest, and leaves no stale frame behind.
+TEST_CASE(chunk_compressor, clear_in_flight) {
+    chunk_compressor compressor(4);
+    compressor.Clear(); // nothing in flight
+    for(uint32_t round = 0; round < 20; round++) {
+        for(uint32_t i = 0; !compressor.Full(); i++) {
+            auto data = chunk_data(i * 7, round); // whole 1 MB chunks keep the workers busy
+            memcpy(compressor.Next().data(), data.data(), data.size());
+            compressor.Submit(round, 0, data.size());
+        }
+        if(round % 2) {
+            // part of the ring was already sent
+            (void)compressor.Front();
+            compressor.Pop();
+        }
+        compressor.Clear();
+        CHECK(compressor.Empty() && !compressor.Full());
+        CHECK(compress_in_order(compressor, 10, round + 1));
+    }
+
+    // chunks still queued when the compressor goes away are dropped
+    chunk_compressor abandoned(2);
+    while(!abandoned.Full())
+        abandoned.Submit(1, 0, DataChunkSize);
+}
@@ -0,0 +1,128 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "content_chunker.h"
+#include "chunk_store.h"
+#include <array>
+#include <fstream>
+#include <random>
+
+using namespace std;
+using namespace content_chunker;
+
+// The chunker written out byte by byte from its definition, to check the vector kernels against.
+static size_t reference_next_chunk(span<const uint8_t> data) {
+    static const auto gear = [] {
+        array<uint32_t, 256> table {};
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        for(auto& value : table) {
+            state += 0x9E3779B97F4A7C15ull;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            value = uint32_t((z ^ (z >> 31)) >> 32);
+        }
+        return table;
+    }();
+    if(data.size() <= MinChunkSize)
+        return data.size();
+    size_t end = min(data.size(), MaxChunkSize);
+    uint32_t hash = 0;
+    for(size_t p = MinChunkSize - 31; p < end; p++) {
+        hash = (hash << 1) + gear[data[p]];
+        uint32_t mask = p < AverageChunkSize ? 0xFFFFC000 : 0xFFFC0000;
+        if(p >= MinChunkSize && !(hash & mask))
+            return p + 1;
+    }
+    return end;
+}
+
+static vector<size_t> chunk_lengths(span<const uint8_t> data, size_t (*next_chunk)(span<const uint8_t>)) {
+    vector<size_t> lengths;
+    for(size_t offset = 0; offset < data.size(); offset += lengths.back())
+        lengths.push_back(next_chunk(data.subspan(offset)));
+    return lengths;
+}
+
+static vector<uint8_t> random_data(size_t size, uint64_t seed) {
+    mt19937_64 random(seed);
+    vector<uint8_t> data(size);
+    for(auto& byte : data)
+        byte = uint8_t(random());
+    return data;
+}
+
+TEST_CASE(content_chunker, matches_reference) {
+    auto data = random_data(16 << 20, 1);
+    // a run of zeros never matches the mask and is cut at MaxChunkSize
+    fill(data.begin() + (4 << 20), data.begin() + (5 << 20), 0);
+    auto lengths = chunk_lengths(data, NextChunk);
+    CHECK(lengths == chunk_lengths(data, reference_next_chunk));
+    CHECK(chunk_lengths(data, NextChunk) == lengths);
+}
+
+TEST_CASE(content_chunker, lengths_stay_within_bounds) {
+    auto data = random_data(16 << 20, 2);
+    fill(data.begin() + (4 << 20), data.begin() + (5 << 20), 0);
+    auto lengths = chunk_lengths(data, NextChunk);
+    size_t total = 0;
+    for(size_t i = 0; i < lengths.size(); i++) {
+        CHECK(lengths[i] <= MaxChunkSize);
+        CHECK(lengths[i] > MinChunkSize || i + 1 == lengths.size());
+        total += lengths[i];
+    }
+    CHECK(total == data.size());
+    // normalized chunking keeps the average near AverageChunkSize
+    size_t average = data.size() / lengths.size();
+    CHECK(average > AverageChunkSize / 2 && average < 2 * AverageChunkSize);
+    CHECK(NextChunk({ data.data(), 100 }) == 100);
+    CHECK(NextChunk({}) == 0);
+}
+
+TEST_CASE(content_chunker, insertion_keeps_later_boundaries) {
+    auto data = random_data(8 << 20, 3);
+    auto lengths = chunk_lengths(data, NextChunk);
+    auto edited = data;
+    edited.insert(edited.begin() + 100000, 17, 3);
+    auto edited_lengths = chunk_lengths(edited, NextChunk);
+    // the chunks after the one holding the insertion are cut exactly as before
+    size_t unchanged = 0;
+    for(auto it = lengths.rbegin(), edited_it = edited_lengths.rbegin();
+        it != lengths.rend() && edited_it != edited_lengths.rend() && *it == *edited_it; ++it, ++edited_it)
+        unchanged++;
+    CHECK(unchanged + 3 >= lengths.size());
+}
+
+// Chunks written to the store read back as they were, and a damaged one is refused.
+TEST_CASE(content_chunker, chunks_round_trip_through_store) {
+    auto directory = filesystem::temp_directory_path() / "webclient_test_chunk_store";
+    filesystem::remove_all(directory);
+    chunk_store store(directory);
+    auto data = random_data(2 << 20, 4);
+    vector<sha256::digest> hashes;
+    for(size_t offset = 0, length; offset < data.size(); offset += length) {
+        length = NextChunk(span<const uint8_t>(data).subspan(offset));
+        auto chunk = span<const uint8_t>(data).subspan(offset, length);
+        hashes.push_back(sha256::Hash(chunk));
+        CHECK(store.Write(hashes.back(), chunk));
+        CHECK(store.Write(hashes.back(), chunk)); // already stored
+    }
+    vector<uint8_t> rebuilt, chunk;
+    for(const auto& hash : hashes) {
+        CHECK(store.Read(hash, chunk));
+        rebuilt.insert(rebuilt.end(), chunk.begin(), chunk.end());
+    }
+    CHECK(rebuilt == data);
+
+    auto name = sha256::ToHex(hashes[0]);
+    {
+        fstream file(directory / name.substr(0, 2) / name, ios::binary | ios::in | ios::out);
+        file.seekp(10);
+        file.put('x');
+    }
+    CHECK(!store.Read(hashes[0], chunk));
+    CHECK(!store.Read(sha256::Hash(span<const uint8_t>()), chunk));
+    filesystem::remove_all(directory);
+}
@@ -0,0 +1,67 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "crc32c.h"
+#include <numeric>
+#include <random>
+#include <string_view>
+
+using namespace std;
+
+static uint32_t crc_of(string_view text) {
+    return crc32c::Compute({ reinterpret_cast<const uint8_t*>(text.data()), text.size() });
+}
+
+// One bit at a time, straight from the definition.
+static uint32_t crc_bitwise(span<const uint8_t> data) {
+    uint32_t crc = 0xFFFFFFFF;
+    for(uint8_t byte : data) {
+        crc ^= byte;
+        for(int i = 0; i < 8; i++)
+            crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+    }
+    return ~crc;
+}
+
+// The catalogue check value and the iSCSI examples of RFC 3720, B.4.
+TEST_CASE(crc32c, known_vectors) {
+    CHECK(crc_of("") == 0);
+    CHECK(crc_of("123456789") == 0xE3069283);
+    vector<uint8_t> data(32, 0);
+    CHECK(crc32c::Compute(data) == 0x8A9136AA);
+    fill(data.begin(), data.end(), 0xFF);
+    CHECK(crc32c::Compute(data) == 0x62A8AB43);
+    iota(data.begin(), data.end(), 0);
+    CHECK(crc32c::Compute(data) == 0x46DD794E);
+}
+
+// Every length around the kernel's block and stream sizes, from every alignment.
+TEST_CASE(crc32c, matches_bitwise_reference) {
+    mt19937 random(1);
+    vector<uint8_t> data(3 * 4096 * 3 + 64);
+    for(auto& byte : data)
+        byte = uint8_t(random());
+    span<const uint8_t> all(data);
+    for(size_t align = 0; align < 8; align++) {
+        for(size_t length = 0; length <= 64; length++)
+            CHECK(crc32c::Compute(all.subspan(align, length)) == crc_bitwise(all.subspan(align, length)));
+        for(size_t length : { size_t(3 * 4096 - 1), size_t(3 * 4096), size_t(3 * 4096 + 9), data.size() - 8 })
+            CHECK(crc32c::Compute(all.subspan(align, length)) == crc_bitwise(all.subspan(align, length)));
+    }
+}
+
+TEST_CASE(crc32c, incremental_matches_one_shot) {
+    mt19937 random(2);
+    vector<uint8_t> data(1 << 20);
+    for(auto& byte : data)
+        byte = uint8_t(random());
+    uint32_t crc = 0;
+    for(size_t offset = 0; offset < data.size();) {
+        size_t length = min<size_t>(random() % 20000, data.size() - offset);
+        crc = crc32c::Update(crc, { data.data() + offset, length });
+        offset += length;
+    }
+    CHECK(crc == crc32c::Compute(data));
+}
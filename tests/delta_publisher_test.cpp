@@ -0,0 +1,119 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "delta_publisher.h"
+#include <algorithm>
+
+using namespace std;
+
+static constexpr uint16_t TestPort = 47401;
+
+// A websocket client of the test server, subscribed to the resource it connected to.
+struct subscriber {
+    sw::Socket Socket { sw::SocketType::TCP };
+    string Received;
+    vector<web_socket_opcode> OpCodes;
+
+    subscriber(web_server& server, uint16_t port, const string& resource) {
+        Socket.Connect("127.0.0.1", port);
+        Socket.SetBlockingMode(false);
+        Socket.Send("GET " + resource + " HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+        size_t end = string::npos;
+        for(int i = 0; i < 200 && end == string::npos; i++) {
+            server.Serve();
+            Read();
+            end = Received.find("\r\n\r\n");
+        }
+        CHECK(Received.starts_with("HTTP/1.1 101"));
+        Received.erase(0, end == string::npos ? Received.size() : end + 4);
+    }
+
+    ~subscriber() { Socket.Disconnect().Close(); }
+
+    void Read() {
+        char buffer[4096];
+        for(int32_t length; (length = Socket.Recv(buffer, sizeof(buffer), false)) > 0;)
+            Received.append(buffer, size_t(length));
+    }
+
+    // Waits for the next count frames and returns their payloads, their opcodes are appended to OpCodes.
+    vector<string> Next(web_server& server, size_t count) {
+        vector<string> payloads;
+        for(int i = 0; i < 200 && payloads.size() < count; i++) {
+            server.Serve();
+            Read();
+            web_frame_header header;
+            auto data = span(reinterpret_cast<const uint8_t*>(Received.data()), Received.size());
+            while(web_frame_header::Parse(data, UINT32_MAX, header) == web_packet_parse_code::complete &&
+                  data.size() >= header.FrameSize() && payloads.size() < count) {
+                payloads.push_back(Received.substr(header.HeaderSize, header.PayloadLength));
+                OpCodes.push_back(header.OpCode);
+                Received.erase(0, header.FrameSize());
+                data = span(reinterpret_cast<const uint8_t*>(Received.data()), Received.size());
+            }
+        }
+        return payloads;
+    }
+};
+
+TEST_CASE(delta_publisher, keyframes_and_deltas) {
+    web_server server(TestPort);
+    delta_publisher publisher(server, { "/Stats" }, { delta_encoding::json, 0.01, 4 });
+    publisher.Update({ { "cpu", 1 }, { "memory", 2 } });
+
+    // a new subscriber starts from a snapshot of the current state
+    subscriber client(server, TestPort, "/Stats");
+    CHECK(client.Next(server, 1) == vector<string>({ R"({"k":1,"cpu":1,"memory":2})" }));
+
+    publisher.Update({ { "cpu", 1.005 }, { "memory", 2 } }); // below the resolution, nothing is sent
+    publisher.Update({ { "cpu", 1.5 }, { "memory", 2 } });
+    publisher.Update({ { "cpu", 1.5 }, { "memory", 3 } });
+    // deltas are cumulative since the keyframe, every fourth update is a keyframe again
+    publisher.Update({ { "cpu", 1.25 }, { "memory", 3 } });
+    CHECK(client.Next(server, 3) == vector<string>({ R"({"k":1,"d":{"cpu":1.5}})",
+                                                     R"({"k":1,"d":{"cpu":1.5,"memory":3}})",
+                                                     R"({"k":2,"cpu":1.25,"memory":3})" }));
+    publisher.Update({ { "cpu", 1.25 }, { "memory", 4 } });
+    // a different set of fields starts a new keyframe right away
+    publisher.Update({ { "cpu", 1.25 }, { "memory", 4 }, { "disk", 0.5 } });
+    publisher.Update({ { "cpu", 1.25 }, { "memory", 4 }, { "disk", 0.75 } });
+    CHECK(client.Next(server, 3) == vector<string>({ R"({"k":2,"d":{"memory":4}})",
+                                                     R"({"k":3,"cpu":1.25,"memory":4,"disk":0.5})",
+                                                     R"({"k":3,"d":{"disk":0.75}})" }));
+    CHECK(all_of(client.OpCodes.begin(), client.OpCodes.end(),
+                 [](web_socket_opcode opcode) { return opcode == web_socket_opcode::TextFrame; }));
+
+    // late subscribers get the latest state, not the keyframe
+    subscriber late(server, TestPort, "/Stats");
+    CHECK(late.Next(server, 1) == vector<string>({ R"({"k":3,"cpu":1.25,"memory":4,"disk":0.75})" }));
+    CHECK(publisher.PublishedBytes() > 0);
+}
+
+// 'D', the generation, then the index and value of every field changed since the keyframe.
+static string binary_delta(uint32_t generation, const vector<pair<uint8_t, double>>& fields) {
+    string delta(1, 'D');
+    delta.append(reinterpret_cast<const char*>(&generation), 4);
+    for(const auto& [index, value] : fields) {
+        delta += char(index);
+        delta.append(reinterpret_cast<const char*>(&value), 8);
+    }
+    return delta;
+}
+
+TEST_CASE(delta_publisher, binary_deltas) {
+    web_server server(TestPort + 1);
+    delta_publisher publisher(server, { "/Binary" }, { delta_encoding::binary, 0.01, 20 });
+    subscriber client(server, TestPort + 1, "/Binary");
+    // nothing was published before the client subscribed, its first frame is the first keyframe
+    publisher.Update({ { "cpu", 1 }, { "memory", 2 }, { "disk", 3 } });
+    publisher.Update({ { "cpu", 1 }, { "memory", 2 }, { "disk", 3.5 } });
+    publisher.Update({ { "cpu", 0.5 }, { "memory", 2 }, { "disk", 3.5 } });
+    auto keyframe = R"({"k":1,"cpu":1,"memory":2,"disk":3,"f":["cpu","memory","disk"]})";
+    CHECK(client.Next(server, 3) == vector<string>({ keyframe, binary_delta(1, { { 2, 3.5 } }),
+                                                     binary_delta(1, { { 0, 0.5 }, { 2, 3.5 } }) }));
+    CHECK((client.OpCodes == vector<web_socket_opcode> { web_socket_opcode::TextFrame, web_socket_opcode::BinaryFrame,
+                                                         web_socket_opcode::BinaryFrame }));
+}
@@ -0,0 +1,117 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "file_delta.h"
+#include <cstring>
+#include <random>
+
+using namespace std;
+
+static file_delta::reader reader_of(const vector<uint8_t>& data) {
+    return [&data](uint64_t offset, span<uint8_t> out) -> int64_t {
+        if(offset > data.size())
+            return -1;
+        size_t length = min<size_t>(out.size(), data.size() - offset);
+        memcpy(out.data(), data.data() + offset, length);
+        return int64_t(length);
+    };
+}
+
+static vector<uint8_t> random_bytes(size_t size, mt19937& random) {
+    vector<uint8_t> data(size);
+    for(auto& byte : data)
+        byte = uint8_t(random());
+    return data;
+}
+
+// Rebuilds next from base the way the receiver does: the signature goes through its wire encoding, literals are
+// copied and block runs are read from base. Returns the bytes that came from base.
+static uint64_t reconstruct(const vector<uint8_t>& base, const vector<uint8_t>& next, bool& matches) {
+    file_delta::signature computed, signature;
+    vector<uint8_t> payload;
+    matches = file_delta::ComputeSignature(reader_of(base), base.size(), computed);
+    computed.Encode(payload);
+    matches = matches && signature.Decode(payload, computed.BlockSize, computed.FileSize);
+
+    vector<uint8_t> out;
+    file_delta::delta_encoder encoder(signature);
+    matches = matches && encoder.Encode(reader_of(next), next.size(), [&](uint64_t offset, span<const uint8_t> data) {
+        if(offset != out.size())
+            return false;
+        out.insert(out.end(), data.begin(), data.end());
+        return true;
+    }, [&](uint64_t offset, uint32_t first_block, uint32_t count) {
+        if(offset != out.size() || uint64_t(first_block) + count > signature.Blocks.size())
+            return false;
+        for(uint32_t block = first_block; block < first_block + count; block++) {
+            auto start = base.begin() + ptrdiff_t(uint64_t(block) * signature.BlockSize);
+            out.insert(out.end(), start, start + ptrdiff_t(signature.BlockLength(block)));
+        }
+        return true;
+    });
+    matches = matches && out == next;
+    return encoder.CopiedBytes();
+}
+
+TEST_CASE(file_delta, rolling_checksum_slides) {
+    mt19937 random(1);
+    auto data = random_bytes(5000, random);
+    const size_t window = 700;
+    file_delta::rolling_checksum rolling, fresh;
+    rolling.Reset({ data.data(), window });
+    for(size_t start = 1; start + window <= data.size(); start++) {
+        rolling.Roll(data[start - 1], data[start + window - 1]);
+        fresh.Reset({ data.data() + start, window });
+        if(rolling.Value() != fresh.Value()) {
+            CHECK(rolling.Value() == fresh.Value());
+            break;
+        }
+    }
+}
+
+TEST_CASE(file_delta, reconstructs_edited_files) {
+    mt19937 random(2);
+    bool matches = false;
+    for(size_t size : { size_t(100), size_t(5000), size_t(100000), size_t(3000000) }) {
+        auto base = random_bytes(size, random);
+        // identical: everything but a short tail comes from base
+        CHECK(reconstruct(base, base, matches) + file_delta::BlockSizeFor(size) > size && matches);
+
+        auto edited = base;
+        edited.insert(edited.begin() + ptrdiff_t(size / 3), 7, uint8_t(0x42));
+        edited.erase(edited.begin() + ptrdiff_t(size / 2), edited.begin() + ptrdiff_t(size / 2 + 5));
+        edited[size * 3 / 4] ^= 1;
+        uint64_t copied = reconstruct(base, edited, matches);
+        CHECK(matches);
+        if(size >= 100000)
+            CHECK(copied > size / 2);
+
+        auto shifted = base;
+        shifted.insert(shifted.begin(), uint8_t(9));
+        reconstruct(base, shifted, matches);
+        CHECK(matches);
+
+        reconstruct(base, random_bytes(size / 2, random), matches);
+        CHECK(matches);
+        CHECK(reconstruct({}, base, matches) == 0 && matches);
+        reconstruct(base, {}, matches);
+        CHECK(matches);
+    }
+    // many equal blocks
+    reconstruct(vector<uint8_t>(200000, 0), vector<uint8_t>(300001, 0), matches);
+    CHECK(matches);
+}
+
+TEST_CASE(file_delta, signature_decode_rejects_wrong_length) {
+    mt19937 random(3);
+    auto base = random_bytes(50000, random);
+    file_delta::signature signature, decoded;
+    CHECK(file_delta::ComputeSignature(reader_of(base), base.size(), signature));
+    vector<uint8_t> payload;
+    signature.Encode(payload);
+    CHECK(payload.size() == signature.Blocks.size() * file_delta::BlockSignatureSize);
+    payload.pop_back();
+    CHECK(!decoded.Decode(payload, signature.BlockSize, signature.FileSize));
+}
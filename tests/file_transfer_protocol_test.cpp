@@ -0,0 +1,250 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "file_transfer_protocol.h"
+#include "sha256.h"
+#include <fstream>
+#include <random>
+
+using namespace std;
+using namespace file_transfer;
+namespace fs = std::filesystem;
+
+// Empty directory of its own for every case, removed with it.
+struct temp_directory {
+    fs::path Path;
+
+    explicit temp_directory(const char* name) : Path(fs::temp_directory_path() / ("webclient_test_" + string(name))) {
+        fs::remove_all(Path);
+        fs::create_directories(Path);
+    }
+    ~temp_directory() {
+        error_code ec;
+        fs::remove_all(Path, ec);
+    }
+};
+
+static vector<uint8_t> read_file(const fs::path& path) {
+    ifstream file(path, ios::binary);
+    return { istreambuf_iterator<char>(file), istreambuf_iterator<char>() };
+}
+
+// Half random bytes, half repeated text, so compressed chunks are exercised too.
+static vector<uint8_t> test_data(size_t size, uint32_t seed) {
+    mt19937 random(seed);
+    vector<uint8_t> data(size);
+    for(size_t i = 0; i < size; i++)
+        data[i] = i % 2048 < 1024 ? uint8_t(random()) : uint8_t("lorem ipsum "[i % 12]);
+    return data;
+}
+
+// Feeds the stream in pieces of random size, as the socket would deliver them.
+static bool feed(stream_receiver& receiver, span<const uint8_t> stream, uint32_t seed, size_t max_piece) {
+    mt19937 random(seed);
+    while(!stream.empty()) {
+        size_t length = min<size_t>(random() % max_piece + 1, stream.size());
+        if(!receiver.Consume(stream.first(length)))
+            return false;
+        stream = stream.subspan(length);
+    }
+    return true;
+}
+
+static void append_file(vector<uint8_t>& stream, uint32_t file_id, const string& path, span<const uint8_t> data,
+                        bool compress) {
+    AppendFrame(stream, TransferOpCode::CreateFile, file_id, create_file_meta { path, data.size() });
+    for(size_t offset = 0; offset < data.size(); offset += DataChunkSize)
+        AppendDataFrame(stream, file_id, offset, data.subspan(offset, min(DataChunkSize, data.size() - offset)), compress);
+}
+
+static string hash_of(span<const uint8_t> data) {
+    auto digest = sha256::Hash(data);
+    return { digest.begin(), digest.end() };
+}
+
+// Status of the FileStatus reply at the start of replies.
+static bool read_status(span<const uint8_t> replies, CloseStatus& status, vector<pair<uint64_t, uint64_t>>& ranges) {
+    frame_header header;
+    if(replies.size() < FrameHeaderSize || !frame_header::Decode(replies.data(), header) ||
+       header.OpCode != TransferOpCode::FileStatus)
+        return false;
+    auto meta = replies.subspan(FrameHeaderSize, header.MetaLength);
+    file_status_meta result;
+    if(!DecodeMeta(meta, result))
+        return false;
+    status = result.Status;
+    return DecodeRanges(replies.subspan(FrameHeaderSize + header.MetaLength, header.PayloadLength), ranges);
+}
+
+TEST_CASE(file_transfer_protocol, header_round_trip) {
+    frame_header header { TransferOpCode::CopyBlocks, ChecksumFlag, 17, 42, 0x123456789AULL };
+    uint8_t encoded[FrameHeaderSize];
+    header.Encode(encoded);
+    frame_header decoded;
+    CHECK(frame_header::Decode(encoded, decoded));
+    CHECK(decoded.OpCode == header.OpCode && decoded.Flags == header.Flags && decoded.MetaLength == header.MetaLength);
+    CHECK(decoded.FileId == header.FileId && decoded.PayloadLength == header.PayloadLength);
+    encoded[0] ^= 1;
+    CHECK(!frame_header::Decode(encoded, decoded));
+}
+
+TEST_CASE(file_transfer_protocol, files_arrive_in_any_split) {
+    temp_directory directory("consume");
+    auto large = test_data(3 * DataChunkSize + 17, 1);
+    auto small = test_data(100, 2);
+    vector<uint8_t> stream;
+    AppendFrame(stream, TransferOpCode::CreateDirectory, 0, create_directory_meta { "a/b" });
+    append_file(stream, 7, "a/large.bin", large, true);
+    AppendFrame(stream, TransferOpCode::CloseFile, 7, close_file_meta { hash_of(large) });
+    append_file(stream, 8, "a/b/small.bin", small, false);
+    AppendFrame(stream, TransferOpCode::CloseFile, 8, close_file_meta {});
+    AppendFrame(stream, TransferOpCode::CreateFile, 9, create_file_meta { "empty" });
+    AppendFrame(stream, TransferOpCode::CloseFile, 9, close_file_meta {});
+
+    // headers and metadata split at every byte, and payloads split across large reads
+    for(size_t max_piece : { size_t(1), size_t(7), size_t(70000) }) {
+        session_registry registry(directory.Path);
+        stream_receiver receiver(registry);
+        CHECK(feed(receiver, max_piece == 1 ? span<const uint8_t>(stream).first(4096) : span<const uint8_t>(stream),
+                   uint32_t(max_piece), max_piece));
+        if(max_piece == 1)
+            continue;
+        CHECK(read_file(directory.Path / "a/large.bin") == large);
+        CHECK(read_file(directory.Path / "a/b/small.bin") == small);
+        CHECK(fs::exists(directory.Path / "empty") && fs::file_size(directory.Path / "empty") == 0);
+        CHECK(!fs::exists(directory.Path / "a/large.bin.part"));
+        CloseStatus status = CloseStatus::Failed;
+        vector<pair<uint64_t, uint64_t>> ranges;
+        CHECK(read_status(receiver.Replies(), status, ranges) && status == CloseStatus::Committed && ranges.empty());
+    }
+}
+
+TEST_CASE(file_transfer_protocol, truncated_stream_leaves_no_file) {
+    temp_directory directory("truncated");
+    auto data = test_data(5000, 3);
+    vector<uint8_t> stream;
+    append_file(stream, 1, "cut.bin", data, false);
+    AppendFrame(stream, TransferOpCode::CloseFile, 1, close_file_meta {});
+    // cut inside the payload, then inside the header of the CloseFile frame
+    for(size_t cut : { stream.size() - 2000, stream.size() - 5 }) {
+        {
+            session_registry registry(directory.Path);
+            stream_receiver receiver(registry);
+            CHECK(receiver.Consume(span<const uint8_t>(stream).first(cut)));
+            CHECK(fs::exists(directory.Path / "cut.bin.part"));
+            CHECK(!fs::exists(directory.Path / "cut.bin"));
+        }
+        // the interrupted file is removed with its session
+        CHECK(!fs::exists(directory.Path / "cut.bin.part"));
+        CHECK(!fs::exists(directory.Path / "cut.bin"));
+    }
+}
+
+TEST_CASE(file_transfer_protocol, malformed_frames_are_rejected) {
+    temp_directory directory("malformed");
+    auto data = test_data(4096, 4);
+    auto rejects = [&](const vector<uint8_t>& stream) {
+        session_registry registry(directory.Path);
+        stream_receiver receiver(registry);
+        return !feed(receiver, stream, 5, 100);
+    };
+    vector<uint8_t> open;
+    AppendFrame(open, TransferOpCode::CreateFile, 1, create_file_meta { "file.bin", data.size() });
+
+    vector<uint8_t> stream = open;
+    stream[0] ^= 0xFF;
+    CHECK(rejects(stream)); // bad magic
+
+    stream.assign(FrameHeaderSize, 0);
+    frame_header { TransferOpCode::CreateDirectory, 0, MaxMetaLength + 1, 0, 0 }.Encode(stream.data());
+    CHECK(rejects(stream)); // metadata too large
+
+    stream.clear();
+    AppendFrame(stream, TransferOpCode(200), 0, empty_meta {});
+    CHECK(rejects(stream)); // unknown opcode
+
+    stream.clear();
+    AppendFrame(stream, TransferOpCode::CreateDirectory, 0, create_directory_meta { "d" }, 10);
+    stream.resize(stream.size() + 10);
+    CHECK(rejects(stream)); // payload on a frame that has none
+
+    stream.clear();
+    AppendFrame(stream, TransferOpCode::CreateFile, 1, create_file_meta { "../outside", 1 });
+    CHECK(rejects(stream));
+    CHECK(!fs::exists(directory.Path.parent_path() / "outside.part"));
+
+    stream.clear();
+    AppendFrame(stream, TransferOpCode::CreateFile, 1, create_file_meta { "file.bin", 10 });
+    // the path claims 100 bytes, 1 follows
+    stream[FrameHeaderSize] = 100;
+    CHECK(rejects(stream)); // truncated metadata
+
+    stream.clear();
+    AppendDataFrame(stream, 3, 0, data, false);
+    CHECK(rejects(stream)); // data for a file that was never announced
+
+    stream = open;
+    AppendDataFrame(stream, 1, 1, data, false);
+    CHECK(rejects(stream)); // data past the end of the file
+
+    stream = open;
+    AppendFrame(stream, TransferOpCode::FileData, 1, file_data_meta { 0, 0, 0 }, 10, CompressedFlag);
+    stream.resize(stream.size() + 10);
+    CHECK(rejects(stream)); // compressed chunk without its length
+
+    stream = open;
+    AppendFrame(stream, TransferOpCode::FileData, 1, file_data_meta { 0, 0, uint32_t(data.size()) }, 3, CompressedFlag);
+    stream.insert(stream.end(), { 0xF0, 0xFF, 0xFF });
+    CHECK(rejects(stream)); // LZ4 block that does not decompress, and no checksum to ask for it again
+
+    stream = open;
+    AppendDataFrame(stream, 1, 0, span<const uint8_t>(data).first(100), false);
+    AppendFrame(stream, TransferOpCode::CloseFile, 1, close_file_meta {});
+    CHECK(rejects(stream)); // closed before all of its bytes arrived
+    CHECK(!fs::exists(directory.Path / "file.bin"));
+}
+
+TEST_CASE(file_transfer_protocol, damaged_chunks_are_asked_again) {
+    temp_directory directory("damaged");
+    auto data = test_data(2 * DataChunkSize, 6);
+    vector<uint8_t> stream;
+    append_file(stream, 1, "file.bin", data, false);
+    // flip a byte in the second chunk's payload, its CRC-32C no longer matches
+    stream[stream.size() - 10] ^= 1;
+    AppendFrame(stream, TransferOpCode::CloseFile, 1, close_file_meta { hash_of(data) });
+
+    session_registry registry(directory.Path);
+    stream_receiver receiver(registry);
+    CHECK(feed(receiver, stream, 7, 300000));
+    CloseStatus status = CloseStatus::Failed;
+    vector<pair<uint64_t, uint64_t>> ranges;
+    CHECK(read_status(receiver.Replies(), status, ranges) && status == CloseStatus::Retransmit);
+    CHECK(ranges.size() == 1 && ranges[0] == make_pair(uint64_t(DataChunkSize), uint64_t(DataChunkSize)));
+    CHECK(!fs::exists(directory.Path / "file.bin"));
+
+    // the resent chunk completes the file
+    vector<uint8_t> resend;
+    AppendDataFrame(resend, 1, DataChunkSize, span<const uint8_t>(data).subspan(DataChunkSize), false);
+    AppendFrame(resend, TransferOpCode::CloseFile, 1, close_file_meta { hash_of(data) });
+    size_t replied = receiver.Replies().size();
+    CHECK(feed(receiver, resend, 8, 300000));
+    CHECK(read_status(receiver.Replies().subspan(replied), status, ranges) && status == CloseStatus::Committed);
+    CHECK(read_file(directory.Path / "file.bin") == data);
+}
+
+TEST_CASE(file_transfer_protocol, range_set_counts_overlaps_once) {
+    range_set ranges;
+    ranges.Add(0, 10);
+    ranges.Add(5, 10);
+    ranges.Add(0, 10);
+    CHECK(ranges.Covered() == 15);
+    ranges.Add(20, 5);
+    ranges.Add(15, 5); // touches both neighbours
+    CHECK(ranges.Covered() == 25);
+    ranges.Add(30, 0);
+    CHECK(ranges.Covered() == 25);
+    ranges.Clear();
+    CHECK(ranges.Covered() == 0);
+}
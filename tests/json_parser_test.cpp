@@ -0,0 +1,156 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "json_parser.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+using namespace std;
+using namespace json_parser;
+
+// Stage 1 one byte at a time: structurals, string openings and the first byte of every other scalar.
+static bool reference_structurals(string_view json, vector<uint32_t>& out) {
+    out.clear();
+    bool in_string = false, escaped = false, in_scalar = false;
+    for(size_t i = 0; i < json.size(); i++) {
+        auto c = uint8_t(json[i]);
+        if(in_string) {
+            if(c < 0x20)
+                return false;
+            if(escaped)
+                escaped = false;
+            else if(c == '\\')
+                escaped = true;
+            else if(c == '"')
+                in_string = false;
+            continue;
+        }
+        bool was_escaped = escaped;
+        escaped = false;
+        if(c == '"' && !was_escaped) {
+            out.push_back(uint32_t(i));
+            in_string = true;
+            in_scalar = false;
+            continue;
+        }
+        if(c == '\\' && !was_escaped)
+            escaped = true;
+        if(c != 0 && strchr("{}[]:,", c)) {
+            out.push_back(uint32_t(i));
+            in_scalar = false;
+        } else if(c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            in_scalar = false;
+        } else {
+            if(!in_scalar)
+                out.push_back(uint32_t(i));
+            in_scalar = true;
+        }
+    }
+    return !in_string;
+}
+
+static const string Sample = R"( {"a": 1, "b": [true, false, null, -1.5e3, "x\"y\u00e9\ud83d\ude00"], "c": {"d": {}}, )"
+                             R"("e": [], "big": 9007199254740993, "s":"plain"} )";
+
+// Random mixes of quotes, backslashes, brackets and control bytes, around the 64 byte blocks of the kernels. Every
+// kernel the CPU can run is checked, not only the one picked at startup.
+TEST_CASE(json_parser, structurals_match_reference) {
+    auto kernels = SupportedKernels();
+    CHECK(find(kernels.begin(), kernels.end(), KernelName()) != kernels.end());
+    CHECK(find(kernels.begin(), kernels.end(), "scalar") != kernels.end());
+    vector<uint32_t> found, expected;
+    CHECK(!FindStructurals("[1]", found, "unknown") && found.empty());
+    for(auto kernel : kernels) {
+        mt19937 random(1);
+        const char alphabet[] = "\"\\{}[]:, \tab1\n\x0c\x1a\x80";
+        for(int i = 0; i < 100000; i++) {
+            string json;
+            for(size_t length = random() % 300; json.size() < length;)
+                json += alphabet[random() % (sizeof(alphabet) - 1)];
+            bool valid = FindStructurals(json, found, kernel);
+            CHECK(valid == reference_structurals(json, expected));
+            CHECK(!valid || found == expected);
+        }
+    }
+}
+
+TEST_CASE(json_parser, document) {
+    json_document document;
+    CHECK(document.Parse(Sample));
+    auto root = document.Root();
+    CHECK(root.Size() == 6 && root["a"].AsInt64() == 1 && root["b"].Size() == 5);
+    CHECK(root["b"][0].AsBool() && !root["b"][1].AsBool(true) && root["b"][2].IsNull());
+    CHECK(root["b"][3].AsNumber() == -1500);
+    CHECK(root["b"][4].AsString() == "x\"y\xc3\xa9\xf0\x9f\x98\x80");
+    CHECK(root["c"]["d"].Type() == json_type::object && root["c"].Raw() == R"({"d": {}})");
+    CHECK(root["e"].Size() == 0 && root["s"].AsString() == "plain");
+    CHECK(root["big"].AsInt64() == 9007199254740993LL); // not representable as a double
+    CHECK(!root["missing"].Exists() && !root["b"][5].Exists());
+    CHECK(root["missing"]["deeper"].Type() == json_type::missing);
+
+    vector<string> keys;
+    root.ForEachMember([&](string_view key, json_value) { keys.emplace_back(key); });
+    CHECK(keys == vector<string>({ "a", "b", "c", "e", "big", "s" }));
+    size_t elements = 0;
+    root["b"].ForEachElement([&](json_value) { elements++; });
+    CHECK(elements == 5);
+
+    auto members = parse(Sample);
+    CHECK(members.size() == 6 && members["s"] == "plain" && members["a"] == "1");
+}
+
+// Escaped keys and strings next to whitespace, the end of the input and other strings.
+TEST_CASE(json_parser, escaped_strings) {
+    string json = "{\"k\\\"ey\" \t: \"v\\\\\"  , \"p\":\"x\"\n,\"arr\":[\"a\\n\" ,\"b\"]}  ";
+    json_document document;
+    CHECK(document.Parse(json));
+    auto root = document.Root();
+    CHECK(root["k\"ey"].AsString() == "v\\" && root["k\"ey"].Raw() == "\"v\\\\\"");
+    CHECK(root["p"].Raw() == "\"x\"");
+    CHECK(root["arr"][0].AsString() == "a\n" && root["arr"][0].Raw() == "\"a\\n\"" && root["arr"][1].AsString() == "b");
+    CHECK(document.Parse("\"end\\\"s\"  ") && document.Root().AsString() == "end\"s");
+
+    json_on_demand on_demand;
+    CHECK(on_demand.Parse(json));
+    string text;
+    CHECK(on_demand.Root()["k\"ey"].GetString(text) && text == "v\\");
+    CHECK(on_demand.Root()["k\"ey"].Raw() == "\"v\\\\\"");
+    CHECK(on_demand.Root()["arr"][0].GetString(text) && text == "a\n");
+    CHECK(on_demand.Root()["p"].Raw() == "\"x\"");
+    CHECK(on_demand.Parse("\"tail\"") && on_demand.Root().GetString(text) && text == "tail");
+}
+
+TEST_CASE(json_parser, on_demand) {
+    json_on_demand document;
+    CHECK(document.Parse(Sample));
+    auto root = document.Root();
+    int64_t integer;
+    double number;
+    bool boolean;
+    string text;
+    CHECK(root["a"].GetInt64(integer) && integer == 1);
+    CHECK(root["b"][3].GetNumber(number) && number == -1500);
+    CHECK(root["b"][4].GetString(text) && text == "x\"y\xc3\xa9\xf0\x9f\x98\x80");
+    CHECK(root["b"][0].GetBool(boolean) && boolean);
+    CHECK(!root["b"][5].Exists() && !root["missing"].Exists());
+    CHECK(root["s"].GetString(text) && text == "plain");
+    CHECK(root["c"].Raw() == R"({"d": {}})" && root["c"]["d"].Type() == json_type::object);
+    CHECK(root["big"].GetInt64(integer) && integer == 9007199254740993LL);
+    CHECK(!root["s"].GetInt64(integer) && !root["a"].GetString(text));
+}
+
+TEST_CASE(json_parser, invalid_documents) {
+    json_document document;
+    for(const char* json : { "", "{", "[1,]", "{\"a\" 1}", "{\"a\":1,}", "01", "[1 2]", "\"abc", "tru", "{\"a\":1}}",
+                             "[\"\\x\"]", "[\"a\tb\"]", "1.", "-", "[\"\\ud800\"]", "{1:2}" }) {
+        CHECK(!document.Parse(json));
+        CHECK(!document.Error().empty());
+    }
+    for(const char* json : { "1", "\"\"", "[]", "{}", "-0.5E+2", "[[[]]]", " null " })
+        CHECK(document.Parse(json));
+    // the document is reused after an error
+    CHECK(document.Parse(Sample) && document.Root()["s"].AsString() == "plain");
+}
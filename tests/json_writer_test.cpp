@@ -0,0 +1,97 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "json_writer.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+
+using namespace std;
+
+static string format_double(double value) {
+    char out[json_format::MaxNumberLength];
+    return { out, json_format::Double(value, out) };
+}
+
+static string format_float(float value) {
+    char out[json_format::MaxNumberLength];
+    return { out, json_format::Float(value, out) };
+}
+
+static string quoted(string_view text) {
+    string json;
+    json_string_writer(json).Value(text);
+    return json;
+}
+
+TEST_CASE(json_writer, escaping) {
+    CHECK(quoted("plain") == R"("plain")" && quoted("") == R"("")");
+    CHECK(quoted("a\"b\\c/d") == R"("a\"b\\c/d")");
+    CHECK(quoted("\n\r\t\b\f") == R"("\n\r\t\b\f")");
+    CHECK(quoted(string_view("\x01\x1f\0", 3)) == R"("\u0001\u001f\u0000")");
+    // everything from 0x20 up is written as is, UTF-8 included
+    CHECK(quoted("\x7f\xc3\xa9\xf0\x9f\x98\x80") == "\"\x7f\xc3\xa9\xf0\x9f\x98\x80\"");
+    CHECK(quoted("run \"quoted\" run\n") == R"("run \"quoted\" run\n")");
+
+    string json;
+    json_string_writer(json).BeginObject().Member("k\"ey\n", "v").EndObject();
+    CHECK(json == R"({"k\"ey\n":"v"})");
+}
+
+TEST_CASE(json_writer, numbers) {
+    CHECK(format_double(0) == "0" && format_double(42) == "42" && format_double(-3) == "-3");
+    CHECK(format_double(123456789012345.0) == "123456789012345");
+    CHECK(format_double(0.1) == "0.1" && format_double(-2.5) == "-2.5");
+    CHECK(format_double(1.0 / 3) == "0.3333333333333333");
+    CHECK(format_double(1e21) == "1e+21" && format_double(1.5e-7) == "1.5e-07");
+    CHECK(format_double(numeric_limits<double>::max()) == "1.7976931348623157e+308");
+    CHECK(format_float(0.1f) == "0.1" && format_float(12.0f) == "12" && format_float(3.25f) == "3.25");
+
+    char out[json_format::MaxNumberLength];
+    CHECK(string(out, json_format::Int64(INT64_MIN, out)) == "-9223372036854775808");
+    CHECK(string(out, json_format::UInt64(UINT64_MAX, out)) == "18446744073709551615");
+
+    // the shortest text still parses back to the same double
+    mt19937_64 random(9);
+    bool round_trips = true;
+    for(int i = 0; i < 100000; i++) {
+        uint64_t bits = random();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if(!isfinite(value))
+            continue;
+        round_trips &= strtod(format_double(value).c_str(), nullptr) == value;
+    }
+    CHECK(round_trips);
+}
+
+// NaN and infinities have no JSON representation.
+TEST_CASE(json_writer, non_finite_values) {
+    for(double value : { numeric_limits<double>::quiet_NaN(), numeric_limits<double>::infinity(),
+                         -numeric_limits<double>::infinity() }) {
+        CHECK(format_double(value) == "null" && format_float(float(value)) == "null");
+    }
+    string json;
+    json_string_writer(json).BeginArray().Value(nan("")).Value(1.5).Value(numeric_limits<float>::infinity()).EndArray();
+    CHECK(json == "[null,1.5,null]");
+}
+
+TEST_CASE(json_writer, structure) {
+    vector<uint8_t> body { 'x' }; // appended to, not replaced
+    json_writer json(body);
+    json.BeginObject()
+        .Member("count", 3)
+        .Member("ok", true)
+        .Key("empty").BeginObject().EndObject()
+        .Key("list").BeginArray().Value(1u).Null().Value("two").BeginArray().EndArray().EndArray()
+        .Key("raw").RawValue(R"({"a":[1]})")
+        .Member("last", -1L)
+        .EndObject();
+    CHECK(string(body.begin(), body.end()) ==
+          R"(x{"count":3,"ok":true,"empty":{},"list":[1,null,"two",[]],"raw":{"a":[1]},"last":-1})");
+    CHECK(&json.Output() == &body);
+}
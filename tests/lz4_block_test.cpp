@@ -0,0 +1,95 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "lz4_block.h"
+#include <random>
+#include <string>
+
+using namespace std;
+
+static vector<uint8_t> bytes_of(const string& text) {
+    return { text.begin(), text.end() };
+}
+
+static bool round_trips(const vector<uint8_t>& data) {
+    vector<uint8_t> compressed(data.size() + data.size() / 255 + 16), back(data.size());
+    size_t length = lz4_block::Compress(data, compressed);
+    return length > 0 && lz4_block::Decompress({ compressed.data(), length }, back) && back == data;
+}
+
+TEST_CASE(lz4_block, round_trip) {
+    mt19937 random(1);
+    for(size_t size : { 0, 1, 5, 12, 13, 100, 65536, 70000, 1 << 20 }) {
+        vector<uint8_t> noise(size), repeated(size, 7), pattern(size), text;
+        for(size_t i = 0; i < size; i++) {
+            noise[i] = uint8_t(random());
+            pattern[i] = uint8_t(i % 3);
+        }
+        while(text.size() < size) {
+            string line = "GET /api/v1/users/" + to_string(random() % 1000) + " 200 " + to_string(random() % 90);
+            line += "ms\n";
+            text.insert(text.end(), line.begin(), line.end());
+        }
+        text.resize(size);
+        CHECK(round_trips(noise));
+        CHECK(round_trips(repeated));
+        CHECK(round_trips(pattern));
+        CHECK(round_trips(text));
+    }
+}
+
+// Blocks written by the reference liblz4 (LZ4_compress_default).
+TEST_CASE(lz4_block, decodes_reference_blocks) {
+    auto decodes_to = [](const vector<uint8_t>& block, const string& text) {
+        vector<uint8_t> out(text.size());
+        return lz4_block::Decompress(block, out) && out == bytes_of(text);
+    };
+    CHECK(decodes_to({ 0x40, 0x61, 0x61, 0x61, 0x61 }, "aaaa"));
+    CHECK(decodes_to({ 0x6F, 0x68, 0x65, 0x6C, 0x6C, 0x6F, 0x20, 0x06, 0x00, 0x0C, 0x50, 0x65, 0x6C, 0x6C, 0x6F, 0x21 },
+                     "hello hello hello hello hello hello hello!"));
+    // overlapping match of offset 1 with an extended length, then an extended literal run
+    CHECK(decodes_to({ 0x1F, 0x61, 0x01, 0x00, 0x50, 0xF0, 0x02, 0x74, 0x61, 0x69, 0x6C, 0x20, 0x6F, 0x66, 0x20, 0x74,
+                       0x68, 0x65, 0x20, 0x62, 0x6C, 0x6F, 0x63, 0x6B },
+                     string(100, 'a') + "tail of the block"));
+}
+
+TEST_CASE(lz4_block, malformed_blocks_are_rejected) {
+    vector<uint8_t> out(10);
+    // 'a', a match of 4 at offset 1, then 5 literals: "aaaaa" twice
+    vector<uint8_t> block { 0x10, 0x61, 0x01, 0x00, 0x50, 0x61, 0x61, 0x61, 0x61, 0x61 };
+    CHECK(lz4_block::Decompress(block, out) && out == vector<uint8_t>(10, 0x61));
+
+    auto broken = block;
+    broken[2] = 0;
+    CHECK(!lz4_block::Decompress(broken, out)); // offset 0
+    broken[2] = 2;
+    CHECK(!lz4_block::Decompress(broken, out)); // offset before the start of the output
+    CHECK(!lz4_block::Decompress(span<const uint8_t>(block).first(block.size() - 1), out)); // truncated
+    CHECK(!lz4_block::Decompress(span<const uint8_t>(block).first(3), out)); // cut inside the offset
+    CHECK(!lz4_block::Decompress(vector<uint8_t> { 0xF0 }, out)); // literal length without its extension
+    CHECK(!lz4_block::Decompress(vector<uint8_t> {}, out));
+
+    vector<uint8_t> small(9), large(11);
+    CHECK(!lz4_block::Decompress(block, small));
+    CHECK(!lz4_block::Decompress(block, large));
+
+    // random input never reads or writes outside of its spans
+    mt19937 random(2);
+    for(int i = 0; i < 20000; i++) {
+        vector<uint8_t> junk(random() % 64), target(random() % 200);
+        for(auto& byte : junk)
+            byte = uint8_t(random());
+        lz4_block::Decompress(junk, target);
+    }
+}
+
+TEST_CASE(lz4_block, compress_reports_a_full_output) {
+    mt19937 random(3);
+    vector<uint8_t> data(4096), out(100);
+    for(auto& byte : data)
+        byte = uint8_t(random());
+    CHECK(lz4_block::Compress(data, out) == 0);
+    CHECK(lz4_block::Compress(data, span<uint8_t>()) == 0);
+}
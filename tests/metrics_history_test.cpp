@@ -0,0 +1,108 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "metrics_history.h"
+#include "json_parser.h"
+
+using namespace std;
+using json_parser::json_document;
+
+// An hour boundary, so the points of every tier start with the recording.
+static constexpr int64_t Start = 1699999200;
+
+static string query(const metrics_history& history, int64_t range, int64_t resolution = 0, const string& metric = "") {
+    vector<uint8_t> body;
+    json_writer json(body);
+    history.QueryJSON(json, range, resolution, metric);
+    return { body.begin(), body.end() };
+}
+
+// Records cpu = t and memory = 2t every second for the given number of seconds.
+static void record_ramp(metrics_history& history, int64_t seconds) {
+    for(int64_t t = 0; t < seconds; t++) {
+        double values[] = { double(t), double(2 * t) };
+        history.Record(Start + t, values);
+    }
+}
+
+TEST_CASE(metrics_history, points) {
+    metrics_history history({ "cpu", "memory" });
+    CHECK(query(history, 60) == R"({"resolution":1,"time":[],"metrics":{"cpu":[],"memory":[]}})");
+    // samples of the same second are averaged, a point is stored once the next one starts
+    double first[] = { 1, 10 }, second[] = { 3, 30 }, later[] = { 5, 50 };
+    history.Record(Start, first);
+    history.Record(Start, second);
+    CHECK(query(history, 60) == R"({"resolution":1,"time":[],"metrics":{"cpu":[],"memory":[]}})");
+    history.Record(Start + 5, later);
+    CHECK(query(history, 60) == R"({"resolution":1,"time":[1699999200],"metrics":{"cpu":[2],"memory":[20]}})");
+    // a sample with the wrong number of values is ignored
+    double wrong[] = { 1 };
+    history.Record(Start + 6, wrong);
+    history.Record(Start + 7, later);
+    CHECK(query(history, 60, 0, "memory") == R"({"resolution":1,"time":[1699999200,1699999205],)"
+                                             R"("metrics":{"memory":[20,50]}})");
+    CHECK(query(history, 60, 0, "disk") == R"({"resolution":1,"time":[1699999200,1699999205],"metrics":{}})");
+}
+
+TEST_CASE(metrics_history, tier_roll_up) {
+    metrics_history history({ "cpu", "memory" });
+    record_ramp(history, 180);
+    // minute points are the average of their seconds, the minute in progress is not stored yet
+    CHECK(query(history, 3600, 60) == R"({"resolution":60,"time":[1699999200,1699999260],)"
+                                      R"("metrics":{"cpu":[29.5,89.5],"memory":[59,179]}})");
+    CHECK(query(history, 86400 * 30, 3600) == R"({"resolution":3600,"time":[],"metrics":{"cpu":[],"memory":[]}})");
+
+    // hour points are fed by the minute points, each hour is complete once a minute of the next one is
+    metrics_history hours({ "cpu", "memory" });
+    record_ramp(hours, 7300);
+    CHECK(query(hours, 86400, 3600) == R"({"resolution":3600,"time":[1699999200,1700002800],)"
+                                       R"("metrics":{"cpu":[1799.5,5399.5],"memory":[3599,10799]}})");
+}
+
+TEST_CASE(metrics_history, tier_selection) {
+    metrics_history history({ "cpu", "memory" });
+    record_ramp(history, 7300);
+    // the document refers to the text, which must outlive it
+    string json;
+    auto resolution = [&](int64_t range, int64_t requested) {
+        json_document document;
+        json = query(history, range, requested);
+        CHECK(document.Parse(json));
+        return document.Root()["resolution"].AsInt64();
+    };
+    // the finest tier whose capacity covers the range
+    CHECK(resolution(60, 0) == 1 && resolution(3600, 0) == 1 && resolution(3601, 0) == 60);
+    CHECK(resolution(86400, 0) == 60 && resolution(86401, 0) == 3600 && resolution(86400 * 365, 0) == 3600);
+    // or the first one at least as coarse as asked for
+    CHECK(resolution(60, 30) == 60 && resolution(60, 60) == 60 && resolution(60, 61) == 3600);
+    CHECK(resolution(60, 86400) == 3600);
+
+    // the range picks how many of the latest points are returned, at least one
+    json_document document;
+    json = query(history, 10);
+    CHECK(document.Parse(json));
+    auto time = document.Root()["time"];
+    CHECK(time.Size() == 10 && time[0].AsInt64() == Start + 7289 && time[9].AsInt64() == Start + 7298);
+    json = query(history, 30, 60);
+    CHECK(document.Parse(json) && document.Root()["time"].Size() == 1);
+    CHECK(document.Root()["metrics"]["cpu"][0].AsNumber() == 7229.5);
+}
+
+// The 1 second tier keeps its last 3600 points, older ones are overwritten in order.
+TEST_CASE(metrics_history, ring_wrap) {
+    metrics_history history({ "cpu", "memory" });
+    record_ramp(history, 7300);
+    json_document document;
+    auto json = query(history, 100000, 1);
+    CHECK(document.Parse(json));
+    auto time = document.Root()["time"];
+    auto cpu = document.Root()["metrics"]["cpu"];
+    CHECK(time.Size() == 3600 && cpu.Size() == 3600);
+    bool in_order = true;
+    for(size_t i = 0; i < 3600; i++)
+        in_order &= time[i].AsInt64() == Start + 3699 + int64_t(i) && cpu[i].AsNumber() == double(3699 + i);
+    CHECK(in_order);
+    CHECK(document.Root()["metrics"]["memory"][3599].AsNumber() == 2 * 7298);
+}
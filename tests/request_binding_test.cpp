@@ -0,0 +1,145 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "request_binding.h"
+
+using namespace std;
+
+enum class sample_color { red, green };
+
+struct sample_query {
+    int64_t Range = 600;
+    optional<uint64_t> Tail;
+    string Metric;
+    bool Flag = false;
+    vector<int> Ids;
+    sample_color Color = sample_color::red;
+    double Scale = 0;
+    static constexpr auto Fields = make_tuple(request_binding::field("range", &sample_query::Range),
+                                              request_binding::field("tail", &sample_query::Tail),
+                                              request_binding::required("metric", &sample_query::Metric),
+                                              request_binding::field("flag", &sample_query::Flag),
+                                              request_binding::field("ids", &sample_query::Ids),
+                                              request_binding::field("color", &sample_query::Color),
+                                              request_binding::field("scale", &sample_query::Scale));
+
+    bool Validate(string& error) const {
+        if(Range > 0)
+            return true;
+        error = "range must be positive";
+        return false;
+    }
+};
+
+static http_request make_request(const string& query_string, const string& content_type = "", const string& body = "") {
+    http_request request;
+    request.verb = body.empty() ? http_verb::GET : http_verb::POST;
+    request.resource = "/history";
+    request.query_string = query_string;
+    if(!content_type.empty())
+        request.fields["content-type"] = content_type;
+    if(!body.empty())
+        request.content = vector<uint8_t>(body.begin(), body.end());
+    return request;
+}
+
+// Binds a fresh query, error holds the message on failure.
+static bool bind_query(const http_request& request, sample_query& query, string& error) {
+    query = {};
+    error.clear();
+    return request_binding::Bind(request, query, error);
+}
+
+TEST_CASE(request_binding, query_string) {
+    sample_query query;
+    string error;
+    auto request = make_request("range=5&metric=a%20b+c&flag=on&ids=1&ids=2&color=1&scale=2.5&unknown=x");
+    CHECK(bind_query(request, query, error));
+    CHECK(query.Range == 5 && query.Metric == "a b c" && query.Flag && query.Ids == vector<int>({ 1, 2 }));
+    CHECK(query.Color == sample_color::green && query.Scale == 2.5 && !query.Tail);
+    // defaults are kept for absent fields
+    CHECK(bind_query(make_request("metric=cpu"), query, error));
+    CHECK(query.Range == 600 && !query.Flag && query.Ids.empty());
+}
+
+TEST_CASE(request_binding, bodies) {
+    sample_query query;
+    string error;
+    // body members override query parameters of the same name
+    auto request = make_request("range=1&metric=q", "application/json; charset=utf-8",
+                                R"({"range":7,"tail":99,"ids":[4,5,6],"metric":"z\n","scale":1e2,"other":{}})");
+    CHECK(bind_query(request, query, error));
+    CHECK(query.Range == 7 && query.Tail == 99u && query.Ids == vector<int>({ 4, 5, 6 }) && query.Metric == "z\n");
+    CHECK(query.Scale == 100);
+    request = make_request("", "application/json", R"({"metric":"a","tail":null})");
+    CHECK(bind_query(request, query, error) && !query.Tail);
+
+    request = make_request("", "application/x-www-form-urlencoded", "metric=%41%42&tail=3&&flag=1");
+    CHECK(bind_query(request, query, error));
+    CHECK(query.Metric == "AB" && query.Tail == 3u && query.Flag);
+
+    // header names are matched whatever their case
+    request = make_request("", "", R"({"metric":"b"})");
+    request.fields["CONTENT-TYPE"] = "application/json";
+    CHECK(bind_query(request, query, error) && query.Metric == "b");
+    CHECK(request.FindField("content-type") && !request.FindField("content-length"));
+}
+
+TEST_CASE(request_binding, errors) {
+    sample_query query;
+    string error;
+    auto fails = [&](const http_request& request, string_view expected) {
+        return !bind_query(request, query, error) && error.find(expected) != string::npos;
+    };
+    CHECK(fails(make_request("range=abc&metric=x"), "invalid value for query parameter 'range'"));
+    CHECK(fails(make_request("range=5x&metric=x"), "'range'"));
+    CHECK(fails(make_request("range=1"), "missing required field 'metric'"));
+    CHECK(fails(make_request("range=0&metric=x"), "range must be positive"));
+    CHECK(fails(make_request("metric=%zz"), "malformed percent-encoding"));
+    CHECK(fails(make_request("metric=x&flag=maybe"), "'flag'"));
+    CHECK(fails(make_request("", "text/plain", "hi"), "unsupported Content-Type"));
+    CHECK(fails(make_request("", "application/json", "{bad"), ""));
+    CHECK(fails(make_request("", "application/json", "[1]"), "JSON body must be an object"));
+    CHECK(fails(make_request("", "application/json", R"({"range":1.5,"metric":"a"})"), "member 'range'"));
+    CHECK(fails(make_request("", "application/json", R"({"tail":-1,"metric":"a"})"), "member 'tail'"));
+    CHECK(fails(make_request("", "application/json", R"({"ids":[1,"2"],"metric":"a"})"), "member 'ids'"));
+    CHECK(fails(make_request("", "application/json", R"({"metric":5})"), "member 'metric'"));
+}
+
+TEST_CASE(request_binding, handler_answers_bad_requests) {
+    int calls = 0;
+    auto handler = request_binding::Handler<sample_query>(
+            [&](http_request&, sample_query& query, optional<http_response>&) {
+                calls++;
+                CHECK(query.Metric == "cpu");
+                return middleware_route_status::dynamic_response;
+            });
+    optional<http_response> response;
+    auto request = make_request("metric=cpu");
+    handler(request, response);
+    CHECK(calls == 1 && !response);
+
+    request = make_request("range=x");
+    CHECK(handler(request, response) == middleware_route_status::dynamic_response);
+    CHECK(calls == 1 && response && response->code == http_code::http_400_bad_request);
+    string body(response->body->begin(), response->body->end());
+    CHECK(body == R"({"error":"invalid value for query parameter 'range'"})");
+}
+
+TEST_CASE(request_binding, text_conversions) {
+    bool value = false;
+    CHECK(request_binding::ParseBool("TRUE", value) && value);
+    CHECK(request_binding::ParseBool("off", value) && !value);
+    CHECK(!request_binding::ParseBool("", value) && !request_binding::ParseBool("2", value));
+    uint8_t small;
+    CHECK(!request_binding::FromText("256", small) && !request_binding::FromText("", small));
+    CHECK(request_binding::FromText("255", small) && small == 255);
+
+    vector<pair<string, string>> pairs;
+    request_binding::ForEachPair("a=1&&b&=x&c=", [&](string_view name, string_view text) {
+        pairs.emplace_back(name, text);
+    });
+    CHECK((pairs == vector<pair<string, string>> { { "a", "1" }, { "b", "" }, { "c", "" } }));
+}
@@ -0,0 +1,51 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "sha256.h"
+#include <random>
+#include <string>
+
+using namespace std;
+
+static string hex_of(string_view text) {
+    return sha256::ToHex(sha256::Hash({ reinterpret_cast<const uint8_t*>(text.data()), text.size() }));
+}
+
+// FIPS 180-2 examples and the NIST short message vectors.
+TEST_CASE(sha256, nist_vectors) {
+    CHECK(hex_of("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    CHECK(sha256::ToHex(sha256::Hash({})) == hex_of(""));
+    CHECK(hex_of("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    CHECK(hex_of("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    CHECK(hex_of("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrst"
+                 "nopqrstu") == "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1");
+    CHECK(hex_of(string(1000000, 'a')) == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+// Messages of 55, 56 and 64 bytes put the length in the last block or push it into a new one.
+TEST_CASE(sha256, padding_boundaries) {
+    CHECK(hex_of(string(55, 'a')) == "9f4390f8d30c2dd92ec9f095b65e2b9ae9b0a925a5258e241c9f1e910f734318");
+    CHECK(hex_of(string(56, 'a')) == "b35439a4ac6f0948b6d6f9e3c6af0f5f590ce20f1bde7090ef7970686ec6738a");
+    CHECK(hex_of(string(64, 'a')) == "ffe054fe7ae0cb6dc65c3af9b61d5209f439851db43d0ba5997337df154668eb");
+}
+
+TEST_CASE(sha256, incremental_matches_one_shot) {
+    mt19937 random(3);
+    vector<uint8_t> data(1 << 20);
+    for(auto& byte : data)
+        byte = uint8_t(random());
+    sha256::hasher hasher;
+    for(size_t offset = 0; offset < data.size();) {
+        size_t length = min<size_t>(random() % 300, data.size() - offset);
+        hasher.Update({ data.data() + offset, length });
+        offset += length;
+    }
+    auto digest = hasher.Final();
+    CHECK(digest == sha256::Hash(data));
+    hasher.Reset();
+    hasher.Update(data);
+    CHECK(hasher.Final() == digest);
+}
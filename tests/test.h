@@ -0,0 +1,42 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#ifndef WEBCLIENT_TEST_H
+#define WEBCLIENT_TEST_H
+#include <vector>
+
+/*
+ * Minimal test registry. Every TEST_CASE registers itself under its suite when the program starts and test_main.cpp
+ * runs the suite named on the command line, or all of them. A failed CHECK reports its expression and the case goes
+ * on, so one run shows every broken expectation.
+ */
+namespace test {
+    using test_function = void (*)();
+
+    struct test_case {
+        const char* Suite;
+        const char* Name;
+        test_function Run;
+    };
+
+    std::vector<test_case>& Registry();
+    void Fail(const char* file, int line, const char* expression);
+
+    struct registration {
+        registration(const char* suite, const char* name, test_function run) { Registry().push_back({ suite, name, run }); }
+    };
+}
+
+#define TEST_CASE(suite, name) \
+    static void suite##_##name(); \
+    static test::registration suite##_##name##_registration(#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+#define CHECK(expression) \
+    do { \
+        if(!(expression)) \
+            test::Fail(__FILE__, __LINE__, #expression); \
+    } while(false)
+
+#endif //WEBCLIENT_TEST_H
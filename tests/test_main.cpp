@@ -0,0 +1,43 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+static size_t g_failures = 0;
+
+vector<test::test_case>& test::Registry() {
+    static vector<test_case> registry;
+    return registry;
+}
+
+void test::Fail(const char *file, int line, const char *expression) {
+    printf("  %s:%d: CHECK(%s) failed\n", file, line, expression);
+    g_failures++;
+}
+
+// WebClientTests [suite], every suite without one. The exit code is the number of failed cases.
+int main(int argc, char** argv) {
+    const char* suite = argc > 1 ? argv[1] : nullptr;
+    int failed = 0, run = 0;
+    for(const auto& item : test::Registry()) {
+        if(suite && strcmp(suite, item.Suite) != 0)
+            continue;
+        size_t failures = g_failures;
+        item.Run();
+        run++;
+        bool passed = failures == g_failures;
+        failed += !passed;
+        printf("[%s] %s: %s\n", item.Suite, item.Name, passed ? "ok" : "FAILED");
+    }
+    if(run == 0) {
+        printf("No test cases%s%s.\n", suite ? " in suite " : "", suite ? suite : "");
+        return 1;
+    }
+    printf("%d of %d test cases passed.\n", run - failed, run);
+    return failed;
+}
@@ -0,0 +1,128 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "web_deflate.h"
+#include <random>
+
+using namespace std;
+
+// Large enough that the memory budget never shrinks the windows.
+static const web_deflate_config Unlimited { .MaxMemoryPerConnection = 1 << 30 };
+
+static optional<web_deflate_options> negotiate(const string& offers, string& response,
+                                               const web_deflate_config& config = Unlimited) {
+    response.clear();
+    return web_deflate_options::Negotiate(offers, config, response);
+}
+
+#ifndef WEBCLIENT_HAS_ZLIB
+// Without zlib the extension is never offered back.
+TEST_CASE(web_deflate, disabled_without_zlib) {
+    string response;
+    CHECK(!negotiate("permessage-deflate", response) && response.empty());
+}
+#else
+TEST_CASE(web_deflate, negotiation) {
+    string response;
+    auto options = negotiate("permessage-deflate", response);
+    CHECK(options && response == "permessage-deflate");
+    CHECK(options->ServerWindowBits == 15 && options->ClientWindowBits == 15 && !options->ServerNoContextTakeover);
+
+    // the client may limit its window only if it offered to
+    options = negotiate("permessage-deflate; client_max_window_bits", response);
+    CHECK(options && response == "permessage-deflate; client_max_window_bits=15");
+    options = negotiate("permessage-deflate; server_max_window_bits=10; client_max_window_bits=\"9\"", response);
+    CHECK(options && options->ServerWindowBits == 10 && options->ClientWindowBits == 9);
+    CHECK(response == "permessage-deflate; server_max_window_bits=10; client_max_window_bits=9");
+    options = negotiate("permessage-deflate; client_no_context_takeover; server_no_context_takeover", response);
+    CHECK(options && options->ClientNoContextTakeover && options->ServerNoContextTakeover);
+    CHECK(response == "permessage-deflate; server_no_context_takeover; client_no_context_takeover");
+
+    // offers we cannot accept are skipped for the next one
+    options = negotiate("x-webkit-deflate-frame, permessage-deflate; server_max_window_bits=8, "
+                        "permessage-deflate; unknown, permessage-deflate; server_max_window_bits=12", response);
+    CHECK(options && options->ServerWindowBits == 12 && response == "permessage-deflate; server_max_window_bits=12");
+    CHECK(!negotiate("permessage-deflate; client_max_window_bits=16", response) && response.empty());
+    CHECK(!negotiate("", response));
+}
+
+TEST_CASE(web_deflate, server_policy) {
+    string response;
+    web_deflate_config config { .MaxMemoryPerConnection = 1 << 30, .MaxWindowBits = 11, .AllowContextTakeover = false };
+    auto options = negotiate("permessage-deflate; client_max_window_bits", response, config);
+    CHECK(options && options->ServerWindowBits == 11 && options->ClientWindowBits == 11);
+    CHECK(options->ServerNoContextTakeover && !options->ClientNoContextTakeover);
+    CHECK(response == "permessage-deflate; server_no_context_takeover; server_max_window_bits=11; "
+                      "client_max_window_bits=11");
+    CHECK(!negotiate("permessage-deflate", response, { .Enabled = false }));
+
+    // the default budget does not fit two 15 bit windows, the compressor is shrunk first
+    options = negotiate("permessage-deflate", response, {});
+    CHECK(options && options->ServerWindowBits == 14 && options->MemoryLevel == 7 && options->ClientWindowBits == 15);
+    CHECK(response == "permessage-deflate; server_max_window_bits=14");
+    // the client window is only reduced once the server side can shrink no further
+    web_deflate_config tight { .MaxMemoryPerConnection = 17 * 1024 };
+    options = negotiate("permessage-deflate; client_max_window_bits", response, tight);
+    CHECK(options && options->ServerWindowBits == 9 && options->MemoryLevel == 1 && options->ClientWindowBits == 8);
+    CHECK(!negotiate("permessage-deflate", response, tight));
+}
+
+// The options the client ends up with: it inflates with our window and takeover setting.
+static web_deflate_options peer_of(const web_deflate_options& server) {
+    web_deflate_options peer = server;
+    peer.ClientWindowBits = server.ServerWindowBits;
+    peer.ClientNoContextTakeover = server.ServerNoContextTakeover;
+    return peer;
+}
+
+static vector<uint8_t> text(const string& value) {
+    return { value.begin(), value.end() };
+}
+
+TEST_CASE(web_deflate, round_trip) {
+    for(bool takeover : { true, false }) {
+        web_deflate_options options;
+        options.ServerNoContextTakeover = !takeover;
+        web_deflate_context server(options), client(peer_of(options));
+        auto message = text(R"({"cpu": 12.5, "memory": 4096, "network_in": 100, "network_out": 200, "disk": 7})");
+        vector<uint8_t> first, second, inflated;
+        CHECK(server.Compress(message, first));
+        CHECK(client.Decompress(first, inflated, 1 << 20) && inflated == message);
+        CHECK(server.Compress(message, second));
+        CHECK(client.Decompress(second, inflated, 1 << 20) && inflated == message);
+        // with context takeover the repeated message is a reference to the previous one
+        CHECK(takeover ? second.size() < first.size() : second == first);
+
+        // once the history is invalidated the next message stands alone again
+        server.InvalidateCompressorHistory();
+        CHECK(server.Compress(message, second) && second == first);
+        CHECK(client.Decompress(second, inflated, 1 << 20) && inflated == message);
+    }
+}
+
+TEST_CASE(web_deflate, limits) {
+    web_deflate_options options;
+    web_deflate_context server(options), client(peer_of(options));
+    vector<uint8_t> compressed, inflated;
+    // incompressible messages are sent as they are
+    mt19937 random(3);
+    vector<uint8_t> noise(4096);
+    for(auto& byte : noise)
+        byte = uint8_t(random());
+    CHECK(!server.Compress(noise, compressed));
+
+    vector<uint8_t> zeros(1 << 20);
+    CHECK(server.Compress(zeros, compressed) && compressed.size() < 4096);
+    CHECK(!client.Decompress(compressed, inflated, (1 << 20) - 1));
+    vector<uint8_t> garbage { 0xFF, 0xFF, 0xFF };
+    web_deflate_context other(options);
+    CHECK(!other.Decompress(garbage, inflated, 1 << 20));
+
+    // broadcasts compressed once are readable with any window at least as large, a message exactly at the limit fits
+    CHECK(web_deflate_context::CompressStandalone(zeros, 10, 8, compressed));
+    web_deflate_context reader(options);
+    CHECK(reader.Decompress(compressed, inflated, 1 << 20) && inflated == zeros);
+}
+#endif
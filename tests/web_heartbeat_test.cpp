@@ -0,0 +1,114 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "web_heartbeat.h"
+#include <random>
+#include <algorithm>
+
+using namespace std;
+using namespace std::chrono;
+
+static const steady_clock::time_point Epoch = steady_clock::time_point() + hours(1);
+
+// Sends the next ping when it is due and answers it rtt later, returns the measured round trip.
+static optional<double> ping_pong(web_heartbeat& heartbeat, heartbeat_state& state, milliseconds rtt) {
+    array<uint8_t, 8> payload {};
+    auto sent = state.NextPing;
+    if(heartbeat.Tick(state, sent, payload) != web_heartbeat::tick_result::send_ping)
+        return {};
+    return heartbeat.OnPong(state, payload, sent + rtt);
+}
+
+TEST_CASE(web_heartbeat, schedule) {
+    web_heartbeat heartbeat;
+    heartbeat.Config.Interval = seconds(10);
+    heartbeat_state first, second;
+    heartbeat.Start(first, 1, Epoch);
+    heartbeat.Start(second, 2, Epoch);
+    // each connection gets its own phase within the interval
+    CHECK(first.NextPing >= Epoch && first.NextPing < Epoch + seconds(10) && first.NextPing != second.NextPing);
+
+    array<uint8_t, 8> payload {};
+    CHECK(heartbeat.Tick(first, first.NextPing - milliseconds(1), payload) == web_heartbeat::tick_result::idle);
+    auto due = first.NextPing;
+    CHECK(heartbeat.Tick(first, due + milliseconds(3), payload) == web_heartbeat::tick_result::send_ping);
+    CHECK((payload == array<uint8_t, 8> { 0, 0, 0, 0, 0, 0, 0, 1 }) && first.AwaitingPong);
+    // the phase is kept even though the tick came late
+    CHECK(first.NextPing == due + seconds(10));
+    // a tick that missed whole intervals starts over from now
+    CHECK(heartbeat.Tick(first, due + seconds(35), payload) == web_heartbeat::tick_result::send_ping);
+    CHECK(first.NextPing == due + seconds(45) && first.Sequence == 2 && first.MissedPongs == 1);
+
+    heartbeat.Config.Enabled = false;
+    CHECK(heartbeat.Tick(second, second.NextPing, payload) == web_heartbeat::tick_result::idle);
+}
+
+TEST_CASE(web_heartbeat, pongs) {
+    web_heartbeat heartbeat;
+    heartbeat_state state;
+    heartbeat.Start(state, 7, Epoch);
+    array<uint8_t, 8> payload {};
+    CHECK(!heartbeat.OnPong(state, payload, Epoch)); // unsolicited
+
+    auto sent = state.NextPing;
+    CHECK(heartbeat.Tick(state, sent, payload) == web_heartbeat::tick_result::send_ping);
+    auto stale = payload;
+    stale[7]--;
+    CHECK(!heartbeat.OnPong(state, stale, sent + milliseconds(5)));
+    CHECK(!heartbeat.OnPong(state, span(payload).first(7), sent + milliseconds(5)));
+    CHECK(heartbeat.OnPong(state, payload, sent + milliseconds(40)) == 40.0);
+    CHECK(!state.AwaitingPong && state.LastRttMs == 40 && state.SmoothedRttMs == 40);
+    CHECK(!heartbeat.OnPong(state, payload, sent + milliseconds(50))); // answered already
+
+    CHECK(ping_pong(heartbeat, state, milliseconds(80)) == 80.0);
+    CHECK(state.LastRttMs == 80 && state.SmoothedRttMs == 45);
+    CHECK(heartbeat.GetRttPercentiles().Samples == 2);
+}
+
+TEST_CASE(web_heartbeat, missed_pongs) {
+    web_heartbeat heartbeat;
+    heartbeat.Config.MaxMissedPongs = 3;
+    heartbeat_state state;
+    heartbeat.Start(state, 3, Epoch);
+    array<uint8_t, 8> payload {};
+    for(int i = 0; i < 3; i++)
+        CHECK(heartbeat.Tick(state, state.NextPing, payload) == web_heartbeat::tick_result::send_ping);
+    CHECK(state.MissedPongs == 2);
+    // a late answer to the latest ping clears the count
+    CHECK(heartbeat.OnPong(state, payload, state.NextPing) && state.MissedPongs == 0);
+    for(int i = 0; i < 3; i++)
+        CHECK(heartbeat.Tick(state, state.NextPing, payload) == web_heartbeat::tick_result::send_ping);
+    CHECK(heartbeat.Tick(state, state.NextPing, payload) == web_heartbeat::tick_result::evict);
+}
+
+TEST_CASE(web_heartbeat, rtt_percentiles) {
+    web_heartbeat heartbeat;
+    CHECK(heartbeat.GetRttPercentiles().Samples == 0 && heartbeat.GetRttPercentiles().Max == 0);
+    heartbeat_state state;
+    heartbeat.Start(state, 11, Epoch);
+    // 1..100 ms in random order
+    vector<int> rtts(100);
+    for(int i = 0; i < 100; i++)
+        rtts[i] = i + 1;
+    shuffle(rtts.begin(), rtts.end(), mt19937(5));
+    for(int rtt : rtts)
+        CHECK(ping_pong(heartbeat, state, milliseconds(rtt)) == double(rtt));
+    auto percentiles = heartbeat.GetRttPercentiles();
+    CHECK(percentiles.Samples == 100 && percentiles.P50 == 51 && percentiles.P90 == 91);
+    CHECK(percentiles.P99 == 100 && percentiles.Max == 100);
+
+    // only the latest 4096 samples count, the oldest are overwritten first
+    for(int i = 0; i < 4096 - 100; i++)
+        ping_pong(heartbeat, state, milliseconds(500));
+    CHECK(heartbeat.GetRttPercentiles().Samples == 4096 && heartbeat.GetRttPercentiles().Max == 500);
+    for(int i = 0; i < 100; i++)
+        ping_pong(heartbeat, state, milliseconds(2));
+    percentiles = heartbeat.GetRttPercentiles();
+    CHECK(percentiles.Samples == 4096 && percentiles.P50 == 500 && percentiles.Max == 500);
+    for(int i = 0; i < 4096 - 100; i++)
+        ping_pong(heartbeat, state, milliseconds(2));
+    percentiles = heartbeat.GetRttPercentiles();
+    CHECK(percentiles.Samples == 4096 && percentiles.P50 == 2 && percentiles.Max == 2);
+}
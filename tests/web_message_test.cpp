@@ -0,0 +1,109 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "web_message.h"
+#include "web_server.h"
+#include <cmath>
+
+using namespace std;
+
+struct sample_message {
+    static constexpr uint16_t Id = 300;
+    static constexpr const char* Name = "sample";
+    uint32_t Count = 7;
+    int64_t Delta = 0;
+    double Ratio = 0;
+    string Text;
+    bool Flag = false;
+    static constexpr auto Fields = make_tuple(web_message::field("count", &sample_message::Count),
+                                              web_message::field("delta", &sample_message::Delta),
+                                              web_message::field("ratio", &sample_message::Ratio),
+                                              web_message::field("text", &sample_message::Text),
+                                              web_message::field("flag", &sample_message::Flag));
+};
+
+static vector<uint8_t> encode(const sample_message& message) {
+    vector<uint8_t> out;
+    web_message::Encode(message, out);
+    return out;
+}
+
+TEST_CASE(web_message, round_trip) {
+    for(int64_t delta : { int64_t(0), int64_t(-1), int64_t(63), int64_t(-64), INT64_MIN, INT64_MAX }) {
+        sample_message message { 300000, delta, -2.5, string(200, 'x'), true };
+        auto encoded = encode(message);
+        CHECK(encoded[0] == 300 % 256 && encoded[1] == 300 / 256);
+        sample_message decoded;
+        CHECK(web_message::Decode(encoded, decoded));
+        CHECK(decoded.Count == message.Count && decoded.Delta == delta && decoded.Ratio == -2.5);
+        CHECK(decoded.Text == message.Text && decoded.Flag);
+    }
+    // small values take a single byte each
+    CHECK(encode(sample_message { 1, -1, 0, "", false }).size() == 2 + 1 + 1 + 8 + 1 + 1);
+}
+
+TEST_CASE(web_message, older_and_newer_senders) {
+    sample_message message { 5, -3, 1.5, "hello", true };
+    auto encoded = encode(message);
+    // an older sender stops after the first two fields, the rest keep their defaults
+    vector<uint8_t> older(encoded.begin(), encoded.begin() + 4);
+    sample_message decoded;
+    CHECK(web_message::Decode(older, decoded));
+    CHECK(decoded.Count == 5 && decoded.Delta == -3 && decoded.Ratio == 0 && decoded.Text.empty() && !decoded.Flag);
+    // a newer sender appends fields we do not know
+    auto newer = encoded;
+    web_message::WriteString(newer, "future");
+    CHECK(web_message::Decode(newer, decoded) && decoded.Text == "hello" && decoded.Flag);
+}
+
+TEST_CASE(web_message, malformed_payloads_are_rejected) {
+    auto encoded = encode(sample_message { 5, -3, 1.5, "hello", true });
+    sample_message decoded;
+    CHECK(!web_message::Decode(span<const uint8_t>(encoded).first(1), decoded));
+    auto other = encoded;
+    other[0]++;
+    CHECK(!web_message::Decode(other, decoded)); // another message id
+    // cut inside the double and inside the string
+    CHECK(!web_message::Decode(span<const uint8_t>(encoded).first(8), decoded));
+    CHECK(!web_message::Decode(span<const uint8_t>(encoded).first(encoded.size() - 3), decoded));
+
+    vector<uint8_t> unterminated { 0x2C, 0x01, 0x80, 0x80 };
+    CHECK(!web_message::Decode(unterminated, decoded));
+    vector<uint8_t> overlong(12, 0x80);
+    span<const uint8_t> in(overlong);
+    uint64_t value;
+    CHECK(!web_message::ReadVarint(in, value) && in.size() == overlong.size());
+    vector<uint8_t> long_string { 0x05, 'a', 'b' };
+    in = long_string;
+    string text;
+    CHECK(!web_message::ReadString(in, text));
+}
+
+TEST_CASE(web_message, dispatcher_routes_by_id) {
+    web_message::dispatcher dispatcher;
+    int calls = 0;
+    dispatcher.On<sample_message>([&](client_ctx&, sample_message& message) {
+        calls++;
+        CHECK(message.Text == "hello");
+    });
+    client_ctx client;
+    auto dispatch = [&](vector<uint8_t> payload, web_socket_opcode opcode = web_socket_opcode::BinaryFrame) {
+        web_packet_view packet;
+        packet.OpCode = opcode;
+        packet.Payload = payload;
+        return dispatcher.Dispatch(client, packet);
+    };
+    auto encoded = encode(sample_message { 5, -3, 1.5, "hello", true });
+    CHECK(dispatch(encoded) == websocket_callback_status::processed && calls == 1);
+    CHECK(dispatch(encoded, web_socket_opcode::TextFrame) == websocket_callback_status::ignore);
+    CHECK(dispatch({ 0x01, 0x00 }) == websocket_callback_status::ignore); // no handler
+    CHECK(dispatch({ 0x2C }) == websocket_callback_status::ignore);
+    encoded.resize(encoded.size() - 3);
+    CHECK(dispatch(encoded) == websocket_callback_status::ignore); // malformed, the handler is not called
+    CHECK(calls == 1);
+
+    CHECK(dispatcher.SchemaAsJSON() == R"({"messages":[{"id":300,"name":"sample","fields":[["count","uint"],)"
+                                       R"(["delta","sint"],["ratio","float64"],["text","string"],["flag","uint"]]}]})");
+}
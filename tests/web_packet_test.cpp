@@ -0,0 +1,147 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "web_packet.h"
+#include "ring_buffer.h"
+#include <cstring>
+
+using namespace std;
+
+static vector<uint8_t> frame(web_socket_opcode opcode, size_t payload_size, bool final_fragment = true) {
+    web_packet packet;
+    packet.OpCode = opcode;
+    packet.FinalFragment = final_fragment;
+    packet.Payload.resize(payload_size);
+    for(size_t i = 0; i < payload_size; i++)
+        packet.Payload[i] = uint8_t(i * 7);
+    return packet.ToBinaryStream();
+}
+
+static web_packet_parse_code parse(span<const uint8_t> data, web_frame_header& header,
+                                   uint64_t max_payload_length = 1ull << 40) {
+    header = {};
+    return web_frame_header::Parse(data, max_payload_length, header);
+}
+
+// 7, 16 and 64-bit lengths, each on both sides of the boundary, with every cut of the header reported as missing.
+TEST_CASE(web_packet, payload_lengths) {
+    web_frame_header header;
+    for(size_t length : { size_t(0), size_t(125), size_t(126), size_t(65535), size_t(65536), size_t(70000) }) {
+        auto data = frame(web_socket_opcode::BinaryFrame, length);
+        size_t header_size = length < 126 ? 2 : length <= 65535 ? 4 : 10;
+        CHECK(data.size() == header_size + length);
+        for(size_t cut = 0; cut < header_size; cut++)
+            CHECK(parse(span(data).first(cut), header) == web_packet_parse_code::missing_header);
+        // the header alone is enough, the payload is the caller's to wait for
+        CHECK(parse(span(data).first(header_size), header) == web_packet_parse_code::complete);
+        CHECK(header.PayloadLength == length && header.HeaderSize == header_size);
+        CHECK(header.FrameSize() == data.size() && header.OpCode == web_socket_opcode::BinaryFrame);
+        CHECK(header.FinalFragment && !header.MaskFlag && !header.RSV1);
+    }
+
+    // a 64-bit length beyond 32 bits, in network order
+    const uint8_t huge[] = { 0x82, 127, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+    CHECK(parse(huge, header, UINT64_MAX) == web_packet_parse_code::complete);
+    CHECK(header.PayloadLength == 0x010203040506ull);
+}
+
+TEST_CASE(web_packet, size_limit) {
+    web_frame_header header;
+    auto data = frame(web_socket_opcode::TextFrame, 1000);
+    CHECK(parse(data, header, 1000) == web_packet_parse_code::complete);
+    CHECK(parse(data, header, 999) == web_packet_parse_code::error);
+    // rejected from the header alone, before the payload arrived
+    CHECK(parse(span(data).first(4), header, 999) == web_packet_parse_code::error);
+    const uint8_t huge[] = { 0x82, 127, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    CHECK(parse(huge, header) == web_packet_parse_code::error);
+}
+
+TEST_CASE(web_packet, control_frames) {
+    web_frame_header header;
+    for(auto opcode : { web_socket_opcode::PingFrame, web_socket_opcode::PongFrame,
+                        web_socket_opcode::ConnectionCloseFrame }) {
+        CHECK(parse(frame(opcode, 125), header) == web_packet_parse_code::complete && header.IsControl());
+        // control frames are never fragmented and carry at most 125 bytes
+        CHECK(parse(frame(opcode, 10, false), header) == web_packet_parse_code::error);
+        CHECK(parse(frame(opcode, 126), header) == web_packet_parse_code::error);
+    }
+    // data frames may be fragmented
+    CHECK(parse(frame(web_socket_opcode::TextFrame, 10, false), header) == web_packet_parse_code::complete);
+    CHECK(!header.FinalFragment && !header.IsControl());
+    CHECK(parse(frame(web_socket_opcode::ContinuationFrame, 10), header) == web_packet_parse_code::complete);
+    // reserved opcodes fail the connection
+    for(uint8_t opcode : { 0x3, 0x7, 0xB, 0xF }) {
+        const uint8_t data[] = { uint8_t(0x80 | opcode), 0 };
+        CHECK(parse(data, header) == web_packet_parse_code::error);
+    }
+}
+
+TEST_CASE(web_packet, masked_frames) {
+    web_packet packet = web_packet::TextPacket("masked payload");
+    packet.MaskFlag = true;
+    const uint8_t mask[4] = { 0xA1, 0xB2, 0xC3, 0xD4 };
+    memcpy(packet.Mask, mask, 4);
+    auto data = packet.ToBinaryStream();
+    CHECK(packet.GetPayloadAsString() == "masked payload"); // serializing leaves the payload unmasked
+
+    web_frame_header header;
+    CHECK(parse(span(data).first(5), header) == web_packet_parse_code::missing_header);
+    CHECK(parse(data, header) == web_packet_parse_code::complete);
+    CHECK(header.MaskFlag && header.HeaderSize == 6 && memcmp(header.Mask, mask, 4) == 0);
+    string unmasked;
+    for(size_t i = 0; i < header.PayloadLength; i++)
+        unmasked += char(data[header.HeaderSize + i] ^ mask[i % 4]);
+    CHECK(unmasked == "masked payload");
+}
+
+// Parses the complete frames at the front of the buffer the way the server does, returns their payloads.
+static vector<string> parse_frames(ring_buffer& buffer) {
+    vector<string> payloads;
+    while(!buffer.Empty()) {
+        auto data = buffer.Readable();
+        web_frame_header header;
+        if(parse(data, header) != web_packet_parse_code::complete)
+            break;
+        if(data.size() < header.FrameSize()) {
+            buffer.Reserve(header.FrameSize());
+            break;
+        }
+        payloads.emplace_back(data.begin() + header.HeaderSize, data.begin() + header.FrameSize());
+        buffer.Consume(header.FrameSize());
+    }
+    return payloads;
+}
+
+static string payload_of(const vector<uint8_t>& frame, size_t header_size) {
+    return { frame.begin() + header_size, frame.end() };
+}
+
+static void receive(ring_buffer& buffer, span<const uint8_t> data) {
+    auto writable = buffer.Writable(data.size());
+    memcpy(writable.data(), data.data(), data.size());
+    buffer.Commit(data.size());
+}
+
+// A frame that reaches past the end of the receive buffer is completed at the front, in one contiguous piece and
+// without growing the buffer, whether the cut is in its header or in its payload.
+TEST_CASE(web_packet, frames_split_at_buffer_end) {
+    for(size_t cut : { size_t(1), size_t(3), size_t(90) }) {
+        ring_buffer buffer;
+        auto first = frame(web_socket_opcode::BinaryFrame, 3996);
+        auto second = frame(web_socket_opcode::BinaryFrame, 300);
+        CHECK(first.size() == 4000);
+        receive(buffer, first);
+        size_t capacity = buffer.Capacity();
+        CHECK(capacity - first.size() < second.size());
+        receive(buffer, span(second).first(cut));
+        CHECK(parse_frames(buffer) == vector<string>({ payload_of(first, 4) }));
+        CHECK(buffer.Size() == cut);
+
+        receive(buffer, span(second).subspan(cut));
+        CHECK(buffer.Capacity() == capacity);
+        CHECK(parse_frames(buffer) == vector<string>({ payload_of(second, 4) }));
+        CHECK(buffer.Empty() && buffer.Capacity() == 0);
+    }
+}
@@ -0,0 +1,218 @@
+//
+// Created by youssef on 10/18/2026.
+//
+
+#include "test.h"
+#include "web_server.h"
+#include <thread>
+
+using namespace std;
+
+static constexpr uint16_t TestPort = 47391;
+
+// Client frames are always masked.
+static string masked_text_frame(const string& text) {
+    const uint8_t mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+    string frame { char(0x81), char(0x80 | text.size()) };
+    frame.append(reinterpret_cast<const char*>(mask), 4);
+    for(size_t i = 0; i < text.size(); i++)
+        frame += char(text[i] ^ mask[i % 4]);
+    return frame;
+}
+
+// Runs the server loop until done() holds, false if it never does.
+template<class Condition>
+static bool serve_until(web_server& server, Condition done) {
+    for(int i = 0; i < 200; i++) {
+        server.Serve();
+        if(done())
+            return true;
+    }
+    return false;
+}
+
+// Readiness is matched to the connection, not to its name, so a renamed client is still read from.
+TEST_CASE(web_server, renamed_client_keeps_receiving) {
+    web_server server(TestPort);
+    vector<string> received;
+    bool renamed = false;
+    server.AddWebSocketHandler([&](client_ctx& client, web_packet_view& packet) {
+        auto text = packet.GetPayloadAsString();
+        if(text.starts_with("/set_name ")) {
+            client.Name = text.substr(10);
+            renamed = true;
+        } else {
+            received.push_back(client.Name + ": " + text);
+        }
+        return websocket_callback_status::processed;
+    });
+
+    sw::Socket socket(sw::SocketType::TCP);
+    socket.Connect("127.0.0.1", TestPort);
+    socket.SetBlockingMode(false);
+    socket.Send("GET /Stats HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+    string response;
+    CHECK(serve_until(server, [&] {
+        char buffer[1024];
+        int32_t length = socket.Recv(buffer, sizeof(buffer), false);
+        if(length > 0)
+            response.append(buffer, size_t(length));
+        return response.find("\r\n\r\n") != string::npos;
+    }));
+    CHECK(response.starts_with("HTTP/1.1 101"));
+
+    socket.Send(masked_text_frame("/set_name alice"));
+    CHECK(serve_until(server, [&] { return renamed; }));
+    // the frame arrives after the rename, in a read of its own
+    socket.Send(masked_text_frame("hello"));
+    CHECK(serve_until(server, [&] { return !received.empty(); }));
+    CHECK(received == vector<string>({ "alice: hello" }));
+
+    socket.Send(masked_text_frame("again"));
+    CHECK(serve_until(server, [&] { return received.size() == 2; }));
+    CHECK(received.size() == 2 && received[1] == "alice: again");
+    socket.Disconnect().Close();
+}
+
+static web_frame_buffer serialized(const string& text, web_socket_opcode opcode = web_socket_opcode::TextFrame) {
+    web_packet packet = web_packet::TextPacket(text);
+    packet.OpCode = opcode;
+    return make_shared<const vector<uint8_t>>(packet.ToBinaryStream());
+}
+
+// A websocket whose peer never reads. The first frame fills the socket buffers and stays half written at the front of
+// the queue, everything queued after it waits there.
+struct stalled_client {
+    sw::Socket Listener { sw::SocketType::TCP };
+    sw::Socket Peer { sw::SocketType::TCP };
+    client_ctx Client;
+    web_frame_buffer Filler = make_shared<const vector<uint8_t>>(32 * 1024 * 1024, uint8_t(0));
+
+    explicit stalled_client(websocket_backlog_policy policy, size_t filler_key = 0) {
+        Listener.SetReuseAddrOption(true).Bind(sw::SocketInterface::Any, TestPort + 1).Listen(1);
+        Peer.Connect("127.0.0.1", TestPort + 1);
+        Client.connection = Listener.Accept();
+        Client.connection.SetBlockingMode(false);
+        Client.SendPolicy = { policy, SIZE_MAX, chrono::hours(1) };
+        Client.SendFrame(Filler, filler_key);
+    }
+
+    ~stalled_client() {
+        Peer.Disconnect().Close();
+        Client.connection.Disconnect().Close();
+        Listener.Close();
+    }
+
+    // Frames queued behind the half written one.
+    [[nodiscard]] vector<web_frame_buffer> Waiting() const {
+        vector<web_frame_buffer> frames;
+        for(size_t i = 1; i < Client.SendQueue.size(); i++)
+            frames.push_back(Client.SendQueue[i].Frame);
+        return frames;
+    }
+
+    // Lets extra more bytes be queued before the backlog policy applies.
+    void Limit(size_t extra) { Client.SendPolicy.MaxQueuedBytes = Client.QueuedBytes + extra; }
+
+    // Every queued frame is now older than the backlog age.
+    void Expire() {
+        this_thread::sleep_for(chrono::milliseconds(2));
+        Client.SendPolicy.MaxBacklogAge = chrono::milliseconds(0);
+    }
+};
+
+TEST_CASE(web_server, send_queue_drop_oldest) {
+    stalled_client stalled(websocket_backlog_policy::drop_oldest);
+    auto& client = stalled.Client;
+    CHECK(client.SendOffset > 0 && client.SendQueue.size() == 1);
+    CHECK(client.QueuedBytes == stalled.Filler->size() - client.SendOffset);
+
+    vector<web_frame_buffer> frames;
+    for(char letter = 'a'; letter < 'f'; letter++)
+        frames.push_back(serialized(string(1000, letter)));
+    stalled.Limit(2 * frames[0]->size() + 500);
+    for(auto& frame : frames)
+        client.SendFrame(frame);
+    CHECK(stalled.Waiting() == vector<web_frame_buffer>({ frames[3], frames[4] }));
+    CHECK(client.DroppedFrames == 3 && !client.SlowConsumer);
+    CHECK(client.QueuedBytes == stalled.Filler->size() - client.SendOffset + 2 * frames[0]->size());
+
+    // frames past the backlog age are dropped too, but never the half written one
+    stalled.Expire();
+    CHECK(client.FlushSendQueue() && stalled.Waiting().empty() && client.SendQueue.size() == 1);
+    CHECK(client.DroppedFrames == 5 && !client.SlowConsumer);
+}
+
+TEST_CASE(web_server, send_queue_coalesce_latest) {
+    stalled_client stalled(websocket_backlog_policy::coalesce_latest, 5);
+    auto& client = stalled.Client;
+    auto first = serialized("snapshot 1"), second = serialized("snapshot 2"), other = serialized("other topic");
+    auto message = serialized("chat 1"), next_message = serialized("chat 2");
+    client.SendFrame(first, 7);
+    client.SendFrame(message);
+    client.SendFrame(second, 7);
+    client.SendFrame(next_message);
+    client.SendFrame(other, 9);
+    // the newest snapshot takes the place of the queued one, frames without a key are all kept
+    CHECK(stalled.Waiting() == vector<web_frame_buffer>({ second, message, next_message, other }));
+    CHECK(client.DroppedFrames == 1);
+
+    // the half written frame is never replaced, nor is a frame compressed against the connection's history
+    auto after_filler = serialized("after filler"), compressed = serialized("compressed");
+    auto latest = serialized("latest");
+    client.SendFrame(after_filler, 5);
+    client.SendFrame(compressed, 11, queued_frame_kind::stream);
+    client.SendFrame(latest, 11);
+    CHECK(stalled.Waiting() == vector<web_frame_buffer>({ second, message, next_message, other, after_filler,
+                                                          compressed, latest }));
+
+    // clients that do not coalesce keep every keyed frame
+    client.SendPolicy.Policy = websocket_backlog_policy::drop_oldest;
+    auto third = serialized("snapshot 3");
+    client.SendFrame(third, 7);
+    CHECK(stalled.Waiting().size() == 8 && stalled.Waiting().back() == third && client.DroppedFrames == 1);
+}
+
+TEST_CASE(web_server, send_queue_disconnect) {
+    {
+        stalled_client stalled(websocket_backlog_policy::disconnect);
+        auto& client = stalled.Client;
+        stalled.Limit(150);
+        client.SendFrame(serialized(string(50, 'x')));
+        CHECK(!client.SlowConsumer && stalled.Waiting().size() == 1);
+        client.SendFrame(serialized(string(100, 'y')));
+        CHECK(client.SlowConsumer && client.DroppedFrames == 0);
+    }
+    {
+        // dropping data frames is not enough when control frames alone are over the limit
+        stalled_client stalled(websocket_backlog_policy::drop_oldest);
+        auto& client = stalled.Client;
+        stalled.Limit(150);
+        auto ping = serialized(string(100, 'p'), web_socket_opcode::PingFrame);
+        client.SendFrame(serialized(string(100, 'x')));
+        client.SendFrame(ping, 0, queued_frame_kind::control);
+        CHECK(!client.SlowConsumer && client.DroppedFrames == 1);
+        client.SendFrame(ping, 0, queued_frame_kind::control);
+        CHECK(client.SlowConsumer && !client.FlushSendQueue());
+    }
+}
+
+// Pings and pongs go out right after the frame being written, in the order they were queued, and are never dropped.
+TEST_CASE(web_server, control_frames_jump_the_queue) {
+    stalled_client stalled(websocket_backlog_policy::drop_oldest);
+    auto& client = stalled.Client;
+    auto data = serialized("data"), compressed = serialized("compressed"), more_data = serialized("more data");
+    auto ping = serialized("1", web_socket_opcode::PingFrame);
+    auto pong = serialized("2", web_socket_opcode::PongFrame);
+    client.SendFrame(data);
+    client.SendFrame(compressed, 0, queued_frame_kind::stream);
+    client.SendFrame(ping, 0, queued_frame_kind::control);
+    client.SendFrame(more_data);
+    client.SendFrame(pong, 0, queued_frame_kind::control);
+    CHECK(stalled.Waiting() == vector<web_frame_buffer>({ ping, pong, data, compressed, more_data }));
+
+    stalled.Expire();
+    CHECK(client.FlushSendQueue() && client.DroppedFrames == 2);
+    CHECK(stalled.Waiting() == vector<web_frame_buffer>({ ping, pong, compressed }));
+}
@@ -1,9 +1,41 @@
 let socket;
 let reconnectInterval = 2000; // 2 seconds
 let totalPhysicalMemory = 1; // Initialize with a default value
+let stats = null; // merged state of the last snapshot and the deltas after it
+let statsGeneration = -1;
+let statsFields = [];
+
+// Snapshots carry "k" (their generation), deltas carry the generation they apply to and only the changed fields.
+function mergeStats(message) {
+    if (message instanceof ArrayBuffer) {
+        const view = new DataView(message);
+        if (view.byteLength < 5 || view.getUint8(0) !== 0x44 || view.getUint32(1, true) !== statsGeneration) {
+            return null;
+        }
+        for (let offset = 5; offset + 9 <= view.byteLength; offset += 9) {
+            stats[statsFields[view.getUint8(offset)]] = view.getFloat64(offset + 1, true);
+        }
+        return stats;
+    }
+    const data = JSON.parse(message);
+    if (data.d !== undefined) {
+        if (data.k !== statsGeneration) {
+            return null; // belongs to a snapshot we never got, wait for the next one
+        }
+        Object.assign(stats, data.d);
+        return stats;
+    }
+    if (data.k !== undefined) {
+        statsGeneration = data.k;
+        statsFields = data.f || [];
+    }
+    stats = data;
+    return stats;
+}
 
 function connectWebSocket() {
     socket = new WebSocket('ws://192.168.1.242:80/Stats');
+    socket.binaryType = 'arraybuffer';
 
     socket.onopen = function() {
         console.log('WebSocket connection established.');
@@ -11,6 +43,13 @@ function connectWebSocket() {
     };
 
     socket.onmessage = function(event) {
+        if (event.data instanceof ArrayBuffer) {
+            const data = mergeStats(event.data);
+            if (data) {
+                updateCharts(data);
+            }
+            return;
+        }
         const message = event.data.trim();
 
         if (message === 'refresh') {
@@ -20,19 +59,10 @@ function connectWebSocket() {
         }
 
         try {
-            const data = JSON.parse(message);
-            const cpuUsage = data.cpu_usage;
-            totalPhysicalMemory = data.total_physical_memory / 1e9; // Convert bytes to GB
-            const usedMemory = data.total_used_memory / 1e9; // Convert bytes to GB
-
-            // Update CPU usage chart
-            cpuChart.data.datasets[0].data[0] = cpuUsage;
-            cpuChart.update();
-
-            // Update memory usage chart
-            memoryChart.options.scales.y.max = totalPhysicalMemory;
-            memoryChart.data.datasets[0].data[0] = usedMemory;
-            memoryChart.update();
+            const data = mergeStats(message);
+            if (data) {
+                updateCharts(data);
+            }
         } catch (e) {
             logMessage(message);
         }
@@ -52,6 +82,21 @@ function connectWebSocket() {
 
 }
 
+function updateCharts(data) {
+    const cpuUsage = data.cpu_usage;
+    totalPhysicalMemory = data.total_physical_memory / 1e9; // Convert bytes to GB
+    const usedMemory = data.total_used_memory / 1e9; // Convert bytes to GB
+
+    // Update CPU usage chart
+    cpuChart.data.datasets[0].data[0] = cpuUsage;
+    cpuChart.update();
+
+    // Update memory usage chart
+    memoryChart.options.scales.y.max = totalPhysicalMemory;
+    memoryChart.data.datasets[0].data[0] = usedMemory;
+    memoryChart.update();
+}
+
 function logMessage(message) {
     const messageLog = document.getElementById('messageLog');
     messageLog.value += message + '\n';
@@ -0,0 +1,98 @@
+// Decoder/encoder for the binary web_message frames (see src/web_message.h).
+// The codecs are built from /message_schema.json, so they always match the server.
+class WebMessages {
+    constructor(schema) {
+        this.byId = new Map();
+        this.byName = new Map();
+        for (const message of schema.messages) {
+            this.byId.set(message.id, message);
+            this.byName.set(message.name, message);
+        }
+    }
+
+    static async load(url = '/message_schema.json') {
+        const response = await fetch(url);
+        return new WebMessages(await response.json());
+    }
+
+    // Returns {name, fields} or null for unknown/malformed messages.
+    decode(buffer) {
+        const bytes = new Uint8Array(buffer);
+        if (bytes.length < 2) {
+            return null;
+        }
+        const message = this.byId.get(bytes[0] | (bytes[1] << 8));
+        if (!message) {
+            return null;
+        }
+        const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+        let offset = 2;
+        const readVarint = () => {
+            let value = 0n;
+            for (let shift = 0n; offset < bytes.length && shift < 70n; shift += 7n) {
+                const byte = bytes[offset++];
+                value |= BigInt(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                    return value;
+                }
+            }
+            throw new Error('truncated varint');
+        };
+        const fields = {};
+        try {
+            // fields missing at the end keep their defaults, like the C++ decoder
+            for (const [name, type] of message.fields) {
+                if (offset >= bytes.length) {
+                    break;
+                }
+                if (type === 'uint') {
+                    fields[name] = Number(readVarint());
+                } else if (type === 'sint') {
+                    const raw = readVarint();
+                    fields[name] = Number((raw >> 1n) ^ -(raw & 1n));
+                } else if (type === 'float64') {
+                    fields[name] = view.getFloat64(offset, true);
+                    offset += 8;
+                } else {
+                    const length = Number(readVarint());
+                    fields[name] = new TextDecoder().decode(bytes.subarray(offset, offset + length));
+                    offset += length;
+                }
+            }
+        } catch (e) {
+            return null;
+        }
+        return { name: message.name, fields };
+    }
+
+    encode(name, fields) {
+        const message = this.byName.get(name);
+        const out = [message.id & 0xFF, message.id >> 8];
+        const writeVarint = (value) => {
+            value = BigInt(value);
+            while (value >= 0x80n) {
+                out.push(Number(value & 0x7Fn) | 0x80);
+                value >>= 7n;
+            }
+            out.push(Number(value));
+        };
+        for (const [field, type] of message.fields) {
+            const value = fields[field];
+            if (type === 'uint') {
+                writeVarint(value || 0);
+            } else if (type === 'sint') {
+                const signed = BigInt.asIntN(64, BigInt(value || 0));
+                writeVarint(BigInt.asUintN(64, (signed << 1n) ^ (signed >> 63n)));
+            } else if (type === 'float64') {
+                const bytes = new Uint8Array(8);
+                new DataView(bytes.buffer).setFloat64(0, value || 0, true);
+                out.push(...bytes);
+            } else {
+                const bytes = new TextEncoder().encode(value || '');
+                writeVarint(bytes.length);
+                out.push(...bytes);
+            }
+        }
+        return new Uint8Array(out).buffer;
+    }
+}